@@ -0,0 +1,210 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_BENCHMARK_HH
+# define HPP_MODEL_BENCHMARK_HH
+
+# include <sys/time.h>
+# include <unistd.h>
+
+# include <algorithm>
+# include <ctime>
+# include <fstream>
+# include <iostream>
+# include <limits>
+# include <sstream>
+# include <string>
+# include <utility>
+# include <vector>
+
+# include <boost/function.hpp>
+
+# include "hpp/model/exception.hh"
+
+namespace hpp {
+  namespace model {
+    namespace benchmark {
+      inline double now ()
+      {
+	struct timeval tv;
+	gettimeofday (&tv, 0);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+      }
+
+      /// \brief Pseudo-random generator with a fixed seed
+
+      /// Benchmarks draw the same configurations from one run to the
+      /// next, whatever the platform.
+      class Random
+      {
+      public:
+	explicit Random (unsigned long seed = 1) : state_ (seed) {}
+
+	/// \brief Uniform number in [lower, upper]
+	double uniform (double lower, double upper)
+	{
+	  state_ = (state_ * 6364136223846793005ULL + 1442695040888963407ULL);
+	  const double u = double (state_ >> 11) / double (1ULL << 53);
+	  return lower + u * (upper - lower);
+	}
+
+      private:
+	unsigned long long state_;
+      }; // class Random
+
+      /// \brief Timings of a set of benchmarks, written as JSON
+
+      /// Each benchmark runs a function a number of times per
+      /// repetition, after one warm-up repetition. The time per call of
+      /// each repetition is recorded; the report gives minimum, median
+      /// and mean over repetitions.
+      class Report
+      {
+      public:
+	typedef boost::function<void ()> Function_t;
+
+	/// \brief Constructor
+	/// \param suite name of the benchmark suite,
+	/// \param repetitions number of timed repetitions per benchmark.
+	Report (const std::string& suite, std::size_t repetitions = 7)
+	  : suite_ (suite), repetitions_ (repetitions), context_ (),
+	    results_ ()
+	{
+	}
+
+	/// \brief Add a key describing the context of the run
+	void context (const std::string& key, const std::string& value)
+	{
+	  context_.push_back (std::make_pair (key, "\"" + value + "\""));
+	}
+
+	/// \brief Add a numerical key describing the context of the run
+	void context (const std::string& key, double value)
+	{
+	  std::ostringstream oss;
+	  oss << value;
+	  context_.push_back (std::make_pair (key, oss.str ()));
+	}
+
+	/// \brief Time a function
+	/// \param name name of the benchmark,
+	/// \param function function to call,
+	/// \param calls number of calls per repetition.
+	void run (const std::string& name, const Function_t& function,
+		  std::size_t calls)
+	{
+	  std::vector<double> samples;
+	  for (std::size_t r = 0; r <= repetitions_; ++r) {
+	    const double start = now ();
+	    for (std::size_t i = 0; i < calls; ++i) function ();
+	    // First repetition warms caches up.
+	    if (r > 0) samples.push_back (1e9 * (now () - start) / calls);
+	  }
+	  add (name, calls, samples);
+	}
+
+	/// \brief Record timings measured by the caller
+	/// \param name name of the benchmark,
+	/// \param calls number of calls per sample,
+	/// \param samples time per call of each repetition in nanoseconds.
+	void add (const std::string& name, std::size_t calls,
+		  std::vector<double> samples)
+	{
+	  if (samples.empty ()) {
+	    throw Exception ("No sample for benchmark " + name + ".");
+	  }
+	  Result result;
+	  result.name = name;
+	  result.calls = calls;
+	  result.repetitions = samples.size ();
+	  std::sort (samples.begin (), samples.end ());
+	  result.min = samples.front ();
+	  result.median = samples [samples.size () / 2];
+	  result.mean = 0;
+	  for (std::size_t i = 0; i < samples.size (); ++i) {
+	    result.mean += samples [i] / samples.size ();
+	  }
+	  results_.push_back (result);
+	  std::cout << name << "\t" << result.median << " ns" << std::endl;
+	}
+
+	/// \brief Write report
+	void write (std::ostream& os) const
+	{
+	  char host [256] = "";
+	  gethostname (host, sizeof (host) - 1);
+	  const std::streamsize precision = os.precision ();
+	  os.precision (std::numeric_limits<double>::digits10);
+	  os << "{" << std::endl
+	     << "  \"suite\": \"" << suite_ << "\"," << std::endl
+	     << "  \"host\": \"" << host << "\"," << std::endl
+	     << "  \"time\": " << std::time (0) << "," << std::endl
+	     << "  \"context\": {";
+	  for (std::size_t i = 0; i < context_.size (); ++i) {
+	    os << (i == 0 ? "" : ",") << std::endl << "    \""
+	       << context_ [i].first << "\": " << context_ [i].second;
+	  }
+	  os << std::endl << "  }," << std::endl
+	     << "  \"benchmarks\": [";
+	  for (std::size_t i = 0; i < results_.size (); ++i) {
+	    const Result& result = results_ [i];
+	    os << (i == 0 ? "" : ",") << std::endl
+	       << "    {\"name\": \"" << result.name << "\", "
+	       << "\"calls\": " << result.calls << ", "
+	       << "\"repetitions\": " << result.repetitions << ", "
+	       << "\"unit\": \"ns\", "
+	       << "\"min\": " << result.min << ", "
+	       << "\"median\": " << result.median << ", "
+	       << "\"mean\": " << result.mean << "}";
+	  }
+	  os << std::endl << "  ]" << std::endl << "}" << std::endl;
+	  os.precision (precision);
+	}
+
+	/// \brief Write report to a file
+	void write (const std::string& filename) const
+	{
+	  std::ofstream file (filename.c_str ());
+	  write (file);
+	  if (!file) {
+	    throw Exception ("Failed to write " + filename + ".");
+	  }
+	}
+
+      private:
+	struct Result
+	{
+	  std::string name;
+	  std::size_t calls;
+	  std::size_t repetitions;
+	  double min;
+	  double median;
+	  double mean;
+	};
+
+	std::string suite_;
+	std::size_t repetitions_;
+	std::vector<std::pair<std::string, std::string> > context_;
+	std::vector<Result> results_;
+      }; // class Report
+    } // namespace benchmark
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_BENCHMARK_HH
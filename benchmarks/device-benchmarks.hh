@@ -0,0 +1,244 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_DEVICE_BENCHMARKS_HH
+# define HPP_MODEL_DEVICE_BENCHMARKS_HH
+
+# include <algorithm>
+# include <cmath>
+# include <string>
+# include <vector>
+
+# include "hpp/model/capsule-body-distance.hh"
+# include "hpp/model/device.hh"
+# include "hpp/model/kinematic-tree.hh"
+
+# include "benchmark.hh"
+
+namespace hpp {
+  namespace model {
+    namespace benchmark {
+      /// \brief Draw configurations in joint bounds
+
+      /// Unbounded degrees of freedom are drawn in [-pi, pi].
+      inline std::vector<vectorN>
+      drawConfigs (const KinematicTreeConstShPtr& tree, std::size_t nbConfigs)
+      {
+	Random random;
+	std::vector<vectorN> configs;
+	for (std::size_t k = 0; k < nbConfigs; ++k) {
+	  vectorN config (tree->numberDof ());
+	  for (std::size_t i = 0; i < tree->numberDof (); ++i) {
+	    const double lower = std::max (tree->lowerBound (i), -M_PI);
+	    const double upper = std::min (tree->upperBound (i), M_PI);
+	    config [i] = random.uniform (lower, upper);
+	  }
+	  configs.push_back (config);
+	}
+	return configs;
+      }
+
+      struct SetCurrentConfig
+      {
+	SetCurrentConfig (const DeviceShPtr& device,
+			  const std::vector<vectorN>& configs,
+			  Device::EwhichPart part)
+	  : device (device), configs (configs), part (part), k (0) {}
+	void operator () ()
+	{
+	  device->hppSetCurrentConfig (configs [k++ % configs.size ()], part);
+	}
+	DeviceShPtr device;
+	const std::vector<vectorN>& configs;
+	Device::EwhichPart part;
+	std::size_t k;
+      };
+
+      struct JrlToKws
+      {
+	JrlToKws (const DeviceShPtr& device,
+		  const std::vector<vectorN>& configs)
+	  : device (device), configs (configs), output (), k (0) {}
+	void operator () ()
+	{
+	  device->jrlDynamicsToKwsDofValues (configs [k++ % configs.size ()],
+					     output);
+	}
+	DeviceShPtr device;
+	const std::vector<vectorN>& configs;
+	std::vector<double> output;
+	std::size_t k;
+      };
+
+      struct KwsToJrl
+      {
+	KwsToJrl (const DeviceShPtr& device,
+		  const std::vector<std::vector<double> >& configs)
+	  : device (device), configs (configs),
+	    output (device->kinematicTree ()->numberDof ()), k (0) {}
+	void operator () ()
+	{
+	  device->kwsToJrlDynamicsDofValues (configs [k++ % configs.size ()],
+					     output);
+	}
+	DeviceShPtr device;
+	const std::vector<std::vector<double> >& configs;
+	vectorN output;
+	std::size_t k;
+      };
+
+      struct ForwardKinematics
+      {
+	ForwardKinematics (const KinematicTreeConstShPtr& tree,
+			   const std::vector<vectorN>& configs)
+	  : tree (tree), configs (configs.size () * tree->numberDof ()),
+	    transforms (12 * tree->nbJoints ()), k (0)
+	{
+	  for (std::size_t c = 0; c < configs.size (); ++c) {
+	    for (std::size_t i = 0; i < tree->numberDof (); ++i) {
+	      this->configs [c * tree->numberDof () + i] = configs [c][i];
+	    }
+	  }
+	}
+	void operator () ()
+	{
+	  const std::size_t nbConfigs = configs.size () / tree->numberDof ();
+	  tree->forwardKinematics
+	    (&configs [(k++ % nbConfigs) * tree->numberDof ()],
+	     &transforms [0]);
+	}
+	KinematicTreeConstShPtr tree;
+	std::vector<double> configs;
+	std::vector<double> transforms;
+	std::size_t k;
+      };
+
+      struct BoundingBox
+      {
+	explicit BoundingBox (const DeviceShPtr& device) : device (device) {}
+	void operator () ()
+	{
+	  double xMin, yMin, zMin, xMax, yMax, zMax;
+	  device->axisAlignedBoundingBox (xMin, yMin, zMin, xMax, yMax, zMax);
+	}
+	DeviceShPtr device;
+      };
+
+      /// \brief Compute all distance pairs of a set of body distances
+      struct Distances
+      {
+	explicit Distances (const std::vector<BodyDistanceShPtr>& distances)
+	  : distances (distances) {}
+	void operator () ()
+	{
+	  double distance;
+	  CkcdPoint pointBody, pointEnv;
+	  for (std::size_t i = 0; i < distances.size (); ++i) {
+	    for (std::size_t j = 0; j < distances [i]->nbDistPairs (); ++j) {
+	      distances [i]->distAndPairsOfPoints (j, distance, pointBody,
+						   pointEnv);
+	    }
+	  }
+	}
+	std::vector<BodyDistanceShPtr> distances;
+      };
+
+      inline std::size_t
+      nbPairs (const std::vector<BodyDistanceShPtr>& distances)
+      {
+	std::size_t result = 0;
+	for (std::size_t i = 0; i < distances.size (); ++i) {
+	  result += distances [i]->nbDistPairs ();
+	}
+	return result;
+      }
+
+      struct CreateCopy
+      {
+	explicit CreateCopy (const DeviceShPtr& device) : device (device) {}
+	void operator () ()
+	{
+	  Device::createCopy (device);
+	}
+	DeviceShPtr device;
+      };
+
+      /// \brief Time the hot paths of a device
+      /// \param report report timings are added to,
+      /// \param device initialized device,
+      /// \param prefix prefix of the names of the benchmarks,
+      /// \param calls number of calls per repetition of
+      /// hppSetCurrentConfig. Cheaper operations are called 10 times
+      /// more, distances 10 times less and createCopy 100 times less.
+      inline void runDeviceBenchmarks (Report& report,
+				       const DeviceShPtr& device,
+				       const std::string& prefix,
+				       std::size_t calls)
+      {
+	const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+	const std::vector<vectorN> configs = drawConfigs (tree, 64);
+	std::vector<std::vector<double> > kwsConfigs (configs.size ());
+	for (std::size_t k = 0; k < configs.size (); ++k) {
+	  device->jrlDynamicsToKwsDofValues (configs [k], kwsConfigs [k]);
+	}
+	const std::size_t fewCalls = std::max<std::size_t> (1, calls / 10);
+	const std::size_t copyCalls = std::max<std::size_t> (1, calls / 100);
+
+	report.run (prefix + "jrl-to-kws-config",
+		    JrlToKws (device, configs), 10 * calls);
+	report.run (prefix + "kws-to-jrl-config",
+		    KwsToJrl (device, kwsConfigs), 10 * calls);
+	report.run (prefix + "forward-kinematics",
+		    ForwardKinematics (tree, configs), 10 * calls);
+	report.run (prefix + "set-config-geometric",
+		    SetCurrentConfig (device, configs, Device::GEOMETRIC),
+		    calls);
+	report.run (prefix + "set-config-dynamic",
+		    SetCurrentConfig (device, configs, Device::DYNAMIC), calls);
+	report.run (prefix + "set-config-both",
+		    SetCurrentConfig (device, configs, Device::BOTH), calls);
+
+	device->hppSetCurrentConfig (configs [0]);
+	report.run (prefix + "bounding-box", BoundingBox (device), calls);
+
+	std::vector<BodyDistanceShPtr> exact;
+	std::vector<BodyDistanceShPtr> capsules;
+	for (std::size_t i = 0; i < device->bodyDistances ().size (); ++i) {
+	  const BodyDistanceShPtr& distance = device->bodyDistances () [i];
+	  if (KIT_DYNAMIC_PTR_CAST (CapsuleBodyDistance, distance)) {
+	    capsules.push_back (distance);
+	  } else {
+	    exact.push_back (distance);
+	  }
+	}
+	if (nbPairs (exact) > 0) {
+	  report.run (prefix + "body-distance", Distances (exact), fewCalls);
+	}
+	if (nbPairs (capsules) > 0) {
+	  report.run (prefix + "capsule-body-distance", Distances (capsules),
+		      fewCalls);
+	}
+
+	report.run (prefix + "create-copy", CreateCopy (device), copyCalls);
+      }
+    } // namespace benchmark
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_DEVICE_BENCHMARKS_HH
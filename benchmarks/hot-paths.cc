@@ -0,0 +1,113 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// Time the operations called in the inner loops of planners on a model
+// read from a kxml file:
+//
+//   hot-paths [model.kxml [output.json]]
+//
+// Default model is ./romeo-hpp.kxml, default output is
+// ./hot-paths.json. Configurations are drawn with a fixed seed inside
+// joint bounds so that successive runs can be compared.
+
+#include <vector>
+
+#include <KineoUtility/kitParameterMap.h>
+#include <kprParserXML/kprParserManager.h>
+#include <KineoModel/kppComponentFactoryRegistry.h>
+#include <KineoModel/kppDeviceNode.h>
+#include <KineoModel/kppLicense.h>
+#include <KineoModel/kppModelTree.h>
+#include <KineoController/kppDocument.h>
+
+#include "hpp/model/exception.hh"
+#include "hpp/model/humanoid-robot.hh"
+#include "hpp/model/parser.hh"
+
+#include "device-benchmarks.hh"
+
+using hpp::model::Device;
+using hpp::model::DeviceShPtr;
+using hpp::model::Exception;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::benchmark::Report;
+using hpp::model::benchmark::now;
+using hpp::model::benchmark::runDeviceBenchmarks;
+
+namespace {
+  DeviceShPtr loadDevice (const std::string& filename)
+  {
+    CkprParserManagerShPtr parser = CkprParserManager::defaultManager ();
+    CkppDocumentShPtr document =
+      CkppDocument::create (parser->moduleManager ());
+    CkppComponentShPtr component;
+    if (parser->loadComponentFromFile
+	(filename, component, document->componentFactoryRegistry (),
+	 CkitParameterMap::create ()) != KD_OK) {
+      throw Exception ("failed to read " + filename + ".\n" +
+		       std::string (parser->lastError ().errorMessage ()));
+    }
+    CkppModelTreeShPtr modelTree =
+      KIT_DYNAMIC_PTR_CAST (CkppModelTree, component);
+    if (!modelTree || !modelTree->deviceNode () ||
+	modelTree->deviceNode ()->countChildComponents () == 0) {
+      throw Exception ("No device in " + filename + ".");
+    }
+    DeviceShPtr device =
+      KIT_DYNAMIC_PTR_CAST (Device,
+			    modelTree->deviceNode ()->childComponent (0));
+    if (!device) {
+      throw Exception ("Device in " + filename + " is not of type Device.");
+    }
+    device->initialize ();
+    return device;
+  }
+} // namespace
+
+int main (int argc, char** argv)
+{
+  const std::string model = argc > 1 ? argv [1] : "./romeo-hpp.kxml";
+  const std::string output = argc > 2 ? argv [2] : "./hot-paths.json";
+
+  if (!CkppLicense::initialize ()) {
+    throw Exception ("failed to validate Kineo license.");
+  }
+  hpp::model::Parser extra (true);
+  Report report ("hot-paths");
+  report.context ("model", model);
+
+  // Loading is timed once per repetition: it is too slow to be run
+  // many times.
+  std::vector<double> samples;
+  DeviceShPtr device;
+  for (std::size_t r = 0; r < 5; ++r) {
+    const double start = now ();
+    device = loadDevice (model);
+    samples.push_back (1e9 * (now () - start));
+  }
+  report.add ("load-model", 1, samples);
+
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  report.context ("joints", tree->nbJoints ());
+  report.context ("dofs", tree->numberDof ());
+  runDeviceBenchmarks (report, device, "", 1000);
+
+  report.write (output);
+  return 0;
+}
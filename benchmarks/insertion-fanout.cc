@@ -0,0 +1,89 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// Measure the cost of inserting joints in a device as a function of the
+// number of live devices in the process. Insertion notifications being
+// routed to the owning device only, the cost per insertion should not
+// depend on the number of devices.
+
+#include <sys/time.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <KineoModel/kppLicense.h>
+
+#include "hpp/model/device.hh"
+#include "hpp/model/exception.hh"
+#include "hpp/model/rotation-joint.hh"
+
+using hpp::model::Device;
+using hpp::model::DeviceShPtr;
+using hpp::model::Exception;
+using hpp::model::JointShPtr;
+using hpp::model::RotationJoint;
+
+static double now ()
+{
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+// Build a chain of nbJoints rotation joints and return the time spent
+// per insertion in microseconds.
+static double buildChain (std::size_t nbJoints)
+{
+  DeviceShPtr device = Device::create ("benchmark-robot");
+  JointShPtr joint = RotationJoint::create ("joint-0", CkitMat4 ());
+  device->setRootJoint (joint);
+  const double start = now ();
+  for (std::size_t i = 1; i < nbJoints; ++i) {
+    std::ostringstream oss;
+    oss << "joint-" << i;
+    JointShPtr child = RotationJoint::create (oss.str (), CkitMat4 ());
+    joint->addChildJoint (child);
+    joint = child;
+  }
+  return 1e6 * (now () - start) / (nbJoints - 1);
+}
+
+int main ()
+{
+  if (!CkppLicense::initialize ()) {
+    throw Exception ("failed to validate Kineo license.");
+  }
+  const std::size_t nbJoints = 100;
+  const std::size_t nbDevices [] = {0, 8, 32, 128};
+  std::vector<DeviceShPtr> pool;
+
+  std::cout << "live devices\tus per insertion" << std::endl;
+  for (std::size_t i = 0; i < sizeof (nbDevices) / sizeof (std::size_t);
+       ++i) {
+    while (pool.size () < nbDevices [i]) {
+      std::ostringstream oss;
+      oss << "idle-device-" << pool.size ();
+      pool.push_back (Device::create (oss.str ()));
+    }
+    std::cout << pool.size () << "\t\t" << buildChain (nbJoints)
+	      << std::endl;
+  }
+  return 0;
+}
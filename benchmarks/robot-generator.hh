@@ -0,0 +1,318 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_ROBOT_GENERATOR_HH
+# define HPP_MODEL_ROBOT_GENERATOR_HH
+
+# include <algorithm>
+# include <cmath>
+# include <deque>
+# include <limits>
+# include <sstream>
+# include <string>
+# include <vector>
+
+# include <KineoUtility/kitMat4.h>
+# include <KineoWorks2/kwsJoint.h>
+# include <kwsKcd2/kwsKCDBodyAdvanced.h>
+# include <kcd2/kcdPoint.h>
+
+# include <hpp/geometry/component/segment.hh>
+
+# include "hpp/model/capsule-body-distance.hh"
+# include "hpp/model/device.hh"
+# include "hpp/model/exception.hh"
+# include "hpp/model/freeflyer-joint.hh"
+# include "hpp/model/humanoid-robot.hh"
+# include "hpp/model/rotation-joint.hh"
+# include "hpp/model/translation-joint.hh"
+
+# include "benchmark.hh"
+
+namespace hpp {
+  namespace model {
+    namespace benchmark {
+      /// \brief Build synthetic devices of arbitrary size and shape
+
+      /// Joints are created breadth first: the root joint, then its
+      /// branching () children, then their children, and so on until
+      /// depth () levels below the root or nbJoints () joints have been
+      /// created. A branching of 1 gives a serial chain.
+      ///
+      /// Each joint is a rotation or a translation joint drawn with the
+      /// given probabilities, placed at linkLength () from its parent.
+      /// Successive levels are rotated by 90 degrees about z so that
+      /// axes of successive joints are not parallel.
+      ///
+      /// Each body carries capsulesPerBody () capsules, registered in a
+      /// CapsuleBodyDistance. nbObstacles () capsules are placed at
+      /// random around the device and added as outer capsules of every
+      /// body, so that each call of distance computation processes
+      /// nbJoints * capsulesPerBody * nbObstacles pairs.
+      ///
+      /// Draws use a fixed seed: the same parameters produce the same
+      /// device.
+      class RobotGenerator
+      {
+      public:
+	RobotGenerator ()
+	  : depth_ (std::numeric_limits<std::size_t>::max ()),
+	    branching_ (1), nbJoints_ (10), rotationRatio_ (1.),
+	    freeflyerRoot_ (false), humanoid_ (false), capsulesPerBody_ (1),
+	    nbObstacles_ (0), linkLength_ (.1), capsuleRadius_ (.02),
+	    mass_ (0), seed_ (1)
+	{
+	}
+
+	/// \name Parameters
+	/// @{
+
+	/// \brief Maximal number of levels below the root joint
+	RobotGenerator& depth (std::size_t depth)
+	{
+	  depth_ = depth; return *this;
+	}
+	/// \brief Number of children of each joint
+	RobotGenerator& branching (std::size_t branching)
+	{
+	  branching_ = branching; return *this;
+	}
+	/// \brief Maximal number of joints, root included
+	RobotGenerator& nbJoints (std::size_t nbJoints)
+	{
+	  nbJoints_ = nbJoints; return *this;
+	}
+	/// \brief Probability for a joint to be a rotation joint
+
+	/// Other joints are translation joints.
+	RobotGenerator& rotationRatio (double ratio)
+	{
+	  rotationRatio_ = ratio; return *this;
+	}
+	/// \brief Whether the root joint is a freeflyer joint
+	RobotGenerator& freeflyerRoot (bool freeflyer)
+	{
+	  freeflyerRoot_ = freeflyer; return *this;
+	}
+	/// \brief Whether to build a HumanoidRobot instead of a Device
+	RobotGenerator& humanoid (bool humanoid)
+	{
+	  humanoid_ = humanoid; return *this;
+	}
+	/// \brief Number of capsules attached to each joint
+	RobotGenerator& capsulesPerBody (std::size_t nbCapsules)
+	{
+	  capsulesPerBody_ = nbCapsules; return *this;
+	}
+	/// \brief Number of capsule obstacles
+	RobotGenerator& nbObstacles (std::size_t nbObstacles)
+	{
+	  nbObstacles_ = nbObstacles; return *this;
+	}
+	/// \brief Distance between a joint and its children
+	RobotGenerator& linkLength (double length)
+	{
+	  linkLength_ = length; return *this;
+	}
+	/// \brief Mean mass of the links, 0 for massless links
+
+	/// Link masses are drawn between 0.5 and 1.5 times the mean mass.
+	/// Each link is a rod from its joint to the children of the joint.
+	RobotGenerator& mass (double mass)
+	{
+	  mass_ = mass; return *this;
+	}
+	/// \brief Seed of random draws
+	RobotGenerator& seed (unsigned long seed)
+	{
+	  seed_ = seed; return *this;
+	}
+
+	/// @}
+
+	/// \brief Build and initialize a device
+	/// \throw Exception if the device cannot be built.
+	DeviceShPtr generate (const std::string& name) const
+	{
+	  Random random (seed_);
+	  DeviceShPtr device;
+	  {
+	    Device::BulkBuildScope scope;
+	    if (humanoid_) {
+	      device = HumanoidRobot::create (name);
+	    } else {
+	      device = Device::create (name);
+	    }
+	    if (!device) {
+	      throw Exception ("Failed to create device " + name + ".");
+	    }
+	    JointShPtr root;
+	    if (freeflyerRoot_) {
+	      root = FreeflyerJoint::create ("joint-0", CkitMat4 ());
+	    } else {
+	      root = RotationJoint::create ("joint-0", CkitMat4 ());
+	    }
+	    device->setRootJoint (root);
+	    setInertia (root, random);
+	    attachCapsules (device, root, CkitMat4 (), random);
+
+	    std::deque<Node> queue;
+	    queue.push_back (Node (root, CkitMat4 (), 0));
+	    std::size_t count = 1;
+	    while (!queue.empty () && count < nbJoints_) {
+	      const Node parent = queue.front ();
+	      queue.pop_front ();
+	      if (parent.depth >= depth_) continue;
+	      for (std::size_t b = 0; b < branching_ && count < nbJoints_;
+		   ++b) {
+		const CkitMat4 position = parent.position *
+		  offset (parent.depth + 1, b);
+		std::ostringstream oss;
+		oss << "joint-" << count++;
+		JointShPtr joint;
+		if (random.uniform (0, 1) < rotationRatio_) {
+		  joint = RotationJoint::create (oss.str (), position);
+		} else {
+		  joint = TranslationJoint::create (oss.str (), position);
+		  joint->bounds (0, -linkLength_, linkLength_);
+		}
+		parent.joint->addChildJoint (joint);
+		setInertia (joint, random);
+		attachCapsules (device, joint, position, random);
+		queue.push_back (Node (joint, position, parent.depth + 1));
+	      }
+	    }
+	  }
+	  if (!device->initialize ()) {
+	    throw Exception ("Failed to initialize device " + name + ".");
+	  }
+	  addObstacles (device, random);
+	  return device;
+	}
+
+      private:
+	struct Node
+	{
+	  Node (const JointShPtr& joint, const CkitMat4& position,
+		std::size_t depth)
+	    : joint (joint), position (position), depth (depth) {}
+	  JointShPtr joint;
+	  CkitMat4 position;
+	  std::size_t depth;
+	};
+
+	// Position of child b of a joint at given level in the frame of its
+	// parent.
+	CkitMat4 offset (std::size_t level, std::size_t b) const
+	{
+	  const double angle = (level % 2 == 0) ? 0 : M_PI / 2;
+	  const double spread = branching_ > 1 ?
+	    (double (b) / (branching_ - 1) - .5) * linkLength_ : 0;
+	  CkitMat4 result;
+	  result (0, 0) = cos (angle); result (0, 1) = -sin (angle);
+	  result (1, 0) = sin (angle); result (1, 1) = cos (angle);
+	  result (0, 3) = spread;
+	  result (2, 3) = linkLength_;
+	  return result;
+	}
+
+	static hpp::geometry::component::SegmentShPtr
+	capsule (const CkcdPoint& end1, const CkcdPoint& end2, double radius)
+	{
+	  return hpp::geometry::component::Segment::create (end1, end2,
+							     radius);
+	}
+
+	void setInertia (const JointShPtr& joint, Random& random) const
+	{
+	  if (mass_ <= 0) return;
+	  const double m = mass_ * random.uniform (.5, 1.5);
+	  const double l = linkLength_;
+	  const double r = capsuleRadius_;
+	  const double com [3] = {random.uniform (-r, r), random.uniform (-r, r),
+				  .5 * l};
+	  const double inertia [6] = {m * (3*r*r + l*l) / 12,
+				      m * (3*r*r + l*l) / 12,
+				      m * r*r / 2, 0, 0, 0};
+	  joint->inertialParameters (m, com, inertia);
+	}
+
+	void attachCapsules (const DeviceShPtr& device, const JointShPtr& joint,
+			     const CkitMat4& position, Random& random) const
+	{
+	  if (capsulesPerBody_ == 0) return;
+	  const std::string name =
+	    KIT_DYNAMIC_PTR_CAST (CkppComponent, joint)->name ();
+	  CkwsKCDBodyAdvancedShPtr body = CkwsKCDBodyAdvanced::create (name);
+	  joint->kppJoint ()->kwsJoint ()->setAttachedBody (body);
+	  CapsuleBodyDistanceShPtr distance =
+	    CapsuleBodyDistance::create (body, name);
+	  for (std::size_t c = 0; c < capsulesPerBody_; ++c) {
+	    const double z = random.uniform (0, linkLength_);
+	    CapsuleBodyDistance::capsule_t segment =
+	      capsule (CkcdPoint (0, 0, z),
+		       CkcdPoint (0, 0, std::min (z + .5 * linkLength_,
+						  linkLength_)),
+		       capsuleRadius_);
+	    segment->setAbsolutePosition (position);
+	    distance->addInnerCapsule (segment);
+	  }
+	  device->addBodyDistance (distance);
+	}
+
+	void addObstacles (const DeviceShPtr& device, Random& random) const
+	{
+	  // Obstacles are spread in a box of the size of the device.
+	  const double extent = linkLength_ *
+	    std::min<double> (nbJoints_, 10 * std::sqrt (double (nbJoints_)));
+	  const std::vector<BodyDistanceShPtr>& distances =
+	    device->bodyDistances ();
+	  for (std::size_t o = 0; o < nbObstacles_; ++o) {
+	    const double x = random.uniform (-extent, extent);
+	    const double y = random.uniform (-extent, extent);
+	    const double z = random.uniform (0, extent);
+	    CapsuleBodyDistance::capsule_t obstacle =
+	      capsule (CkcdPoint (x, y, z), CkcdPoint (x + linkLength_, y, z),
+		       capsuleRadius_);
+	    for (std::size_t i = 0; i < distances.size (); ++i) {
+	      CapsuleBodyDistanceShPtr distance =
+		KIT_DYNAMIC_PTR_CAST (CapsuleBodyDistance, distances [i]);
+	      if (distance) distance->addOuterCapsule (obstacle);
+	    }
+	  }
+	}
+
+	std::size_t depth_;
+	std::size_t branching_;
+	std::size_t nbJoints_;
+	double rotationRatio_;
+	bool freeflyerRoot_;
+	bool humanoid_;
+	std::size_t capsulesPerBody_;
+	std::size_t nbObstacles_;
+	double linkLength_;
+	double capsuleRadius_;
+	double mass_;
+	unsigned long seed_;
+      }; // class RobotGenerator
+    } // namespace benchmark
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_ROBOT_GENERATOR_HH
@@ -0,0 +1,94 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// Measure how the cost of hot paths grows with the size of the device.
+//
+//   scaling [output.json]
+//
+// Synthetic devices from 10 to 10000 joints are built with two shapes:
+// a serial chain and a tree of branching 3 with a freeflyer root and a
+// mix of rotation and translation joints. Benchmarks are named
+// <shape>/<number of joints>/<operation>. Default output is
+// ./scaling.json.
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <KineoModel/kppLicense.h>
+
+#include "hpp/model/exception.hh"
+
+#include "device-benchmarks.hh"
+#include "robot-generator.hh"
+
+using hpp::model::DeviceShPtr;
+using hpp::model::Exception;
+using hpp::model::benchmark::Report;
+using hpp::model::benchmark::RobotGenerator;
+using hpp::model::benchmark::now;
+using hpp::model::benchmark::runDeviceBenchmarks;
+
+namespace {
+  void sweep (Report& report, const std::string& shape,
+	      RobotGenerator generator)
+  {
+    const std::size_t sizes [] = {10, 30, 100, 300, 1000, 3000, 10000};
+    for (std::size_t i = 0; i < sizeof (sizes) / sizeof (std::size_t);
+	 ++i) {
+      std::ostringstream oss;
+      oss << shape << "/" << sizes [i] << "/";
+      generator.nbJoints (sizes [i]);
+
+      std::vector<double> samples;
+      DeviceShPtr device;
+      for (std::size_t r = 0; r < 3; ++r) {
+	const double start = now ();
+	device = generator.generate (shape);
+	samples.push_back (1e9 * (now () - start));
+      }
+      report.add (oss.str () + "generate", 1, samples);
+
+      // Keep the time per repetition roughly constant across sizes.
+      runDeviceBenchmarks (report, device, oss.str (),
+			   std::max<std::size_t> (10, 100000 / sizes [i]));
+    }
+  }
+} // namespace
+
+int main (int argc, char** argv)
+{
+  const std::string output = argc > 1 ? argv [1] : "./scaling.json";
+
+  if (!CkppLicense::initialize ()) {
+    throw Exception ("failed to validate Kineo license.");
+  }
+  Report report ("scaling", 5);
+  report.context ("capsules-per-body", 2.);
+  report.context ("obstacles", 4.);
+
+  sweep (report, "chain",
+	 RobotGenerator ().branching (1).capsulesPerBody (2).nbObstacles (4));
+  sweep (report, "tree",
+	 RobotGenerator ().branching (3).freeflyerRoot (true)
+	 .rotationRatio (.8).capsulesPerBody (2).nbObstacles (4));
+
+  report.write (output);
+  return 0;
+}
@@ -0,0 +1,165 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_ALLOWED_COLLISION_MATRIX_HH
+# define HPP_MODEL_ALLOWED_COLLISION_MATRIX_HH
+
+# include <stdint.h>
+
+# include <string>
+# include <vector>
+
+# include "hpp/model/fwd.hh"
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Pairs of bodies of a device that need no self-collision test
+
+    /// Bodies are identified by the name of the joint they are attached
+    /// to. A pair of bodies is allowed, i.e. can be skipped by
+    /// self-collision checking and self-distance computation, if the
+    /// bodies are
+    /// \li adjacent: attached to the same joint, or to a joint and its
+    /// parent, anchor joints being merged with their parent,
+    /// \li always colliding in the sampled configurations, which usually
+    /// means that the geometries overlap at the joint,
+    /// \li never colliding in the sampled configurations.
+
+    /// generate () samples random configurations within the bounds of the
+    /// kinematic tree of the device. Since the pose of a root freeflyer
+    /// joint does not change self-collisions, its degrees of freedom are
+    /// set to 0. Samples are shared between threads working on copies of
+    /// the device, so that the device is not modified. With one thread,
+    /// the device itself is used and its configuration restored.
+    /// Configuration k only depends on the seed and on k: the result does
+    /// not depend on the number of threads.
+
+    /// "Never colliding" is a statistical classification: pairs that
+    /// collide in a small fraction of the configuration space may be
+    /// missed with too few samples.
+
+    /// Matrices are cached on disk by loadOrGenerate ().
+    class AllowedCollisionMatrix
+    {
+    public:
+      /// \brief Why a pair of bodies is allowed
+      typedef enum Ereason {
+	/// Not allowed: the pair must be checked
+	CHECK,
+	ADJACENT,
+	ALWAYS_COLLIDING,
+	NEVER_COLLIDING
+      } Ereason;
+
+      /// \brief Version of the file format
+      static const uint32_t VERSION = 1;
+
+      /// \brief Sample configurations and classify pairs of bodies
+      /// \param device initialized device,
+      /// \param nbSamples number of random configurations,
+      /// \param nbThreads number of threads. With several threads, one
+      /// copy of the device is created per thread. 0 uses the number of
+      /// hardware threads.
+      /// \param seed seed of the random configurations.
+      /// \throw Exception if the device is not initialized or if a
+      /// distance computation fails.
+      static AllowedCollisionMatrixShPtr generate
+      (const DeviceShPtr& device, std::size_t nbSamples,
+       std::size_t nbThreads = 0, uint64_t seed = 0);
+
+      /// \brief Write the matrix
+      /// \param filename matrix file,
+      /// \param sourceHash hash of the model the device was built from,
+      /// see ModelSnapshot::sourceHash ().
+      /// \throw Exception if the file cannot be written.
+      void write (const std::string& filename, uint64_t sourceHash) const;
+
+      /// \brief Load a matrix
+      /// \param filename matrix file,
+      /// \param sourceHash expected hash of the model.
+      /// \return null pointer if the file does not exist, is not a matrix
+      /// of the current version, is corrupted or was produced from
+      /// another model.
+      static AllowedCollisionMatrixShPtr load (const std::string& filename,
+					       uint64_t sourceHash);
+
+      /// \brief Load the matrix cached next to a model, generate it if needed
+      /// \param device initialized device built from modelFilename,
+      /// \param modelFilename KXML description of the device,
+      /// \param nbSamples, nbThreads, seed see generate ().
+
+      /// The matrix is cached in modelFilename + ".acm". It is generated
+      /// again if the model changed, if it was sampled with other
+      /// parameters or if the bodies of the device differ.
+      /// \throw Exception if the matrix cannot be written.
+      static AllowedCollisionMatrixShPtr loadOrGenerate
+      (const DeviceShPtr& device, const std::string& modelFilename,
+       std::size_t nbSamples, std::size_t nbThreads = 0, uint64_t seed = 0);
+
+      /// \brief Number of bodies
+      std::size_t nbBodies () const { return bodyName_.size (); }
+
+      /// \brief Name of the joint a body is attached to
+      const std::string& bodyName (std::size_t bodyId) const
+      {
+	return bodyName_ [bodyId];
+      }
+
+      /// \brief Index of a body from the name of its joint
+      /// \return SIZE_MAX if no body is attached to this joint.
+      std::size_t bodyIndex (const std::string& jointName) const;
+
+      /// \brief Why a pair of bodies is allowed
+      Ereason reason (std::size_t bodyId1, std::size_t bodyId2) const
+      {
+	return Ereason (reason_ [bodyId1 * nbBodies () + bodyId2]);
+      }
+
+      /// \brief Whether a pair of bodies can be skipped
+      bool isAllowed (std::size_t bodyId1, std::size_t bodyId2) const
+      {
+	return reason (bodyId1, bodyId2) != CHECK;
+      }
+
+      /// \brief Number of pairs of distinct bodies with given reason
+      std::size_t nbPairs (Ereason reason) const;
+
+      /// \brief Number of configurations sampled
+      std::size_t nbSamples () const { return nbSamples_; }
+
+      /// \brief Seed of the sampled configurations
+      uint64_t seed () const { return seed_; }
+
+      /// \brief Whether the matrix describes the bodies of a device
+      bool matches (const Device& device) const;
+
+    private:
+      AllowedCollisionMatrix ();
+
+      std::vector<std::string> bodyName_;
+      /// Ereason of each ordered pair, row-major, symmetric.
+      std::vector<uint8_t> reason_;
+      std::size_t nbSamples_;
+      uint64_t seed_;
+    }; // class AllowedCollisionMatrix
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_ALLOWED_COLLISION_MATRIX_HH
@@ -29,6 +29,7 @@ INCLUDE
 #include <kwsKcd2/kwsKCDBodyAdvanced.h>
 
 #include "hpp/model/fwd.hh"
+#include "hpp/model/sparse-jacobian.hh"
 
 HPP_KIT_PREDEF_CLASS(CkppSolidComponentRef);
 class CkitMat4;
@@ -151,6 +152,43 @@ namespace hpp {
 					    CkcdPoint& outPointBody,
 					    CkcdPoint& outPointEnv);
 
+      /// \brief Compute distance, closest points and gradient of the distance
+
+      /// \param pairId id of the pair of objects,
+      /// \param jointPosition position of the joint the body is attached
+      /// to, as a row-major 3x4 matrix computed by
+      /// KinematicTree::forwardKinematics (),
+      /// \param jointJacobian Jacobian of the same joint, computed by
+      /// KinematicTree::computeJacobians () for the same configuration.
+
+      /// \retval outDistance, outPointBody, outPointEnv see
+      /// distAndPairsOfPoints (),
+      /// \retval outGradient derivative of outDistance with respect to
+      /// the configuration, in impl::DynamicRobot convention
+      /// (jointJacobian.numberDof () doubles).
+
+      /// The gradient is computed from the closest points: outer objects
+      /// being fixed, it is -n^T Jv where n is the unit normal pointing
+      /// from the body to the outer object and Jv the Jacobian of the
+      /// velocity of outPointBody. If the distance is 0, n is not defined
+      /// and the gradient is set to 0.
+      /// Closest points are computed by the virtual distAndPairsOfPoints
+      /// (), so that the gradient of CapsuleBodyDistance pairs accounts
+      /// for the radii of the capsules.
+      /// \note The current configuration of the device must be the one
+      /// used to compute jointPosition and jointJacobian.
+      ktStatus distanceGradient (std::size_t pairId,
+				 const double* jointPosition,
+				 const SparseJacobian& jointJacobian,
+				 double& outDistance,
+				 CkcdPoint& outPointBody,
+				 CkcdPoint& outPointEnv,
+				 std::vector<double>& outGradient);
+
+      /// \brief Index in a kinematic tree of the joint of the body
+      /// \return SIZE_MAX if the body is not attached to a joint of tree.
+      std::size_t jointIndex (const KinematicTree& tree) const;
+
       ///
       /// @}
       ///
@@ -165,6 +203,12 @@ namespace hpp {
       /// \param weakPtr weak pointer to itself
       ktStatus init(const BodyDistanceWkPtr weakPtr);
 
+      /// \brief Exact distance analysis of a pair of objects
+      const CkcdAnalysisShPtr& distanceAnalysis (std::size_t pairId) const
+      {
+	return distCompPairs_ [pairId];
+      }
+
     private:
 
       /// \brief Shared pointer to underlying body.
@@ -24,19 +24,40 @@
 INCLUDE
 **************************************/
 
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
 #include <KineoUtility/kitDefine.h>
+#include <KineoUtility/kitMat4.h>
 #include <kcd2/kcdAnalysisType.h>
 
 #include <hpp/geometry/component/segment.hh>
 
 #include "hpp/model/fwd.hh"
 #include <hpp/model/body-distance.hh>
+#include "hpp/model/capsule-fitter.hh"
 
 namespace hpp {
   namespace model {
 
+    class CapsuleTree;
+
     /// \brief Specialization of a body representing a capsule
     /// geometric object attached to a joint.
+
+    /// Distances to the outer capsules are computed through a bounding
+    /// volume hierarchy built on the first query after outer capsules
+    /// are added. Outer capsules are assumed not to move: after moving
+    /// them, call refitOuterCapsules () before the next query.
+
+    /// In cascade mode, distances between inner capsules and outer KCD
+    /// objects are first bounded from below by the distance to a
+    /// capsule bounding each outer object. Exact distances are computed
+    /// by increasing lower bound, until the lower bound cannot beat the
+    /// best distance found so far or the query threshold.
     class CapsuleBodyDistance : public BodyDistance
     {
     public:
@@ -66,6 +87,18 @@ namespace hpp {
       bool addInnerCapsule (const capsule_t& innerCapsule,
 			    bool distanceComputation=true);
 
+      /// \brief Add a capsule for distance computation only
+
+      /// \param innerCapsule capsule at its current position.
+
+      /// Unlike addInnerCapsule (), the capsule is not added to the
+      /// mobile objects of the body: collision checking keeps testing the
+      /// geometry the capsule bounds. Its position with respect to the
+      /// joint of the body is recorded, and the capsule is moved with the
+      /// joint before distance queries.
+      /// \throw Exception if the body is not attached to a joint.
+      void addDistanceCapsule (const capsule_t& innerCapsule);
+
       /// \brief Add a capsule for collision testing with the body
       /// \param outerCapsule new capsule
       /// \param distanceComputation whether distance analyses should be added for
@@ -76,6 +109,15 @@ namespace hpp {
       /// \brief Reset the list of outer capsules
       void resetOuterCapsules ();
 
+      /// \brief Update the hierarchy of outer capsules after they moved
+
+      /// The boxes of the hierarchy are recomputed in linear time, its
+      /// structure is kept. Queries use the positions of the outer
+      /// capsules at the last call, or when the hierarchy was built: this
+      /// has to be called whenever outer capsules move. If they moved a
+      /// lot, resetting and adding them again gives a tighter hierarchy.
+      void refitOuterCapsules ();
+
       /// \brief Reset the list of outer objects
       void resetOuterObjects ();
 
@@ -126,6 +168,10 @@ namespace hpp {
       /// \brief Compute minimum exact distance and closest points
       /// between body and set of outer capsules.
 
+      /// For each inner capsule, the hierarchy of outer capsules is
+      /// searched by branch and bound: subtrees that cannot be closer
+      /// than the best distance found so far are skipped.
+
       /// \retval outDistance Distance between body and outer capsules
       /// \retval outPointCapsuleBodyDistance Closest point on body (in global reference frame)
       /// \retval outPointEnv Closest point in outer capsule object set (in global reference frame)
@@ -143,6 +189,36 @@ namespace hpp {
 				     CkcdPoint& outPointBody,
 				     CkcdPoint& outPointEnv);
 
+      /// \brief Compute minimum distance, computing exact distances to
+      /// outer KCD objects only when needed
+
+      /// \param threshold distances above threshold are not needed
+      /// exactly.
+
+      /// \retval outDistance Distance between body and outer objects if
+      /// below threshold, otherwise a lower bound of this distance not
+      /// below threshold,
+      /// \retval outPointBody, outPointEnv closest points, only
+      /// meaningful when outDistance is the exact distance.
+
+      /// Outer KCD objects that are not polyhedra, and pairs whose inner
+      /// object is not a capsule, are always computed exactly.
+      ktStatus cascadeDistAndPairsOfPoints (double threshold,
+					    double& outDistance,
+					    CkcdPoint& outPointBody,
+					    CkcdPoint& outPointEnv);
+
+      /// \brief Whether distAndPairsOfPoints () for all pairs uses
+      /// cascadeDistAndPairsOfPoints () without threshold
+      void cascade (bool enabled) { cascade_ = enabled; }
+
+      /// \brief Whether cascade mode is enabled
+      bool cascade () const { return cascade_; }
+
+      /// \brief Number of KCD pairs computed exactly by the last call to
+      /// cascadeDistAndPairsOfPoints ()
+      std::size_t nbExactPairs () const { return nbExactPairs_; }
+
       ///
       /// @}
       ///
@@ -165,6 +241,24 @@ namespace hpp {
       /// \brief Outer capsules for which distance computation is performed
       std::vector<capsule_t> outerCapsulesForDist_;
 
+      /// \brief Capsules added by addDistanceCapsule () with their
+      /// position in the frame of the joint
+      std::vector<std::pair<capsule_t, CkitMat4> > distanceCapsules_;
+
+      /// \brief Whether distanceCapsules_ are placed at
+      /// placedJointPosition_
+      bool distanceCapsulesPlaced_;
+
+      /// \brief Position of the joint when distanceCapsules_ were placed
+      CkitMat4 placedJointPosition_;
+
+      /// \brief Build the pairs of an inner capsule with outer capsules
+      void addInnerCapsulePairs (const capsule_t& innerCapsule);
+
+      /// \brief Move the capsules of addDistanceCapsule () with the joint,
+      /// if the joint moved since they were placed
+      void placeDistanceCapsules ();
+
       /// \brief Capsule collision pairs for this body
       /// Each pair (inner capsule, outer capsule) potentially defines
       /// an exact distance analysis.
@@ -173,6 +267,23 @@ namespace hpp {
       /// \brief Weak pointer to itself
       CapsuleBodyDistanceWkPtr weakPtr_;
 
+      /// \brief Hierarchy of outer capsules, null until built
+      boost::shared_ptr<CapsuleTree> outerCapsuleTree_;
+
+      /// \brief Outer capsules in the global frame, 7 values each, given
+      /// to outerCapsuleTree_
+      std::vector<double> worldOuterCapsules_;
+
+      /// \brief Lower bound of the distance of a KCD pair
+      double kcdLowerBound (std::size_t pairId);
+
+      bool cascade_;
+      std::size_t nbExactPairs_;
+
+      /// \brief Capsules bounding outer KCD objects in their frame,
+      /// radius -1 if the object is not a polyhedron
+      std::map<const CkcdObject*, CapsuleFitter::Capsule> outerBounds_;
+
       /// \brief Temporary variables used in distance computation.
       mutable capsuleDistCompPair_t distPair_;
       mutable CkcdPoint leftEndPoint1_;
@@ -0,0 +1,162 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_CAPSULE_FITTER_HH
+# define HPP_MODEL_CAPSULE_FITTER_HH
+
+# include <stdint.h>
+
+# include <map>
+# include <string>
+# include <utility>
+# include <vector>
+
+# include "hpp/model/fwd.hh"
+
+HPP_KIT_PREDEF_CLASS(CkcdObject);
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Bounding capsules of the objects of bodies
+
+    /// fit () computes capsules containing a triangle mesh. The mesh is
+    /// cut in up to maxCapsules slabs along its principal axis,
+    /// triangles being assigned to slabs by their centroid. Each slab is
+    /// bounded by the capsule whose axis is the principal axis of its
+    /// vertices and whose radius is the largest distance of a vertex to
+    /// this axis. The number of slabs minimizing the total volume of the
+    /// capsules is kept. Since capsules are convex, a capsule containing
+    /// the vertices of a triangle contains the triangle.
+
+    /// Fitted capsules are cached in memory and in a file, keyed by a
+    /// hash of the mesh and by the maximal number of capsules, so that
+    /// models sharing meshes, or loaded again, are not fitted again.
+    class CapsuleFitter
+    {
+    public:
+      /// \brief Capsule: segment [end1, end2] dilated by radius
+      struct Capsule
+      {
+	double end1 [3];
+	double end2 [3];
+	double radius;
+      };
+      typedef std::vector<Capsule> Capsules_t;
+
+      /// \brief Version of the cache file format
+      static const uint32_t VERSION = 1;
+
+      /// \brief Fit capsules to a triangle mesh
+      /// \param vertices 3 coordinates per vertex,
+      /// \param triangles 3 vertex indices per triangle,
+      /// \param maxCapsules maximal number of capsules, at least 1,
+      /// \retval result capsules in the frame of the vertices, empty if
+      /// there is no vertex.
+      /// \throw Exception if a triangle refers to a missing vertex.
+      static void fit (const std::vector<double>& vertices,
+		       const std::vector<uint32_t>& triangles,
+		       std::size_t maxCapsules, Capsules_t& result);
+
+      /// \brief Vertices and triangles of a polyhedron in its own frame
+      /// \return false if the object is not a polyhedron.
+      static bool mesh (const CkcdObjectShPtr& object,
+			std::vector<double>& vertices,
+			std::vector<uint32_t>& triangles);
+
+      /// \brief Hash of a triangle mesh (64-bit FNV-1a)
+      static uint64_t meshHash (const std::vector<double>& vertices,
+				const std::vector<uint32_t>& triangles);
+
+      /// \brief Create a fitter
+      /// \param cacheFilename file storing fitted capsules, loaded if it
+      /// exists. An empty name only caches capsules in memory.
+
+      /// A cache file that is not a valid cache of the current version
+      /// is ignored and overwritten by save ().
+      static CapsuleFitterShPtr create (const std::string& cacheFilename);
+
+      /// \brief Capsules of a mesh, fitted or found in the cache
+      /// \param vertices, triangles, maxCapsules see fit ().
+      const Capsules_t& capsules (const std::vector<double>& vertices,
+				  const std::vector<uint32_t>& triangles,
+				  std::size_t maxCapsules);
+
+      /// \brief Fit capsules to the mobile objects of a body
+      /// \param distance body distance the capsules are added to as inner
+      /// capsules for distance computation,
+      /// \param maxCapsules maximal number of capsules per object.
+      /// \return number of capsules added.
+
+      /// Capsules are placed at the current position of the objects
+      /// they bound and registered by
+      /// CapsuleBodyDistance::addDistanceCapsule (): they are used for
+      /// distance computation only, collision checking keeps testing the
+      /// objects of the body. Objects that are not polyhedra are skipped.
+      /// \note Call once per body: a second call adds the same capsules
+      /// again.
+      std::size_t fitBody (const CapsuleBodyDistanceShPtr& distance,
+			   std::size_t maxCapsules);
+
+      /// \brief Fit capsules to the bodies of a device
+      /// \param device initialized device,
+      /// \param maxCapsules maximal number of capsules per object.
+
+      /// A CapsuleBodyDistance named after the joint of each body with
+      /// mobile objects is created and added to the device. Bodies that
+      /// already have a CapsuleBodyDistance in the device are skipped.
+      /// \return capsule body distances created.
+      std::vector<CapsuleBodyDistanceShPtr>
+      fitDevice (const DeviceShPtr& device, std::size_t maxCapsules);
+
+      /// \brief Write the cache file if capsules were fitted since it
+      /// was loaded
+      /// \throw Exception if the file cannot be written.
+      void save ();
+
+      /// \brief Name of the cache file
+      const std::string& cacheFilename () const { return cacheFilename_; }
+
+      /// \brief Number of cached meshes
+      std::size_t nbEntries () const { return cache_.size (); }
+
+      /// \brief Number of calls to capsules () answered by the cache
+      std::size_t nbHits () const { return nbHits_; }
+
+      /// \brief Number of calls to capsules () that fitted a mesh
+      std::size_t nbFits () const { return nbFits_; }
+
+    private:
+      /// (mesh hash, maximal number of capsules)
+      typedef std::pair<uint64_t, uint64_t> Key_t;
+      typedef std::map<Key_t, Capsules_t> Cache_t;
+
+      explicit CapsuleFitter (const std::string& cacheFilename);
+      void load ();
+
+      std::string cacheFilename_;
+      Cache_t cache_;
+      bool modified_;
+      std::size_t nbHits_;
+      std::size_t nbFits_;
+    }; // class CapsuleFitter
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_CAPSULE_FITTER_HH
@@ -0,0 +1,194 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_CONFIGURATION_BATCH_HH
+# define HPP_MODEL_CONFIGURATION_BATCH_HH
+
+# include <stdint.h>
+
+# include <fstream>
+# include <string>
+# include <vector>
+
+# include <boost/noncopyable.hpp>
+# include <boost/scoped_ptr.hpp>
+
+# include "hpp/model/fwd.hh"
+# include "hpp/model/kinematic-tree.hh"
+
+namespace hpp {
+  namespace model {
+    class MappedFile;
+
+    /// \brief Batch of configurations or path stored in a binary file
+
+    /// A file holds rows of numberDof () doubles stored contiguously,
+    /// preceded by a description of the degrees of freedom of the device
+    /// (name, type and rank in configuration of each joint of its
+    /// KinematicTree). Paths additionally store one parameter per row.
+
+    /// Files are mapped read-only: rows () points into the mapping and
+    /// can be passed directly to Device::forwardKinematicsBatch (),
+    /// Device::centerOfMassBatch () and to the batch methods of
+    /// KinematicTree when the convention is JRL_DYNAMICS.
+
+    /// Files are written by ConfigurationBatchWriter.
+    class ConfigurationBatch : private boost::noncopyable
+    {
+    public:
+      /// \brief Content of a file
+      typedef enum Ekind {
+	CONFIGURATIONS,
+	PATH
+      } Ekind;
+
+      /// \brief Order of degrees of freedom in rows
+      typedef enum Econvention {
+	/// impl::DynamicRobot convention
+	JRL_DYNAMICS,
+	/// CkwsConfig convention
+	KINEOWORKS
+      } Econvention;
+
+      /// \brief Version of the file format
+      static const uint32_t VERSION = 1;
+
+      ~ConfigurationBatch ();
+
+      /// \brief Open a file
+      /// \throw Exception if the file is not a valid batch.
+      static ConfigurationBatchShPtr open (const std::string& filename);
+
+      /// \brief Kind of file
+      Ekind kind () const;
+
+      /// \brief Order of the degrees of freedom
+      Econvention convention () const;
+
+      /// \brief Number of doubles per row
+      std::size_t numberDof () const;
+
+      /// \brief Number of rows
+      std::size_t nbRows () const;
+
+      /// \brief All rows, stored contiguously in the mapped file
+      const double* rows () const;
+
+      /// \brief Row of given rank
+      const double* row (std::size_t rank) const
+      {
+	return rows () + rank * numberDof ();
+      }
+
+      /// \brief Parameters of the rows of a path, null for configurations
+      const double* parameters () const;
+
+      /// \name Description of degrees of freedom
+      /// @{
+
+      /// \brief Number of joints
+      std::size_t nbJoints () const;
+
+      /// \brief Name of a joint
+      std::string jointName (std::size_t jointId) const;
+
+      /// \brief Type of a joint
+      KinematicTree::EjointType jointType (std::size_t jointId) const;
+
+      /// \brief Rank of a joint in impl::DynamicRobot configurations
+      std::size_t rankInConfiguration (std::size_t jointId) const;
+
+      /// \brief Whether the description matches a kinematic tree
+      bool matches (const KinematicTree& tree) const;
+
+      /// @}
+
+    private:
+      ConfigurationBatch ();
+
+      boost::scoped_ptr<MappedFile> file_;
+      const char* data_;
+    }; // class ConfigurationBatch
+
+    /// \brief Writer of ConfigurationBatch files
+
+    /// Rows are appended one after the other and written as they come:
+    /// memory used by the writer does not depend on the number of
+    /// configurations, except for path parameters (8 bytes per row).
+    /// The file is complete and visible under its name after close ().
+    class ConfigurationBatchWriter : private boost::noncopyable
+    {
+    public:
+      /// \brief Open a file for writing
+      /// \param filename file to write,
+      /// \param tree kinematic tree of the device,
+      /// \param kind configurations or path,
+      /// \param convention order of the degrees of freedom in rows,
+      /// \param numberDof number of doubles per row. Must be equal to
+      /// tree.numberDof () for JRL_DYNAMICS convention. For KINEOWORKS
+      /// convention, use CkwsDevice::countDofs ().
+      /// \throw Exception if the file cannot be created.
+      ConfigurationBatchWriter (const std::string& filename,
+				const KinematicTree& tree,
+				ConfigurationBatch::Ekind kind,
+				ConfigurationBatch::Econvention convention,
+				std::size_t numberDof);
+
+      /// \brief Discard the file if close () was not called
+
+      /// The temporary file is removed and filename is left untouched,
+      /// so that an interrupted writer never publishes a truncated file.
+      ~ConfigurationBatchWriter ();
+
+      /// \brief Append a configuration
+      /// \param row numberDof doubles,
+      /// \param parameter parameter of the configuration along the path,
+      /// ignored for configurations.
+      void append (const double* row, double parameter = 0);
+
+      /// \brief Append several configurations
+      /// \param rows nbRows * numberDof doubles,
+      /// \param nbRows number of configurations,
+      /// \param parameters nbRows parameters, ignored for configurations.
+      void append (const double* rows, std::size_t nbRows,
+		   const double* parameters = 0);
+
+      /// \brief Number of rows written so far
+      std::size_t nbRows () const { return nbRows_; }
+
+      /// \brief Complete the file
+      /// \throw Exception if writing failed.
+
+      /// The file appears under filename only once this call succeeds.
+      void close ();
+
+    private:
+      std::string filename_;
+      std::string tmp_;
+      std::ofstream file_;
+      ConfigurationBatch::Ekind kind_;
+      std::size_t numberDof_;
+      std::size_t nbRows_;
+      std::vector<double> parameters_;
+      bool closed_;
+    }; // class ConfigurationBatchWriter
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_CONFIGURATION_BATCH_HH
@@ -33,6 +33,7 @@
 
 #include "hpp/model/robot-dynamics-impl.hh"
 #include "hpp/model/fwd.hh"
+#include "hpp/model/sparse-jacobian.hh"
 
 namespace hpp {
   namespace model {
@@ -70,6 +71,30 @@ namespace hpp {
 
       static impl::ObjectFactory objectFactory_;
 
+      /// \brief Defer construction work during model building
+
+      /// While an object of this class is alive, insertion of joints and
+      /// solids in devices does not update the dynamic part of the
+      /// devices nor register humanoid specific joints. All this work is
+      /// done in a single pass by initialize (), that must therefore be
+      /// called on every device built in the scope.
+      ///
+      /// Scopes can be nested. Bulk-build mode is per thread: devices
+      /// built by other threads while a scope is alive are updated on
+      /// insertion as usual.
+      class BulkBuildScope
+      {
+      public:
+	BulkBuildScope ();
+	~BulkBuildScope ();
+      private:
+	BulkBuildScope (const BulkBuildScope&);
+	BulkBuildScope& operator= (const BulkBuildScope&);
+      }; // class BulkBuildScope
+
+      /// \brief Whether a BulkBuildScope is alive
+      static bool isBulkBuilding ();
+
       /// \name Construction, copy and destruction
       /// @{
       virtual ~Device();
@@ -237,6 +262,77 @@ namespace hpp {
       /// @}
       ///
 
+      ///
+      /// \name Kinematic tree
+      /// @{
+
+      /// \brief Get flat description of the kinematic chain
+      /// \note The tree is built by initialize ().
+      const KinematicTreeConstShPtr& kinematicTree () const;
+
+      /// \brief Compute forward kinematics for a batch of configurations
+
+      /// \param configs configurations in impl::DynamicRobot convention,
+      /// \retval outTransforms position of every joint for every
+      /// configuration, as row-major 3x4 matrices. The position of
+      /// joint j of kinematicTree () for configuration k starts at index
+      /// (k * kinematicTree ()->nbJoints () + j) * 12.
+
+      /// Configurations are processed by blocks of
+      /// KinematicTree::BLOCK_SIZE. This method does not modify the
+      /// current configuration of the device.
+      void forwardKinematicsBatch (const std::vector<vectorN>& configs,
+				   std::vector<double>& outTransforms) const;
+
+      /// \brief Compute forward kinematics for a batch of configurations
+
+      /// \param configs nbConfigs configurations of numberDof () doubles
+      /// stored contiguously,
+      /// \param nbConfigs number of configurations,
+      /// \retval outTransforms see
+      /// forwardKinematicsBatch (const std::vector<vectorN>&, std::vector<double>&).
+      void forwardKinematicsBatch (const double* configs,
+				   std::size_t nbConfigs,
+				   std::vector<double>& outTransforms) const;
+
+      /// \brief Compute the center of mass for a given configuration
+      /// \param config configuration in impl::DynamicRobot convention,
+      /// \return position of the center of mass in the global frame.
+
+      /// Unlike positionCenterOfMass (), this method does not need
+      /// hppSetCurrentConfig () to be called: only joint positions are
+      /// computed and the state of the device is left untouched. It can
+      /// thus be called concurrently from several threads.
+      vector3d centerOfMass (const vectorN& config) const;
+
+      /// \brief Compute the center of mass for a batch of configurations
+      /// \param configs configurations in impl::DynamicRobot convention,
+      /// \retval outComs 3 doubles per configuration.
+      void centerOfMassBatch (const std::vector<vectorN>& configs,
+			      std::vector<double>& outComs) const;
+
+      /// \brief Compute the center of mass for a batch of configurations
+      /// \param configs nbConfigs configurations of numberDof () doubles
+      /// stored contiguously,
+      /// \param nbConfigs number of configurations,
+      /// \retval outComs 3 doubles per configuration.
+      void centerOfMassBatch (const double* configs, std::size_t nbConfigs,
+			      std::vector<double>& outComs) const;
+
+      /// \brief Compute the Jacobians of all joints and of the center of mass
+      /// \param config configuration in impl::DynamicRobot convention,
+      /// \retval outJointJacobians Jacobian of each joint of
+      /// kinematicTree (), in the same order,
+      /// \retval outComJacobian Jacobian of the center of mass.
+      /// \sa KinematicTree::computeJacobians.
+      void computeJacobians (const vectorN& config,
+			     std::vector<SparseJacobian>& outJointJacobians,
+			     SparseJacobian& outComJacobian) const;
+
+      ///
+      /// @}
+      ///
+
       ///
       /// \name Collision checking and distance computations
       /// @{
@@ -273,13 +369,22 @@ namespace hpp {
       /// \brief Called whenever a child component is inserted
       /// This function enables the object to update information provided
       /// through properties when joints are inserted to the robot.
-      void componentDidInsertChild
+      /// \note Insertion notifications are received by a single
+      /// process-wide subscriber that forwards them to the device owning
+      /// the parent component only.
+      virtual void componentDidInsertChild
       (const CkitNotificationConstShPtr& notification);
 
       /// \brief Called before a child component is inserted
       /// This function enables the object to update information provided
       /// through properties when joints are inserted to the robot.
-      void componentWillInsertChild
+      virtual void componentWillInsertChild
+      (const CkitNotificationConstShPtr& notification);
+
+      /// \brief Update dynamic part of joints before a child insertion
+      /// Called by componentWillInsertChild, or directly when the parent
+      /// component does not belong to any device yet.
+      static void prepareChildInsertion
       (const CkitNotificationConstShPtr& notification);
 
       /// \brief Initialize kinematic chain
@@ -336,6 +441,19 @@ namespace hpp {
       /// \brief Store weak pointer to object.
       DeviceWkPtr weakPtr_;
 
+      /// \brief Flat kinematic chain built by initialize ().
+      KinematicTreeConstShPtr kinematicTree_;
+
+      /// \brief Whether loadDeferredGeometry () has been called.
+      bool deferredGeometryLoaded_;
+
+      /// \brief Load the objects of the bodies that the geometry store
+      /// deferred (see GeometryStore::deferPolyhedron ()).
+
+      /// Called by initialize () and by the first geometric update of
+      /// the configuration, so that KCD never tests empty polyhedra.
+      void loadDeferredGeometry ();
+
       void computeBodyBoundingBox(const CkwsKCDBodyAdvancedShPtr& body, double& xMin,
 				  double& yMin, double& zMin, double& xMax,
 				  double& yMax, double& zMax) const;
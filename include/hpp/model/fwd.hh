@@ -24,11 +24,18 @@
 
 namespace hpp {
   namespace model {
+    HPP_KIT_PREDEF_CLASS(AllowedCollisionMatrix);
+    HPP_KIT_PREDEF_CLASS(CapsuleFitter);
+    HPP_KIT_PREDEF_CLASS(ConfigurationBatch);
     HPP_KIT_PREDEF_CLASS(Device);
     HPP_KIT_PREDEF_CLASS(Exception);
     HPP_KIT_PREDEF_CLASS(FreeflyerJoint);
+    HPP_KIT_PREDEF_CLASS(GeometryStore);
     HPP_KIT_PREDEF_CLASS(HumanoidRobot);
     HPP_KIT_PREDEF_CLASS(Joint);
+    HPP_KIT_PREDEF_CLASS(KinematicTree);
+    HPP_KIT_PREDEF_CLASS(ModelSnapshot);
+    HPP_KIT_PREDEF_CLASS(SelfDistanceTable);
     HPP_KIT_PREDEF_CLASS(BodyDistance);
     HPP_KIT_PREDEF_CLASS(CapsuleBodyDistance);
   } // namespace model
@@ -0,0 +1,180 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_GEOMETRY_STORE_HH
+# define HPP_MODEL_GEOMETRY_STORE_HH
+
+# include <stdint.h>
+
+# include <string>
+# include <vector>
+
+# include <boost/noncopyable.hpp>
+# include <boost/scoped_ptr.hpp>
+
+# include <KineoKCDModel/kppKCDPolyhedron.h>
+
+# include "hpp/model/fwd.hh"
+
+namespace hpp {
+  namespace model {
+    class MappedFile;
+
+    /// \brief Read-only store of meshes shared between processes
+
+    /// A store is a single file holding named triangle meshes. It is
+    /// mapped read-only and shared: processes opening the same store use
+    /// a single copy of the data in the page cache.
+    /// Within a process, open () returns the same object for the same
+    /// file, whatever the path used to name it, as long as it is alive.
+
+    /// Meshes are referenced from KXML files by tag
+    /// HPP_STORED_POLYHEDRON (see Parser).
+
+    /// \note Savings are limited to load time. KCD keeps its own copy of
+    /// the vertices and triangles of each polyhedron, and of the
+    /// collision entity built from them: buildPolyhedron () and
+    /// fillPolyhedron () allocate this memory in every process, which
+    /// dominates the resident memory of a loaded model. What is saved
+    /// is parsing of mesh files, file buffers and the source data, which
+    /// pages out once polyhedra are built. Deferred loading (see
+    /// deferPolyhedron ()) is what reduces resident memory, for objects
+    /// that are never used.
+    class GeometryStore : private boost::noncopyable
+    {
+    public:
+      /// \brief Triangle mesh
+      struct Mesh
+      {
+	std::string name;
+	/// 3 coordinates per vertex
+	std::vector<double> vertices;
+	/// 3 vertex indices per triangle
+	std::vector<uint32_t> triangles;
+      };
+
+      /// \brief Version of the file format
+      static const uint32_t VERSION = 2;
+
+      ~GeometryStore ();
+
+      /// \brief Write a store
+      /// \throw Exception if the file cannot be written or if two
+      /// meshes have the same name.
+      static void write (const std::string& filename,
+			 const std::vector<Mesh>& meshes);
+
+      /// \brief Open a store
+      /// \throw Exception if the file is not a valid store, in
+      /// particular if a triangle refers to a vertex outside its mesh.
+      static GeometryStoreShPtr open (const std::string& filename);
+
+      /// \brief Name of the file
+      const std::string& filename () const { return filename_; }
+
+      /// \name Meshes
+      /// @{
+
+      /// \brief Number of meshes
+      std::size_t nbMeshes () const;
+
+      /// \brief Index of a mesh from its name, SIZE_MAX if not found
+      std::size_t meshIndex (const std::string& name) const;
+
+      /// \brief Name of a mesh
+      std::string meshName (std::size_t mesh) const;
+
+      /// \brief Number of vertices of a mesh
+      std::size_t nbVertices (std::size_t mesh) const;
+
+      /// \brief Vertices of a mesh, 3 doubles per vertex, in the mapped file
+      const double* vertices (std::size_t mesh) const;
+
+      /// \brief Number of triangles of a mesh
+      std::size_t nbTriangles (std::size_t mesh) const;
+
+      /// \brief Triangles of a mesh, 3 indices per triangle, in the
+      /// mapped file
+      const uint32_t* triangles (std::size_t mesh) const;
+
+      /// \brief Axis aligned bounding box of a mesh (min x, y, z, max x,
+      /// y, z)
+      const double* boundingBox (std::size_t mesh) const;
+
+      /// \brief Build a Kineo polyhedron from a mesh
+      /// \param mesh index of the mesh,
+      /// \param name name of the polyhedron.
+      CkppKCDPolyhedronShPtr buildPolyhedron (std::size_t mesh,
+					      const std::string& name) const;
+
+      /// \brief Fill an empty polyhedron with a mesh and build its
+      /// collision entity
+      void fillPolyhedron (std::size_t mesh,
+			   const CkppKCDPolyhedronShPtr& polyhedron) const;
+
+      /// @}
+
+      /// \name Deferred loading
+      /// @{
+
+      /// \brief Register an empty polyhedron to be filled on first use
+
+      /// The polyhedron is filled by loadDeferred (). Until then, its
+      /// bounding box is available through deferredBoundingBox ().
+      /// \note Devices load the deferred objects of their bodies when
+      /// they are initialized and on their first geometric configuration
+      /// update. Objects attached later are loaded when they are given
+      /// to BodyDistance; any other user has to call loadDeferred ().
+      static void deferPolyhedron (const GeometryStoreShPtr& store,
+				   std::size_t mesh,
+				   const CkppKCDPolyhedronShPtr& polyhedron);
+
+      /// \brief Fill an object if it was registered by deferPolyhedron ()
+      /// \return whether the object was filled by this call.
+
+      /// Called by Device, by BodyDistance and by CapsuleFitter before
+      /// objects are handed to KCD. Viewers should call it before
+      /// displaying an object.
+      static bool loadDeferred (const CkcdObjectShPtr& object);
+
+      /// \brief Bounding box of an object that is not loaded yet
+      /// \retval outBox axis aligned bounding box in the object frame
+      /// (min x, y, z, max x, y, z).
+      /// \return false if the object is not deferred.
+
+      /// The box is copied while the store is locked: the object may be
+      /// loaded and its entry removed by another thread right after.
+      static bool deferredBoundingBox (const CkcdObjectShPtr& object,
+				       double outBox [6]);
+
+      /// \brief Number of objects not loaded yet
+      static std::size_t nbDeferred ();
+
+      /// @}
+
+    private:
+      GeometryStore (const std::string& filename);
+
+      std::string filename_;
+      boost::scoped_ptr<MappedFile> file_;
+    }; // class GeometryStore
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_GEOMETRY_STORE_HH
@@ -20,6 +20,10 @@
 #ifndef HPP_MODEL_HUMANOID_ROBOT_HH
 #define HPP_MODEL_HUMANOID_ROBOT_HH
 
+#include <string>
+
+#include <boost/unordered_map.hpp>
+
 #include <KineoWorks2/kwsInterface.h>
 #include <KineoUtility/kitInterface.h>
 #include <KineoModel/kppDeviceComponent.h>
@@ -198,6 +202,17 @@ namespace hpp {
       /// \name Joints specific to humanoid robots
       ///
 
+      /// \brief Roles of joints specific to humanoid robots (bitmask)
+      enum {
+	ROLE_GAZE = 1 << 0,
+	ROLE_LEFT_ANKLE = 1 << 1,
+	ROLE_RIGHT_ANKLE = 1 << 2,
+	ROLE_LEFT_WRIST = 1 << 3,
+	ROLE_RIGHT_WRIST = 1 << 4,
+	ROLE_WAIST = 1 << 5,
+	ROLE_CHEST = 1 << 6
+      };
+
       /// \brief Get Joint corresponding to the waist.
       JointShPtr hppWaist();
 
@@ -254,9 +269,19 @@ namespace hpp {
 		    const HumanoidRobotShPtr& device);
 
     private:
+      typedef boost::unordered_map<std::string, unsigned int> RoleTable_t;
+
       /// \brief Check whether this joint is a specific joint
       /// If so, register joint in dynamic part
       void registerSpecificJoint(const JointShPtr& joint);
+      /// \brief Whether property holds the name of a specific joint
+      bool isRoleProperty(const CkppPropertyShPtr& property) const;
+      /// \brief Build map from joint names to roles from properties
+      void buildRoleTable();
+      /// \brief Roles of joints indexed by name
+      /// Built lazily, cleared when a joint name property changes.
+      RoleTable_t roleTable_;
+      bool roleTableValid_;
       /// \brief Store weak pointer to object.
       HumanoidRobotWkPtr weakPtr_;
     }; // class HumanoidRobot
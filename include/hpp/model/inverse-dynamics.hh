@@ -0,0 +1,137 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_INVERSE_DYNAMICS_HH
+# define HPP_MODEL_INVERSE_DYNAMICS_HH
+
+# include <vector>
+
+# include "hpp/model/fwd.hh"
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Recursive Newton-Euler inverse dynamics on a kinematic tree
+
+    /// All the memory needed by the algorithm is allocated by the
+    /// constructor: compute () and computeTrajectory () do not allocate.
+    /// An object holds its own workspace and should therefore not be
+    /// shared between threads; create one object per thread instead.
+
+    /// Velocities and accelerations are the time derivatives of the
+    /// configuration in impl::DynamicRobot convention, torques are the
+    /// generalized forces associated to the same coordinates. For a
+    /// freeflyer joint, they correspond to x, y, z, roll, pitch, yaw.
+
+    /// Spatial quantities are expressed in the global frame at the
+    /// origin, angular part first.
+    class InverseDynamics
+    {
+    public:
+      /// \brief Allocate workspace for a kinematic tree
+      /// \param tree kinematic tree of a device,
+      /// \note torque bounds are read from the joints of the tree at
+      /// construction.
+      explicit InverseDynamics (const KinematicTreeConstShPtr& tree);
+
+      /// \brief Get kinematic tree
+      const KinematicTreeConstShPtr& kinematicTree () const
+      {
+	return tree_;
+      }
+
+      /// \brief Set gravity vector (default (0, 0, -9.81))
+      void gravity (double x, double y, double z);
+
+      /// \brief Compute joint torques for one sample
+      /// \param q configuration,
+      /// \param dq velocity,
+      /// \param ddq acceleration, each of numberDof () doubles,
+      /// \retval outTorques numberDof () doubles.
+      void compute (const double* q, const double* dq, const double* ddq,
+		    double* outTorques);
+
+      /// \brief Compute joint torques along a trajectory
+      /// \param q, dq, ddq nbSamples vectors of numberDof () doubles
+      /// stored contiguously,
+      /// \param nbSamples number of samples,
+      /// \retval outTorques nbSamples * numberDof () doubles.
+
+      /// Joint positions are computed by blocks of
+      /// KinematicTree::BLOCK_SIZE samples.
+      void computeTrajectory (const double* q, const double* dq,
+			      const double* ddq, std::size_t nbSamples,
+			      double* outTorques);
+
+      /// \brief Lower torque bound of a degree of freedom
+      double lowerTorqueBound (std::size_t dof) const
+      {
+	return lowerTorqueBound_ [dof];
+      }
+
+      /// \brief Upper torque bound of a degree of freedom
+      double upperTorqueBound (std::size_t dof) const
+      {
+	return upperTorqueBound_ [dof];
+      }
+
+      /// \brief Check torques against bounds
+      /// \param torques numberDof () doubles,
+      /// \return whether every actuated degree of freedom is within
+      /// bounds. Degrees of freedom of freeflyer joints are not actuated
+      /// and thus not checked.
+      bool isWithinTorqueBounds (const double* torques) const;
+
+      /// \brief Check torque feasibility of a trajectory
+      /// \param q, dq, ddq see computeTrajectory (),
+      /// \param nbSamples number of samples,
+      /// \return index of the first sample violating torque bounds,
+      /// nbSamples if the whole trajectory is feasible.
+
+      /// Stops at the first infeasible sample.
+      std::size_t firstTorqueViolation (const double* q, const double* dq,
+					const double* ddq,
+					std::size_t nbSamples);
+
+    private:
+      void computeFromTransforms (const double* q, const double* dq,
+				  const double* ddq, const double* transforms,
+				  double* outTorques);
+
+      KinematicTreeConstShPtr tree_;
+      double gravity_ [3];
+      std::vector<double> lowerTorqueBound_;
+      std::vector<double> upperTorqueBound_;
+      std::vector<bool> actuated_;
+      // Workspace
+      std::vector<double> transforms_;
+      std::vector<double> axis_;
+      std::vector<double> point_;
+      std::vector<bool> prismatic_;
+      std::vector<double> velocity_;
+      std::vector<double> acceleration_;
+      std::vector<double> force_;
+      std::vector<double> blockConfig_;
+      std::vector<double> blockTransforms_;
+      std::vector<double> torques_;
+    }; // class InverseDynamics
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_INVERSE_DYNAMICS_HH
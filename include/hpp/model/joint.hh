@@ -223,6 +223,19 @@ namespace hpp {
       /// insert it beforehand.
       void insertBody();
 
+      /// \brief Set inertial parameters of the attached body
+      ///
+      /// \param mass mass of the body,
+      /// \param com center of mass in the joint frame,
+      /// \param inertia inertia matrix at the center of mass in the joint
+      /// frame: xx, yy, zz, xy, xz, yz.
+      ///
+      /// Parameters are stored in the properties of the joint and copied
+      /// to the attached body if it is already inserted. The kinematic
+      /// tree of a device reads them when the device is initialized.
+      void inertialParameters(double mass, const double com[3],
+			      const double inertia[6]);
+
       ///
       /// @}
       ///
@@ -0,0 +1,311 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_KINEMATIC_TREE_HH
+# define HPP_MODEL_KINEMATIC_TREE_HH
+
+# include <map>
+# include <string>
+# include <vector>
+
+# include "hpp/model/fwd.hh"
+# include "hpp/model/sparse-jacobian.hh"
+# include "hpp/model/types.hh"
+
+class CjrlJoint;
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Flat description of the kinematic chain of a device
+
+    /// The tree is built by Device::initialize() from the dynamic part
+    /// of the joints and does not depend on any Kineo or jrl-dynamics
+    /// object afterwards. Its methods are const and do not modify the
+    /// device: they can be called concurrently from several threads.
+
+    /// Joints are stored in depth-first order, so that the parent of a
+    /// joint always comes before the joint itself. Configurations follow
+    /// impl::DynamicRobot convention.
+
+    /// Joint positions are represented as row-major 3x4 homogeneous
+    /// matrices (12 doubles). As in jrl-dynamics,
+    /// \li rotation joints rotate about the x-axis of their frame,
+    /// \li translation joints translate along the x-axis of their frame,
+    /// \li the configuration of a freeflyer joint (x, y, z, roll, pitch,
+    /// yaw) is the position of the joint in the frame of its parent.
+    class KinematicTree
+    {
+    public:
+      /// \brief Type of joint
+      typedef enum EjointType {
+	FREEFLYER,
+	ROTATION,
+	TRANSLATION,
+	ANCHOR
+      } EjointType;
+
+      /// \brief Number of configurations processed together by batch methods
+
+      /// Batch methods store the data of BLOCK_SIZE configurations in
+      /// interleaved arrays (one lane per configuration), so that the
+      /// inner loops over lanes are vectorized by the compiler.
+      static const std::size_t BLOCK_SIZE = 4;
+
+      /// \brief Build the tree from the dynamic part of the joints
+      /// \param rootJoint root of the kinematic chain,
+      /// \param numberDof size of impl::DynamicRobot configurations.
+      /// \pre the dynamic part of every joint has been created.
+      static KinematicTreeShPtr create (const JointShPtr& rootJoint,
+					std::size_t numberDof);
+
+      /// \name Structure
+      /// @{
+
+      /// \brief Number of joints (anchor joints included)
+      std::size_t nbJoints () const { return parent_.size (); }
+
+      /// \brief Size of configurations
+      std::size_t numberDof () const { return numberDof_; }
+
+      /// \brief Index of the parent of a joint, SIZE_MAX for the root joint
+      std::size_t parent (std::size_t jointId) const
+      {
+	return parent_ [jointId];
+      }
+
+      /// \brief Type of a joint
+      EjointType jointType (std::size_t jointId) const
+      {
+	return jointType_ [jointId];
+      }
+
+      /// \brief Rank of the first degree of freedom of a joint
+      std::size_t rankInConfiguration (std::size_t jointId) const
+      {
+	return rankInConfiguration_ [jointId];
+      }
+
+      /// \brief Number of degrees of freedom of a joint
+      std::size_t jointDof (std::size_t jointId) const;
+
+      /// \brief Name of a joint
+      const std::string& jointName (std::size_t jointId) const
+      {
+	return jointName_ [jointId];
+      }
+
+      /// \brief Index of a joint from its dynamic part
+      /// \return SIZE_MAX if the joint does not belong to the tree, in
+      /// particular for trees loaded from a ModelSnapshot.
+      std::size_t jointIndex (const CjrlJoint* joint) const;
+
+      /// \brief Get joint from its index
+      /// \return null pointer if the device the tree was built from has
+      /// been destroyed, and for trees loaded from a ModelSnapshot, that
+      /// are not built from a device. Use jointName () to match joints
+      /// of such trees with the joints of a device.
+      JointShPtr joint (std::size_t jointId) const;
+
+      /// \brief Position of a joint in its parent frame when the joint
+      /// configuration is 0.
+      const double* staticTransform (std::size_t jointId) const
+      {
+	return &staticTransform_ [12*jointId];
+      }
+
+      /// \brief Degrees of freedom that move a joint, in increasing order
+
+      /// These are the degrees of freedom of the joint and of its
+      /// ancestors, i.e. the structurally non-zero columns of the
+      /// Jacobian of the joint.
+      const std::vector<std::size_t>& supportDofs (std::size_t jointId) const
+      {
+	return supportDofs_ [jointId];
+      }
+
+      /// \brief Index of the joint a degree of freedom belongs to
+      std::size_t jointOfDof (std::size_t dof) const
+      {
+	return jointOfDof_ [dof];
+      }
+
+      /// \brief Lower bound of a degree of freedom
+      double lowerBound (std::size_t dof) const
+      {
+	return lowerBound_ [dof];
+      }
+
+      /// \brief Upper bound of a degree of freedom
+      double upperBound (std::size_t dof) const
+      {
+	return upperBound_ [dof];
+      }
+
+      /// \brief Lower torque bound of a degree of freedom
+      double lowerTorqueBound (std::size_t dof) const
+      {
+	return lowerTorqueBound_ [dof];
+      }
+
+      /// \brief Upper torque bound of a degree of freedom
+      double upperTorqueBound (std::size_t dof) const
+      {
+	return upperTorqueBound_ [dof];
+      }
+
+      /// @}
+
+      /// \name Inertial parameters of the bodies attached to the joints
+      /// @{
+
+      /// \brief Mass of the body attached to a joint
+      double mass (std::size_t jointId) const { return mass_ [jointId]; }
+
+      /// \brief Center of mass of a body in the joint frame (3 doubles)
+      const double* localCenterOfMass (std::size_t jointId) const
+      {
+	return &localCenterOfMass_ [3*jointId];
+      }
+
+      /// \brief Inertia matrix of a body at its center of mass
+
+      /// Six doubles in the joint frame: xx, yy, zz, xy, xz, yz.
+      const double* inertia (std::size_t jointId) const
+      {
+	return &inertia_ [6*jointId];
+      }
+
+      /// \brief Total mass of the device
+      double totalMass () const { return totalMass_; }
+
+      /// @}
+
+      /// \name Forward kinematics
+      /// @{
+
+      /// \brief Compute the position of all joints for one configuration
+      /// \param config configuration of numberDof () doubles,
+      /// \retval outTransforms nbJoints () row-major 3x4 matrices.
+      void forwardKinematics (const double* config, double* outTransforms)
+	const;
+
+      /// \brief Compute the position of all joints for several configurations
+      /// \param configs nbConfigs configurations stored contiguously,
+      /// \param nbConfigs number of configurations,
+      /// \retval outTransforms nbConfigs * nbJoints () row-major 3x4
+      /// matrices. The position of joint j for configuration k starts at
+      /// index (k * nbJoints () + j) * 12.
+      void forwardKinematics (const double* configs, std::size_t nbConfigs,
+			      double* outTransforms) const;
+
+      /// @}
+
+      /// \name Center of mass
+      /// @{
+
+      /// \brief Compute the center of mass of the device for one configuration
+      /// \param config configuration of numberDof () doubles,
+      /// \retval outCom position of the center of mass (3 doubles).
+
+      /// Only joint positions are computed. If the device has no mass,
+      /// outCom is set to 0.
+      void centerOfMass (const double* config, double* outCom) const;
+
+      /// \brief Compute the center of mass for several configurations
+      /// \param configs nbConfigs configurations stored contiguously,
+      /// \param nbConfigs number of configurations,
+      /// \retval outComs nbConfigs positions of 3 doubles.
+      void centerOfMass (const double* configs, std::size_t nbConfigs,
+			 double* outComs) const;
+
+      /// @}
+
+      /// \name Jacobians
+      /// @{
+
+      /// \brief Compute the Jacobians of all joints and of the center of mass
+
+      /// \param config configuration of numberDof () doubles,
+      /// \retval outJointJacobians Jacobian of each joint, with
+      /// supportDofs () as stored columns,
+      /// \retval outComJacobian Jacobian of the center of mass of the
+      /// device, storing the columns of the degrees of freedom that move
+      /// a body of non-zero mass.
+
+      /// Joint positions are computed in a forward pass, subtree masses
+      /// and centers of mass in a single backward pass.
+
+      /// \note For freeflyer joints, columns correspond to the
+      /// derivatives with respect to x, y, z, roll, pitch, yaw.
+      void computeJacobians (const double* config,
+			     std::vector<SparseJacobian>& outJointJacobians,
+			     SparseJacobian& outComJacobian) const;
+
+      /// \brief Compute the motion generated by each degree of freedom
+
+      /// \param config configuration of numberDof () doubles,
+      /// \param transforms positions of the joints as computed by
+      /// forwardKinematics (),
+      /// \retval outAxis for each degree of freedom, the unit axis of the
+      /// motion in the global frame (3 doubles per dof),
+      /// \retval outPoint for each degree of freedom, a point of the
+      /// rotation axis (3 doubles per dof),
+      /// \retval outPrismatic for each degree of freedom, whether the
+      /// motion is a translation.
+      void motionAxes (const double* config, const double* transforms,
+		       double* outAxis, double* outPoint,
+		       std::vector<bool>& outPrismatic) const;
+
+      /// @}
+
+    protected:
+      KinematicTree ();
+
+    private:
+      friend class ModelSnapshot;
+
+      void addJoint (const JointShPtr& joint, std::size_t parent,
+		     const double* parentInitialPosition);
+
+      std::size_t numberDof_;
+      std::vector<std::size_t> parent_;
+      std::vector<EjointType> jointType_;
+      std::vector<std::size_t> rankInConfiguration_;
+      std::vector<std::string> jointName_;
+      std::vector<JointWkPtr> joint_;
+      std::map<const CjrlJoint*, std::size_t> jointIndex_;
+      /// Static transformations: 12 doubles per joint.
+      std::vector<double> staticTransform_;
+      std::vector<std::vector<std::size_t> > supportDofs_;
+      std::vector<std::size_t> jointOfDof_;
+      /// Bounds read from the joints when the tree is built.
+      std::vector<double> lowerBound_;
+      std::vector<double> upperBound_;
+      std::vector<double> lowerTorqueBound_;
+      std::vector<double> upperTorqueBound_;
+      std::vector<double> mass_;
+      std::vector<double> localCenterOfMass_;
+      std::vector<double> inertia_;
+      double totalMass_;
+    }; // class KinematicTree
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_KINEMATIC_TREE_HH
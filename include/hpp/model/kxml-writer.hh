@@ -0,0 +1,97 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_KXML_WRITER_HH
+# define HPP_MODEL_KXML_WRITER_HH
+
+# include <ostream>
+# include <string>
+
+# include <KineoModel/kppComponent.h>
+# include <kprParserXML/kprXMLTag.h>
+# include <kprParserXML/kprXMLWriter.h>
+
+# include "hpp/model/fwd.hh"
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Streaming KXML writer of component trees
+
+    /// Unlike CkprParserManager::writeComponentToFile, which builds the
+    /// tag tree of the whole scene before writing it, this writer emits
+    /// each component as it walks the component tree.
+
+    /// The tag of each component is produced by the XML writer methods
+    /// registered in CkprParserManager for its type: Kineo native ones
+    /// and the ones of Parser for components of this package. Files are
+    /// thus read back by Parser and by Kitelab. Only the tag of the
+    /// component being written is held in memory, its child components
+    /// being written afterwards, so that memory is proportional to the
+    /// largest component rather than to the scene. Text content, that
+    /// holds the vertices and triangles of polyhedra, is written in
+    /// chunks of CHUNK_SIZE characters.
+
+    /// The stream is never flushed before the end of write (), so that
+    /// compressed output is not degraded by flushes.
+    class KxmlWriter
+    {
+    public:
+      /// \brief Compression of the output file
+      typedef enum Ecompression {
+	NONE,
+	GZIP
+      } Ecompression;
+
+      /// \brief Size of the chunks text content is written by
+      static const std::size_t CHUNK_SIZE = 1 << 16;
+
+      /// \brief Constructor
+      /// \param stream stream tags are written to.
+      explicit KxmlWriter (std::ostream& stream);
+
+      /// \brief Write a component and its descendants
+      /// \throw Exception if a component cannot be written.
+      void write (const CkppComponentConstShPtr& component);
+
+      /// \brief Write a component and its descendants to a file
+      /// \param filename output file,
+      /// \param component root of the tree to write,
+      /// \param compression compression of the file.
+      /// \throw Exception if the file cannot be written.
+      static void writeToFile (const std::string& filename,
+			       const CkppComponentConstShPtr& component,
+			       Ecompression compression = NONE);
+
+    private:
+      void writeComponent (const CkppComponentConstShPtr& component,
+			   std::size_t depth);
+      void writeStartTag (const CkprXMLTagConstShPtr& tag, std::size_t depth,
+			  bool empty);
+      void writeTag (const CkprXMLTagConstShPtr& tag, std::size_t depth);
+      void writeText (const std::string& text);
+      void indent (std::size_t depth);
+
+      std::ostream& stream_;
+      CkprXMLWriterShPtr writer_;
+    }; // class KxmlWriter
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_KXML_WRITER_HH
@@ -0,0 +1,165 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_MODEL_SNAPSHOT_HH
+# define HPP_MODEL_MODEL_SNAPSHOT_HH
+
+# include <stdint.h>
+
+# include <string>
+
+# include <boost/function.hpp>
+# include <boost/noncopyable.hpp>
+# include <boost/scoped_ptr.hpp>
+
+# include "hpp/model/fwd.hh"
+
+namespace hpp {
+  namespace model {
+    class MappedFile;
+
+    /// \brief Binary snapshot of the kinematic tree of a humanoid robot
+
+    /// A snapshot caches, in a single file, the part of an initialized
+    /// HumanoidRobot that does not depend on Kineo or jrl-dynamics
+    /// objects:
+    /// \li the kinematic tree: joint types, static transformations,
+    /// ranks in configuration, bounds, masses and inertias,
+    /// \li the roles of the joints specific to humanoid robots,
+    /// \li the names of the solid components attached to each joint,
+    /// \li the names of the body distances and their number of pairs.
+
+    /// The file is mapped in memory when loaded: only the kinematic tree
+    /// is copied. Every snapshot records sourceHash () of the KXML file
+    /// it was produced from, so that a stale snapshot is detected and
+    /// rebuilt by loadOrBuild ().
+
+    /// A snapshot is not a device and does not restore one. It is
+    /// enough for computations on the kinematic tree alone: forward
+    /// kinematics, center of mass, Jacobians and InverseDynamics, for
+    /// instance in worker processes that do not check collisions. Code
+    /// that needs the device itself (collision checking, distance
+    /// computation, StaticStability, Kineo planners) requires a KXML
+    /// parse, and loadOrBuild () returns the robot it parsed so that it
+    /// is not parsed twice.
+
+    /// \note Joints of the snapshot tree do not exist:
+    /// KinematicTree::joint () returns a null pointer and
+    /// KinematicTree::jointIndex () returns SIZE_MAX. Joints are
+    /// identified by KinematicTree::jointName ().
+
+    /// The file is in native byte order and is not meant to be shared
+    /// between machines of different architectures.
+    class ModelSnapshot : private boost::noncopyable
+    {
+    public:
+      /// \brief Function parsing a KXML file into an initialized robot
+      typedef boost::function<HumanoidRobotShPtr (const std::string&)>
+      Builder_t;
+
+      /// \brief Version of the file format
+      static const uint32_t VERSION = 1;
+
+      ~ModelSnapshot ();
+
+      /// \brief Content hash of a file (64-bit FNV-1a)
+      /// \throw Exception if the file cannot be read.
+      static uint64_t sourceHash (const std::string& filename);
+
+      /// \brief Write a snapshot of an initialized robot
+      /// \param filename snapshot file,
+      /// \param robot initialized robot,
+      /// \param sourceHash hash of the KXML file the robot was parsed from.
+
+      /// The snapshot is written to a temporary file that is renamed
+      /// afterwards, so that concurrent readers never see a partial file.
+      /// \throw Exception if the file cannot be written.
+      static void write (const std::string& filename,
+			 const HumanoidRobot& robot, uint64_t sourceHash);
+
+      /// \brief Load a snapshot
+      /// \param filename snapshot file,
+      /// \param sourceHash expected hash of the KXML source.
+      /// \return null pointer if the file does not exist, is not a
+      /// snapshot of the current version or was produced from another
+      /// source.
+      static ModelSnapshotShPtr load (const std::string& filename,
+				      uint64_t sourceHash);
+
+      /// \brief Load a snapshot, rebuilding it from the source if needed
+      /// \param kxmlFilename KXML description of the robot,
+      /// \param snapshotFilename snapshot file,
+      /// \param builder function parsing and initializing the robot,
+      /// called only if the snapshot is missing or stale.
+      /// \retval outRobot robot built by builder if the snapshot was
+      /// rebuilt, null pointer if the snapshot was up to date.
+      /// \throw Exception if the rebuilt snapshot cannot be written.
+      static ModelSnapshotShPtr loadOrBuild
+      (const std::string& kxmlFilename, const std::string& snapshotFilename,
+       const Builder_t& builder, HumanoidRobotShPtr& outRobot);
+
+      /// \brief Hash of the source the snapshot was produced from
+      uint64_t hash () const;
+
+      /// \brief Kinematic tree of the robot
+      const KinematicTreeConstShPtr& kinematicTree () const
+      {
+	return kinematicTree_;
+      }
+
+      /// \brief Roles of a joint of kinematicTree ()
+      /// \return bitmask of HumanoidRobot::ROLE_GAZE, ...
+      unsigned int jointRoles (std::size_t jointId) const;
+
+      /// \brief Index in kinematicTree () of the joint with given role
+      /// \return SIZE_MAX if no joint has this role.
+      std::size_t jointWithRole (unsigned int role) const;
+
+      /// \name Geometry
+      /// @{
+
+      /// \brief Number of solid components attached to a joint
+      std::size_t nbGeometries (std::size_t jointId) const;
+
+      /// \brief Name of a solid component attached to a joint
+      std::string geometryName (std::size_t jointId, std::size_t rank) const;
+
+      /// \brief Number of body distances
+      std::size_t nbBodyDistances () const;
+
+      /// \brief Name of a body distance
+      std::string bodyDistanceName (std::size_t rank) const;
+
+      /// \brief Number of pairs of objects of a body distance
+      std::size_t nbDistPairs (std::size_t rank) const;
+
+      /// @}
+
+    private:
+      ModelSnapshot ();
+      std::string stringAt (uint64_t offset, uint64_t length) const;
+
+      boost::scoped_ptr<MappedFile> file_;
+      const char* data_;
+      KinematicTreeConstShPtr kinematicTree_;
+    }; // class ModelSnapshot
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_MODEL_SNAPSHOT_HH
@@ -19,17 +19,32 @@
 #ifndef HPP_CORE_PARSER_HH
 #define HPP_CORE_PARSER_HH
 
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+
 #include <KineoModel/kppComponent.h>
 #include <kprParserXML/kprXMLTag.h>
 #include <kprParserXML/kprXMLBuildingContext.h>
 #include <kprParserXML/kprXMLWriter.h>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include <hpp/util/kitelab.hh>
 
+#include "hpp/model/fwd.hh"
+
+HPP_KIT_PREDEF_CLASS(CkitParameterMap);
+HPP_KIT_PREDEF_CLASS(CkppComponentFactoryRegistry);
 HPP_KIT_PREDEF_CLASS(CkppDeviceComponent);
+HPP_KIT_PREDEF_CLASS(CkppKCDPolyhedron);
 
 namespace hpp {
   namespace model {
+    class TaskPool;
+
     class Parser {
     public:
       /// Add tags to Kineo parser
@@ -40,6 +55,61 @@ namespace hpp {
       Parser(bool addon = true);
       ~Parser();
 
+      /// \name Parallel loading
+      /// @{
+
+      /// \brief Set number of threads building geometry
+
+      /// With nbThreads > 0, loadComponentFromFile() looks for the
+      /// HPP_STORED_POLYHEDRON tags of the document before handing it to
+      /// the Kineo parser, and nbThreads threads fill the polyhedra they
+      /// refer to and build their collision entities while the rest of
+      /// the document is parsed. These polyhedra are not known to Kineo
+      /// until the tag builder returns them, in document order, after
+      /// waiting for their own task only. Joints and other components
+      /// are still built by the calling thread.
+      /// \note Default value is 0: polyhedra are built by the tag builder.
+      /// Nothing is built in advance when lazyGeometry() is set.
+      void geometryThreads(std::size_t nbThreads);
+
+      /// \brief Number of threads building geometry
+      std::size_t geometryThreads() const;
+
+      /// \brief Set whether geometry is loaded on first use
+
+      /// When set, polyhedra read from HPP_STORED_POLYHEDRON tags are
+      /// returned empty and registered by GeometryStore::deferPolyhedron
+      /// (). Only their bounding box is known until they are attached to
+      /// an initialized device, used by BodyDistance or fitted by
+      /// CapsuleFitter. Geometry that is never used that way, like the
+      /// visual meshes of an environment, is never loaded.
+      /// \note Default value is false.
+      void lazyGeometry(bool lazy);
+
+      /// \brief Whether geometry is loaded on first use
+      bool lazyGeometry() const;
+
+      /// \brief Wait until all geometry is built
+
+      /// The model is complete when parsing returns: waiting only
+      /// matters to release the threads building geometry or to measure
+      /// loading time. The destructor waits as well.
+      void waitForGeometry();
+
+      /// \brief Read a component from a kxml file
+
+      /// Same as CkprParserManager::loadComponentFromFile(), with
+      /// polyhedra read from a GeometryStore built by the threads set by
+      /// geometryThreads(). Files read directly by CkprParserManager are
+      /// parsed as well, with polyhedra built by the tag builder.
+      ktStatus loadComponentFromFile(const std::string& filename,
+				     CkppComponentShPtr& outComponent,
+				     const CkppComponentFactoryRegistryShPtr&
+				     registry,
+				     const CkitParameterMapShPtr& parameters);
+
+      /// @}
+
       ///
       /// \name Call back for kxml read write
       /// @{
@@ -112,7 +182,44 @@ namespace hpp {
 		       inPrebuiltChildComponentVector,
 		       CkprXMLBuildingContextShPtr& inOutContext,
 		       CkppComponentShPtr& outComponent);
+      /// \brief Build a polyhedron from a mesh of a GeometryStore
+
+      /// The tag has attributes \c store, the file of the store, \c mesh,
+      /// the name of the mesh in the store, and optionally \c name, the
+      /// name of the polyhedron (default: mesh name).
+      ktStatus
+      buildStoredPolyhedron(const CkprXMLTagConstShPtr& inTag,
+			    const CkppComponentShPtr&
+			    inOutParentComponent,
+			    std::vector< CkppComponentShPtr >&
+			    inPrebuiltChildComponentVector,
+			    CkprXMLBuildingContextShPtr& inOutContext,
+			    CkppComponentShPtr& outComponent);
       /// @}
+
+    private:
+      struct PreparedPolyhedron;
+      typedef boost::shared_ptr<PreparedPolyhedron> PreparedPolyhedronShPtr;
+      /// Key of a stored polyhedron: store file, mesh index, name.
+      typedef std::pair<std::string, std::pair<std::size_t, std::string> >
+      PreparedKey_t;
+      typedef std::map<PreparedKey_t, std::deque<PreparedPolyhedronShPtr> >
+      PreparedPolyhedra_t;
+
+      /// Push the polyhedra of a document to geometryPool_.
+      void preparePolyhedra(const std::string& filename);
+      /// Wait for the next polyhedron built for a key, null if none.
+      CkppKCDPolyhedronShPtr preparedPolyhedron(const PreparedKey_t& key);
+      /// Task of geometryPool_.
+      static void preparePolyhedron(const GeometryStoreShPtr& store,
+				    std::size_t mesh, const std::string& name,
+				    const PreparedPolyhedronShPtr& result);
+
+      boost::scoped_ptr<TaskPool> geometryPool_;
+      bool lazyGeometry_;
+      /// Polyhedra built by geometryPool_ for the document being parsed,
+      /// in document order for each key.
+      PreparedPolyhedra_t preparedPolyhedra_;
     }; // Parser
   } // namespace model
 } // namespace hpp
@@ -0,0 +1,137 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_SELF_DISTANCE_TABLE_HH
+# define HPP_MODEL_SELF_DISTANCE_TABLE_HH
+
+# include <string>
+# include <vector>
+
+# include <kcd2/kcdInterface.h>
+
+# include "hpp/model/fwd.hh"
+
+class CkcdPoint;
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Distances between the bodies of a device
+
+    /// Each pair of objects attached to two different bodies of the
+    /// device is stored once. Pairs of bodies allowed by an
+    /// AllowedCollisionMatrix are left out.
+
+    /// Pairs are stored as parallel arrays (body indices, distance
+    /// analyses, distances, closest points) in the order of the bodies.
+    /// computeDistances () evaluates every pair for the current
+    /// configuration of the device, set by
+    /// Device::hppSetCurrentConfig (), and returns the minimum.
+
+    /// The table uses the objects of the device: it must not be used
+    /// concurrently with other collision checks of the device.
+    class SelfDistanceTable
+    {
+    public:
+      /// \brief Build the table of an initialized device
+      /// \param device device the bodies of which are paired,
+      /// \param matrix allowed collision matrix of the device. If null,
+      /// all pairs of different bodies are stored.
+      /// \throw Exception if the matrix does not describe the bodies of
+      /// the device.
+      static SelfDistanceTableShPtr create
+      (const DeviceShPtr& device,
+       const AllowedCollisionMatrixConstShPtr& matrix =
+       AllowedCollisionMatrixConstShPtr ());
+
+      /// \brief Number of bodies of the device
+      std::size_t nbBodies () const { return bodyName_.size (); }
+
+      /// \brief Name of the joint a body is attached to
+      const std::string& bodyName (std::size_t bodyId) const
+      {
+	return bodyName_ [bodyId];
+      }
+
+      /// \brief Number of pairs of objects
+      std::size_t nbPairs () const { return analysis_.size (); }
+
+      /// \brief Index of the first body of a pair
+      std::size_t body1 (std::size_t pairId) const { return body1_ [pairId]; }
+
+      /// \brief Index of the second body of a pair, greater than body1 ()
+      std::size_t body2 (std::size_t pairId) const { return body2_ [pairId]; }
+
+      /// \brief Compute the distance of every pair
+      /// \return minimum distance, 0 if two bodies collide, infinity
+      /// if there is no pair.
+      /// \throw Exception if a distance computation fails.
+      double computeDistances ();
+
+      /// \name Results of the last call to computeDistances ()
+      /// @{
+
+      /// \brief Distances of all pairs
+      const std::vector<double>& distances () const { return distance_; }
+
+      /// \brief Distance of a pair
+      double distance (std::size_t pairId) const
+      {
+	return distance_ [pairId];
+      }
+
+      /// \brief Pair of minimum distance, SIZE_MAX if there is no pair
+      std::size_t minPair () const { return minPair_; }
+
+      /// \brief Whether closest points of a pair are defined
+
+      /// They are not when the objects of the pair collide: the distance
+      /// is then 0 and closestPoints () returns NaN coordinates.
+      bool hasClosestPoints (std::size_t pairId) const
+      {
+	// NaN is the only value different from itself.
+	return point1_ [3*pairId] == point1_ [3*pairId];
+      }
+
+      /// \brief Closest points of a pair in the global frame
+      /// \retval outPoint1 point on body1 (pairId),
+      /// \retval outPoint2 point on body2 (pairId).
+      /// \note Coordinates are NaN if !hasClosestPoints (pairId).
+      void closestPoints (std::size_t pairId, CkcdPoint& outPoint1,
+			  CkcdPoint& outPoint2) const;
+
+      /// @}
+
+    private:
+      SelfDistanceTable ();
+
+      std::vector<std::string> bodyName_;
+      std::vector<std::size_t> body1_;
+      std::vector<std::size_t> body2_;
+      std::vector<CkcdAnalysisShPtr> analysis_;
+      std::vector<double> distance_;
+      /// Closest points, 3 coordinates per pair
+      std::vector<double> point1_;
+      std::vector<double> point2_;
+      std::size_t minPair_;
+    }; // class SelfDistanceTable
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_SELF_DISTANCE_TABLE_HH
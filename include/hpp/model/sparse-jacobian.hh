@@ -0,0 +1,107 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_SPARSE_JACOBIAN_HH
+# define HPP_MODEL_SPARSE_JACOBIAN_HH
+
+# include <vector>
+# include <cstddef>
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Jacobian matrix storing only structurally non-zero columns
+
+    /// The Jacobian of a joint only depends on the degrees of freedom of
+    /// the joint and of its ancestors. Only these columns are stored:
+    /// column i of the compact matrix corresponds to the degree of
+    /// freedom columns ()[i] of the configuration. Columns are stored
+    /// contiguously (nbRows () doubles per column).
+
+    /// For joint Jacobians, the first three rows are the linear velocity
+    /// of the joint origin and the last three rows the angular velocity,
+    /// both expressed in the global frame. The center of mass Jacobian
+    /// has three rows.
+    class SparseJacobian
+    {
+    public:
+      SparseJacobian () : nbRows_ (0), numberDof_ (0), columns_ (),
+			  values_ ()
+      {
+      }
+
+      /// \brief Number of rows
+      std::size_t nbRows () const { return nbRows_; }
+
+      /// \brief Number of columns of the full matrix
+      std::size_t numberDof () const { return numberDof_; }
+
+      /// \brief Number of stored columns
+      std::size_t nbColumns () const { return columns_.size (); }
+
+      /// \brief Degrees of freedom of the stored columns, in increasing order
+      const std::vector<std::size_t>& columns () const { return columns_; }
+
+      /// \brief Access to stored column i
+      const double* column (std::size_t i) const
+      {
+	return &values_ [i * nbRows_];
+      }
+
+      /// \brief Access to stored column i
+      double* column (std::size_t i)
+      {
+	return &values_ [i * nbRows_];
+      }
+
+      /// \brief Coefficient of the full matrix
+      double operator () (std::size_t row, std::size_t dof) const;
+
+      /// \brief Reset the structure of the matrix
+      /// \param nbRows number of rows,
+      /// \param numberDof number of columns of the full matrix,
+      /// \param columns stored columns, in increasing order.
+      void resize (std::size_t nbRows, std::size_t numberDof,
+		   const std::vector<std::size_t>& columns);
+
+      /// \brief Compute out = J * v
+      /// \param v vector of size numberDof (),
+      /// \retval out vector of size nbRows ().
+      void multiply (const double* v, double* out) const;
+
+      /// \brief Compute out += J^T * f
+      /// \param f vector of size nbRows (),
+      /// \retval out vector of size numberDof (). Only the stored columns
+      /// are updated.
+      void transposeMultiplyAdd (const double* f, double* out) const;
+
+      /// \brief Copy into a dense column-major matrix
+      /// \retval out nbRows () * numberDof () doubles.
+      void toDense (double* out) const;
+
+    private:
+      std::size_t nbRows_;
+      std::size_t numberDof_;
+      std::vector<std::size_t> columns_;
+      std::vector<double> values_;
+    }; // class SparseJacobian
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_SPARSE_JACOBIAN_HH
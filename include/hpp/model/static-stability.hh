@@ -0,0 +1,142 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_STATIC_STABILITY_HH
+# define HPP_MODEL_STATIC_STABILITY_HH
+
+# include <vector>
+
+# include "hpp/model/fwd.hh"
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Static stability of a humanoid robot standing on its feet
+
+    /// A configuration is statically stable if the projection of the
+    /// center of mass on the horizontal plane lies inside the support
+    /// polygon, at distance at least margin () from its boundary. The
+    /// support polygon is the convex hull of the soles in contact.
+
+    /// Soles are rectangles of size CjrlFoot::getSoleSize () centered
+    /// below the ankle (CjrlFoot::getAnklePositionInLocalFrame ()). The
+    /// foot frame is parallel to the global frame when the ankle is in
+    /// its initial position.
+
+    /// Sole geometry is read from the robot at construction. Methods are
+    /// const and can be called concurrently.
+    class StaticStability
+    {
+    public:
+      /// \brief Feet in contact with the ground
+      typedef enum Esupport {
+	LEFT_FOOT,
+	RIGHT_FOOT,
+	BOTH_FEET
+      } Esupport;
+
+      /// \brief Constructor
+      /// \param robot initialized humanoid robot with both feet defined,
+      /// \param margin minimal distance between the projection of the
+      /// center of mass and the boundary of the support polygon.
+      /// \throw Exception if feet are not defined or if the robot has no
+      /// mass.
+      StaticStability (const HumanoidRobot& robot, double margin = 0);
+
+      /// \brief Get margin
+      double margin () const { return margin_; }
+
+      /// \brief Set margin
+      void margin (double margin) { margin_ = margin; }
+
+      /// \brief Compute the support polygon
+      /// \param transforms positions of the joints as computed by
+      /// KinematicTree::forwardKinematics (),
+      /// \param support feet in contact,
+      /// \retval outVertices vertices (x, y) of the polygon in
+      /// counter-clockwise order.
+      void supportPolygon (const double* transforms, Esupport support,
+			   std::vector<double>& outVertices) const;
+
+      /// \brief Signed distance of the center of mass projection to the
+      /// boundary of the support polygon, positive inside.
+      /// See signedDistance ().
+      /// \param config configuration in impl::DynamicRobot convention,
+      /// \param support feet in contact.
+      double stabilityMargin (const double* config, Esupport support) const;
+
+      /// \brief Whether a configuration is statically stable
+      /// \param config configuration in impl::DynamicRobot convention,
+      /// \param support feet in contact.
+      bool isStable (const double* config, Esupport support) const;
+
+      /// \brief Check stability of several configurations
+      /// \param configs nbConfigs configurations stored contiguously,
+      /// \param nbConfigs number of configurations,
+      /// \param support feet in contact,
+      /// \retval outStable whether each configuration is stable.
+
+      /// Joint positions and centers of mass are computed by blocks of
+      /// KinematicTree::BLOCK_SIZE configurations.
+      void isStable (const double* configs, std::size_t nbConfigs,
+		     Esupport support, std::vector<bool>& outStable) const;
+
+      /// \brief Convex hull of points of the plane
+      /// \param points nbPoints points (x, y),
+      /// \param nbPoints number of points, at most 8,
+      /// \retval outVertices vertices (x, y) of the hull in
+      /// counter-clockwise order, at most nbPoints.
+      /// \return number of vertices.
+      /// \throw Exception if there are more than 8 points.
+      static std::size_t convexHull (const double* points,
+				     std::size_t nbPoints,
+				     double* outVertices);
+
+      /// \brief Signed distance of a point to the boundary of a polygon
+      /// \param vertices vertices (x, y) of a convex polygon in
+      /// counter-clockwise order,
+      /// \param nbVertices number of vertices,
+      /// \param point point (x, y).
+      /// \return Euclidean distance to the boundary, positive inside the
+      /// polygon, negative outside.
+      static double signedDistance (const double* vertices,
+				    std::size_t nbVertices,
+				    const double* point);
+
+    private:
+      /// Sole corners (x, y) in the global frame, 4 per foot.
+      void soleCorners (const double* ankleTransform, std::size_t foot,
+			double* outCorners) const;
+
+      /// Hull of the soles in contact, returns the number of vertices.
+      std::size_t supportHull (const double* leftAnkleTransform,
+			       const double* rightAnkleTransform,
+			       Esupport support, double* outVertices) const;
+
+      KinematicTreeConstShPtr tree_;
+      double margin_;
+      /// Index of left and right ankles in tree_.
+      std::size_t ankle_ [2];
+      /// Sole corners in ankle frame, 4 corners of 3 doubles per foot.
+      double corner_ [2][12];
+    }; // class StaticStability
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_STATIC_STABILITY_HH
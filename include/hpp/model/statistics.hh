@@ -0,0 +1,149 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_STATISTICS_HH
+# define HPP_MODEL_STATISTICS_HH
+
+# include <stdint.h>
+
+# include <ostream>
+# include <string>
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Call counters and latency histograms of hot paths
+
+    /// Each instrumented function counts its calls. When statistics are
+    /// enabled, it also records its latency in a histogram with
+    /// logarithmic buckets, 16 buckets per power of two, giving about 6%
+    /// precision from 1 ns to several minutes.
+    ///
+    /// Counters and histograms are stored per thread and merged on
+    /// demand by count (), percentile () and write (). Values read
+    /// while other threads are recording may miss the last calls.
+    /// reset () does not touch the histograms of other threads: each
+    /// thread clears its own histograms on its next call, and they are
+    /// ignored until then. Histograms of terminated threads are merged
+    /// together.
+    ///
+    /// When statistics are disabled (the default), an instrumented call
+    /// only increments its counter: the clock is not read.
+    class Statistics
+    {
+    public:
+      /// \brief Instrumented functions
+      typedef enum Ecounter {
+	/// Device::hppSetCurrentConfig with GEOMETRIC
+	SET_CONFIG_GEOMETRIC,
+	/// Device::hppSetCurrentConfig with DYNAMIC
+	SET_CONFIG_DYNAMIC,
+	/// Device::hppSetCurrentConfig with BOTH
+	SET_CONFIG_BOTH,
+	/// Device::kwsToJrlDynamicsDofValues
+	KWS_TO_JRL_CONFIG,
+	/// Device::jrlDynamicsToKwsDofValues
+	JRL_TO_KWS_CONFIG,
+	/// KinematicTree::forwardKinematics, one configuration
+	FORWARD_KINEMATICS,
+	/// KinematicTree::forwardKinematics, several configurations
+	FORWARD_KINEMATICS_BATCH,
+	/// BodyDistance::distAndPairsOfPoints
+	BODY_DISTANCE,
+	/// CapsuleBodyDistance::distAndPairsOfPoints for one pair
+	CAPSULE_BODY_DISTANCE,
+	/// CapsuleBodyDistance::kcdDistAndPairsOfPoints
+	CAPSULE_BODY_KCD_DISTANCE,
+	/// CapsuleBodyDistance::capsuleDistAndPairsOfPoints
+	CAPSULE_BODY_CAPSULE_DISTANCE,
+	/// CapsuleBodyDistance::distAndPairsOfPoints for all pairs
+	CAPSULE_BODY_MIN_DISTANCE,
+	/// CapsuleBodyDistance::cascadeDistAndPairsOfPoints
+	CAPSULE_BODY_CASCADE_DISTANCE,
+	/// SelfDistanceTable::computeDistances
+	SELF_DISTANCE,
+	/// Device::axisAlignedBoundingBox
+	BOUNDING_BOX,
+	/// Device::createCopy and HumanoidRobot::createCopy
+	CREATE_COPY,
+	NB_COUNTERS
+      } Ecounter;
+
+      /// \brief Record latency of a call until the end of the scope
+      class Scope
+      {
+      public:
+	explicit Scope (Ecounter counter)
+	  : counter_ (counter), start_ (isEnabled () ? now () : 0)
+	{
+	}
+	~Scope ()
+	{
+	  record (counter_, start_);
+	}
+      private:
+	Scope (const Scope&);
+	Scope& operator= (const Scope&);
+	Ecounter counter_;
+	uint64_t start_;
+      }; // class Scope
+
+      /// \brief Enable or disable latency histograms
+      static void enable (bool enabled);
+
+      /// \brief Whether latency histograms are enabled
+      static bool isEnabled ()
+      {
+	return __atomic_load_n (&enabled_, __ATOMIC_RELAXED);
+      }
+
+      /// \brief Reset counters and histograms of all threads
+      static void reset ();
+
+      /// \brief Name of a counter, as written by write ()
+      static const char* name (Ecounter counter);
+
+      /// \brief Number of calls, merged over threads
+      static uint64_t count (Ecounter counter);
+
+      /// \brief Number of calls whose latency has been recorded
+      static uint64_t nbSamples (Ecounter counter);
+
+      /// \brief Latency percentile in nanoseconds, merged over threads
+      /// \param counter instrumented function,
+      /// \param percent percentage in [0, 100].
+      /// \return upper bound of the bucket holding the percentile,
+      /// 0 if no latency has been recorded.
+      static double percentile (Ecounter counter, double percent);
+
+      /// \brief Write counters and histograms of all threads as JSON
+      static void write (std::ostream& os);
+
+      /// \brief Monotonic clock in nanoseconds
+      static uint64_t now ();
+
+    private:
+      static void record (Ecounter counter, uint64_t start);
+      /// Read and written with relaxed atomic accesses.
+      static bool enabled_;
+    }; // class Statistics
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_STATISTICS_HH
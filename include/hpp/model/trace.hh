@@ -0,0 +1,118 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_TRACE_HH
+# define HPP_MODEL_TRACE_HH
+
+# include <stdint.h>
+
+# include <string>
+
+# include "hpp/model/statistics.hh"
+
+namespace hpp {
+  namespace model {
+
+    /// \brief Trace of model operations in Chrome trace-event format
+
+    /// Between start () and stop (), each Span writes a complete event
+    /// ("ph": "X") with its duration, process and thread identifiers and
+    /// optional argument to the trace file. The file can be opened in
+    /// chrome://tracing or in Perfetto.
+    ///
+    /// When tracing is stopped (the default), a span only tests a flag.
+    class Trace
+    {
+    public:
+      /// \brief Scoped trace event
+      class Span
+      {
+      public:
+	/// \brief Constructor
+	/// \param category category of the event (device, distance, parser),
+	/// \param name name of the event.
+	/// \note category and name must be string literals.
+	Span (const char* category, const char* name)
+	  : start_ (isEnabled () ? Statistics::now () : 0),
+	    category_ (category), name_ (name), argName_ (0), intArg_ (0),
+	    stringArg_ (), isString_ (false)
+	{
+	}
+
+	/// \brief Constructor with an integer argument
+	Span (const char* category, const char* name, const char* argName,
+	      long argValue)
+	  : start_ (isEnabled () ? Statistics::now () : 0),
+	    category_ (category), name_ (name), argName_ (argName),
+	    intArg_ (argValue), stringArg_ (), isString_ (false)
+	{
+	}
+
+	/// \brief Constructor with a string argument
+	Span (const char* category, const char* name, const char* argName,
+	      const std::string& argValue)
+	  : start_ (isEnabled () ? Statistics::now () : 0),
+	    category_ (category), name_ (name), argName_ (argName),
+	    intArg_ (0), stringArg_ (), isString_ (true)
+	{
+	  if (start_) stringArg_ = argValue;
+	}
+
+	~Span ()
+	{
+	  if (start_) write ();
+	}
+
+      private:
+	Span (const Span&);
+	Span& operator= (const Span&);
+	void write () const;
+
+	uint64_t start_;
+	const char* category_;
+	const char* name_;
+	const char* argName_;
+	long intArg_;
+	std::string stringArg_;
+	bool isString_;
+      }; // class Span
+
+      /// \brief Start writing events to a file
+      /// \throw Exception if the file cannot be created or if a trace
+      /// is already being written.
+      static void start (const std::string& filename);
+
+      /// \brief Stop tracing and close the file
+      static void stop ();
+
+      /// \brief Whether a trace is being written
+      static bool isEnabled ()
+      {
+	return __atomic_load_n (&enabled_, __ATOMIC_RELAXED);
+      }
+
+    private:
+      // Written under the trace mutex by start () and stop (), read by
+      // spans of any thread without the mutex.
+      static bool enabled_;
+    }; // class Trace
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_TRACE_HH
@@ -0,0 +1,510 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <kcd2/kcdAnalysis.h>
+#include <kcd2/kcdExactDistanceReport.h>
+
+#include <jrl/mal/matrixabstractlayer.hh>
+#include <hpp/util/debug.hh>
+
+#include "hpp/model/allowed-collision-matrix.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/exception.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/model-snapshot.hh"
+
+#include "device-bodies.hh"
+#include "mapped-file.hh"
+#include "task-pool.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Layout of a matrix file:
+      //
+      //   Header
+      //   StringRef x nbBodies        names of the joints of the bodies
+      //   uint8_t   x nbBodies^2      reasons, row-major
+      //   char      x stringsSize
+      const char magic [8] = {'H', 'P', 'P', 'M', 'A', 'C', 'M', 'X'};
+      const uint32_t byteOrderMark = 0x01020304;
+
+      struct Header
+      {
+	char magic [8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t sourceHash;
+	uint64_t nbSamples;
+	uint64_t seed;
+	uint64_t nbBodies;
+	uint64_t stringsSize;
+      };
+
+      struct StringRef
+      {
+	uint64_t offset;
+	uint64_t length;
+      };
+
+      typedef std::vector<std::pair<std::size_t, std::size_t> > Pairs_t;
+
+      // Joint moving a joint: anchor joints move with their parent.
+      std::size_t movingJoint (const KinematicTree& tree, std::size_t jointId)
+      {
+	while (tree.jointType (jointId) == KinematicTree::ANCHOR &&
+	       tree.parent (jointId) != SIZE_MAX) {
+	  jointId = tree.parent (jointId);
+	}
+	return jointId;
+      }
+
+      bool areAdjacent (const KinematicTree& tree, std::size_t joint1,
+			std::size_t joint2)
+      {
+	joint1 = movingJoint (tree, joint1);
+	joint2 = movingJoint (tree, joint2);
+	if (joint1 == joint2) return true;
+	const std::size_t parent1 = tree.parent (joint1);
+	const std::size_t parent2 = tree.parent (joint2);
+	return (parent1 != SIZE_MAX && movingJoint (tree, parent1) == joint2)
+	  || (parent2 != SIZE_MAX && movingJoint (tree, parent2) == joint1);
+      }
+
+      // SplitMix64
+      uint64_t nextRandom (uint64_t& state)
+      {
+	state += 0x9e3779b97f4a7c15ULL;
+	uint64_t z = state;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+      }
+
+      double uniform (uint64_t& state, double lower, double upper)
+      {
+	return lower + (upper - lower) *
+	  ((nextRandom (state) >> 11) * (1. / 9007199254740992.));
+      }
+
+      bool isFinite (double value)
+      {
+	return value > -1e6 && value < 1e6;
+      }
+
+      // Random configuration k in impl::DynamicRobot convention.
+      void sampleConfiguration (const KinematicTree& tree, uint64_t seed,
+				std::size_t k, vectorN& config)
+      {
+	uint64_t state = seed ^ (uint64_t (k) * 0xd1b54a32d192ed03ULL);
+	for (std::size_t j = 0; j < tree.nbJoints (); ++j) {
+	  const KinematicTree::EjointType type = tree.jointType (j);
+	  const std::size_t rank = tree.rankInConfiguration (j);
+	  const std::size_t nbDof = tree.jointDof (j);
+	  const bool isRoot = tree.parent (j) == SIZE_MAX;
+	  for (std::size_t i = 0; i < nbDof; ++i) {
+	    const double lower = tree.lowerBound (rank + i);
+	    const double upper = tree.upperBound (rank + i);
+	    const bool isRotation = type == KinematicTree::ROTATION ||
+	      (type == KinematicTree::FREEFLYER && i >= 3);
+	    double value = 0;
+	    if (type == KinematicTree::FREEFLYER && isRoot) {
+	      value = 0;
+	    } else if (isFinite (lower) && isFinite (upper) && lower < upper) {
+	      value = uniform (state, lower, upper);
+	    } else if (isRotation) {
+	      value = uniform (state, -M_PI, M_PI);
+	    } else if (isFinite (lower)) {
+	      value = lower;
+	    }
+	    config [rank + i] = value;
+	  }
+	}
+      }
+
+      bool collide (const CkcdAnalysisShPtr& analysis)
+      {
+	if (!KD_SUCCEEDED (analysis->compute ())) {
+	  throw Exception ("Distance computation failed.");
+	}
+	// No report is returned for objects in collision.
+	return analysis->countExactDistanceReports () == 0 ||
+	  analysis->exactDistanceReport (0)->distance () <= 0;
+      }
+
+      // Count in which configurations first, first + step, ... the pairs
+      // of bodies of the device or of a copy collide. Pairs index the
+      // bodies by their rank in CkwsDevice::getBodyVector, which is the
+      // same in copies.
+      void countCollisions (const DeviceShPtr& device, const Pairs_t& pairs,
+			    std::size_t nbBodies,
+			    const std::vector<double>& kwsConfigs,
+			    std::size_t nbSamples, std::size_t nbKwsDofs,
+			    std::size_t first, std::size_t step,
+			    std::vector<uint32_t>& counts)
+      {
+	Bodies_t bodies;
+	kcdBodies (*device, bodies);
+	if (bodies.size () != nbBodies) {
+	  throw Exception ("Bodies of device copy differ from original.");
+	}
+
+	std::vector<std::vector<CkcdAnalysisShPtr> > analyses (pairs.size ());
+	for (std::size_t p = 0; p < pairs.size (); ++p) {
+	  const std::vector<CkcdObjectShPtr> objects1 =
+	    bodies [pairs [p].first]->mobileObjects ();
+	  const std::vector<CkcdObjectShPtr> objects2 =
+	    bodies [pairs [p].second]->mobileObjects ();
+	  for (std::size_t i = 0; i < objects1.size (); ++i) {
+	    for (std::size_t j = 0; j < objects2.size (); ++j) {
+	      CkcdAnalysisShPtr analysis = CkcdAnalysis::create ();
+	      analysis->analysisData ()
+		->analysisType (CkcdAnalysisType::EXACT_DISTANCE);
+	      analysis->analysisData ()->isToleranceActivated (false);
+	      analysis->leftObject (objects1 [i]);
+	      analysis->rightObject (objects2 [j]);
+	      analyses [p].push_back (analysis);
+	    }
+	  }
+	}
+
+	counts.assign (pairs.size (), 0);
+	std::vector<double> dofValues (nbKwsDofs);
+	for (std::size_t k = first; k < nbSamples; k += step) {
+	  std::vector<double>::const_iterator begin =
+	    kwsConfigs.begin () + k * nbKwsDofs;
+	  std::copy (begin, begin + nbKwsDofs, dofValues.begin ());
+	  if (device->setCurrentDofValues (dofValues) != KD_OK) {
+	    throw Exception ("Failed to set configuration of device copy.");
+	  }
+	  for (std::size_t p = 0; p < pairs.size (); ++p) {
+	    for (std::size_t a = 0; a < analyses [p].size (); ++a) {
+	      if (collide (analyses [p][a])) {
+		++counts [p];
+		break;
+	      }
+	    }
+	  }
+	}
+      }
+    } // namespace
+
+    const uint32_t AllowedCollisionMatrix::VERSION;
+
+    // ======================================================================
+
+    AllowedCollisionMatrix::AllowedCollisionMatrix ()
+      : bodyName_ (), reason_ (), nbSamples_ (0), seed_ (0)
+    {
+    }
+
+    // ======================================================================
+
+    AllowedCollisionMatrixShPtr AllowedCollisionMatrix::generate
+    (const DeviceShPtr& device, std::size_t nbSamples, std::size_t nbThreads,
+     uint64_t seed)
+    {
+      if (nbSamples == 0) {
+	throw Exception ("Allowed collision matrix needs samples.");
+      }
+      if (nbThreads == 0) {
+	nbThreads = std::max (1u, boost::thread::hardware_concurrency ());
+      }
+      const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+      Bodies_t bodies;
+      std::vector<std::size_t> jointIds;
+      deviceBodies (*device, bodies, jointIds);
+      const std::size_t n = bodies.size ();
+
+      AllowedCollisionMatrix* ptr = new AllowedCollisionMatrix ();
+      AllowedCollisionMatrixShPtr shPtr (ptr);
+      ptr->nbSamples_ = nbSamples;
+      ptr->seed_ = seed;
+      ptr->reason_.assign (n * n, CHECK);
+      for (std::size_t i = 0; i < n; ++i) {
+	ptr->bodyName_.push_back (tree->jointName (jointIds [i]));
+      }
+
+      // Pairs to sample
+      Pairs_t pairs;
+      for (std::size_t i = 0; i < n; ++i) {
+	ptr->reason_ [i * n + i] = ADJACENT;
+	for (std::size_t j = i + 1; j < n; ++j) {
+	  Ereason reason = CHECK;
+	  if (areAdjacent (*tree, jointIds [i], jointIds [j])) {
+	    reason = ADJACENT;
+	  } else if (bodies [i]->mobileObjects ().empty () ||
+		     bodies [j]->mobileObjects ().empty ()) {
+	    reason = NEVER_COLLIDING;
+	  } else {
+	    pairs.push_back (std::make_pair (i, j));
+	  }
+	  ptr->reason_ [i * n + j] = ptr->reason_ [j * n + i] = reason;
+	}
+      }
+
+      // Configurations are converted once by the device: copies are
+      // only used for collision checking.
+      std::vector<double> dofValues;
+      device->getCurrentDofValues (dofValues);
+      const std::size_t nbKwsDofs = dofValues.size ();
+      std::vector<double> kwsConfigs (nbSamples * nbKwsDofs);
+      vectorN config (tree->numberDof ());
+      for (std::size_t k = 0; k < nbSamples; ++k) {
+	sampleConfiguration (*tree, seed, k, config);
+	if (!device->jrlDynamicsToKwsDofValues (config, dofValues)) {
+	  throw Exception ("Failed to convert sampled configuration.");
+	}
+	std::copy (dofValues.begin (), dofValues.end (),
+		   kwsConfigs.begin () + k * nbKwsDofs);
+      }
+
+      std::vector<std::vector<uint32_t> > counts (nbThreads);
+      if (nbThreads == 1) {
+	// Sample on the device itself and restore its configuration.
+	std::vector<double> current;
+	device->getCurrentDofValues (current);
+	try {
+	  countCollisions (device, pairs, n, kwsConfigs, nbSamples,
+			   nbKwsDofs, 0, 1, counts [0]);
+	} catch (...) {
+	  device->setCurrentDofValues (current);
+	  throw;
+	}
+	device->setCurrentDofValues (current);
+      } else {
+	std::vector<DeviceShPtr> copies;
+	for (std::size_t t = 0; t < nbThreads; ++t) {
+	  DeviceShPtr copy = Device::createCopy (device);
+	  if (!copy) {
+	    throw Exception ("Failed to copy device " + device->name () + ".");
+	  }
+	  copies.push_back (copy);
+	}
+	TaskPool pool (nbThreads);
+	for (std::size_t t = 0; t < nbThreads; ++t) {
+	  pool.push (boost::bind (&countCollisions, copies [t],
+				  boost::cref (pairs), n,
+				  boost::cref (kwsConfigs), nbSamples,
+				  nbKwsDofs, t, nbThreads,
+				  boost::ref (counts [t])));
+	}
+	pool.wait ();
+      }
+
+      for (std::size_t p = 0; p < pairs.size (); ++p) {
+	std::size_t nbCollisions = 0;
+	for (std::size_t t = 0; t < nbThreads; ++t) {
+	  nbCollisions += counts [t][p];
+	}
+	Ereason reason = CHECK;
+	if (nbCollisions == 0) {
+	  reason = NEVER_COLLIDING;
+	} else if (nbCollisions == nbSamples) {
+	  reason = ALWAYS_COLLIDING;
+	}
+	const std::size_t i = pairs [p].first;
+	const std::size_t j = pairs [p].second;
+	ptr->reason_ [i * n + j] = ptr->reason_ [j * n + i] = reason;
+      }
+      hppDout (info, "Allowed collision matrix of " << device->name ()
+	       << ": " << n << " bodies, " << ptr->nbPairs (CHECK)
+	       << " pairs to check, " << ptr->nbPairs (ADJACENT)
+	       << " adjacent, " << ptr->nbPairs (ALWAYS_COLLIDING)
+	       << " always colliding, " << ptr->nbPairs (NEVER_COLLIDING)
+	       << " never colliding in " << nbSamples << " samples.");
+      return shPtr;
+    }
+
+    // ======================================================================
+
+    void AllowedCollisionMatrix::write (const std::string& filename,
+					uint64_t sourceHash) const
+    {
+      std::string stringTable;
+      std::vector<StringRef> names (nbBodies ());
+      for (std::size_t i = 0; i < nbBodies (); ++i) {
+	names [i].offset = stringTable.size ();
+	names [i].length = bodyName_ [i].size ();
+	stringTable += bodyName_ [i];
+      }
+
+      Header h;
+      memset (&h, 0, sizeof (Header));
+      memcpy (h.magic, magic, sizeof (magic));
+      h.version = VERSION;
+      h.byteOrder = byteOrderMark;
+      h.sourceHash = sourceHash;
+      h.nbSamples = nbSamples_;
+      h.seed = seed_;
+      h.nbBodies = nbBodies ();
+      h.stringsSize = stringTable.size ();
+
+      const std::string tmp = temporaryFilename (filename);
+      {
+	std::ofstream file (tmp.c_str (), std::ios::binary | std::ios::trunc);
+	if (!file) {
+	  throw Exception ("Cannot write " + tmp + ".");
+	}
+	file.write (reinterpret_cast<const char*> (&h), sizeof (Header));
+	if (!names.empty ()) {
+	  file.write (reinterpret_cast<const char*> (&names [0]),
+		      names.size () * sizeof (StringRef));
+	  file.write (reinterpret_cast<const char*> (&reason_ [0]),
+		      reason_.size ());
+	}
+	file.write (stringTable.data (), stringTable.size ());
+	if (!file) {
+	  unlink (tmp.c_str ());
+	  throw Exception ("Failed to write " + tmp + ".");
+	}
+      }
+      commitTemporaryFile (tmp, filename);
+      hppDout (info, "Wrote allowed collision matrix " << filename << ".");
+    }
+
+    // ======================================================================
+
+    AllowedCollisionMatrixShPtr
+    AllowedCollisionMatrix::load (const std::string& filename,
+				  uint64_t sourceHash)
+    {
+      MappedFile file;
+      if (!file.open (filename) || file.size () < sizeof (Header)) {
+	return AllowedCollisionMatrixShPtr ();
+      }
+      const char* data = file.data ();
+      const Header& h = *reinterpret_cast<const Header*> (data);
+      if (memcmp (h.magic, magic, sizeof (magic)) != 0 ||
+	  h.version != VERSION || h.byteOrder != byteOrderMark) {
+	hppDout (info, filename << " is not an allowed collision matrix of"
+		 " version " << VERSION << ".");
+	return AllowedCollisionMatrixShPtr ();
+      }
+      if (h.sourceHash != sourceHash) {
+	hppDout (info, filename << " was produced from another model.");
+	return AllowedCollisionMatrixShPtr ();
+      }
+      const uint64_t limit = uint64_t (1) << 20;
+      if (h.nbBodies > limit || h.stringsSize > limit * limit ||
+	  file.size () != sizeof (Header) + h.nbBodies * sizeof (StringRef)
+	  + h.nbBodies * h.nbBodies + h.stringsSize) {
+	hppDout (error, filename << " is truncated.");
+	return AllowedCollisionMatrixShPtr ();
+      }
+
+      AllowedCollisionMatrix* ptr = new AllowedCollisionMatrix ();
+      AllowedCollisionMatrixShPtr shPtr (ptr);
+      const std::size_t n = h.nbBodies;
+      const StringRef* names =
+	reinterpret_cast<const StringRef*> (data + sizeof (Header));
+      const uint8_t* reasons = reinterpret_cast<const uint8_t*> (names + n);
+      const char* strings = reinterpret_cast<const char*> (reasons + n * n);
+      for (std::size_t i = 0; i < n; ++i) {
+	if (names [i].offset > h.stringsSize ||
+	    names [i].length > h.stringsSize - names [i].offset) {
+	  hppDout (error, filename << " is corrupted.");
+	  return AllowedCollisionMatrixShPtr ();
+	}
+	ptr->bodyName_.push_back (std::string (strings + names [i].offset,
+					       names [i].length));
+      }
+      for (std::size_t i = 0; i < n * n; ++i) {
+	if (reasons [i] > NEVER_COLLIDING ||
+	    reasons [i] != reasons [(i % n) * n + i / n]) {
+	  hppDout (error, filename << " is corrupted.");
+	  return AllowedCollisionMatrixShPtr ();
+	}
+      }
+      ptr->reason_.assign (reasons, reasons + n * n);
+      ptr->nbSamples_ = h.nbSamples;
+      ptr->seed_ = h.seed;
+      return shPtr;
+    }
+
+    // ======================================================================
+
+    AllowedCollisionMatrixShPtr AllowedCollisionMatrix::loadOrGenerate
+    (const DeviceShPtr& device, const std::string& modelFilename,
+     std::size_t nbSamples, std::size_t nbThreads, uint64_t seed)
+    {
+      const uint64_t hash = ModelSnapshot::sourceHash (modelFilename);
+      const std::string filename = modelFilename + ".acm";
+      AllowedCollisionMatrixShPtr matrix = load (filename, hash);
+      if (matrix && matrix->nbSamples () == nbSamples &&
+	  matrix->seed () == seed && matrix->matches (*device)) {
+	hppDout (info, "Loaded allowed collision matrix " << filename << ".");
+	return matrix;
+      }
+      matrix = generate (device, nbSamples, nbThreads, seed);
+      matrix->write (filename, hash);
+      return matrix;
+    }
+
+    // ======================================================================
+
+    std::size_t
+    AllowedCollisionMatrix::bodyIndex (const std::string& jointName) const
+    {
+      for (std::size_t i = 0; i < bodyName_.size (); ++i) {
+	if (bodyName_ [i] == jointName) return i;
+      }
+      return SIZE_MAX;
+    }
+
+    // ======================================================================
+
+    std::size_t AllowedCollisionMatrix::nbPairs (Ereason reason) const
+    {
+      std::size_t result = 0;
+      for (std::size_t i = 0; i < nbBodies (); ++i) {
+	for (std::size_t j = i + 1; j < nbBodies (); ++j) {
+	  if (this->reason (i, j) == reason) ++result;
+	}
+      }
+      return result;
+    }
+
+    // ======================================================================
+
+    bool AllowedCollisionMatrix::matches (const Device& device) const
+    {
+      const KinematicTreeConstShPtr& tree = device.kinematicTree ();
+      Bodies_t bodies;
+      std::vector<std::size_t> jointIds;
+      deviceBodies (device, bodies, jointIds);
+      if (bodies.size () != nbBodies ()) return false;
+      for (std::size_t i = 0; i < bodies.size (); ++i) {
+	if (tree->jointName (jointIds [i]) != bodyName_ [i]) return false;
+      }
+      return true;
+    }
+  } // namespace model
+} // namespace hpp
@@ -17,6 +17,7 @@
 // hpp-model  If not, see
 // <http://www.gnu.org/licenses/>.
 
+#include <cmath>
 #include <iostream>
 
 #include <KineoWorks2/kwsJoint.h>
@@ -33,6 +34,13 @@
 
 #include <hpp/model/body-distance.hh>
 #include "hpp/model/exception.hh"
+#include "hpp/model/geometry-store.hh"
+#include "hpp/model/joint.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/statistics.hh"
+#include "hpp/model/trace.hh"
+
+#include "probes.hh"
 
 namespace hpp {
   namespace model {
@@ -81,6 +89,8 @@ namespace hpp {
     {
       CkppSolidComponentShPtr solidComponent =
 	solidCompRef->referencedSolidComponent();
+      GeometryStore::loadDeferred (KIT_DYNAMIC_PTR_CAST (CkcdObject,
+							 solidComponent));
 
 #ifdef HPP_DEBUG
       std::string innerName = solidComponent->name();
@@ -157,6 +167,7 @@ namespace hpp {
     BodyDistance::addInnerObject (const CkcdObjectShPtr& innerObject,
 				  bool distanceComputation)
     {
+      GeometryStore::loadDeferred (innerObject);
       // Check that object is not already in innerObjects list before
       // adding it.
       std::vector<CkcdObjectShPtr> innerList = body_->mobileObjects ();
@@ -237,6 +248,7 @@ namespace hpp {
 	outerName = std::string("");
       }
 #endif
+      GeometryStore::loadDeferred (outerObject);
       // Append object at the end of KineoWorks set of outer objects
       // for collision checking
       std::vector<CkcdObjectShPtr> outerList = body_->obstacleObjects ();
@@ -300,6 +312,9 @@ namespace hpp {
 				       CkcdPoint& outPointBody,
 				       CkcdPoint& outPointEnv)
     {
+      Trace::Span span ("distance", "kcd-distance", "pair", long (inPairId));
+      HPP_MODEL_PROBE_SCOPE3 (kcd_distance, this, inPairId, nbDistPairs ());
+      Statistics::Scope statistics (Statistics::BODY_DISTANCE);
       KWS_PRECONDITION(pairId < nbDistPairs());
 
       CkcdAnalysisShPtr analysis = distCompPairs_[inPairId];
@@ -340,5 +355,62 @@ namespace hpp {
       }
       return KD_OK;
     }
+
+    //=========================================================================
+
+    ktStatus
+    BodyDistance::distanceGradient (std::size_t pairId,
+				     const double* jointPosition,
+				     const SparseJacobian& jointJacobian,
+				     double& outDistance,
+				     CkcdPoint& outPointBody,
+				     CkcdPoint& outPointEnv,
+				     std::vector<double>& outGradient)
+    {
+      outGradient.assign (jointJacobian.numberDof (), 0);
+      if (distAndPairsOfPoints (pairId, outDistance, outPointBody,
+				outPointEnv) != KD_OK) {
+	return KD_ERROR;
+      }
+      if (fabs (outDistance) < 1e-12) {
+	hppDout (info, "objects in contact, gradient set to 0.");
+	return KD_OK;
+      }
+      // outPointEnv - outPointBody = outDistance * n, also for
+      // penetrating capsules where the distance is negative.
+      double n [3];
+      for (std::size_t i = 0; i < 3; ++i) {
+	n [i] = (outPointEnv [i] - outPointBody [i]) / outDistance;
+      }
+      // Velocity of the body point for dof k is v_k + w_k x r, where r
+      // goes from the joint origin to the point, so that
+      // n.(v_k + w_k x r) = n.v_k + w_k.(r x n).
+      const double r [3] = {outPointBody [0] - jointPosition [3],
+			    outPointBody [1] - jointPosition [7],
+			    outPointBody [2] - jointPosition [11]};
+      const double rxn [3] = {r [1] * n [2] - r [2] * n [1],
+			      r [2] * n [0] - r [0] * n [2],
+			      r [0] * n [1] - r [1] * n [0]};
+      const std::vector<std::size_t>& columns = jointJacobian.columns ();
+      for (std::size_t c = 0; c < columns.size (); ++c) {
+	const double* column = jointJacobian.column (c);
+	outGradient [columns [c]] =
+	  - (n [0] * column [0] + n [1] * column [1] + n [2] * column [2]
+	     + column [3] * rxn [0] + column [4] * rxn [1]
+	     + column [5] * rxn [2]);
+      }
+      return KD_OK;
+    }
+
+    //=========================================================================
+
+    std::size_t BodyDistance::jointIndex (const KinematicTree& tree) const
+    {
+      JointShPtr joint =
+	KIT_DYNAMIC_PTR_CAST (Joint, KIT_DYNAMIC_PTR_CAST
+			      (CkppJointComponent, body_->joint ()));
+      if (!joint) return SIZE_MAX;
+      return tree.jointIndex (joint->jrlJoint ());
+    }
   } // namespace model
 } // namespace hpp
@@ -17,6 +17,7 @@
 // hpp-model  If not, see
 // <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <iostream>
 
 #include <KineoWorks2/kwsJoint.h>
@@ -36,9 +37,108 @@
 #include <hpp/model/capsule-body-distance.hh>
 #include "hpp/model/joint.hh"
 #include "hpp/model/exception.hh"
+#include "hpp/model/statistics.hh"
+#include "hpp/model/trace.hh"
+
+#include "capsule-tree.hh"
+#include "probes.hh"
 
 namespace hpp {
   namespace model {
+    namespace {
+      // Inverse of a rigid transformation.
+      CkitMat4 rigidInverse (const CkitMat4& m)
+      {
+	CkitMat4 result;
+	for (unsigned int r = 0; r < 3; ++r) {
+	  result (r, 3) = 0;
+	  for (unsigned int c = 0; c < 3; ++c) {
+	    result (r, c) = m (c, r);
+	    result (r, 3) -= m (c, r) * m (c, 3);
+	  }
+	}
+	return result;
+      }
+
+      bool sameTransform (const CkitMat4& m1, const CkitMat4& m2)
+      {
+	for (unsigned int r = 0; r < 3; ++r) {
+	  for (unsigned int c = 0; c < 4; ++c) {
+	    if (m1 (r, c) != m2 (r, c)) return false;
+	  }
+	}
+	return true;
+      }
+
+      // Segment ends in the global frame and radius of a capsule.
+      void worldCapsule (const CapsuleBodyDistance::capsule_t& capsule,
+			 CkcdPoint& end1, CkcdPoint& end2, kcdReal& radius)
+      {
+	CkcdMat4 position;
+	capsule->getSegment (0, end1, end2, radius);
+	capsule->getAbsolutePosition (position);
+	end1 = position * end1;
+	end2 = position * end2;
+      }
+
+      void worldCapsules
+      (const std::vector<CapsuleBodyDistance::capsule_t>& capsules,
+       std::vector<double>& out)
+      {
+	out.resize (7 * capsules.size ());
+	CkcdPoint end1, end2;
+	kcdReal radius;
+	for (std::size_t i = 0; i < capsules.size (); ++i) {
+	  worldCapsule (capsules [i], end1, end2, radius);
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    out [7*i + k] = end1 [k];
+	    out [7*i + k + 3] = end2 [k];
+	  }
+	  out [7*i + 6] = radius;
+	}
+      }
+
+      // Distance between an inner capsule and outer capsules of a
+      // CapsuleTree, keeping the closest pair.
+      struct NearestCapsule
+      {
+	NearestCapsule (const CapsuleTree& tree, const CkcdPoint& end1,
+			const CkcdPoint& end2, kcdReal radius,
+			double bestDistance)
+	  : tree (tree), end1 (end1), end2 (end2), radius (radius),
+	    bestDistance (bestDistance), pointBody (), pointEnv ()
+	{
+	}
+
+	void operator () (std::size_t i)
+	{
+	  const double* c = tree.capsule (i);
+	  const CkcdPoint outerEnd1 (c [0], c [1], c [2]);
+	  const CkcdPoint outerEnd2 (c [3], c [4], c [5]);
+	  kcdReal squareDistance;
+	  CkcdPoint point1, point2;
+	  hpp::geometry::collision::computeSquareDistanceSegmentSegment
+	    (end1, end2, outerEnd1, outerEnd2, squareDistance, point1,
+	     point2);
+	  const double distance = sqrt (squareDistance) - (radius + c [6]);
+	  if (distance < bestDistance) {
+	    CkitVect3 axis = point2 - point1;
+	    axis.normalize ();
+	    bestDistance = distance;
+	    pointBody = point1 + axis * radius;
+	    pointEnv = point2 - axis * c [6];
+	  }
+	}
+
+	const CapsuleTree& tree;
+	const CkcdPoint& end1;
+	const CkcdPoint& end2;
+	kcdReal radius;
+	double bestDistance;
+	CkcdPoint pointBody;
+	CkcdPoint pointEnv;
+      };
+    } // namespace
 
     CapsuleBodyDistance::
     CapsuleBodyDistance (const CkwsKCDBodyAdvancedShPtr& body,
@@ -46,8 +146,16 @@ namespace hpp {
       BodyDistance (body, name),
       innerCapsulesForDist_ (),
       outerCapsulesForDist_ (),
+      distanceCapsules_ (),
+      distanceCapsulesPlaced_ (false),
+      placedJointPosition_ (),
       capsuleDistCompPairs_ (),
       weakPtr_ (),
+      outerCapsuleTree_ (),
+      worldOuterCapsules_ (),
+      cascade_ (false),
+      nbExactPairs_ (0),
+      outerBounds_ (),
       distPair_ (),
       leftEndPoint1_ (),
       leftEndPoint2_ (),
@@ -101,39 +209,83 @@ namespace hpp {
       // the list of segments the distance to which needs to be
       // computed.
       if (distanceComputation) {
-	CkppSolidComponentShPtr solidComponent
-	  = KIT_DYNAMIC_PTR_CAST (CkppSolidComponent, innerCapsule);
-
-	if (solidComponent) {
-	  hppDout(info,"adding " << solidComponent->name ()
-		  << " to list of capsules for distance computation.");
-	  innerCapsulesForDist_.push_back (innerCapsule);
-	  // Build Exact distance computation pairs for capsule
-	  const std::vector<capsule_t>& outerList = outerCapsulesForDist_;
-	  for (std::vector<capsule_t>::const_iterator it =
-		 outerList.begin (); it != outerList.end (); it++) {
-	    const capsule_t& outerCapsule = *it;
-
-	    // Build new collision pair between inner and outer
-	    // capsules.
-	    capsuleDistCompPair_t distCompPair (innerCapsule, outerCapsule);
-
-	    hppDout(info,"creating collision pair between "
-		    << innerCapsule->name () << " and "
-		    << outerCapsule->name ());
-	    capsuleDistCompPairs_.push_back(distCompPair);
-	  }
-	}
-	else {
-	  hppDout(error,"cannot cast solid component into CkcdObject.");
-	  throw Exception("cannot cast solid component into CkcdObject.");
-	}
+	addInnerCapsulePairs (innerCapsule);
       }
       return true;
     }
 
     //=========================================================================
 
+    void
+    CapsuleBodyDistance::addDistanceCapsule (const capsule_t& innerCapsule)
+    {
+      CkwsJointShPtr joint = body ()->joint ();
+      if (!joint) {
+	throw Exception ("Body " + name () + " is not attached to a joint.");
+      }
+      CkitMat4 position;
+      innerCapsule->getAbsolutePosition (position);
+      distanceCapsules_.push_back
+	(std::make_pair (innerCapsule,
+			 rigidInverse (joint->currentPosition ()) * position));
+      distanceCapsulesPlaced_ = false;
+      addInnerCapsulePairs (innerCapsule);
+    }
+
+    //=========================================================================
+
+    void
+    CapsuleBodyDistance::addInnerCapsulePairs (const capsule_t& innerCapsule)
+    {
+      CkppSolidComponentShPtr solidComponent
+	= KIT_DYNAMIC_PTR_CAST (CkppSolidComponent, innerCapsule);
+
+      if (solidComponent) {
+	hppDout(info,"adding " << solidComponent->name ()
+		<< " to list of capsules for distance computation.");
+	innerCapsulesForDist_.push_back (innerCapsule);
+	// Build Exact distance computation pairs for capsule
+	const std::vector<capsule_t>& outerList = outerCapsulesForDist_;
+	for (std::vector<capsule_t>::const_iterator it =
+	       outerList.begin (); it != outerList.end (); it++) {
+	  const capsule_t& outerCapsule = *it;
+
+	  // Build new collision pair between inner and outer
+	  // capsules.
+	  capsuleDistCompPair_t distCompPair (innerCapsule, outerCapsule);
+
+	  hppDout(info,"creating collision pair between "
+		  << innerCapsule->name () << " and "
+		  << outerCapsule->name ());
+	  capsuleDistCompPairs_.push_back(distCompPair);
+	}
+      }
+      else {
+	hppDout(error,"cannot cast solid component into CkcdObject.");
+	throw Exception("cannot cast solid component into CkcdObject.");
+      }
+    }
+
+    //=========================================================================
+
+    void CapsuleBodyDistance::placeDistanceCapsules ()
+    {
+      if (distanceCapsules_.empty ()) return;
+      const CkitMat4 jointPosition = body ()->joint ()->currentPosition ();
+      // Per pair queries at the same configuration do not move the
+      // capsules again.
+      if (distanceCapsulesPlaced_ &&
+	  sameTransform (jointPosition, placedJointPosition_)) return;
+      distanceCapsulesPlaced_ = true;
+      placedJointPosition_ = jointPosition;
+      for (std::size_t i = 0; i < distanceCapsules_.size (); ++i) {
+	distanceCapsules_ [i].first->setAbsolutePosition
+	  (jointPosition * distanceCapsules_ [i].second);
+      }
+    }
+
+    //=========================================================================
+
     void CapsuleBodyDistance::addOuterCapsule(const capsule_t& outerCapsule,
 				      bool distanceComputation)
 
@@ -151,6 +303,7 @@ namespace hpp {
       if (distanceComputation) {
 	// Store object in case inner objects are added a posteriori
 	outerCapsulesForDist_.push_back (outerCapsule);
+	outerCapsuleTree_.reset ();
 
 	// Build distance computation pairs
 	const std::vector<capsule_t> innerList = innerCapsulesForDist_;
@@ -184,6 +337,7 @@ namespace hpp {
     {
       BodyDistance::resetOuterObjects ();
       resetOuterCapsules ();
+      outerBounds_.clear ();
     }
 
     //=========================================================================
@@ -192,6 +346,20 @@ namespace hpp {
     {
       outerCapsulesForDist_.clear();
       capsuleDistCompPairs_.clear();
+      outerCapsuleTree_.reset ();
+    }
+
+    //=========================================================================
+
+    void CapsuleBodyDistance::refitOuterCapsules ()
+    {
+      worldCapsules (outerCapsulesForDist_, worldOuterCapsules_);
+      if (!outerCapsuleTree_) {
+	outerCapsuleTree_.reset (new CapsuleTree ());
+	outerCapsuleTree_->build (worldOuterCapsules_);
+      } else {
+	outerCapsuleTree_->refit (worldOuterCapsules_);
+      }
     }
 
 
@@ -203,6 +371,11 @@ namespace hpp {
 				       CkcdPoint& outPointBody,
 				       CkcdPoint& outPointEnv)
     {
+      Trace::Span span ("distance", "capsule-pair-distance", "pair",
+			long (inPairId));
+      HPP_MODEL_PROBE_SCOPE3 (capsule_pair_distance, this, inPairId,
+			      nbCapsuleDistPairs ());
+      Statistics::Scope statistics (Statistics::CAPSULE_BODY_DISTANCE);
       KWS_PRECONDITION(pairId < nbDistPairs());
 
       if (inPairId < nbKCDDistPairs ())
@@ -225,6 +398,7 @@ namespace hpp {
       else
 	{
 	  // Compute distance between two capsules with nearest points.
+	  placeDistanceCapsules ();
 	  distPair_ = capsuleDistCompPairs_[inPairId - nbKCDDistPairs ()];
 
 	  distPair_.first->getSegment (0, leftEndPoint1_, leftEndPoint2_,
@@ -267,6 +441,11 @@ namespace hpp {
 					  CkcdPoint& outPointBody,
 					  CkcdPoint& outPointEnv)
     {
+      Trace::Span span ("distance", "capsule-body-kcd-distance", "body",
+			name ());
+      HPP_MODEL_PROBE_SCOPE3 (capsule_body_kcd_distance, this, nbDistPairs (),
+			      nbCapsuleDistPairs ());
+      Statistics::Scope statistics (Statistics::CAPSULE_BODY_KCD_DISTANCE);
       double minDistance = std::numeric_limits<double>::max ();
       CkcdPoint minPointBody, minPointEnv;
       for (unsigned int i = 0; i < nbKCDDistPairs (); ++i)
@@ -300,23 +479,37 @@ namespace hpp {
 					      CkcdPoint& outPointBody,
 					      CkcdPoint& outPointEnv)
     {
+      Trace::Span span ("distance", "capsule-body-capsule-distance", "body",
+			name ());
+      HPP_MODEL_PROBE_SCOPE3 (capsule_body_capsule_distance, this,
+			      nbDistPairs (), nbCapsuleDistPairs ());
+      Statistics::Scope statistics
+	(Statistics::CAPSULE_BODY_CAPSULE_DISTANCE);
+      placeDistanceCapsules ();
+      if (!outerCapsuleTree_) {
+	refitOuterCapsules ();
+      }
       double minDistance = std::numeric_limits<double>::max ();
       CkcdPoint minPointBody, minPointEnv;
-      for (unsigned int i = nbKCDDistPairs (); i < nbDistPairs (); ++i)
+      CkcdPoint end1, end2;
+      kcdReal radius;
+      for (std::size_t i = 0; i < innerCapsulesForDist_.size (); ++i)
 	{
-	  if (KD_OK == distAndPairsOfPoints (i,
-					     outDistance,
-					     outPointBody,
-					     outPointEnv))
+	  worldCapsule (innerCapsulesForDist_ [i], end1, end2, radius);
+	  double lower [3], upper [3];
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    lower [k] = std::min (end1 [k], end2 [k]);
+	    upper [k] = std::max (end1 [k], end2 [k]);
+	  }
+	  NearestCapsule nearest (*outerCapsuleTree_, end1, end2, radius,
+				  minDistance);
+	  outerCapsuleTree_->query (lower, upper, radius, nearest);
+	  if (nearest.bestDistance < minDistance)
 	    {
-	      if (outDistance < minDistance)
-		{
-		  minDistance = outDistance;
-		  minPointBody = outPointBody;
-		  minPointEnv = outPointEnv;
-		} 
+	      minDistance = nearest.bestDistance;
+	      minPointBody = nearest.pointBody;
+	      minPointEnv = nearest.pointEnv;
 	    }
-	  else return KD_ERROR;
 	}
 
       outDistance = minDistance;
@@ -333,29 +526,133 @@ namespace hpp {
 				       CkcdPoint& outPointBody,
 				       CkcdPoint& outPointEnv)
     {
-      double minDistance = std::numeric_limits<double>::max ();
-      CkcdPoint minPointBody, minPointEnv;
-      for (unsigned int i = 0; i < nbDistPairs (); ++i)
+      Trace::Span span ("distance", "capsule-body-min-distance", "body",
+			name ());
+      HPP_MODEL_PROBE_SCOPE3 (capsule_body_min_distance, this,
+			      nbDistPairs (), nbCapsuleDistPairs ());
+      Statistics::Scope statistics (Statistics::CAPSULE_BODY_MIN_DISTANCE);
+      if (cascade_) {
+	return cascadeDistAndPairsOfPoints
+	  (std::numeric_limits<double>::max (), outDistance, outPointBody,
+	   outPointEnv);
+      }
+      double capsuleDistance;
+      CkcdPoint capsulePointBody, capsulePointEnv;
+      if (kcdDistAndPairsOfPoints (outDistance, outPointBody,
+				   outPointEnv) != KD_OK ||
+	  capsuleDistAndPairsOfPoints (capsuleDistance, capsulePointBody,
+				       capsulePointEnv) != KD_OK) {
+	return KD_ERROR;
+      }
+      if (capsuleDistance < outDistance)
 	{
-	  if (KD_OK == distAndPairsOfPoints (i,
-					     outDistance,
-					     outPointBody,
-					     outPointEnv))
-	    {
-	      if (outDistance < minDistance)
-		{
-		  minDistance = outDistance;
-		  minPointBody = outPointBody;
-		  minPointEnv = outPointEnv;
-		} 
-	    }
-	  else return KD_ERROR;
+	  outDistance = capsuleDistance;
+	  outPointBody = capsulePointBody;
+	  outPointEnv = capsulePointEnv;
 	}
 
-      outDistance = minDistance;
-      outPointBody = minPointBody;
-      outPointEnv = minPointEnv;
+      return KD_OK;
+    }
+
+    //=========================================================================
+
+    double CapsuleBodyDistance::kcdLowerBound (std::size_t pairId)
+    {
+      const CkcdAnalysisShPtr& analysis = distanceAnalysis (pairId);
+      const capsule_t inner =
+	KIT_DYNAMIC_PTR_CAST (hpp::geometry::component::Segment,
+			      analysis->leftObject ());
+      const CkcdObjectShPtr outer = analysis->rightObject ();
+      if (!inner || innerCapsulesForDist_.empty ()) {
+	return -std::numeric_limits<double>::max ();
+      }
+
+      std::map<const CkcdObject*, CapsuleFitter::Capsule>::iterator it =
+	outerBounds_.find (outer.get ());
+      if (it == outerBounds_.end ()) {
+	CapsuleFitter::Capsule bound;
+	bound.radius = -1;
+	std::vector<double> vertices;
+	std::vector<uint32_t> triangles;
+	if (CapsuleFitter::mesh (outer, vertices, triangles) &&
+	    !vertices.empty ()) {
+	  CapsuleFitter::Capsules_t capsules;
+	  CapsuleFitter::fit (vertices, triangles, 1, capsules);
+	  bound = capsules [0];
+	}
+	it = outerBounds_.insert (std::make_pair (outer.get (), bound)).first;
+      }
+      const CapsuleFitter::Capsule& bound = it->second;
+      if (bound.radius < 0) return -std::numeric_limits<double>::max ();
+
+      CkcdPoint end1, end2;
+      kcdReal radius;
+      worldCapsule (inner, end1, end2, radius);
+      CkcdMat4 position;
+      outer->getAbsolutePosition (position);
+      const CkcdPoint outerEnd1 =
+	position * CkcdPoint (bound.end1 [0], bound.end1 [1], bound.end1 [2]);
+      const CkcdPoint outerEnd2 =
+	position * CkcdPoint (bound.end2 [0], bound.end2 [1], bound.end2 [2]);
+      kcdReal squareDistance;
+      CkcdPoint point1, point2;
+      hpp::geometry::collision::computeSquareDistanceSegmentSegment
+	(end1, end2, outerEnd1, outerEnd2, squareDistance, point1, point2);
+      // Same radius as distAndPairsOfPoints () for KCD pairs.
+      return sqrt (squareDistance) - bound.radius
+	- innerCapsulesForDist_ [0]->getSegmentRadius (0);
+    }
+
+    //=========================================================================
+
+    ktStatus
+    CapsuleBodyDistance::cascadeDistAndPairsOfPoints (double threshold,
+						      double& outDistance,
+						      CkcdPoint& outPointBody,
+						      CkcdPoint& outPointEnv)
+    {
+      Trace::Span span ("distance", "capsule-body-cascade-distance", "body",
+			name ());
+      HPP_MODEL_PROBE_SCOPE3 (capsule_body_cascade_distance, this,
+			      nbDistPairs (), nbCapsuleDistPairs ());
+      Statistics::Scope statistics
+	(Statistics::CAPSULE_BODY_CASCADE_DISTANCE);
+      if (capsuleDistAndPairsOfPoints (outDistance, outPointBody,
+				       outPointEnv) != KD_OK) {
+	return KD_ERROR;
+      }
 
+      // KCD pairs by increasing lower bound
+      std::vector<std::pair<double, std::size_t> > pairs (nbKCDDistPairs ());
+      for (std::size_t i = 0; i < pairs.size (); ++i) {
+	pairs [i] = std::make_pair (kcdLowerBound (i), i);
+      }
+      std::sort (pairs.begin (), pairs.end ());
+
+      nbExactPairs_ = 0;
+      double distance;
+      CkcdPoint pointBody, pointEnv;
+      for (std::size_t i = 0; i < pairs.size (); ++i) {
+	const double lowerBound = pairs [i].first;
+	if (lowerBound >= std::min (outDistance, threshold)) {
+	  // Neither this pair nor the next ones can be closer than the
+	  // best distance, or below threshold.
+	  outDistance = std::min (outDistance, lowerBound);
+	  break;
+	}
+	if (distAndPairsOfPoints (pairs [i].second, distance, pointBody,
+				  pointEnv) != KD_OK) {
+	  return KD_ERROR;
+	}
+	++nbExactPairs_;
+	if (distance < outDistance) {
+	  outDistance = distance;
+	  outPointBody = pointBody;
+	  outPointEnv = pointEnv;
+	}
+      }
+      hppDout (info, name () << ": " << nbExactPairs_ << " exact distances"
+	       " out of " << pairs.size () << " KCD pairs.");
       return KD_OK;
     }
   } // namespace model
@@ -0,0 +1,548 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <set>
+
+#include <kcd2/kcdPoint.h>
+#include <kcd2/kcdPolyhedron.h>
+
+#include <hpp/util/debug.hh>
+#include <hpp/geometry/component/segment.hh>
+
+#include "hpp/model/capsule-body-distance.hh"
+#include "hpp/model/capsule-fitter.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/exception.hh"
+#include "hpp/model/geometry-store.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/trace.hh"
+
+#include "device-bodies.hh"
+#include "mapped-file.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Layout of a cache file:
+      //
+      //   Header
+      //   EntryRecord             x nbEntries, sorted by key
+      //   CapsuleFitter::Capsule  x nbCapsules
+      const char magic [8] = {'H', 'P', 'P', 'C', 'A', 'P', 'F', 'T'};
+      const uint32_t byteOrderMark = 0x01020304;
+
+      struct Header
+      {
+	char magic [8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t nbEntries;
+	uint64_t nbCapsules;
+      };
+
+      struct EntryRecord
+      {
+	uint64_t meshHash;
+	uint64_t maxCapsules;
+	uint64_t firstCapsule;
+	uint64_t nbCapsules;
+      };
+
+      typedef CapsuleFitter::Capsule Capsule;
+      typedef CapsuleFitter::Capsules_t Capsules_t;
+
+      double dot (const double* u, const double* v)
+      {
+	return u [0] * v [0] + u [1] * v [1] + u [2] * v [2];
+      }
+
+      // Principal axis of a set of vertices, by power iteration on
+      // their covariance. Returns the centroid.
+      void principalAxis (const std::vector<double>& vertices,
+			  const std::vector<uint32_t>& indices,
+			  double* centroid, double* axis)
+      {
+	centroid [0] = centroid [1] = centroid [2] = 0;
+	for (std::size_t i = 0; i < indices.size (); ++i) {
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    centroid [k] += vertices [3 * indices [i] + k];
+	  }
+	}
+	for (std::size_t k = 0; k < 3; ++k) centroid [k] /= indices.size ();
+
+	double covariance [3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+	for (std::size_t i = 0; i < indices.size (); ++i) {
+	  double p [3];
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    p [k] = vertices [3 * indices [i] + k] - centroid [k];
+	  }
+	  for (std::size_t r = 0; r < 3; ++r) {
+	    for (std::size_t c = 0; c < 3; ++c) {
+	      covariance [r][c] += p [r] * p [c];
+	    }
+	  }
+	}
+
+	// Start from the row of largest norm, which is not orthogonal to
+	// the principal axis.
+	std::size_t start = 0;
+	for (std::size_t r = 1; r < 3; ++r) {
+	  if (dot (covariance [r], covariance [r]) >
+	      dot (covariance [start], covariance [start])) start = r;
+	}
+	double norm = std::sqrt (dot (covariance [start], covariance [start]));
+	if (norm == 0) {
+	  axis [0] = axis [1] = 0;
+	  axis [2] = 1;
+	  return;
+	}
+	for (std::size_t k = 0; k < 3; ++k) {
+	  axis [k] = covariance [start][k] / norm;
+	}
+	for (std::size_t iteration = 0; iteration < 64; ++iteration) {
+	  double next [3];
+	  for (std::size_t r = 0; r < 3; ++r) {
+	    next [r] = dot (covariance [r], axis);
+	  }
+	  norm = std::sqrt (dot (next, next));
+	  if (norm == 0) break;
+	  for (std::size_t k = 0; k < 3; ++k) axis [k] = next [k] / norm;
+	}
+      }
+
+      // Capsule along the principal axis of a set of vertices containing
+      // the vertices.
+      void fitCapsule (const std::vector<double>& vertices,
+		       const std::vector<uint32_t>& indices, Capsule& capsule)
+      {
+	double centroid [3], axis [3];
+	principalAxis (vertices, indices, centroid, axis);
+
+	// Abscissa along the axis and square distance to the axis
+	std::vector<double> abscissa (indices.size ());
+	std::vector<double> squareDistance (indices.size ());
+	double radius = 0;
+	for (std::size_t i = 0; i < indices.size (); ++i) {
+	  double p [3];
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    p [k] = vertices [3 * indices [i] + k] - centroid [k];
+	  }
+	  abscissa [i] = dot (p, axis);
+	  squareDistance [i] =
+	    std::max (0., dot (p, p) - abscissa [i] * abscissa [i]);
+	  radius = std::max (radius, squareDistance [i]);
+	}
+	radius = std::sqrt (radius);
+
+	// Shortest segment such that each vertex is within radius: vertex
+	// i is covered by the segment if the segment reaches
+	// [abscissa - h, abscissa + h] with h^2 = radius^2 - distance^2.
+	double lower = std::numeric_limits<double>::max ();
+	double upper = -std::numeric_limits<double>::max ();
+	for (std::size_t i = 0; i < indices.size (); ++i) {
+	  const double h =
+	    std::sqrt (std::max (0., radius * radius - squareDistance [i]));
+	  lower = std::min (lower, abscissa [i] + h);
+	  upper = std::max (upper, abscissa [i] - h);
+	}
+	if (lower > upper) {
+	  lower = upper = .5 * (lower + upper);
+	}
+	for (std::size_t k = 0; k < 3; ++k) {
+	  capsule.end1 [k] = centroid [k] + lower * axis [k];
+	  capsule.end2 [k] = centroid [k] + upper * axis [k];
+	}
+	// Absorb rounding errors of the projections.
+	capsule.radius = radius * (1 + 1e-9) + 1e-12;
+      }
+
+      double volume (const Capsule& capsule)
+      {
+	double length = 0;
+	for (std::size_t k = 0; k < 3; ++k) {
+	  const double d = capsule.end2 [k] - capsule.end1 [k];
+	  length += d * d;
+	}
+	const double r = capsule.radius;
+	return M_PI * r * r * (std::sqrt (length) + 4. / 3. * r);
+      }
+
+      void hash (uint64_t& state, const void* data, std::size_t size)
+      {
+	const unsigned char* bytes = static_cast<const unsigned char*> (data);
+	for (std::size_t i = 0; i < size; ++i) {
+	  state ^= bytes [i];
+	  state *= 1099511628211ULL;
+	}
+      }
+    } // namespace
+
+    const uint32_t CapsuleFitter::VERSION;
+
+    // ======================================================================
+
+    void CapsuleFitter::fit (const std::vector<double>& vertices,
+			     const std::vector<uint32_t>& triangles,
+			     std::size_t maxCapsules, Capsules_t& result)
+    {
+      result.clear ();
+      const std::size_t nbVertices = vertices.size () / 3;
+      if (nbVertices == 0) return;
+      for (std::size_t i = 0; i < triangles.size (); ++i) {
+	if (triangles [i] >= nbVertices) {
+	  throw Exception ("Triangle refers to a missing vertex.");
+	}
+      }
+      // Without triangles, vertices are bounded as a point cloud.
+      const std::size_t nbTriangles = triangles.size () / 3;
+      if (nbTriangles == 0 || maxCapsules <= 1) {
+	std::vector<uint32_t> indices (nbVertices);
+	for (std::size_t i = 0; i < nbVertices; ++i) indices [i] = i;
+	result.resize (1);
+	fitCapsule (vertices, indices, result [0]);
+	return;
+      }
+
+      // Abscissae of the triangle centroids along the principal axis of
+      // the mesh
+      std::vector<uint32_t> indices (triangles);
+      std::sort (indices.begin (), indices.end ());
+      indices.erase (std::unique (indices.begin (), indices.end ()),
+		     indices.end ());
+      double centroid [3], axis [3];
+      principalAxis (vertices, indices, centroid, axis);
+      std::vector<double> abscissa (nbTriangles);
+      double lower = std::numeric_limits<double>::max ();
+      double upper = -std::numeric_limits<double>::max ();
+      for (std::size_t t = 0; t < nbTriangles; ++t) {
+	double p [3] = {0, 0, 0};
+	for (std::size_t v = 0; v < 3; ++v) {
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    p [k] += vertices [3 * triangles [3*t + v] + k] / 3;
+	  }
+	}
+	abscissa [t] = dot (p, axis);
+	lower = std::min (lower, abscissa [t]);
+	upper = std::max (upper, abscissa [t]);
+      }
+
+      double bestVolume = std::numeric_limits<double>::max ();
+      std::vector<uint32_t> slab (nbTriangles);
+      std::vector<std::size_t> mark (nbVertices);
+      for (std::size_t nbSlabs = 1; nbSlabs <= maxCapsules; ++nbSlabs) {
+	const double width = (upper - lower) / nbSlabs;
+	for (std::size_t t = 0; t < nbTriangles; ++t) {
+	  slab [t] = width > 0 ?
+	    std::min<std::size_t> (nbSlabs - 1,
+				   (abscissa [t] - lower) / width) : 0;
+	}
+	Capsules_t capsules;
+	double totalVolume = 0;
+	std::fill (mark.begin (), mark.end (), std::size_t (-1));
+	for (std::size_t s = 0; s < nbSlabs; ++s) {
+	  std::vector<uint32_t> slabVertices;
+	  for (std::size_t t = 0; t < nbTriangles; ++t) {
+	    if (slab [t] != s) continue;
+	    for (std::size_t v = 0; v < 3; ++v) {
+	      const uint32_t i = triangles [3*t + v];
+	      if (mark [i] != s) {
+		mark [i] = s;
+		slabVertices.push_back (i);
+	      }
+	    }
+	  }
+	  if (slabVertices.empty ()) continue;
+	  capsules.resize (capsules.size () + 1);
+	  fitCapsule (vertices, slabVertices, capsules.back ());
+	  totalVolume += volume (capsules.back ());
+	}
+	if (totalVolume < bestVolume) {
+	  bestVolume = totalVolume;
+	  result.swap (capsules);
+	}
+      }
+    }
+
+    // ======================================================================
+
+    bool CapsuleFitter::mesh (const CkcdObjectShPtr& object,
+			      std::vector<double>& vertices,
+			      std::vector<uint32_t>& triangles)
+    {
+      GeometryStore::loadDeferred (object);
+      CkcdPolyhedronShPtr polyhedron =
+	KIT_DYNAMIC_PTR_CAST (CkcdPolyhedron, object);
+      if (!polyhedron) return false;
+      vertices.resize (3 * polyhedron->countPoints ());
+      for (unsigned int i = 0; i < polyhedron->countPoints (); ++i) {
+	kcdReal x, y, z;
+	polyhedron->getPoint (i, x, y, z);
+	vertices [3*i] = x;
+	vertices [3*i + 1] = y;
+	vertices [3*i + 2] = z;
+      }
+      triangles.resize (3 * polyhedron->countTriangles ());
+      for (unsigned int i = 0; i < polyhedron->countTriangles (); ++i) {
+	unsigned int i1, i2, i3;
+	polyhedron->getTriangle (i, i1, i2, i3);
+	triangles [3*i] = i1;
+	triangles [3*i + 1] = i2;
+	triangles [3*i + 2] = i3;
+      }
+      return true;
+    }
+
+    // ======================================================================
+
+    uint64_t CapsuleFitter::meshHash (const std::vector<double>& vertices,
+				      const std::vector<uint32_t>& triangles)
+    {
+      uint64_t state = 14695981039346656037ULL;
+      const uint64_t sizes [2] = {vertices.size (), triangles.size ()};
+      hash (state, sizes, sizeof (sizes));
+      if (!vertices.empty ()) {
+	hash (state, &vertices [0], vertices.size () * sizeof (double));
+      }
+      if (!triangles.empty ()) {
+	hash (state, &triangles [0], triangles.size () * sizeof (uint32_t));
+      }
+      return state;
+    }
+
+    // ======================================================================
+
+    CapsuleFitter::CapsuleFitter (const std::string& cacheFilename)
+      : cacheFilename_ (cacheFilename), cache_ (), modified_ (false),
+	nbHits_ (0), nbFits_ (0)
+    {
+    }
+
+    // ======================================================================
+
+    CapsuleFitterShPtr CapsuleFitter::create (const std::string& cacheFilename)
+    {
+      CapsuleFitterShPtr shPtr (new CapsuleFitter (cacheFilename));
+      if (!cacheFilename.empty ()) shPtr->load ();
+      return shPtr;
+    }
+
+    // ======================================================================
+
+    void CapsuleFitter::load ()
+    {
+      MappedFile file;
+      if (!file.open (cacheFilename_) || file.size () < sizeof (Header)) {
+	return;
+      }
+      const char* data = file.data ();
+      const Header& h = *reinterpret_cast<const Header*> (data);
+      if (memcmp (h.magic, magic, sizeof (magic)) != 0 ||
+	  h.version != VERSION || h.byteOrder != byteOrderMark) {
+	hppDout (info, cacheFilename_ << " is not a capsule cache of version "
+		 << VERSION << ".");
+	return;
+      }
+      const uint64_t limit = uint64_t (1) << 32;
+      if (h.nbEntries > limit || h.nbCapsules > limit ||
+	  file.size () != sizeof (Header) + h.nbEntries * sizeof (EntryRecord)
+	  + h.nbCapsules * sizeof (Capsule)) {
+	hppDout (error, cacheFilename_ << " is truncated.");
+	return;
+      }
+      const EntryRecord* entries =
+	reinterpret_cast<const EntryRecord*> (data + sizeof (Header));
+      const Capsule* capsules =
+	reinterpret_cast<const Capsule*> (entries + h.nbEntries);
+      Cache_t cache;
+      for (std::size_t i = 0; i < h.nbEntries; ++i) {
+	const EntryRecord& entry = entries [i];
+	if (entry.firstCapsule > h.nbCapsules ||
+	    entry.nbCapsules > h.nbCapsules - entry.firstCapsule) {
+	  hppDout (error, cacheFilename_ << " is corrupted.");
+	  return;
+	}
+	cache [Key_t (entry.meshHash, entry.maxCapsules)].assign
+	  (capsules + entry.firstCapsule,
+	   capsules + entry.firstCapsule + entry.nbCapsules);
+      }
+      cache_.swap (cache);
+      hppDout (info, "Loaded " << cache_.size () << " meshes from capsule"
+	       " cache " << cacheFilename_ << ".");
+    }
+
+    // ======================================================================
+
+    void CapsuleFitter::save ()
+    {
+      if (!modified_ || cacheFilename_.empty ()) return;
+      std::vector<EntryRecord> entries;
+      Capsules_t capsules;
+      for (Cache_t::const_iterator it = cache_.begin (); it != cache_.end ();
+	   ++it) {
+	EntryRecord entry;
+	entry.meshHash = it->first.first;
+	entry.maxCapsules = it->first.second;
+	entry.firstCapsule = capsules.size ();
+	entry.nbCapsules = it->second.size ();
+	entries.push_back (entry);
+	capsules.insert (capsules.end (), it->second.begin (),
+			 it->second.end ());
+      }
+
+      Header h;
+      memset (&h, 0, sizeof (Header));
+      memcpy (h.magic, magic, sizeof (magic));
+      h.version = VERSION;
+      h.byteOrder = byteOrderMark;
+      h.nbEntries = entries.size ();
+      h.nbCapsules = capsules.size ();
+
+      const std::string tmp = temporaryFilename (cacheFilename_);
+      {
+	std::ofstream file (tmp.c_str (), std::ios::binary | std::ios::trunc);
+	if (!file) {
+	  throw Exception ("Cannot write " + tmp + ".");
+	}
+	file.write (reinterpret_cast<const char*> (&h), sizeof (Header));
+	if (!entries.empty ()) {
+	  file.write (reinterpret_cast<const char*> (&entries [0]),
+		      entries.size () * sizeof (EntryRecord));
+	}
+	if (!capsules.empty ()) {
+	  file.write (reinterpret_cast<const char*> (&capsules [0]),
+		      capsules.size () * sizeof (Capsule));
+	}
+	if (!file) {
+	  unlink (tmp.c_str ());
+	  throw Exception ("Failed to write " + tmp + ".");
+	}
+      }
+      commitTemporaryFile (tmp, cacheFilename_);
+      modified_ = false;
+      hppDout (info, "Wrote capsule cache " << cacheFilename_ << ".");
+    }
+
+    // ======================================================================
+
+    const CapsuleFitter::Capsules_t&
+    CapsuleFitter::capsules (const std::vector<double>& vertices,
+			     const std::vector<uint32_t>& triangles,
+			     std::size_t maxCapsules)
+    {
+      const Key_t key (meshHash (vertices, triangles), maxCapsules);
+      Cache_t::iterator it = cache_.find (key);
+      if (it != cache_.end ()) {
+	++nbHits_;
+	return it->second;
+      }
+      Trace::Span span ("geometry", "fit-capsules", "vertices",
+			long (vertices.size () / 3));
+      Capsules_t& result = cache_ [key];
+      fit (vertices, triangles, maxCapsules, result);
+      ++nbFits_;
+      modified_ = true;
+      return result;
+    }
+
+    // ======================================================================
+
+    std::size_t
+    CapsuleFitter::fitBody (const CapsuleBodyDistanceShPtr& distance,
+			    std::size_t maxCapsules)
+    {
+      const std::vector<CkcdObjectShPtr> objects =
+	distance->body ()->mobileObjects ();
+      std::vector<double> vertices;
+      std::vector<uint32_t> triangles;
+      std::size_t nbAdded = 0;
+      for (std::size_t i = 0; i < objects.size (); ++i) {
+	if (!mesh (objects [i], vertices, triangles)) {
+	  hppDout (info, "Object " << i << " of " << distance->name ()
+		   << " is not a polyhedron: no capsule fitted.");
+	  continue;
+	}
+	const Capsules_t& fitted = capsules (vertices, triangles,
+					     maxCapsules);
+	CkcdMat4 position;
+	objects [i]->getAbsolutePosition (position);
+	for (std::size_t c = 0; c < fitted.size (); ++c) {
+	  const Capsule& capsule = fitted [c];
+	  CapsuleBodyDistance::capsule_t segment =
+	    hpp::geometry::component::Segment::create
+	    (CkcdPoint (capsule.end1 [0], capsule.end1 [1], capsule.end1 [2]),
+	     CkcdPoint (capsule.end2 [0], capsule.end2 [1], capsule.end2 [2]),
+	     capsule.radius);
+	  segment->setAbsolutePosition (position);
+	  distance->addDistanceCapsule (segment);
+	  ++nbAdded;
+	}
+      }
+      return nbAdded;
+    }
+
+    // ======================================================================
+
+    std::vector<CapsuleBodyDistanceShPtr>
+    CapsuleFitter::fitDevice (const DeviceShPtr& device,
+			      std::size_t maxCapsules)
+    {
+      const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+      Bodies_t bodies;
+      std::vector<std::size_t> jointIds;
+      deviceBodies (*device, bodies, jointIds);
+      // Bodies that already have capsules are left untouched.
+      std::set<const CkwsKCDBodyAdvanced*> withCapsules;
+      const std::vector<BodyDistanceShPtr>& distances =
+	device->bodyDistances ();
+      for (std::size_t i = 0; i < distances.size (); ++i) {
+	if (KIT_DYNAMIC_PTR_CAST (CapsuleBodyDistance, distances [i])) {
+	  withCapsules.insert (distances [i]->body ().get ());
+	}
+      }
+      std::vector<CapsuleBodyDistanceShPtr> result;
+      for (std::size_t i = 0; i < bodies.size (); ++i) {
+	if (bodies [i]->mobileObjects ().empty () ||
+	    withCapsules.count (bodies [i].get ())) continue;
+	CapsuleBodyDistanceShPtr distance =
+	  CapsuleBodyDistance::create (bodies [i],
+				       tree->jointName (jointIds [i]));
+	if (!distance) {
+	  throw Exception ("Failed to create capsule body distance for "
+			   + tree->jointName (jointIds [i]) + ".");
+	}
+	fitBody (distance, maxCapsules);
+	if (device->addBodyDistance (distance) != KD_OK) {
+	  throw Exception ("Failed to add capsule body distance for "
+			   + tree->jointName (jointIds [i]) + ".");
+	}
+	result.push_back (distance);
+      }
+      hppDout (info, "Fitted capsules to " << result.size () << " bodies of "
+	       << device->name () << ": " << nbFits_ << " meshes fitted, "
+	       << nbHits_ << " found in cache.");
+      return result;
+    }
+  } // namespace model
+} // namespace hpp
@@ -0,0 +1,251 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_CAPSULE_TREE_HH
+# define HPP_MODEL_CAPSULE_TREE_HH
+
+# include <algorithm>
+# include <cmath>
+# include <limits>
+# include <vector>
+
+namespace hpp {
+  namespace model {
+    /// Bounding volume hierarchy of axis-aligned boxes over capsules.
+
+    /// A capsule is stored as 7 doubles: both ends of its segment in the
+    /// global frame and its radius. build () sorts capsules by median
+    /// split along the longest axis of the box of their centers, so that
+    /// the depth of the tree is logarithmic. When capsules move without
+    /// being added or removed, refit () updates the boxes in linear time
+    /// and keeps the structure.
+    class CapsuleTree
+    {
+    public:
+      /// Capsules per leaf
+      static const std::size_t LEAF_SIZE = 4;
+
+      CapsuleTree () : capsules_ (), order_ (), nodes_ ()
+      {
+      }
+
+      std::size_t size () const { return capsules_.size () / 7; }
+
+      const double* capsule (std::size_t i) const
+      {
+	return &capsules_ [7*i];
+      }
+
+      /// Build the tree, capsules being 7 doubles each.
+      void build (const std::vector<double>& capsules)
+      {
+	capsules_ = capsules;
+	nodes_.clear ();
+	order_.resize (size ());
+	for (std::size_t i = 0; i < order_.size (); ++i) order_ [i] = i;
+	if (!order_.empty ()) split (0, order_.size ());
+      }
+
+      /// Update positions of the capsules given to build (), in the same
+      /// order.
+      void refit (const std::vector<double>& capsules)
+      {
+	capsules_ = capsules;
+	// Children are stored after their parent.
+	for (std::size_t n = nodes_.size (); n-- > 0;) {
+	  Node& node = nodes_ [n];
+	  if (node.count > 0) {
+	    leafBox (node);
+	  } else {
+	    const Node& left = nodes_ [n + 1];
+	    const Node& right = nodes_ [node.right];
+	    for (std::size_t k = 0; k < 3; ++k) {
+	      node.lower [k] = std::min (left.lower [k], right.lower [k]);
+	      node.upper [k] = std::max (left.upper [k], right.upper [k]);
+	    }
+	    node.radius = std::max (left.radius, right.radius);
+	  }
+	}
+      }
+
+      /// Branch and bound search of the nearest capsules to a capsule
+
+      /// \param lower, upper box containing the segment of the capsule,
+      /// \param radius radius of the capsule,
+      /// \param leaf function object called with the index of a capsule,
+      /// that computes the distance between the capsules and keeps the
+      /// minimum in leaf.bestDistance. Subtrees that cannot contain a
+      /// capsule closer than leaf.bestDistance are skipped.
+
+      /// Boxes bound segments and nodes store the largest radius of
+      /// their capsules, so that the bound remains valid for
+      /// penetrating capsules, whose distance is negative.
+      template <typename Leaf>
+      void query (const double* lower, const double* upper, double radius,
+		  Leaf& leaf) const
+      {
+	if (nodes_.empty ()) return;
+	// Depth is at most log2 (size ()) + 1 and each level pushes at
+	// most one node.
+	std::size_t stack [128];
+	std::size_t top = 0;
+	stack [top++] = 0;
+	while (top > 0) {
+	  const Node& node = nodes_ [stack [--top]];
+	  if (bound (node, lower, upper, radius) >= leaf.bestDistance) {
+	    continue;
+	  }
+	  if (node.count > 0) {
+	    for (std::size_t i = node.first; i < node.first + node.count;
+		 ++i) {
+	      leaf (order_ [i]);
+	    }
+	    continue;
+	  }
+	  // Visit the nearest child first.
+	  std::size_t near = &node - &nodes_ [0] + 1;
+	  std::size_t far = node.right;
+	  if (bound (nodes_ [far], lower, upper, radius) <
+	      bound (nodes_ [near], lower, upper, radius)) {
+	    std::swap (near, far);
+	  }
+	  stack [top++] = far;
+	  stack [top++] = near;
+	}
+      }
+
+    private:
+      struct Node
+      {
+	double lower [3];
+	double upper [3];
+	double radius;
+	/// Range of order_ for leaves, count is 0 for inner nodes.
+	std::size_t first;
+	std::size_t count;
+	/// Right child of inner nodes, the left child is the next node.
+	std::size_t right;
+      };
+
+      // Lower bound of the distance between a capsule and the capsules
+      // of a node.
+      static double bound (const Node& node, const double* lower,
+			   const double* upper, double radius)
+      {
+	double squareDistance = 0;
+	for (std::size_t k = 0; k < 3; ++k) {
+	  const double gap = std::max (std::max (node.lower [k] - upper [k],
+						 lower [k] - node.upper [k]),
+				       0.);
+	  squareDistance += gap * gap;
+	}
+	return sqrt (squareDistance) - radius - node.radius;
+      }
+
+      void leafBox (Node& node) const
+      {
+	for (std::size_t k = 0; k < 3; ++k) {
+	  node.lower [k] = std::numeric_limits<double>::infinity ();
+	  node.upper [k] = -std::numeric_limits<double>::infinity ();
+	}
+	node.radius = 0;
+	for (std::size_t i = node.first; i < node.first + node.count; ++i) {
+	  const double* c = capsule (order_ [i]);
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    node.lower [k] = std::min (node.lower [k], std::min (c [k], c [k+3]));
+	    node.upper [k] = std::max (node.upper [k], std::max (c [k], c [k+3]));
+	  }
+	  node.radius = std::max (node.radius, c [6]);
+	}
+      }
+
+      struct CenterLess
+      {
+	CenterLess (const std::vector<double>& capsules, std::size_t axis)
+	  : capsules_ (capsules), axis_ (axis)
+	{
+	}
+	bool operator () (std::size_t i, std::size_t j) const
+	{
+	  return capsules_ [7*i + axis_] + capsules_ [7*i + axis_ + 3] <
+	    capsules_ [7*j + axis_] + capsules_ [7*j + axis_ + 3];
+	}
+	const std::vector<double>& capsules_;
+	std::size_t axis_;
+      };
+
+      // Build the subtree of capsules order_ [first, last), return its
+      // index.
+      std::size_t split (std::size_t first, std::size_t last)
+      {
+	const std::size_t index = nodes_.size ();
+	nodes_.push_back (Node ());
+	if (last - first <= LEAF_SIZE) {
+	  nodes_ [index].first = first;
+	  nodes_ [index].count = last - first;
+	  nodes_ [index].right = 0;
+	  leafBox (nodes_ [index]);
+	  return index;
+	}
+	// Split along the longest axis of the box of the centers.
+	double lower [3], upper [3];
+	for (std::size_t k = 0; k < 3; ++k) {
+	  lower [k] = std::numeric_limits<double>::infinity ();
+	  upper [k] = -std::numeric_limits<double>::infinity ();
+	}
+	for (std::size_t i = first; i < last; ++i) {
+	  const double* c = capsule (order_ [i]);
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    lower [k] = std::min (lower [k], c [k] + c [k + 3]);
+	    upper [k] = std::max (upper [k], c [k] + c [k + 3]);
+	  }
+	}
+	std::size_t axis = 0;
+	for (std::size_t k = 1; k < 3; ++k) {
+	  if (upper [k] - lower [k] > upper [axis] - lower [axis]) axis = k;
+	}
+	const std::size_t middle = first + (last - first) / 2;
+	std::nth_element (order_.begin () + first, order_.begin () + middle,
+			  order_.begin () + last, CenterLess (capsules_, axis));
+	split (first, middle);
+	const std::size_t right = split (middle, last);
+	Node& node = nodes_ [index];
+	node.first = 0;
+	node.count = 0;
+	node.right = right;
+	const Node& leftNode = nodes_ [index + 1];
+	const Node& rightNode = nodes_ [right];
+	for (std::size_t k = 0; k < 3; ++k) {
+	  node.lower [k] = std::min (leftNode.lower [k], rightNode.lower [k]);
+	  node.upper [k] = std::max (leftNode.upper [k], rightNode.upper [k]);
+	}
+	node.radius = std::max (leftNode.radius, rightNode.radius);
+	return index;
+      }
+
+      std::vector<double> capsules_;
+      /// Capsules sorted by leaf
+      std::vector<std::size_t> order_;
+      /// Nodes in depth-first order, root first
+      std::vector<Node> nodes_;
+    }; // class CapsuleTree
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_CAPSULE_TREE_HH
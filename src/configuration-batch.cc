@@ -0,0 +1,362 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <stddef.h>
+#include <string.h>
+
+#include <hpp/util/debug.hh>
+
+#include "hpp/model/configuration-batch.hh"
+#include "hpp/model/exception.hh"
+
+#include "mapped-file.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Layout of a file
+      //
+      //   Header
+      //   JointRecord x nbJoints
+      //   char        x stringsSize, padded to 8 bytes
+      //   double      x nbRows * numberDof   (at rowsOffset)
+      //   double      x nbRows               (paths only)
+      const char magic [8] = {'H', 'P', 'P', 'C', 'O', 'N', 'F', 'B'};
+      const uint32_t byteOrderMark = 0x01020304;
+
+      struct Header
+      {
+	char magic [8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t kind;
+	uint32_t convention;
+	uint64_t numberDof;
+	uint64_t nbJoints;
+	uint64_t nbRows;
+	uint64_t stringsSize;
+	uint64_t rowsOffset;
+      };
+
+      struct JointRecord
+      {
+	uint64_t nameOffset;
+	uint64_t nameLength;
+	uint64_t type;
+	uint64_t rank;
+      };
+
+      std::size_t padded (std::size_t size)
+      {
+	return (size + 7) & ~std::size_t (7);
+      }
+
+      const Header& header (const char* data)
+      {
+	return *reinterpret_cast<const Header*> (data);
+      }
+
+      const JointRecord* jointRecords (const char* data)
+      {
+	return reinterpret_cast<const JointRecord*> (data + sizeof (Header));
+      }
+
+      const char* strings (const char* data)
+      {
+	return reinterpret_cast<const char*>
+	  (jointRecords (data) + header (data).nbJoints);
+      }
+    } // namespace
+
+    const uint32_t ConfigurationBatch::VERSION;
+
+    // ======================================================================
+
+    ConfigurationBatch::ConfigurationBatch ()
+      : file_ (new MappedFile ()), data_ (0)
+    {
+    }
+
+    // ======================================================================
+
+    ConfigurationBatch::~ConfigurationBatch ()
+    {
+    }
+
+    // ======================================================================
+
+    ConfigurationBatchShPtr
+    ConfigurationBatch::open (const std::string& filename)
+    {
+      ConfigurationBatch* ptr = new ConfigurationBatch ();
+      ConfigurationBatchShPtr shPtr (ptr);
+      if (!ptr->file_->open (filename) ||
+	  ptr->file_->size () < sizeof (Header)) {
+	throw Exception ("Cannot open configuration batch " + filename + ".");
+      }
+      ptr->data_ = ptr->file_->data ();
+      const Header& h = header (ptr->data_);
+      if (memcmp (h.magic, magic, sizeof (magic)) != 0 ||
+	  h.version != VERSION || h.byteOrder != byteOrderMark) {
+	throw Exception (filename + " is not a configuration batch of "
+			 "version 1.");
+      }
+      const uint64_t limit = uint64_t (1) << 40;
+      if (h.kind > PATH || h.convention > KINEOWORKS ||
+	  h.nbJoints > limit || h.stringsSize > limit ||
+	  h.rowsOffset != sizeof (Header) + h.nbJoints * sizeof (JointRecord)
+	  + padded (h.stringsSize) ||
+	  ptr->file_->size () < h.rowsOffset) {
+	throw Exception (filename + " is truncated or corrupted.");
+      }
+      // Number of rows is checked by division, so that products below
+      // cannot overflow.
+      const uint64_t nbDoubles =
+	(ptr->file_->size () - h.rowsOffset) / sizeof (double);
+      if ((h.numberDof != 0 && h.nbRows > nbDoubles / h.numberDof) ||
+	  (h.kind == PATH && h.nbRows > nbDoubles) ||
+	  ptr->file_->size () - h.rowsOffset != sizeof (double) *
+	  (h.nbRows * h.numberDof + (h.kind == PATH ? h.nbRows : 0))) {
+	throw Exception (filename + " is truncated or corrupted.");
+      }
+      const JointRecord* joints = jointRecords (ptr->data_);
+      for (std::size_t j = 0; j < h.nbJoints; ++j) {
+	if (joints [j].nameOffset > h.stringsSize ||
+	    joints [j].nameLength > h.stringsSize - joints [j].nameOffset ||
+	    joints [j].type > KinematicTree::ANCHOR) {
+	  throw Exception (filename + " is corrupted.");
+	}
+      }
+      hppDout (info, "Opened " << filename << " with " << h.nbRows
+	       << " rows of " << h.numberDof << " doubles.");
+      return shPtr;
+    }
+
+    // ======================================================================
+
+    ConfigurationBatch::Ekind ConfigurationBatch::kind () const
+    {
+      return static_cast<Ekind> (header (data_).kind);
+    }
+
+    // ======================================================================
+
+    ConfigurationBatch::Econvention ConfigurationBatch::convention () const
+    {
+      return static_cast<Econvention> (header (data_).convention);
+    }
+
+    // ======================================================================
+
+    std::size_t ConfigurationBatch::numberDof () const
+    {
+      return header (data_).numberDof;
+    }
+
+    // ======================================================================
+
+    std::size_t ConfigurationBatch::nbRows () const
+    {
+      return header (data_).nbRows;
+    }
+
+    // ======================================================================
+
+    const double* ConfigurationBatch::rows () const
+    {
+      return reinterpret_cast<const double*>
+	(data_ + header (data_).rowsOffset);
+    }
+
+    // ======================================================================
+
+    const double* ConfigurationBatch::parameters () const
+    {
+      if (kind () != PATH) return 0;
+      return rows () + nbRows () * numberDof ();
+    }
+
+    // ======================================================================
+
+    std::size_t ConfigurationBatch::nbJoints () const
+    {
+      return header (data_).nbJoints;
+    }
+
+    // ======================================================================
+
+    std::string ConfigurationBatch::jointName (std::size_t jointId) const
+    {
+      const JointRecord& joint = jointRecords (data_) [jointId];
+      return std::string (strings (data_) + joint.nameOffset,
+			  joint.nameLength);
+    }
+
+    // ======================================================================
+
+    KinematicTree::EjointType
+    ConfigurationBatch::jointType (std::size_t jointId) const
+    {
+      return static_cast<KinematicTree::EjointType>
+	(jointRecords (data_) [jointId].type);
+    }
+
+    // ======================================================================
+
+    std::size_t
+    ConfigurationBatch::rankInConfiguration (std::size_t jointId) const
+    {
+      return jointRecords (data_) [jointId].rank;
+    }
+
+    // ======================================================================
+
+    bool ConfigurationBatch::matches (const KinematicTree& tree) const
+    {
+      if (tree.nbJoints () != nbJoints ()) return false;
+      if (convention () == JRL_DYNAMICS && tree.numberDof () != numberDof ()) {
+	return false;
+      }
+      for (std::size_t j = 0; j < nbJoints (); ++j) {
+	if (tree.jointType (j) != jointType (j) ||
+	    tree.rankInConfiguration (j) != rankInConfiguration (j) ||
+	    tree.jointName (j) != jointName (j)) {
+	  return false;
+	}
+      }
+      return true;
+    }
+
+    // ======================================================================
+
+    ConfigurationBatchWriter::ConfigurationBatchWriter
+    (const std::string& filename, const KinematicTree& tree,
+     ConfigurationBatch::Ekind kind,
+     ConfigurationBatch::Econvention convention, std::size_t numberDof)
+      : filename_ (filename), tmp_ (temporaryFilename (filename)), file_ (),
+	kind_ (kind), numberDof_ (numberDof), nbRows_ (0), parameters_ (),
+	closed_ (false)
+    {
+      if (convention == ConfigurationBatch::JRL_DYNAMICS &&
+	  numberDof != tree.numberDof ()) {
+	throw Exception ("Row size does not match kinematic tree.");
+      }
+      file_.open (tmp_.c_str (), std::ios::binary | std::ios::trunc);
+      if (!file_) {
+	throw Exception ("Cannot write " + tmp_ + ".");
+      }
+      std::string stringTable;
+      std::vector<JointRecord> joints (tree.nbJoints ());
+      for (std::size_t j = 0; j < tree.nbJoints (); ++j) {
+	joints [j].nameOffset = stringTable.size ();
+	joints [j].nameLength = tree.jointName (j).size ();
+	joints [j].type = tree.jointType (j);
+	joints [j].rank = tree.rankInConfiguration (j);
+	stringTable += tree.jointName (j);
+      }
+      Header h;
+      memset (&h, 0, sizeof (Header));
+      memcpy (h.magic, magic, sizeof (magic));
+      h.version = ConfigurationBatch::VERSION;
+      h.byteOrder = byteOrderMark;
+      h.kind = kind;
+      h.convention = convention;
+      h.numberDof = numberDof;
+      h.nbJoints = joints.size ();
+      // Number of rows is written by close ().
+      h.nbRows = 0;
+      h.stringsSize = stringTable.size ();
+      h.rowsOffset = sizeof (Header) + joints.size () * sizeof (JointRecord)
+	+ padded (stringTable.size ());
+      file_.write (reinterpret_cast<const char*> (&h), sizeof (Header));
+      if (!joints.empty ()) {
+	file_.write (reinterpret_cast<const char*> (&joints [0]),
+		     joints.size () * sizeof (JointRecord));
+      }
+      stringTable.resize (padded (stringTable.size ()), '\0');
+      file_.write (stringTable.data (), stringTable.size ());
+    }
+
+    // ======================================================================
+
+    ConfigurationBatchWriter::~ConfigurationBatchWriter ()
+    {
+      // Destruction without close () happens when writing is
+      // interrupted, for instance by an exception: the rows written so
+      // far are discarded rather than published as a complete file.
+      if (!closed_) {
+	hppDout (warning, "Discarding " << filename_ << ": " << nbRows_
+		 << " rows written but file not closed.");
+	file_.close ();
+	unlink (tmp_.c_str ());
+      }
+    }
+
+    // ======================================================================
+
+    void ConfigurationBatchWriter::append (const double* row,
+					   double parameter)
+    {
+      append (row, 1, &parameter);
+    }
+
+    // ======================================================================
+
+    void ConfigurationBatchWriter::append (const double* rows,
+					   std::size_t nbRows,
+					   const double* parameters)
+    {
+      if (closed_) {
+	throw Exception ("Cannot append to closed file " + filename_ + ".");
+      }
+      file_.write (reinterpret_cast<const char*> (rows),
+		   nbRows * numberDof_ * sizeof (double));
+      if (kind_ == ConfigurationBatch::PATH) {
+	if (parameters) {
+	  parameters_.insert (parameters_.end (), parameters,
+			      parameters + nbRows);
+	} else {
+	  parameters_.resize (parameters_.size () + nbRows, 0.);
+	}
+      }
+      nbRows_ += nbRows;
+    }
+
+    // ======================================================================
+
+    void ConfigurationBatchWriter::close ()
+    {
+      if (closed_) return;
+      closed_ = true;
+      if (!parameters_.empty ()) {
+	file_.write (reinterpret_cast<const char*> (&parameters_ [0]),
+		     parameters_.size () * sizeof (double));
+      }
+      const uint64_t nbRows = nbRows_;
+      file_.seekp (offsetof (Header, nbRows));
+      file_.write (reinterpret_cast<const char*> (&nbRows), sizeof (nbRows));
+      file_.close ();
+      if (!file_) {
+	unlink (tmp_.c_str ());
+	throw Exception ("Failed to write " + tmp_ + ".");
+      }
+      commitTemporaryFile (tmp_, filename_);
+    }
+  } // namespace model
+} // namespace hpp
@@ -0,0 +1,83 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_DEVICE_BODIES_HH
+# define HPP_MODEL_DEVICE_BODIES_HH
+
+# include <vector>
+
+# include <KineoWorks2/kwsJoint.h>
+# include <KineoModel/kppJointComponent.h>
+# include <kwsKcd2/kwsKCDBodyAdvanced.h>
+
+# include "hpp/model/device.hh"
+# include "hpp/model/exception.hh"
+# include "hpp/model/joint.hh"
+# include "hpp/model/kinematic-tree.hh"
+# include "hpp/model/types.hh"
+
+namespace hpp {
+  namespace model {
+    typedef std::vector<CkwsKCDBodyAdvancedShPtr> Bodies_t;
+
+    /// KCD bodies of a device, in the order of CkwsDevice::getBodyVector.
+
+    /// Unlike deviceBodies (), joints are not resolved: copies made by
+    /// Device::createCopy share the kinematic tree of the original
+    /// device, whose joints are not the ones of the copy. Bodies of a
+    /// copy are in the same order as the ones of the original.
+    inline void kcdBodies (const CkwsDevice& device, Bodies_t& bodies)
+    {
+      CkwsDevice::TBodyVector bodyVector;
+      device.getBodyVector (bodyVector);
+      bodies.clear ();
+      for (std::size_t i = 0; i < bodyVector.size (); ++i) {
+	CkwsKCDBodyAdvancedShPtr body =
+	  KIT_DYNAMIC_PTR_CAST (CkwsKCDBodyAdvanced, bodyVector [i]);
+	if (body) bodies.push_back (body);
+      }
+    }
+
+    /// Bodies of an initialized device with the index in its kinematic
+    /// tree of the joint each body is attached to, in the order of
+    /// CkwsDevice::getBodyVector.
+    /// \throw Exception if a body is not attached to a joint of the tree.
+    inline void deviceBodies (const Device& device, Bodies_t& bodies,
+			      std::vector<std::size_t>& jointIds)
+    {
+      const KinematicTreeConstShPtr& tree = device.kinematicTree ();
+      kcdBodies (device, bodies);
+      jointIds.clear ();
+      for (std::size_t i = 0; i < bodies.size (); ++i) {
+	const CkwsKCDBodyAdvancedShPtr& body = bodies [i];
+	JointShPtr joint =
+	  KIT_DYNAMIC_PTR_CAST (Joint, KIT_DYNAMIC_PTR_CAST
+				(CkppJointComponent, body->joint ()));
+	const std::size_t jointId =
+	  joint ? tree->jointIndex (joint->jrlJoint ()) : SIZE_MAX;
+	if (jointId == SIZE_MAX) {
+	  throw Exception ("Body is not attached to a joint of the device.");
+	}
+	jointIds.push_back (jointId);
+      }
+    }
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_DEVICE_BODIES_HH
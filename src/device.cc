@@ -8,6 +8,7 @@
 #include <iostream>
 
 #include <boost/foreach.hpp>
+#include <boost/thread/tss.hpp>
 
 #include <KineoModel/kppFreeFlyerJointComponent.h>
 #include <KineoModel/kppAnchorJointComponent.h>
@@ -15,6 +16,8 @@
 #include <KineoModel/kppTranslationJointComponent.h>
 #include <KineoModel/kppSolidComponentRef.h>
 #include <KineoModel/kppSteeringMethodComponent.h>
+#include <KineoUtility/kitNotification.h>
+#include <KineoUtility/kitNotificator.h>
 
 #include <hpp/kwsio/configuration.hh>
 #include <jrl/mal/matrixabstractlayer.hh>
@@ -22,26 +25,137 @@
 
 #include "hpp/model/device.hh"
 #include "hpp/model/exception.hh"
+#include "hpp/model/geometry-store.hh"
 #include "hpp/model/joint.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/statistics.hh"
+#include "hpp/model/trace.hh"
 #include <hpp/model/body-distance.hh>
 
+#include "probes.hh"
+
 namespace hpp {
   namespace model {
 
+    namespace {
+      /// Single subscriber to insertion notifications.
+      ///
+      /// Devices used to subscribe individually to the default notificator,
+      /// so that every insertion was processed by every live device. The
+      /// router subscribes once and forwards each notification to the
+      /// device owning the parent component. It is never destroyed, so
+      /// that the notificator never holds a dangling subscriber.
+      class InsertionRouter
+      {
+      public:
+	static InsertionRouter& instance ()
+	{
+	  static InsertionRouter* router = new InsertionRouter ();
+	  return *router;
+	}
+
+	void componentWillInsertChild
+	(const CkitNotificationConstShPtr& notification)
+	{
+	  if (Device::isBulkBuilding ()) return;
+	  DeviceShPtr device = owningDevice (notification);
+	  if (device) {
+	    device->componentWillInsertChild (notification);
+	  } else {
+	    Device::prepareChildInsertion (notification);
+	  }
+	}
+
+	void componentDidInsertChild
+	(const CkitNotificationConstShPtr& notification)
+	{
+	  if (Device::isBulkBuilding ()) return;
+	  DeviceShPtr device = owningDevice (notification);
+	  if (device) {
+	    device->componentDidInsertChild (notification);
+	  }
+	}
+
+      private:
+	InsertionRouter ()
+	{
+	  CkitNotificator::defaultNotificator()->subscribe<InsertionRouter>
+	    (CkppComponent::WILL_INSERT_CHILD, this,
+	     &InsertionRouter::componentWillInsertChild);
+	  CkitNotificator::defaultNotificator()->subscribe<InsertionRouter>
+	    (CkppComponent::DID_INSERT_CHILD, this,
+	     &InsertionRouter::componentDidInsertChild);
+	}
+
+	/// Device the parent component belongs to, if any.
+	static DeviceShPtr
+	owningDevice (const CkitNotificationConstShPtr& notification)
+	{
+	  CkppComponentShPtr parent
+	    (notification->objectShPtr<CkppComponent>());
+	  DeviceShPtr device = KIT_DYNAMIC_PTR_CAST(Device, parent);
+	  if (device) return device;
+	  JointShPtr joint = KIT_DYNAMIC_PTR_CAST(Joint, parent);
+	  if (joint && joint->kppJoint()->kwsJoint()) {
+	    device = KIT_DYNAMIC_PTR_CAST
+	      (Device, joint->kppJoint()->kwsJoint()->device());
+	  }
+	  return device;
+	}
+      }; // class InsertionRouter
+    } // namespace
+
     impl::ObjectFactory Device::objectFactory_;
 
+    namespace {
+      /// Number of BulkBuildScope objects alive in the calling thread.
+      ///
+      /// Insertion notifications are delivered in the thread inserting
+      /// the component, so that a scope only defers the work of the
+      /// devices built by its own thread.
+      unsigned int& bulkBuildDepth ()
+      {
+	static boost::thread_specific_ptr<unsigned int> depth;
+	if (!depth.get ()) {
+	  depth.reset (new unsigned int (0));
+	}
+	return *depth;
+      }
+    } // namespace
+
+    // ========================================================================
+
+    Device::BulkBuildScope::BulkBuildScope ()
+    {
+      ++bulkBuildDepth ();
+    }
+
+    // ========================================================================
+
+    Device::BulkBuildScope::~BulkBuildScope ()
+    {
+      --bulkBuildDepth ();
+    }
+
+    // ========================================================================
+
+    bool Device::isBulkBuilding ()
+    {
+      return bulkBuildDepth () != 0;
+    }
+
+    // ========================================================================
+
+
     Device::Device()
       : impl::DynamicRobot(objectFactory ()),
 	CkppDeviceComponent (),
 	bodyDistances_ (),
-	weakPtr_ ()
+	weakPtr_ (),
+	kinematicTree_ (),
+	deferredGeometryLoaded_ (false)
     {
-      CkitNotificator::defaultNotificator()->subscribe<Device>
-	(CkppComponent::DID_INSERT_CHILD, this,
-	 &Device::componentDidInsertChild);
-      CkitNotificator::defaultNotificator()->subscribe<Device>
-	(CkppComponent::WILL_INSERT_CHILD, this,
-	 &Device::componentWillInsertChild);
+      InsertionRouter::instance ();
     }
 
 
@@ -83,6 +197,8 @@ namespace hpp {
 
     DeviceShPtr Device::createCopy(const DeviceShPtr& device)
     {
+      Trace::Span span ("device", "create-copy", "device", device->name ());
+      Statistics::Scope statistics (Statistics::CREATE_COPY);
       Device* ptr = new Device(*device);
       DeviceShPtr deviceShPtr(ptr);
 
@@ -148,20 +264,138 @@ namespace hpp {
 
     bool Device::initialize ()
     {
+      Trace::Span span ("device", "initialize", "device", name ());
+      HPP_MODEL_PROBE_SCOPE2 (initialize, this, countDofs ());
       JointShPtr rootJoint = getRootJoint();
       initializeKinematicChain(rootJoint);
       impl::DynamicRobot::rootJoint(*(rootJoint->jrlJoint()));
       if (!impl::DynamicRobot::initialize()) {
 	throw Exception("Failed to initialize impl::DynamicRobot");
       }
+      kinematicTree_ = KinematicTree::create (rootJoint, numberDof ());
+      loadDeferredGeometry ();
       return true;
     }
 
     // ========================================================================
 
+    const KinematicTreeConstShPtr& Device::kinematicTree () const
+    {
+      if (!kinematicTree_) {
+	throw Exception ("Device is not initialized.");
+      }
+      return kinematicTree_;
+    }
+
+    // ========================================================================
+
+    void Device::forwardKinematicsBatch (const std::vector<vectorN>& configs,
+					 std::vector<double>& outTransforms)
+      const
+    {
+      const std::size_t nbDof = kinematicTree ()->numberDof ();
+      std::vector<double> packed (configs.size () * nbDof);
+      for (std::size_t k = 0; k < configs.size (); ++k) {
+	if (configs [k].size () != nbDof) {
+	  throw Exception ("Wrong configuration size.");
+	}
+	for (std::size_t i = 0; i < nbDof; ++i) {
+	  packed [k * nbDof + i] = configs [k][i];
+	}
+      }
+      forwardKinematicsBatch (packed.empty () ? 0 : &packed [0],
+			      configs.size (), outTransforms);
+    }
+
+    // ========================================================================
+
+    void Device::forwardKinematicsBatch (const double* configs,
+					 std::size_t nbConfigs,
+					 std::vector<double>& outTransforms)
+      const
+    {
+      const KinematicTreeConstShPtr& tree = kinematicTree ();
+      outTransforms.resize (nbConfigs * tree->nbJoints () * 12);
+      if (nbConfigs == 0) return;
+      tree->forwardKinematics (configs, nbConfigs, &outTransforms [0]);
+    }
+
+    // ========================================================================
+
+    vector3d Device::centerOfMass (const vectorN& config) const
+    {
+      const KinematicTreeConstShPtr& tree = kinematicTree ();
+      if (config.size () != tree->numberDof ()) {
+	throw Exception ("Wrong configuration size.");
+      }
+      std::vector<double> q (config.size () + 1);
+      for (std::size_t i = 0; i < config.size (); ++i) {
+	q [i] = config [i];
+      }
+      double com [3];
+      tree->centerOfMass (&q [0], com);
+      vector3d result;
+      for (std::size_t i = 0; i < 3; ++i) {
+	MAL_S3_VECTOR_ACCESS (result, i) = com [i];
+      }
+      return result;
+    }
+
+    // ========================================================================
+
+    void Device::centerOfMassBatch (const std::vector<vectorN>& configs,
+				    std::vector<double>& outComs) const
+    {
+      const std::size_t nbDof = kinematicTree ()->numberDof ();
+      std::vector<double> packed (configs.size () * nbDof);
+      for (std::size_t k = 0; k < configs.size (); ++k) {
+	if (configs [k].size () != nbDof) {
+	  throw Exception ("Wrong configuration size.");
+	}
+	for (std::size_t i = 0; i < nbDof; ++i) {
+	  packed [k * nbDof + i] = configs [k][i];
+	}
+      }
+      centerOfMassBatch (packed.empty () ? 0 : &packed [0], configs.size (),
+			 outComs);
+    }
+
+    // ========================================================================
+
+    void Device::centerOfMassBatch (const double* configs,
+				    std::size_t nbConfigs,
+				    std::vector<double>& outComs) const
+    {
+      outComs.resize (3 * nbConfigs);
+      if (nbConfigs == 0) return;
+      kinematicTree ()->centerOfMass (configs, nbConfigs, &outComs [0]);
+    }
+
+    // ========================================================================
+
+    void Device::computeJacobians
+    (const vectorN& config, std::vector<SparseJacobian>& outJointJacobians,
+     SparseJacobian& outComJacobian) const
+    {
+      const KinematicTreeConstShPtr& tree = kinematicTree ();
+      if (config.size () != tree->numberDof ()) {
+	throw Exception ("Wrong configuration size.");
+      }
+      std::vector<double> q (config.size () + 1);
+      for (std::size_t i = 0; i < config.size (); ++i) {
+	q [i] = config [i];
+      }
+      tree->computeJacobians (&q [0], outJointJacobians, outComJacobian);
+    }
+
+    // ========================================================================
+
     void Device::initializeKinematicChain(JointShPtr joint)
     {
       joint->createDynamicPart();
+      // Bodies of joints built in bulk-build mode were not inserted when
+      // their solids were.
+      joint->insertBody();
       for (unsigned int iChild=0; iChild < joint->countChildJoints();
 	   iChild++) {
 	JointShPtr child = joint->childJoint(iChild);
@@ -176,6 +410,8 @@ namespace hpp {
 				    double& xMax, double& yMax, double& zMax)
       const
     {
+      Trace::Span span ("device", "bounding-box");
+      Statistics::Scope statistics (Statistics::BOUNDING_BOX);
 
       TBodyVector bodyVector;
       this->getBodyVector(bodyVector);
@@ -250,6 +486,26 @@ namespace hpp {
 
     // ========================================================================
 
+    void Device::loadDeferredGeometry ()
+    {
+      CkwsDevice::TBodyVector bodies;
+      getBodyVector (bodies);
+      for (std::size_t i = 0; i < bodies.size (); ++i) {
+	CkwsKCDBodyAdvancedShPtr body =
+	  KIT_DYNAMIC_PTR_CAST (CkwsKCDBodyAdvanced, bodies [i]);
+	if (!body) continue;
+	std::vector<CkcdObjectShPtr> objects = body->mobileObjects ();
+	const std::vector<CkcdObjectShPtr> obstacles = body->obstacleObjects ();
+	objects.insert (objects.end (), obstacles.begin (), obstacles.end ());
+	for (std::size_t j = 0; j < objects.size (); ++j) {
+	  GeometryStore::loadDeferred (objects [j]);
+	}
+      }
+      deferredGeometryLoaded_ = true;
+    }
+
+    // ========================================================================
+
     void Device::computeBodyBoundingBox(const CkwsKCDBodyAdvancedShPtr& body,
 					double& xMin, double& yMin,
 					double& zMin, double& xMax,
@@ -271,33 +527,43 @@ namespace hpp {
 				       double& yMax, double& zMax) const
     {
       kcdReal x,y,z;
-
-      // If the object has no bounding box, ignore it
-      if (!object->boundingBox()) {
-	return;
-      }
-      object->boundingBox()->getHalfLengths(x, y, z) ;
+      CkcdPoint position[8];
 
       /*Matrices absolute et relative*/
       CkcdMat4 matrixAbsolutePosition;
       CkcdMat4 matrixRelativePosition;
       object->getAbsolutePosition(matrixAbsolutePosition);
-      object->boundingBox()->getRelativePosition(matrixRelativePosition);
-
-      /*Creer les points et change position points*/
-      CkcdMat4 matrixChangePosition =
-	matrixAbsolutePosition*matrixRelativePosition;
 
-      CkcdPoint position[8];
-
-      position[0]=matrixChangePosition*CkcdPoint( x, y, z);
-      position[1]=matrixChangePosition*CkcdPoint( x, y,-z);
-      position[2]=matrixChangePosition*CkcdPoint( x,-y, z);
-      position[3]=matrixChangePosition*CkcdPoint(-x, y, z);
-      position[4]=matrixChangePosition*CkcdPoint( x,-y,-z);
-      position[5]=matrixChangePosition*CkcdPoint(-x,-y, z);
-      position[6]=matrixChangePosition*CkcdPoint(-x, y,-z);
-      position[7]=matrixChangePosition*CkcdPoint(-x,-y,-z);
+      if (!object->boundingBox()) {
+	// Objects whose geometry is not loaded yet only have the
+	// bounding box recorded in the geometry store.
+	double box[6];
+	// If the object has no bounding box, ignore it
+	if (!GeometryStore::deferredBoundingBox(object, box)) {
+	  return;
+	}
+	for (unsigned int i=0; i<8; i++) {
+	  position[i]=matrixAbsolutePosition*
+	    CkcdPoint(box[(i&1) ? 3 : 0], box[(i&2) ? 4 : 1],
+		      box[(i&4) ? 5 : 2]);
+	}
+      } else {
+	object->boundingBox()->getHalfLengths(x, y, z) ;
+	object->boundingBox()->getRelativePosition(matrixRelativePosition);
+
+	/*Creer les points et change position points*/
+	CkcdMat4 matrixChangePosition =
+	  matrixAbsolutePosition*matrixRelativePosition;
+
+	position[0]=matrixChangePosition*CkcdPoint( x, y, z);
+	position[1]=matrixChangePosition*CkcdPoint( x, y,-z);
+	position[2]=matrixChangePosition*CkcdPoint( x,-y, z);
+	position[3]=matrixChangePosition*CkcdPoint(-x, y, z);
+	position[4]=matrixChangePosition*CkcdPoint( x,-y,-z);
+	position[5]=matrixChangePosition*CkcdPoint(-x,-y, z);
+	position[6]=matrixChangePosition*CkcdPoint(-x, y,-z);
+	position[7]=matrixChangePosition*CkcdPoint(-x,-y,-z);
+      }
 
       for(int i=0; i<8; i++)
 	{
@@ -400,6 +666,9 @@ namespace hpp {
 					   kwsDofVector,
 					   vectorN& outJrlDynamicsDofVector)
     {
+      Trace::Span span ("device", "kws-to-jrl-config");
+      HPP_MODEL_PROBE_SCOPE2 (kws_to_jrl_config, this, kwsDofVector.size ());
+      Statistics::Scope statistics (Statistics::KWS_TO_JRL_CONFIG);
       // Count the number of extra dofs of the CkppDeviceComponent
       // since the first degrees of freedom of kwsDofVector correspond
       // to these extra-dofs.
@@ -517,6 +786,10 @@ namespace hpp {
     Device::jrlDynamicsToKwsDofValues(const vectorN& inJrlDynamicsDofVector,
 				      std::vector<double>& outKwsDofVector)
     {
+      Trace::Span span ("device", "jrl-to-kws-config");
+      HPP_MODEL_PROBE_SCOPE2 (jrl_to_kws_config, this,
+			      inJrlDynamicsDofVector.size ());
+      Statistics::Scope statistics (Statistics::JRL_TO_KWS_CONFIG);
       /// Count the number of extra dofs of the CkppDeviceComponent.
       unsigned int rankInDofValues =
 	CkwsDevice::rootJoint ()->customSubspace ()->size ();
@@ -620,13 +893,19 @@ namespace hpp {
     bool Device::hppSetCurrentConfig(const CkwsConfig& config,
 				     EwhichPart updateWhat)
     {
+      Trace::Span span ("device", "set-config", "part", long (updateWhat));
+      HPP_MODEL_PROBE_SCOPE3 (set_config, this, config.size (), updateWhat);
+      Statistics::Scope statistics
+	(Statistics::Ecounter (Statistics::SET_CONFIG_GEOMETRIC + updateWhat));
       bool updateGeom = (updateWhat == GEOMETRIC || updateWhat == BOTH);
       bool updateDynamic = (updateWhat == DYNAMIC || updateWhat == BOTH);
 
       if (updateGeom) {
 	hppDout(info, "updating geometric part: config = " << config);
-
-
+	if (!deferredGeometryLoaded_) {
+	  loadDeferredGeometry();
+	}
+	Trace::Span kineoSpan ("device", "kineo-set-config");
 	if (CkppDeviceComponent::setCurrentConfig(config) != KD_OK) {
 	  hppDout(error, "failed to set configuration of geometric part.");
 	  throw("failed to set configuration of geometric part.");
@@ -640,6 +919,7 @@ namespace hpp {
 	config.getDofValues(kwsDofVector);
 	kwsToJrlDynamicsDofValues(kwsDofVector, jrlConfig);
 
+	Trace::Span jrlSpan ("device", "jrl-forward-kinematics");
 	if (!currentConfiguration(jrlConfig)) {
 	  hppDout(error, "failed to set configuration of dynamic part.");
 	  throw Exception("failed to set configuration of dynamic part.");
@@ -657,11 +937,16 @@ namespace hpp {
     bool Device::hppSetCurrentConfig(const vectorN& config,
 				     EwhichPart updateWhat)
     {
+      Trace::Span span ("device", "set-config", "part", long (updateWhat));
+      HPP_MODEL_PROBE_SCOPE3 (set_config, this, config.size (), updateWhat);
+      Statistics::Scope statistics
+	(Statistics::Ecounter (Statistics::SET_CONFIG_GEOMETRIC + updateWhat));
       bool updateGeom = (updateWhat == GEOMETRIC || updateWhat == BOTH);
       bool updateDynamic = (updateWhat == DYNAMIC || updateWhat == BOTH);
 
       if (updateDynamic) {
 	hppDout(info, "updating dynamic part: config = " << config);
+	Trace::Span jrlSpan ("device", "jrl-forward-kinematics");
 	if (!currentConfiguration(config)) {
 	  throw Exception("failed to set configuration of dynamic part.");
 	}
@@ -674,6 +959,10 @@ namespace hpp {
 	this->getCurrentDofValues(dofValues);
 	jrlDynamicsToKwsDofValues(config, dofValues);
 
+	if (!deferredGeometryLoaded_) {
+	  loadDeferredGeometry();
+	}
+	Trace::Span kineoSpan ("device", "kineo-set-config");
 	if (CkppDeviceComponent::setCurrentDofValues(dofValues) != KD_OK) {
 	  throw("failed to set configuration of geometric part.");
 	}
@@ -788,6 +1077,16 @@ namespace hpp {
     void Device::
     componentWillInsertChild(const CkitNotificationConstShPtr& notification)
     {
+      prepareChildInsertion(notification);
+    }
+
+    // ======================================================================
+
+    void Device::
+    prepareChildInsertion(const CkitNotificationConstShPtr& notification)
+    {
+      // Work is done by initialize () at the end of a bulk build.
+      if (isBulkBuilding ()) return;
       JointShPtr parentJoint, childJoint;
       CkppSolidComponentShPtr childSolid;
       CkppSolidComponentRefShPtr childSolidRef;
@@ -0,0 +1,514 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
+#include <hpp/util/debug.hh>
+
+#include "hpp/model/exception.hh"
+#include "hpp/model/geometry-store.hh"
+#include "hpp/model/trace.hh"
+
+#include "mapped-file.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Layout of a store file. Meshes are sorted by name.
+      //
+      //   Header
+      //   MeshRecord    x nbMeshes
+      //   double        x 3 * nbVertices
+      //   uint32_t      x 3 * nbTriangles, padded to 8 bytes
+      //   char          x stringsSize
+      const char magic [8] = {'H', 'P', 'P', 'G', 'S', 'T', 'O', 'R'};
+      const uint32_t byteOrderMark = 0x01020304;
+
+      struct Header
+      {
+	char magic [8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t nbMeshes;
+	uint64_t nbVertices;
+	uint64_t nbTriangles;
+	uint64_t stringsSize;
+      };
+
+      struct StringRef
+      {
+	uint64_t offset;
+	uint64_t length;
+      };
+
+      struct MeshRecord
+      {
+	StringRef name;
+	uint64_t firstVertex;
+	uint64_t nbVertices;
+	uint64_t firstTriangle;
+	uint64_t nbTriangles;
+	double boundingBox [6];
+      };
+
+      // Stores opened in this process
+      typedef std::map<std::string, GeometryStoreWkPtr> OpenStores_t;
+      OpenStores_t openStores;
+      boost::mutex openStoresMutex;
+
+      std::size_t triangleSectionSize (uint64_t nbTriangles)
+      {
+	return (3 * nbTriangles * sizeof (uint32_t) + 7) & ~std::size_t (7);
+      }
+
+      const Header& header (const char* data)
+      {
+	return *reinterpret_cast<const Header*> (data);
+      }
+
+      const MeshRecord* meshRecords (const char* data)
+      {
+	return reinterpret_cast<const MeshRecord*> (data + sizeof (Header));
+      }
+
+      const double* vertexData (const char* data)
+      {
+	return reinterpret_cast<const double*>
+	  (meshRecords (data) + header (data).nbMeshes);
+      }
+
+      const uint32_t* triangleData (const char* data)
+      {
+	return reinterpret_cast<const uint32_t*>
+	  (vertexData (data) + 3 * header (data).nbVertices);
+      }
+
+      const char* strings (const char* data)
+      {
+	return reinterpret_cast<const char*> (triangleData (data))
+	  + triangleSectionSize (header (data).nbTriangles);
+      }
+
+      bool isValid (const StringRef& ref, const Header& h)
+      {
+	return ref.offset <= h.stringsSize &&
+	  ref.length <= h.stringsSize - ref.offset;
+      }
+
+      // Compare a string of the string table with a name
+      int compare (const char* data, const StringRef& ref,
+		   const std::string& name)
+      {
+	const std::size_t n = std::min (std::size_t (ref.length),
+					name.size ());
+	const int result = memcmp (strings (data) + ref.offset, name.data (), n);
+	if (result != 0) return result;
+	if (ref.length < name.size ()) return -1;
+	return ref.length > name.size () ? 1 : 0;
+      }
+
+      // Binary search of a record by name
+      template <typename Record> std::size_t
+      find (const char* data, const Record* records, std::size_t nbRecords,
+	    const std::string& name)
+      {
+	std::size_t lower = 0, upper = nbRecords;
+	while (lower < upper) {
+	  const std::size_t middle = (lower + upper) / 2;
+	  const int c = compare (data, records [middle].name, name);
+	  if (c == 0) return middle;
+	  if (c < 0) lower = middle + 1;
+	  else upper = middle;
+	}
+	return SIZE_MAX;
+      }
+
+      // Polyhedra waiting for their mesh, indexed by their address as
+      // CkcdObject.
+      struct DeferredPolyhedron
+      {
+	GeometryStoreShPtr store;
+	std::size_t mesh;
+	CkppKCDPolyhedronWkPtr polyhedron;
+      };
+      typedef std::map<const CkcdObject*, DeferredPolyhedron> Deferred_t;
+      Deferred_t deferred;
+      boost::mutex deferredMutex;
+
+      // Find a deferred polyhedron, removing entries of destroyed
+      // polyhedra.
+      Deferred_t::iterator findDeferred (const CkcdObjectShPtr& object)
+      {
+	Deferred_t::iterator it = deferred.find (object.get ());
+	if (it != deferred.end () && !it->second.polyhedron.lock ()) {
+	  deferred.erase (it);
+	  return deferred.end ();
+	}
+	return it;
+      }
+
+      template <typename T> bool nameLess (const T* a, const T* b)
+      {
+	return a->name < b->name;
+      }
+
+      template <typename T> void append (std::ofstream& file,
+					 const std::vector<T>& records)
+      {
+	if (!records.empty ()) {
+	  file.write (reinterpret_cast<const char*> (&records [0]),
+		      records.size () * sizeof (T));
+	}
+      }
+    } // namespace
+
+    const uint32_t GeometryStore::VERSION;
+
+    // ======================================================================
+
+    GeometryStore::GeometryStore (const std::string& filename)
+      : filename_ (filename), file_ (new MappedFile ())
+    {
+    }
+
+    // ======================================================================
+
+    GeometryStore::~GeometryStore ()
+    {
+    }
+
+    // ======================================================================
+
+    void GeometryStore::write (const std::string& filename,
+			       const std::vector<Mesh>& meshes)
+    {
+      std::vector<const Mesh*> sortedMeshes;
+      for (std::size_t i = 0; i < meshes.size (); ++i) {
+	sortedMeshes.push_back (&meshes [i]);
+      }
+      std::sort (sortedMeshes.begin (), sortedMeshes.end (), nameLess<Mesh>);
+
+      std::string stringTable;
+      std::vector<MeshRecord> meshRecords;
+      std::vector<double> vertices;
+      std::vector<uint32_t> triangles;
+      for (std::size_t i = 0; i < sortedMeshes.size (); ++i) {
+	const Mesh& mesh = *sortedMeshes [i];
+	if (i > 0 && mesh.name == sortedMeshes [i - 1]->name) {
+	  throw Exception ("Two meshes are named " + mesh.name + ".");
+	}
+	const std::size_t nbVertices = mesh.vertices.size () / 3;
+	if (3 * nbVertices != mesh.vertices.size () ||
+	    mesh.triangles.size () % 3 != 0) {
+	  throw Exception ("Mesh " + mesh.name + " is ill-formed.");
+	}
+	for (std::size_t k = 0; k < mesh.triangles.size (); ++k) {
+	  if (mesh.triangles [k] >= nbVertices) {
+	    throw Exception ("Mesh " + mesh.name + " is ill-formed.");
+	  }
+	}
+	MeshRecord record;
+	record.name.offset = stringTable.size ();
+	record.name.length = mesh.name.size ();
+	stringTable += mesh.name;
+	record.firstVertex = vertices.size () / 3;
+	record.nbVertices = nbVertices;
+	record.firstTriangle = triangles.size () / 3;
+	record.nbTriangles = mesh.triangles.size () / 3;
+	for (std::size_t k = 0; k < 3; ++k) {
+	  record.boundingBox [k] = std::numeric_limits<double>::infinity ();
+	  record.boundingBox [3 + k] = -std::numeric_limits<double>::infinity ();
+	}
+	for (std::size_t v = 0; v < nbVertices; ++v) {
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    const double x = mesh.vertices [3*v + k];
+	    record.boundingBox [k] = std::min (record.boundingBox [k], x);
+	    record.boundingBox [3 + k] = std::max (record.boundingBox [3 + k],
+						   x);
+	  }
+	}
+	vertices.insert (vertices.end (), mesh.vertices.begin (),
+			 mesh.vertices.end ());
+	triangles.insert (triangles.end (), mesh.triangles.begin (),
+			  mesh.triangles.end ());
+	meshRecords.push_back (record);
+      }
+
+      Header h;
+      memset (&h, 0, sizeof (Header));
+      memcpy (h.magic, magic, sizeof (magic));
+      h.version = VERSION;
+      h.byteOrder = byteOrderMark;
+      h.nbMeshes = meshRecords.size ();
+      h.nbVertices = vertices.size () / 3;
+      h.nbTriangles = triangles.size () / 3;
+      h.stringsSize = stringTable.size ();
+      // Pad triangles so that the string table is aligned.
+      triangles.resize (triangleSectionSize (h.nbTriangles) /
+			sizeof (uint32_t), 0);
+
+      const std::string tmp = temporaryFilename (filename);
+      {
+	std::ofstream file (tmp.c_str (), std::ios::binary | std::ios::trunc);
+	if (!file) {
+	  throw Exception ("Cannot write " + tmp + ".");
+	}
+	file.write (reinterpret_cast<const char*> (&h), sizeof (Header));
+	append (file, meshRecords);
+	append (file, vertices);
+	append (file, triangles);
+	file.write (stringTable.data (), stringTable.size ());
+	if (!file) {
+	  unlink (tmp.c_str ());
+	  throw Exception ("Failed to write " + tmp + ".");
+	}
+      }
+      commitTemporaryFile (tmp, filename);
+      hppDout (info, "Wrote geometry store " << filename << " with "
+	       << h.nbMeshes << " meshes.");
+    }
+
+    // ======================================================================
+
+    GeometryStoreShPtr GeometryStore::open (const std::string& filename)
+    {
+      // Stores are identified by canonical path, so that different names
+      // of the same file share one mapping.
+      char* canonical = realpath (filename.c_str (), 0);
+      if (!canonical) {
+	throw Exception ("Cannot open geometry store " + filename + ".");
+      }
+      const std::string key (canonical);
+      free (canonical);
+
+      boost::mutex::scoped_lock lock (openStoresMutex);
+      OpenStores_t::iterator it = openStores.find (key);
+      if (it != openStores.end ()) {
+	GeometryStoreShPtr store = it->second.lock ();
+	if (store) return store;
+      }
+
+      GeometryStoreShPtr store (new GeometryStore (filename));
+      MappedFile& file = *store->file_;
+      if (!file.open (filename) || file.size () < sizeof (Header)) {
+	throw Exception ("Cannot open geometry store " + filename + ".");
+      }
+      const char* data = file.data ();
+      const Header& h = header (data);
+      if (memcmp (h.magic, magic, sizeof (magic)) != 0 ||
+	  h.version != VERSION || h.byteOrder != byteOrderMark) {
+	throw Exception (filename + " is not a geometry store of version 2.");
+      }
+      const uint64_t limit = uint64_t (1) << 40;
+      if (h.nbMeshes > limit || h.nbVertices > limit ||
+	  h.nbTriangles > limit || h.stringsSize > limit ||
+	  file.size () != sizeof (Header) + h.nbMeshes * sizeof (MeshRecord)
+	  + 3 * h.nbVertices * sizeof (double)
+	  + triangleSectionSize (h.nbTriangles) + h.stringsSize) {
+	throw Exception (filename + " is truncated.");
+      }
+      const MeshRecord* meshes = meshRecords (data);
+      const uint32_t* triangles = triangleData (data);
+      for (std::size_t i = 0; i < h.nbMeshes; ++i) {
+	const MeshRecord& mesh = meshes [i];
+	if (!isValid (mesh.name, h) ||
+	    mesh.nbVertices > h.nbVertices ||
+	    mesh.firstVertex > h.nbVertices - mesh.nbVertices ||
+	    mesh.nbTriangles > h.nbTriangles ||
+	    mesh.firstTriangle > h.nbTriangles - mesh.nbTriangles) {
+	  throw Exception (filename + " is corrupted.");
+	}
+	// Triangles index vertices of their own mesh.
+	const uint32_t* t = triangles + 3 * mesh.firstTriangle;
+	for (std::size_t k = 0; k < 3 * mesh.nbTriangles; ++k) {
+	  if (t [k] >= mesh.nbVertices) {
+	    throw Exception (filename + " is corrupted.");
+	  }
+	}
+      }
+      openStores [key] = store;
+      hppDout (info, "Opened geometry store " << filename << " with "
+	       << h.nbMeshes << " meshes.");
+      return store;
+    }
+
+    // ======================================================================
+
+    std::size_t GeometryStore::nbMeshes () const
+    {
+      return header (file_->data ()).nbMeshes;
+    }
+
+    // ======================================================================
+
+    std::size_t GeometryStore::meshIndex (const std::string& name) const
+    {
+      const char* data = file_->data ();
+      return find (data, meshRecords (data), nbMeshes (), name);
+    }
+
+    // ======================================================================
+
+    std::string GeometryStore::meshName (std::size_t mesh) const
+    {
+      const char* data = file_->data ();
+      const StringRef& ref = meshRecords (data) [mesh].name;
+      return std::string (strings (data) + ref.offset, ref.length);
+    }
+
+    // ======================================================================
+
+    std::size_t GeometryStore::nbVertices (std::size_t mesh) const
+    {
+      return meshRecords (file_->data ()) [mesh].nbVertices;
+    }
+
+    // ======================================================================
+
+    const double* GeometryStore::vertices (std::size_t mesh) const
+    {
+      const char* data = file_->data ();
+      return vertexData (data) + 3 * meshRecords (data) [mesh].firstVertex;
+    }
+
+    // ======================================================================
+
+    std::size_t GeometryStore::nbTriangles (std::size_t mesh) const
+    {
+      return meshRecords (file_->data ()) [mesh].nbTriangles;
+    }
+
+    // ======================================================================
+
+    const uint32_t* GeometryStore::triangles (std::size_t mesh) const
+    {
+      const char* data = file_->data ();
+      return triangleData (data) + 3 * meshRecords (data) [mesh].firstTriangle;
+    }
+
+    // ======================================================================
+
+    const double* GeometryStore::boundingBox (std::size_t mesh) const
+    {
+      return meshRecords (file_->data ()) [mesh].boundingBox;
+    }
+
+    // ======================================================================
+
+    CkppKCDPolyhedronShPtr
+    GeometryStore::buildPolyhedron (std::size_t mesh,
+				    const std::string& name) const
+    {
+      CkppKCDPolyhedronShPtr polyhedron = CkppKCDPolyhedron::create (name);
+      fillPolyhedron (mesh, polyhedron);
+      return polyhedron;
+    }
+
+    // ======================================================================
+
+    void GeometryStore::fillPolyhedron
+    (std::size_t mesh, const CkppKCDPolyhedronShPtr& polyhedron) const
+    {
+      Trace::Span span ("parser", "fill-polyhedron", "mesh", long (mesh));
+      const double* v = vertices (mesh);
+      const uint32_t* t = triangles (mesh);
+      unsigned int rank;
+      for (std::size_t i = 0; i < nbVertices (mesh); ++i) {
+	polyhedron->addPoint (v [3*i], v [3*i + 1], v [3*i + 2], rank);
+      }
+      for (std::size_t i = 0; i < nbTriangles (mesh); ++i) {
+	polyhedron->addTriangle (t [3*i], t [3*i + 1], t [3*i + 2], rank);
+      }
+      polyhedron->makeCollisionEntity (CkcdObject::IMMEDIATE_BUILD);
+    }
+
+    // ======================================================================
+
+    void GeometryStore::deferPolyhedron
+    (const GeometryStoreShPtr& store, std::size_t mesh,
+     const CkppKCDPolyhedronShPtr& polyhedron)
+    {
+      CkcdObjectShPtr object = KIT_DYNAMIC_PTR_CAST (CkcdObject, polyhedron);
+      DeferredPolyhedron entry;
+      entry.store = store;
+      entry.mesh = mesh;
+      entry.polyhedron = polyhedron;
+      boost::mutex::scoped_lock lock (deferredMutex);
+      deferred [object.get ()] = entry;
+    }
+
+    // ======================================================================
+
+    bool GeometryStore::loadDeferred (const CkcdObjectShPtr& object)
+    {
+      // Polyhedra are filled while holding the lock, so that an object
+      // is never used while another thread is filling it.
+      boost::mutex::scoped_lock lock (deferredMutex);
+      Deferred_t::iterator it = findDeferred (object);
+      if (it == deferred.end ()) {
+	return false;
+      }
+      const DeferredPolyhedron entry = it->second;
+      deferred.erase (it);
+      hppDout (info, "Loading " << entry.store->meshName (entry.mesh)
+	       << " from " << entry.store->filename () << ".");
+      entry.store->fillPolyhedron (entry.mesh, entry.polyhedron.lock ());
+      return true;
+    }
+
+    // ======================================================================
+
+    bool GeometryStore::deferredBoundingBox (const CkcdObjectShPtr& object,
+					     double outBox [6])
+    {
+      boost::mutex::scoped_lock lock (deferredMutex);
+      Deferred_t::iterator it = findDeferred (object);
+      if (it == deferred.end ()) {
+	return false;
+      }
+      const double* box = it->second.store->boundingBox (it->second.mesh);
+      std::copy (box, box + 6, outBox);
+      return true;
+    }
+
+    // ======================================================================
+
+    std::size_t GeometryStore::nbDeferred ()
+    {
+      boost::mutex::scoped_lock lock (deferredMutex);
+      for (Deferred_t::iterator it = deferred.begin (); it != deferred.end ();) {
+	if (it->second.polyhedron.lock ()) {
+	  ++it;
+	} else {
+	  deferred.erase (it++);
+	}
+      }
+      return deferred.size ();
+    }
+  } // namespace model
+} // namespace hpp
@@ -0,0 +1,143 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_HISTOGRAM_HH
+# define HPP_MODEL_HISTOGRAM_HH
+
+# include <stdint.h>
+
+# include <algorithm>
+# include <limits>
+# include <vector>
+
+namespace hpp {
+  namespace model {
+    // Values shared between threads are only written by the thread
+    // owning them and read by other threads with relaxed atomic
+    // accesses: each value is consistent, not the histogram as a whole.
+    template <typename T> T load (const T& value)
+    {
+      return __atomic_load_n (&value, __ATOMIC_RELAXED);
+    }
+
+    template <typename T> void store (T& value, T newValue)
+    {
+      __atomic_store_n (&value, newValue, __ATOMIC_RELAXED);
+    }
+
+    inline void increment (uint64_t& value, uint64_t delta = 1)
+    {
+      store (value, load (value) + delta);
+    }
+
+    /// Call count and latency histogram of a counter of Statistics.
+
+    /// Values below 16 have one bucket each. Above, each power of two
+    /// [2^e, 2^(e+1)) is split in 16 buckets of width 2^(e-4).
+    struct Histogram
+    {
+      static const unsigned int subBucketBits = 4;
+      static const unsigned int nbSubBuckets = 1 << subBucketBits;
+      static const unsigned int nbBuckets =
+	(64 - subBucketBits + 1) * nbSubBuckets;
+
+      static unsigned int bucket (uint64_t value)
+      {
+	if (value < nbSubBuckets) return value;
+	const unsigned int exponent = 63 - __builtin_clzll (value);
+	const unsigned int shift = exponent - subBucketBits;
+	return (shift + 1) * nbSubBuckets +
+	  ((value >> shift) & (nbSubBuckets - 1));
+      }
+
+      // Largest value falling in a bucket.
+      static uint64_t bucketUpperBound (unsigned int index)
+      {
+	if (index < nbSubBuckets) return index;
+	const unsigned int shift = index / nbSubBuckets - 1;
+	const uint64_t lower =
+	  uint64_t (nbSubBuckets + index % nbSubBuckets) << shift;
+	return lower + ((uint64_t (1) << shift) - 1);
+      }
+
+      Histogram () : count (0), samples (0), total (0),
+		     min (std::numeric_limits<uint64_t>::max ()), max (0),
+		     buckets (nbBuckets, 0)
+      {
+      }
+
+      // Called by the owning thread only.
+      void clear ()
+      {
+	store<uint64_t> (count, 0);
+	store<uint64_t> (samples, 0);
+	store<uint64_t> (total, 0);
+	store<uint64_t> (max, 0);
+	store (min, std::numeric_limits<uint64_t>::max ());
+	for (unsigned int i = 0; i < nbBuckets; ++i) {
+	  store<uint64_t> (buckets [i], 0);
+	}
+      }
+
+      // Called by the owning thread only.
+      void add (uint64_t latency)
+      {
+	increment (samples);
+	increment (total, latency);
+	if (latency < min) store (min, latency);
+	if (latency > max) store (max, latency);
+	increment (buckets [bucket (latency)]);
+      }
+
+      // Merge the histogram of another thread in a local one.
+      void merge (const Histogram& other)
+      {
+	count += load (other.count);
+	samples += load (other.samples);
+	total += load (other.total);
+	min = std::min (min, load (other.min));
+	max = std::max (max, load (other.max));
+	for (unsigned int i = 0; i < nbBuckets; ++i) {
+	  buckets [i] += load (other.buckets [i]);
+	}
+      }
+
+      uint64_t percentile (double percent) const
+      {
+	if (samples == 0) return 0;
+	const double rank = std::max (1., percent * samples / 100.);
+	uint64_t cumulated = 0;
+	for (unsigned int i = 0; i < nbBuckets; ++i) {
+	  cumulated += buckets [i];
+	  if (cumulated >= rank) return std::min (bucketUpperBound (i), max);
+	}
+	return max;
+      }
+
+      uint64_t count;
+      uint64_t samples;
+      uint64_t total;
+      uint64_t min;
+      uint64_t max;
+      std::vector<uint64_t> buckets;
+    }; // struct Histogram
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_HISTOGRAM_HH
@@ -26,6 +26,8 @@
 #include "hpp/model/humanoid-robot.hh"
 #include "hpp/model/joint.hh"
 #include "hpp/model/robot-dynamics-impl.hh"
+#include "hpp/model/statistics.hh"
+#include "hpp/model/trace.hh"
 
 namespace hpp {
   namespace model {
@@ -140,16 +142,17 @@ namespace hpp {
     HumanoidRobot::HumanoidRobot
     (CjrlRobotDynamicsObjectFactory *objFactory) :
       impl::DynamicRobot(), impl::HumanoidDynamicRobot(objFactory),
-      Device()
+      Device(), roleTable_(), roleTableValid_(false)
     {
-      CkitNotificator::defaultNotificator()->subscribe<HumanoidRobot>
-	(CkppComponent::DID_INSERT_CHILD, this,
-	 &HumanoidRobot::componentDidInsertChild);
     }
 
+    // ======================================================================
+
     void HumanoidRobot::
     componentDidInsertChild(const CkitNotificationConstShPtr& notification)
     {
+      // Work is done by initialize () at the end of a bulk build.
+      if (isBulkBuilding()) return;
       JointShPtr parentJoint, childJoint;
       CkppComponentShPtr parent(notification->objectShPtr<CkppComponent>());
       CkppComponentShPtr child(notification->shPtrValue<CkppComponent>
@@ -164,15 +167,46 @@ namespace hpp {
 
     // ======================================================================
 
+    bool
+    HumanoidRobot::isRoleProperty(const CkppPropertyShPtr& property) const
+    {
+      return property == gaze_ || property == leftAnkle_ ||
+	property == rightAnkle_ || property == leftWrist_ ||
+	property == rightWrist_ || property == waist_ || property == chest_;
+    }
+
+    // ======================================================================
+
+    void HumanoidRobot::buildRoleTable()
+    {
+      roleTable_.clear();
+      roleTable_[gaze_->value()] |= ROLE_GAZE;
+      roleTable_[leftAnkle_->value()] |= ROLE_LEFT_ANKLE;
+      roleTable_[rightAnkle_->value()] |= ROLE_RIGHT_ANKLE;
+      roleTable_[leftWrist_->value()] |= ROLE_LEFT_WRIST;
+      roleTable_[rightWrist_->value()] |= ROLE_RIGHT_WRIST;
+      roleTable_[waist_->value()] |= ROLE_WAIST;
+      roleTable_[chest_->value()] |= ROLE_CHEST;
+      roleTableValid_ = true;
+    }
+
+    // ======================================================================
+
     void HumanoidRobot::registerSpecificJoint(const JointShPtr& joint)
     {
       if (joint->jrlJoint() == 0) return;
-      const std::string name = KIT_DYNAMIC_PTR_CAST(CkppComponent,
-						    joint)->name();
-      if (name == gaze_->value()) {
+      if (!roleTableValid_) {
+	buildRoleTable();
+      }
+      const std::string& name = KIT_DYNAMIC_PTR_CAST(CkppComponent,
+						     joint)->name();
+      RoleTable_t::const_iterator it = roleTable_.find(name);
+      if (it == roleTable_.end()) return;
+      const unsigned int role = it->second;
+      if (role & ROLE_GAZE) {
 	hppDout(info, "gaze = " << name);
 	impl::HumanoidDynamicRobot::gazeJoint(joint->jrlJoint());
-      } else if (name == leftAnkle_->value()) {
+      } else if (role & ROLE_LEFT_ANKLE) {
 	hppDout(info, "left ankle = " << name);
 	impl::HumanoidDynamicRobot::leftAnkle(joint->jrlJoint());
 	// Create left foot if not already created
@@ -189,7 +223,7 @@ namespace hpp {
 	  foot->setAnklePositionInLocalFrame(anklePosition);
 	  impl::HumanoidDynamicRobot::leftFoot(foot);
 	}
-      } else if (name == rightAnkle_->value()) {
+      } else if (role & ROLE_RIGHT_ANKLE) {
 	hppDout(info, "right ankle = " << name);
 	impl::HumanoidDynamicRobot::rightAnkle(joint->jrlJoint());
 	// Create right foot if not already created
@@ -206,7 +240,7 @@ namespace hpp {
 	  foot->setAnklePositionInLocalFrame(anklePosition);
 	  impl::HumanoidDynamicRobot::rightFoot(foot);
 	}
-      } else if (name == leftWrist_->value()) {
+      } else if (role & ROLE_LEFT_WRIST) {
 	hppDout(info, "left wrist = " << name);
 	impl::HumanoidDynamicRobot::leftWrist(joint->jrlJoint());
 	// Create left hand if not already created
@@ -235,7 +269,7 @@ namespace hpp {
 	  hand->setPalmNormal(palmNormal);
 	  impl::HumanoidDynamicRobot::leftHand(hand);
 	}
-      } else if (name == rightWrist_->value()) {
+      } else if (role & ROLE_RIGHT_WRIST) {
 	hppDout(info, "right wrist = " << name);
 	impl::HumanoidDynamicRobot::rightWrist(joint->jrlJoint());
 	// Create right hand
@@ -264,10 +298,10 @@ namespace hpp {
 	  hand->setPalmNormal(palmNormal);
 	  impl::HumanoidDynamicRobot::rightHand(hand);
 	}
-      } else if (name == waist_->value()) {
+      } else if (role & ROLE_WAIST) {
 	hppDout(info, "waist = " << name);
 	impl::HumanoidDynamicRobot::waist(joint->jrlJoint());
-      } if (name == chest_->value()) {
+      } if (role & ROLE_CHEST) {
 	hppDout(info, "chest = " << name);
 	impl::HumanoidDynamicRobot::chest(joint->jrlJoint());
       }
@@ -300,6 +334,8 @@ namespace hpp {
     HumanoidRobotShPtr
     HumanoidRobot::createCopy(const HumanoidRobotShPtr& device)
     {
+      Trace::Span span ("device", "create-copy", "device", device->name ());
+      Statistics::Scope statistics (Statistics::CREATE_COPY);
       HumanoidRobot* ptr = new HumanoidRobot(*device);
       HumanoidRobotShPtr deviceShPtr(ptr);
 
@@ -617,6 +653,7 @@ namespace hpp {
       if (!leftPalmNormalZ_) {
 	throw Exception("Failed to initialize LEFTPALMNORMALZ property");
       }
+      roleTableValid_ = false;
 
       ktStatus success = Device::init(weakPtr, name);
 
@@ -670,14 +707,13 @@ namespace hpp {
 
     // ======================================================================
 
-    void HumanoidRobot::updateProperty(const CkppPropertyShPtr&
-#ifdef HPP_DEBUG
-				       property
-#endif
-				       )
+    void HumanoidRobot::updateProperty(const CkppPropertyShPtr& property)
     {
       hppDout(info,"HumanoidRobot::updateProperty: "
 		<< *property);
+      if (isRoleProperty(property)) {
+	roleTableValid_ = false;
+      }
     }
 
     // ======================================================================
@@ -685,6 +721,9 @@ namespace hpp {
     bool HumanoidRobot::modifiedProperty(const CkppPropertyShPtr &property)
     {
       if (!CkppDeviceComponent::modifiedProperty(property)) return false;
+      if (isRoleProperty(property)) {
+	roleTableValid_ = false;
+      }
 
       vector3d	go = gazeOrigin();
       vector3d gd = gazeDirection();
@@ -961,6 +1000,7 @@ namespace hpp {
       if (!leftPalmNormalZ_) {
 	throw Exception("Failed to initialize LEFTPALMNORMALZ property");
       }
+      roleTableValid_ = false;
       return success;
     }
 
@@ -968,6 +1008,7 @@ namespace hpp {
     {
       hppDout(info, "");
       Device::initialize();
+      buildRoleTable();
       typedef std::vector< CkppJointComponentShPtr > vector_t;
       vector_t jointVector;
       getJointComponentVector(jointVector);
@@ -0,0 +1,342 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include <abstract-robot-dynamics/joint.hh>
+
+#include "hpp/model/exception.hh"
+#include "hpp/model/inverse-dynamics.hh"
+#include "hpp/model/joint.hh"
+#include "hpp/model/kinematic-tree.hh"
+
+#include "kinematic-kernels.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Order in which the degrees of freedom of a freeflyer joint move
+      // the joint: x, y, z, yaw, pitch, roll.
+      const std::size_t freeflyerDofOrder [6] = {0, 1, 2, 5, 4, 3};
+
+      inline void cross (const double* a, const double* b, double* c)
+      {
+	c [0] = a [1] * b [2] - a [2] * b [1];
+	c [1] = a [2] * b [0] - a [0] * b [2];
+	c [2] = a [0] * b [1] - a [1] * b [0];
+      }
+
+      // Motion subspace of a degree of freedom: (a, p x a) for a rotation
+      // about axis a through p, (0, a) for a translation along a.
+      inline void motionSubspace (const double* a, const double* p,
+				  bool prismatic, double* s)
+      {
+	if (prismatic) {
+	  s [0] = s [1] = s [2] = 0;
+	  s [3] = a [0]; s [4] = a [1]; s [5] = a [2];
+	} else {
+	  s [0] = a [0]; s [1] = a [1]; s [2] = a [2];
+	  cross (p, a, s + 3);
+	}
+      }
+
+      // Spatial cross product of motion vectors: out = v x m
+      inline void crossMotion (const double* v, const double* m, double* out)
+      {
+	double tmp [3];
+	cross (v, m, out);
+	cross (v, m + 3, out + 3);
+	cross (v + 3, m, tmp);
+	out [3] += tmp [0]; out [4] += tmp [1]; out [5] += tmp [2];
+      }
+
+      // Spatial cross product of a motion and a force: out += v x* f
+      inline void crossForceAdd (const double* v, const double* f,
+				 double* out)
+      {
+	double tmp [3];
+	cross (v, f, tmp);
+	out [0] += tmp [0]; out [1] += tmp [1]; out [2] += tmp [2];
+	cross (v + 3, f + 3, tmp);
+	out [0] += tmp [0]; out [1] += tmp [1]; out [2] += tmp [2];
+	cross (v, f + 3, tmp);
+	out [3] += tmp [0]; out [4] += tmp [1]; out [5] += tmp [2];
+      }
+
+      // Apply spatial inertia of a body of mass m, center of mass c and
+      // rotational inertia I at c, all in the global frame.
+      inline void applyInertia (double m, const double* c, const double* I,
+				const double* v, double* out)
+      {
+	double vc [3];
+	cross (v, c, vc);
+	vc [0] += v [3]; vc [1] += v [4]; vc [2] += v [5];
+	out [3] = m * vc [0]; out [4] = m * vc [1]; out [5] = m * vc [2];
+	cross (c, out + 3, out);
+	for (std::size_t i = 0; i < 3; ++i) {
+	  out [i] += I [3*i] * v [0] + I [3*i + 1] * v [1] + I [3*i + 2] * v [2];
+	}
+      }
+
+      inline double dot6 (const double* a, const double* b)
+      {
+	return a [0] * b [0] + a [1] * b [1] + a [2] * b [2]
+	  + a [3] * b [3] + a [4] * b [4] + a [5] * b [5];
+      }
+    } // namespace
+
+    // ======================================================================
+
+    InverseDynamics::InverseDynamics (const KinematicTreeConstShPtr& tree)
+      : tree_ (tree),
+	lowerTorqueBound_ (),
+	upperTorqueBound_ (),
+	actuated_ (),
+	transforms_ (),
+	axis_ (),
+	point_ (),
+	prismatic_ (),
+	velocity_ (),
+	acceleration_ (),
+	force_ (),
+	blockConfig_ (),
+	blockTransforms_ (),
+	torques_ ()
+    {
+      if (!tree_) {
+	throw Exception ("Cannot compute inverse dynamics without tree.");
+      }
+      gravity (0, 0, -9.81);
+      const std::size_t n = tree_->nbJoints ();
+      const std::size_t nbDof = tree_->numberDof ();
+      const std::size_t W = KinematicTree::BLOCK_SIZE;
+
+      lowerTorqueBound_.assign (nbDof, 0);
+      upperTorqueBound_.assign (nbDof, 0);
+      actuated_.assign (nbDof, false);
+      for (std::size_t j = 0; j < n; ++j) {
+	if (tree_->jointType (j) == KinematicTree::FREEFLYER) continue;
+	for (std::size_t i = 0; i < tree_->jointDof (j); ++i) {
+	  const std::size_t dof = tree_->rankInConfiguration (j) + i;
+	  actuated_ [dof] = true;
+	  lowerTorqueBound_ [dof] = tree_->lowerTorqueBound (dof);
+	  upperTorqueBound_ [dof] = tree_->upperTorqueBound (dof);
+	}
+      }
+
+      transforms_.resize (12*n);
+      axis_.resize (3*nbDof + 3);
+      point_.resize (3*nbDof + 3);
+      prismatic_.resize (nbDof);
+      velocity_.resize (6*n);
+      acceleration_.resize (6*n);
+      force_.resize (6*n);
+      blockConfig_.resize (W * std::max (nbDof, std::size_t (1)));
+      blockTransforms_.resize (12*W*n);
+      torques_.resize (nbDof + 1);
+    }
+
+    // ======================================================================
+
+    void InverseDynamics::gravity (double x, double y, double z)
+    {
+      gravity_ [0] = x;
+      gravity_ [1] = y;
+      gravity_ [2] = z;
+    }
+
+    // ======================================================================
+
+    void InverseDynamics::compute (const double* q, const double* dq,
+				   const double* ddq, double* outTorques)
+    {
+      tree_->forwardKinematics (q, &transforms_ [0]);
+      computeFromTransforms (q, dq, ddq, &transforms_ [0], outTorques);
+    }
+
+    // ======================================================================
+
+    void InverseDynamics::computeTrajectory (const double* q,
+					     const double* dq,
+					     const double* ddq,
+					     std::size_t nbSamples,
+					     double* outTorques)
+    {
+      const std::size_t W = KinematicTree::BLOCK_SIZE;
+      const std::size_t n = tree_->nbJoints ();
+      const std::size_t nbDof = tree_->numberDof ();
+      for (std::size_t k = 0; k < nbSamples; k += W) {
+	const std::size_t nbLanes = std::min (W, nbSamples - k);
+	kernel::gatherConfigurations<W> (q + k * nbDof, nbLanes, nbDof,
+					 &blockConfig_ [0]);
+	kernel::forwardKinematics<W> (*tree_, &blockConfig_ [0],
+				      &blockTransforms_ [0]);
+	for (std::size_t l = 0; l < nbLanes; ++l) {
+	  const std::size_t offset = (k + l) * nbDof;
+	  kernel::scatterTransforms<W> (&blockTransforms_ [0], n, l,
+					&transforms_ [0]);
+	  computeFromTransforms (q + offset, dq + offset, ddq + offset,
+				 &transforms_ [0], outTorques + offset);
+	}
+      }
+    }
+
+    // ======================================================================
+
+    bool InverseDynamics::isWithinTorqueBounds (const double* torques) const
+    {
+      for (std::size_t dof = 0; dof < tree_->numberDof (); ++dof) {
+	if (actuated_ [dof] && (torques [dof] < lowerTorqueBound_ [dof] ||
+				torques [dof] > upperTorqueBound_ [dof])) {
+	  return false;
+	}
+      }
+      return true;
+    }
+
+    // ======================================================================
+
+    std::size_t InverseDynamics::firstTorqueViolation (const double* q,
+							const double* dq,
+							const double* ddq,
+							std::size_t nbSamples)
+    {
+      const std::size_t W = KinematicTree::BLOCK_SIZE;
+      const std::size_t n = tree_->nbJoints ();
+      const std::size_t nbDof = tree_->numberDof ();
+      for (std::size_t k = 0; k < nbSamples; k += W) {
+	const std::size_t nbLanes = std::min (W, nbSamples - k);
+	kernel::gatherConfigurations<W> (q + k * nbDof, nbLanes, nbDof,
+					 &blockConfig_ [0]);
+	kernel::forwardKinematics<W> (*tree_, &blockConfig_ [0],
+				      &blockTransforms_ [0]);
+	for (std::size_t l = 0; l < nbLanes; ++l) {
+	  const std::size_t offset = (k + l) * nbDof;
+	  kernel::scatterTransforms<W> (&blockTransforms_ [0], n, l,
+					&transforms_ [0]);
+	  computeFromTransforms (q + offset, dq + offset, ddq + offset,
+				 &transforms_ [0], &torques_ [0]);
+	  if (!isWithinTorqueBounds (&torques_ [0])) {
+	    return k + l;
+	  }
+	}
+      }
+      return nbSamples;
+    }
+
+    // ======================================================================
+
+    void InverseDynamics::computeFromTransforms (const double* q,
+						 const double* dq,
+						 const double* ddq,
+						 const double* transforms,
+						 double* outTorques)
+    {
+      const KinematicTree& tree = *tree_;
+      const std::size_t n = tree.nbJoints ();
+      tree.motionAxes (q, transforms, &axis_ [0], &point_ [0], prismatic_);
+
+      // Forward pass: velocity and acceleration of every body, then
+      // force needed to produce this motion.
+      for (std::size_t j = 0; j < n; ++j) {
+	double* v = &velocity_ [6*j];
+	double* a = &acceleration_ [6*j];
+	const std::size_t parent = tree.parent (j);
+	if (parent == SIZE_MAX) {
+	  // Gravity is taken into account as an acceleration of the base.
+	  std::fill (v, v + 6, 0.);
+	  a [0] = a [1] = a [2] = 0;
+	  a [3] = -gravity_ [0]; a [4] = -gravity_ [1]; a [5] = -gravity_ [2];
+	} else {
+	  std::copy (&velocity_ [6*parent], &velocity_ [6*parent] + 6, v);
+	  std::copy (&acceleration_ [6*parent], &acceleration_ [6*parent] + 6,
+		     a);
+	}
+	const std::size_t nbDof = tree.jointDof (j);
+	const std::size_t rank = tree.rankInConfiguration (j);
+	for (std::size_t i = 0; i < nbDof; ++i) {
+	  const std::size_t dof = rank +
+	    (tree.jointType (j) == KinematicTree::FREEFLYER ?
+	     freeflyerDofOrder [i] : i);
+	  double s [6], vxs [6];
+	  motionSubspace (&axis_ [3*dof], &point_ [3*dof], prismatic_ [dof], s);
+	  crossMotion (v, s, vxs);
+	  for (std::size_t k = 0; k < 6; ++k) {
+	    a [k] += s [k] * ddq [dof] + vxs [k] * dq [dof];
+	    v [k] += s [k] * dq [dof];
+	  }
+	}
+
+	double* f = &force_ [6*j];
+	const double mass = tree.mass (j);
+	if (mass == 0) {
+	  std::fill (f, f + 6, 0.);
+	  continue;
+	}
+	// Center of mass and inertia matrix in the global frame
+	const double* m = transforms + 12*j;
+	const double* lc = tree.localCenterOfMass (j);
+	const double* li = tree.inertia (j);
+	const double local [9] = {li [0], li [3], li [4],
+				  li [3], li [1], li [5],
+				  li [4], li [5], li [2]};
+	double c [3], ri [9], I [9];
+	for (std::size_t r = 0; r < 3; ++r) {
+	  c [r] = m [4*r] * lc [0] + m [4*r + 1] * lc [1] + m [4*r + 2] * lc [2]
+	    + m [4*r + 3];
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    ri [3*r + k] = m [4*r] * local [k] + m [4*r + 1] * local [3 + k]
+	      + m [4*r + 2] * local [6 + k];
+	  }
+	}
+	for (std::size_t r = 0; r < 3; ++r) {
+	  for (std::size_t k = 0; k < 3; ++k) {
+	    I [3*r + k] = ri [3*r] * m [4*k] + ri [3*r + 1] * m [4*k + 1]
+	      + ri [3*r + 2] * m [4*k + 2];
+	  }
+	}
+	double h [6];
+	applyInertia (mass, c, I, a, f);
+	applyInertia (mass, c, I, v, h);
+	crossForceAdd (v, h, f);
+      }
+
+      // Backward pass: accumulate forces towards the root and project
+      // them on the motion subspaces.
+      for (std::size_t j = n; j-- > 0;) {
+	const double* f = &force_ [6*j];
+	const std::size_t nbDof = tree.jointDof (j);
+	const std::size_t rank = tree.rankInConfiguration (j);
+	for (std::size_t i = 0; i < nbDof; ++i) {
+	  const std::size_t dof = rank + i;
+	  double s [6];
+	  motionSubspace (&axis_ [3*dof], &point_ [3*dof], prismatic_ [dof], s);
+	  outTorques [dof] = dot6 (s, f);
+	}
+	const std::size_t parent = tree.parent (j);
+	if (parent != SIZE_MAX) {
+	  double* fp = &force_ [6*parent];
+	  for (std::size_t k = 0; k < 6; ++k) {
+	    fp [k] += f [k];
+	  }
+	}
+      }
+    }
+  } // namespace model
+} // namespace hpp
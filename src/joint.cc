@@ -395,6 +395,41 @@ namespace hpp {
 
     // ======================================================================
 
+    void Joint::inertialParameters(double mass, const double com[3],
+				   const double inertia[6])
+    {
+      mass_->value(mass);
+      comX_->value(com[0]);
+      comY_->value(com[1]);
+      comZ_->value(com[2]);
+      inertiaMatrixXX_->value(inertia[0]);
+      inertiaMatrixYY_->value(inertia[1]);
+      inertiaMatrixZZ_->value(inertia[2]);
+      inertiaMatrixXY_->value(inertia[3]);
+      inertiaMatrixXZ_->value(inertia[4]);
+      inertiaMatrixYZ_->value(inertia[5]);
+
+      CjrlBody* jrlBody = jrlJoint() ? jrlJoint()->linkedBody() : 0;
+      if (jrlBody) {
+	jrlBody->mass(mass);
+	vector3d localCom;
+	localCom[0] = com[0];
+	localCom[1] = com[1];
+	localCom[2] = com[2];
+	jrlBody->localCenterOfMass(localCom);
+	matrix3d inertiaMatrix;
+	inertiaMatrix(0,0) = inertia[0];
+	inertiaMatrix(1,1) = inertia[1];
+	inertiaMatrix(2,2) = inertia[2];
+	inertiaMatrix(0,1) = inertiaMatrix(1,0) = inertia[3];
+	inertiaMatrix(0,2) = inertiaMatrix(2,0) = inertia[4];
+	inertiaMatrix(1,2) = inertiaMatrix(2,1) = inertia[5];
+	jrlBody->inertiaMatrix(inertiaMatrix);
+      }
+    }
+
+    // ======================================================================
+
     void Joint::createDynamicPart()
     {
       if (jointFactory_) {
@@ -0,0 +1,233 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// Kernels working on W configurations at a time. Every scalar quantity
+// is stored as W consecutive doubles (one lane per configuration) so
+// that loops over lanes are vectorized. A 3x4 matrix thus occupies 12*W
+// doubles, coefficient e of lane l being at index e*W + l.
+
+#ifndef HPP_MODEL_SRC_KINEMATIC_KERNELS_HH
+# define HPP_MODEL_SRC_KINEMATIC_KERNELS_HH
+
+# include <cmath>
+# include <cstddef>
+
+# include "hpp/model/kinematic-tree.hh"
+
+namespace hpp {
+  namespace model {
+    namespace kernel {
+
+      /// \brief c = a * b for homogeneous 3x4 matrices
+      /// \note c should not alias a or b.
+      template <std::size_t W>
+      inline void compose (const double* a, const double* b, double* c)
+      {
+	for (std::size_t i = 0; i < 3; ++i) {
+	  const double* ai = a + 4*i*W;
+	  double* ci = c + 4*i*W;
+	  for (std::size_t j = 0; j < 4; ++j) {
+	    for (std::size_t l = 0; l < W; ++l) {
+	      ci [j*W + l] = ai [l] * b [j*W + l]
+		+ ai [W + l] * b [(4 + j)*W + l]
+		+ ai [2*W + l] * b [(8 + j)*W + l];
+	    }
+	  }
+	  for (std::size_t l = 0; l < W; ++l) {
+	    ci [3*W + l] += ai [3*W + l];
+	  }
+	}
+      }
+
+      /// \brief c = a * b where b is the same matrix for all lanes
+      template <std::size_t W>
+      inline void composeStatic (const double* a, const double* b, double* c)
+      {
+	for (std::size_t i = 0; i < 3; ++i) {
+	  const double* ai = a + 4*i*W;
+	  double* ci = c + 4*i*W;
+	  for (std::size_t j = 0; j < 4; ++j) {
+	    for (std::size_t l = 0; l < W; ++l) {
+	      ci [j*W + l] = ai [l] * b [j] + ai [W + l] * b [4 + j]
+		+ ai [2*W + l] * b [8 + j];
+	    }
+	  }
+	  for (std::size_t l = 0; l < W; ++l) {
+	    ci [3*W + l] += ai [3*W + l];
+	  }
+	}
+      }
+
+      /// \brief Position of a joint in its parent frame
+      /// \param type type of the joint,
+      /// \param s static transformation of the joint (single matrix),
+      /// \param q joint configuration, W lanes per degree of freedom,
+      /// \retval out position of the joint in parent frame.
+      template <std::size_t W>
+      inline void jointLocalTransform (KinematicTree::EjointType type,
+				       const double* s, const double* q,
+				       double* out)
+      {
+	switch (type) {
+	case KinematicTree::ROTATION:
+	  for (std::size_t l = 0; l < W; ++l) {
+	    const double c = cos (q [l]);
+	    const double sn = sin (q [l]);
+	    for (std::size_t i = 0; i < 3; ++i) {
+	      out [(4*i)*W + l] = s [4*i];
+	      out [(4*i + 1)*W + l] = c * s [4*i + 1] + sn * s [4*i + 2];
+	      out [(4*i + 2)*W + l] = c * s [4*i + 2] - sn * s [4*i + 1];
+	      out [(4*i + 3)*W + l] = s [4*i + 3];
+	    }
+	  }
+	  break;
+	case KinematicTree::TRANSLATION:
+	  for (std::size_t l = 0; l < W; ++l) {
+	    for (std::size_t i = 0; i < 3; ++i) {
+	      out [(4*i)*W + l] = s [4*i];
+	      out [(4*i + 1)*W + l] = s [4*i + 1];
+	      out [(4*i + 2)*W + l] = s [4*i + 2];
+	      out [(4*i + 3)*W + l] = s [4*i + 3] + q [l] * s [4*i];
+	    }
+	  }
+	  break;
+	case KinematicTree::FREEFLYER:
+	  for (std::size_t l = 0; l < W; ++l) {
+	    const double cr = cos (q [3*W + l]);
+	    const double sr = sin (q [3*W + l]);
+	    const double cp = cos (q [4*W + l]);
+	    const double sp = sin (q [4*W + l]);
+	    const double cy = cos (q [5*W + l]);
+	    const double sy = sin (q [5*W + l]);
+	    out [l] = cp * cy;
+	    out [W + l] = sr * sp * cy - cr * sy;
+	    out [2*W + l] = cr * sp * cy + sr * sy;
+	    out [3*W + l] = q [l];
+	    out [4*W + l] = cp * sy;
+	    out [5*W + l] = sr * sp * sy + cr * cy;
+	    out [6*W + l] = cr * sp * sy - sr * cy;
+	    out [7*W + l] = q [W + l];
+	    out [8*W + l] = -sp;
+	    out [9*W + l] = sr * cp;
+	    out [10*W + l] = cr * cp;
+	    out [11*W + l] = q [2*W + l];
+	  }
+	  break;
+	case KinematicTree::ANCHOR:
+	  for (std::size_t e = 0; e < 12; ++e) {
+	    for (std::size_t l = 0; l < W; ++l) {
+	      out [e*W + l] = s [e];
+	    }
+	  }
+	  break;
+	}
+      }
+
+      /// \brief Gather W configurations into interleaved lanes
+      /// \param configs first configuration of the block,
+      /// \param nbConfigs number of valid configurations (<= W). Remaining
+      /// lanes are filled with the last valid configuration,
+      /// \param numberDof size of a configuration,
+      /// \retval out numberDof * W doubles.
+      template <std::size_t W>
+      inline void gatherConfigurations (const double* configs,
+					std::size_t nbConfigs,
+					std::size_t numberDof, double* out)
+      {
+	for (std::size_t l = 0; l < W; ++l) {
+	  const std::size_t k = l < nbConfigs ? l : nbConfigs - 1;
+	  const double* config = configs + k * numberDof;
+	  for (std::size_t i = 0; i < numberDof; ++i) {
+	    out [i*W + l] = config [i];
+	  }
+	}
+      }
+
+      /// \brief Compute the position of every joint for W configurations
+      /// \param tree kinematic tree,
+      /// \param q interleaved configurations (see gatherConfigurations),
+      /// \retval transforms 12 * W * tree.nbJoints () doubles.
+      template <std::size_t W>
+      inline void forwardKinematics (const KinematicTree& tree,
+				     const double* q, double* transforms)
+      {
+	double local [12*W];
+	for (std::size_t j = 0; j < tree.nbJoints (); ++j) {
+	  const std::size_t rank = tree.rankInConfiguration (j);
+	  const std::size_t parent = tree.parent (j);
+	  double* out = transforms + 12*W*j;
+	  if (parent == SIZE_MAX) {
+	    jointLocalTransform<W> (tree.jointType (j),
+				    tree.staticTransform (j), q + rank*W, out);
+	  } else if (tree.jointType (j) == KinematicTree::ANCHOR) {
+	    composeStatic<W> (transforms + 12*W*parent,
+			      tree.staticTransform (j), out);
+	  } else {
+	    jointLocalTransform<W> (tree.jointType (j),
+				    tree.staticTransform (j), q + rank*W,
+				    local);
+	    compose<W> (transforms + 12*W*parent, local, out);
+	  }
+	}
+      }
+
+      /// \brief Accumulate the mass-weighted centers of mass of the bodies
+      /// \param tree kinematic tree,
+      /// \param transforms positions of the joints (see forwardKinematics),
+      /// \retval out sum of m_j * c_j in the global frame, 3 * W doubles.
+      template <std::size_t W>
+      inline void firstMomentOfMass (const KinematicTree& tree,
+				     const double* transforms, double* out)
+      {
+	for (std::size_t i = 0; i < 3*W; ++i) {
+	  out [i] = 0;
+	}
+	for (std::size_t j = 0; j < tree.nbJoints (); ++j) {
+	  const double mass = tree.mass (j);
+	  if (mass == 0) continue;
+	  const double* c = tree.localCenterOfMass (j);
+	  const double* m = transforms + 12*W*j;
+	  for (std::size_t i = 0; i < 3; ++i) {
+	    const double* mi = m + 4*i*W;
+	    for (std::size_t l = 0; l < W; ++l) {
+	      out [i*W + l] += mass * (mi [l] * c [0] + mi [W + l] * c [1]
+				       + mi [2*W + l] * c [2] + mi [3*W + l]);
+	    }
+	  }
+	}
+      }
+
+      /// \brief Extract the matrices of one lane
+      /// \param transforms interleaved matrices of nbJoints joints,
+      /// \param lane index of the lane,
+      /// \retval out nbJoints row-major 3x4 matrices.
+      template <std::size_t W>
+      inline void scatterTransforms (const double* transforms,
+				     std::size_t nbJoints, std::size_t lane,
+				     double* out)
+      {
+	for (std::size_t i = 0; i < 12*nbJoints; ++i) {
+	  out [i] = transforms [i*W + lane];
+	}
+      }
+    } // namespace kernel
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_SRC_KINEMATIC_KERNELS_HH
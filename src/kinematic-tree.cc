@@ -0,0 +1,459 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <jrl/mal/matrixabstractlayer.hh>
+#include <abstract-robot-dynamics/body.hh>
+#include <abstract-robot-dynamics/joint.hh>
+#include <hpp/util/debug.hh>
+
+#include "hpp/model/exception.hh"
+#include "hpp/model/freeflyer-joint.hh"
+#include "hpp/model/joint.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/rotation-joint.hh"
+#include "hpp/model/statistics.hh"
+#include "hpp/model/translation-joint.hh"
+
+#include "kinematic-kernels.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Inverse of a rigid transformation stored as row-major 3x4 matrix.
+      void invert (const double* m, double* out)
+      {
+	for (std::size_t i = 0; i < 3; ++i) {
+	  for (std::size_t j = 0; j < 3; ++j) {
+	    out [4*i + j] = m [4*j + i];
+	  }
+	}
+	for (std::size_t i = 0; i < 3; ++i) {
+	  out [4*i + 3] = -(out [4*i] * m [3] + out [4*i + 1] * m [7]
+			    + out [4*i + 2] * m [11]);
+	}
+      }
+    } // namespace
+
+    const std::size_t KinematicTree::BLOCK_SIZE;
+
+    // ======================================================================
+
+    KinematicTree::KinematicTree ()
+      : numberDof_ (0),
+	parent_ (),
+	jointType_ (),
+	rankInConfiguration_ (),
+	jointName_ (),
+	joint_ (),
+	jointIndex_ (),
+	staticTransform_ (),
+	supportDofs_ (),
+	jointOfDof_ (),
+	lowerBound_ (),
+	upperBound_ (),
+	lowerTorqueBound_ (),
+	upperTorqueBound_ (),
+	mass_ (),
+	localCenterOfMass_ (),
+	inertia_ (),
+	totalMass_ (0)
+    {
+    }
+
+    // ======================================================================
+
+    KinematicTreeShPtr KinematicTree::create (const JointShPtr& rootJoint,
+					      std::size_t numberDof)
+    {
+      if (!rootJoint) {
+	throw Exception ("Cannot build kinematic tree without root joint.");
+      }
+      KinematicTree* ptr = new KinematicTree ();
+      KinematicTreeShPtr shPtr (ptr);
+      ptr->numberDof_ = numberDof;
+      ptr->jointOfDof_.assign (numberDof, SIZE_MAX);
+      ptr->lowerBound_.assign (numberDof, 0);
+      ptr->upperBound_.assign (numberDof, 0);
+      ptr->lowerTorqueBound_.assign (numberDof, 0);
+      ptr->upperTorqueBound_.assign (numberDof, 0);
+      const double identity [12] = {1, 0, 0, 0,
+				    0, 1, 0, 0,
+				    0, 0, 1, 0};
+      ptr->addJoint (rootJoint, SIZE_MAX, identity);
+      hppDout (info, "Kinematic tree with " << ptr->nbJoints ()
+	       << " joints and " << numberDof << " dofs.");
+      return shPtr;
+    }
+
+    // ======================================================================
+
+    void KinematicTree::addJoint (const JointShPtr& joint, std::size_t parent,
+				  const double* parentInitialPosition)
+    {
+      const CjrlJoint* jrlJoint = joint->jrlJoint ();
+      if (!jrlJoint) {
+	std::ostringstream oss;
+	oss << "Joint " << joint->kppJoint ()->name ()
+	    << " has no dynamic part.";
+	throw Exception (oss.str ());
+      }
+      const std::size_t jointId = parent_.size ();
+      EjointType type;
+      if (KIT_DYNAMIC_PTR_CAST (FreeflyerJoint, joint)) {
+	type = FREEFLYER;
+      } else if (KIT_DYNAMIC_PTR_CAST (RotationJoint, joint)) {
+	type = ROTATION;
+      } else if (KIT_DYNAMIC_PTR_CAST (TranslationJoint, joint)) {
+	type = TRANSLATION;
+      } else if (jrlJoint->numberDof () == 0) {
+	type = ANCHOR;
+      } else {
+	throw Exception ("unknow joint type");
+      }
+      parent_.push_back (parent);
+      jointType_.push_back (type);
+      rankInConfiguration_.push_back
+	(type == ANCHOR ? 0 : jrlJoint->rankInConfiguration ());
+      jointName_.push_back (joint->kppJoint ()->name ());
+      joint_.push_back (joint);
+      jointIndex_ [jrlJoint] = jointId;
+
+      // Degrees of freedom moving the joint
+      std::vector<std::size_t> support;
+      if (parent != SIZE_MAX) {
+	support = supportDofs_ [parent];
+      }
+      for (std::size_t i = 0; i < jointDof (jointId); ++i) {
+	const std::size_t dof = rankInConfiguration_ [jointId] + i;
+	if (dof >= numberDof_) {
+	  throw Exception ("rank in configuration is more than configuration");
+	}
+	support.push_back (dof);
+	jointOfDof_ [dof] = jointId;
+	lowerBound_ [dof] = jrlJoint->lowerBound (i);
+	upperBound_ [dof] = jrlJoint->upperBound (i);
+	lowerTorqueBound_ [dof] = jrlJoint->lowerTorqueBound (i);
+	upperTorqueBound_ [dof] = jrlJoint->upperTorqueBound (i);
+      }
+      std::sort (support.begin (), support.end ());
+      supportDofs_.push_back (support);
+
+      // Inertial parameters
+      const CjrlBody* body = jrlJoint->linkedBody ();
+      if (body) {
+	const vector3d& com = body->localCenterOfMass ();
+	const matrix3d& inertia = body->inertiaMatrix ();
+	mass_.push_back (body->mass ());
+	localCenterOfMass_.push_back (com [0]);
+	localCenterOfMass_.push_back (com [1]);
+	localCenterOfMass_.push_back (com [2]);
+	inertia_.push_back (inertia (0, 0));
+	inertia_.push_back (inertia (1, 1));
+	inertia_.push_back (inertia (2, 2));
+	inertia_.push_back (inertia (0, 1));
+	inertia_.push_back (inertia (0, 2));
+	inertia_.push_back (inertia (1, 2));
+	totalMass_ += body->mass ();
+      } else {
+	mass_.push_back (0);
+	localCenterOfMass_.resize (localCenterOfMass_.size () + 3, 0.);
+	inertia_.resize (inertia_.size () + 6, 0.);
+      }
+
+      // Static transformation: position of the joint at initial
+      // configuration expressed in the parent frame at initial
+      // configuration.
+      const matrix4d& initialPosition = jrlJoint->initialPosition ();
+      double position [12];
+      for (std::size_t i = 0; i < 3; ++i) {
+	for (std::size_t j = 0; j < 4; ++j) {
+	  position [4*i + j] =
+	    MAL_S4x4_MATRIX_ACCESS_I_J (initialPosition, i, j);
+	}
+      }
+      double parentInverse [12];
+      invert (parentInitialPosition, parentInverse);
+      staticTransform_.resize (staticTransform_.size () + 12);
+      kernel::composeStatic<1> (parentInverse, position,
+				&staticTransform_ [12*jointId]);
+
+      for (unsigned int iChild = 0; iChild < joint->countChildJoints ();
+	   ++iChild) {
+	addJoint (joint->childJoint (iChild), jointId, position);
+      }
+    }
+
+    // ======================================================================
+
+    std::size_t KinematicTree::jointDof (std::size_t jointId) const
+    {
+      switch (jointType_ [jointId]) {
+      case FREEFLYER:
+	return 6;
+      case ROTATION:
+      case TRANSLATION:
+	return 1;
+      default:
+	return 0;
+      }
+    }
+
+    // ======================================================================
+
+    std::size_t KinematicTree::jointIndex (const CjrlJoint* joint) const
+    {
+      std::map<const CjrlJoint*, std::size_t>::const_iterator it =
+	jointIndex_.find (joint);
+      if (it == jointIndex_.end ()) {
+	return SIZE_MAX;
+      }
+      return it->second;
+    }
+
+    // ======================================================================
+
+    JointShPtr KinematicTree::joint (std::size_t jointId) const
+    {
+      return joint_ [jointId].lock ();
+    }
+
+    // ======================================================================
+
+    void KinematicTree::forwardKinematics (const double* config,
+					   double* outTransforms) const
+    {
+      Statistics::Scope statistics (Statistics::FORWARD_KINEMATICS);
+      kernel::forwardKinematics<1> (*this, config, outTransforms);
+    }
+
+    // ======================================================================
+
+    void KinematicTree::forwardKinematics (const double* configs,
+					   std::size_t nbConfigs,
+					   double* outTransforms) const
+    {
+      Statistics::Scope statistics (Statistics::FORWARD_KINEMATICS_BATCH);
+      const std::size_t W = BLOCK_SIZE;
+      const std::size_t n = nbJoints ();
+      std::vector<double> q (W * std::max (numberDof_, std::size_t (1)));
+      std::vector<double> transforms (12 * W * n);
+
+      for (std::size_t k = 0; k < nbConfigs; k += W) {
+	const std::size_t nbLanes = std::min (W, nbConfigs - k);
+	kernel::gatherConfigurations<W> (configs + k * numberDof_, nbLanes,
+					 numberDof_, &q [0]);
+	kernel::forwardKinematics<W> (*this, &q [0], &transforms [0]);
+	for (std::size_t l = 0; l < nbLanes; ++l) {
+	  kernel::scatterTransforms<W> (&transforms [0], n, l,
+					outTransforms + (k + l) * 12 * n);
+	}
+      }
+    }
+
+    // ======================================================================
+
+    void KinematicTree::centerOfMass (const double* config, double* outCom)
+      const
+    {
+      std::vector<double> transforms (12 * nbJoints ());
+      kernel::forwardKinematics<1> (*this, config, &transforms [0]);
+      kernel::firstMomentOfMass<1> (*this, &transforms [0], outCom);
+      const double scale = totalMass_ > 0 ? 1. / totalMass_ : 0.;
+      for (std::size_t i = 0; i < 3; ++i) {
+	outCom [i] *= scale;
+      }
+    }
+
+    // ======================================================================
+
+    void KinematicTree::centerOfMass (const double* configs,
+				      std::size_t nbConfigs,
+				      double* outComs) const
+    {
+      const std::size_t W = BLOCK_SIZE;
+      std::vector<double> q (W * std::max (numberDof_, std::size_t (1)));
+      std::vector<double> transforms (12 * W * nbJoints ());
+      double moment [3*W];
+      const double scale = totalMass_ > 0 ? 1. / totalMass_ : 0.;
+
+      for (std::size_t k = 0; k < nbConfigs; k += W) {
+	const std::size_t nbLanes = std::min (W, nbConfigs - k);
+	kernel::gatherConfigurations<W> (configs + k * numberDof_, nbLanes,
+					 numberDof_, &q [0]);
+	kernel::forwardKinematics<W> (*this, &q [0], &transforms [0]);
+	kernel::firstMomentOfMass<W> (*this, &transforms [0], moment);
+	for (std::size_t l = 0; l < nbLanes; ++l) {
+	  for (std::size_t i = 0; i < 3; ++i) {
+	    outComs [3*(k + l) + i] = scale * moment [i*W + l];
+	  }
+	}
+      }
+    }
+
+    // ======================================================================
+
+    void KinematicTree::motionAxes (const double* config,
+				    const double* transforms,
+				    double* outAxis, double* outPoint,
+				    std::vector<bool>& outPrismatic) const
+    {
+      const double identity [12] = {1, 0, 0, 0,
+				    0, 1, 0, 0,
+				    0, 0, 1, 0};
+      outPrismatic.assign (numberDof_, false);
+      for (std::size_t j = 0; j < nbJoints (); ++j) {
+	const std::size_t nbDof = jointDof (j);
+	if (nbDof == 0) continue;
+	const std::size_t rank = rankInConfiguration_ [j];
+	const double* m = transforms + 12*j;
+	for (std::size_t i = 0; i < nbDof; ++i) {
+	  for (std::size_t c = 0; c < 3; ++c) {
+	    outPoint [3*(rank + i) + c] = m [4*c + 3];
+	  }
+	}
+	if (jointType_ [j] == FREEFLYER) {
+	  const double* p = parent_ [j] == SIZE_MAX ?
+	    identity : transforms + 12*parent_ [j];
+	  const double cy = cos (config [rank + 5]);
+	  const double sy = sin (config [rank + 5]);
+	  for (std::size_t c = 0; c < 3; ++c) {
+	    // Translations along the axes of the parent frame
+	    outAxis [3*rank + c] = p [4*c];
+	    outAxis [3*(rank + 1) + c] = p [4*c + 1];
+	    outAxis [3*(rank + 2) + c] = p [4*c + 2];
+	    // Roll about x-axis of the joint frame
+	    outAxis [3*(rank + 3) + c] = m [4*c];
+	    // Pitch about Rz(yaw) y-axis of the parent frame
+	    outAxis [3*(rank + 4) + c] = -sy * p [4*c] + cy * p [4*c + 1];
+	    // Yaw about z-axis of the parent frame
+	    outAxis [3*(rank + 5) + c] = p [4*c + 2];
+	  }
+	  outPrismatic [rank] = true;
+	  outPrismatic [rank + 1] = true;
+	  outPrismatic [rank + 2] = true;
+	} else {
+	  for (std::size_t c = 0; c < 3; ++c) {
+	    outAxis [3*rank + c] = m [4*c];
+	  }
+	  outPrismatic [rank] = (jointType_ [j] == TRANSLATION);
+	}
+      }
+    }
+
+    // ======================================================================
+
+    void KinematicTree::computeJacobians
+    (const double* config, std::vector<SparseJacobian>& outJointJacobians,
+     SparseJacobian& outComJacobian) const
+    {
+      const std::size_t n = nbJoints ();
+      std::vector<double> transforms (12*n);
+      forwardKinematics (config, &transforms [0]);
+
+      std::vector<double> axis (3*numberDof_ + 3);
+      std::vector<double> point (3*numberDof_ + 3);
+      std::vector<bool> prismatic;
+      motionAxes (config, &transforms [0], &axis [0], &point [0], prismatic);
+
+      // Joint Jacobians
+      outJointJacobians.resize (n);
+      for (std::size_t j = 0; j < n; ++j) {
+	SparseJacobian& jacobian = outJointJacobians [j];
+	const std::vector<std::size_t>& support = supportDofs_ [j];
+	jacobian.resize (6, numberDof_, support);
+	const double* m = &transforms [12*j];
+	const double origin [3] = {m [3], m [7], m [11]};
+	for (std::size_t i = 0; i < support.size (); ++i) {
+	  const std::size_t dof = support [i];
+	  const double* a = &axis [3*dof];
+	  double* column = jacobian.column (i);
+	  if (prismatic [dof]) {
+	    column [0] = a [0]; column [1] = a [1]; column [2] = a [2];
+	  } else {
+	    const double* p = &point [3*dof];
+	    const double r [3] = {origin [0] - p [0], origin [1] - p [1],
+				  origin [2] - p [2]};
+	    column [0] = a [1] * r [2] - a [2] * r [1];
+	    column [1] = a [2] * r [0] - a [0] * r [2];
+	    column [2] = a [0] * r [1] - a [1] * r [0];
+	    column [3] = a [0]; column [4] = a [1]; column [5] = a [2];
+	  }
+	}
+      }
+
+      // Backward pass: mass and first moment of mass of each subtree.
+      std::vector<double> subtreeMass (n, 0.);
+      std::vector<double> subtreeMoment (3*n, 0.);
+      for (std::size_t j = n; j-- > 0;) {
+	const double* m = &transforms [12*j];
+	const double* c = &localCenterOfMass_ [3*j];
+	subtreeMass [j] += mass_ [j];
+	for (std::size_t i = 0; i < 3; ++i) {
+	  subtreeMoment [3*j + i] += mass_ [j] *
+	    (m [4*i] * c [0] + m [4*i + 1] * c [1] + m [4*i + 2] * c [2]
+	     + m [4*i + 3]);
+	}
+	if (parent_ [j] != SIZE_MAX) {
+	  subtreeMass [parent_ [j]] += subtreeMass [j];
+	  for (std::size_t i = 0; i < 3; ++i) {
+	    subtreeMoment [3*parent_ [j] + i] += subtreeMoment [3*j + i];
+	  }
+	}
+      }
+
+      // Center of mass Jacobian
+      std::vector<std::size_t> columns;
+      if (totalMass_ > 0) {
+	for (std::size_t dof = 0; dof < numberDof_; ++dof) {
+	  if (jointOfDof_ [dof] != SIZE_MAX &&
+	      subtreeMass [jointOfDof_ [dof]] > 0) {
+	    columns.push_back (dof);
+	  }
+	}
+      }
+      outComJacobian.resize (3, numberDof_, columns);
+      for (std::size_t i = 0; i < columns.size (); ++i) {
+	const std::size_t dof = columns [i];
+	const std::size_t j = jointOfDof_ [dof];
+	const double* a = &axis [3*dof];
+	const double ratio = subtreeMass [j] / totalMass_;
+	double* column = outComJacobian.column (i);
+	if (prismatic [dof]) {
+	  column [0] = ratio * a [0];
+	  column [1] = ratio * a [1];
+	  column [2] = ratio * a [2];
+	} else {
+	  const double* p = &point [3*dof];
+	  const double* moment = &subtreeMoment [3*j];
+	  const double r [3] =
+	    {(moment [0] - subtreeMass [j] * p [0]) / totalMass_,
+	     (moment [1] - subtreeMass [j] * p [1]) / totalMass_,
+	     (moment [2] - subtreeMass [j] * p [2]) / totalMass_};
+	  column [0] = a [1] * r [2] - a [2] * r [1];
+	  column [1] = a [2] * r [0] - a [0] * r [2];
+	  column [2] = a [0] * r [1] - a [1] * r [0];
+	}
+      }
+    }
+  } // namespace model
+} // namespace hpp
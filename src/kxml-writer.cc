@@ -0,0 +1,225 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <fstream>
+
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "hpp/model/exception.hh"
+#include "hpp/model/kxml-writer.hh"
+#include "hpp/model/trace.hh"
+
+#include "mapped-file.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      void writeEscaped (std::ostream& os, const char* begin,
+			 const char* end)
+      {
+	const char* chunk = begin;
+	for (const char* it = begin; it != end; ++it) {
+	  const char* entity = 0;
+	  switch (*it) {
+	  case '&': entity = "&amp;"; break;
+	  case '<': entity = "&lt;"; break;
+	  case '>': entity = "&gt;"; break;
+	  case '"': entity = "&quot;"; break;
+	  default: continue;
+	  }
+	  os.write (chunk, it - chunk);
+	  os << entity;
+	  chunk = it + 1;
+	}
+	os.write (chunk, end - chunk);
+      }
+
+      void writeEscaped (std::ostream& os, const std::string& s)
+      {
+	writeEscaped (os, s.data (), s.data () + s.size ());
+      }
+    } // namespace
+
+    const std::size_t KxmlWriter::CHUNK_SIZE;
+
+    // ======================================================================
+
+    KxmlWriter::KxmlWriter (std::ostream& stream)
+      : stream_ (stream), writer_ (CkprXMLWriter::create ())
+    {
+      if (!writer_) {
+	throw Exception ("Failed to create XML writer.");
+      }
+    }
+
+    // ======================================================================
+
+    void KxmlWriter::write (const CkppComponentConstShPtr& component)
+    {
+      Trace::Span span ("kxml-writer", "write", "component",
+			component->name ());
+      stream_ << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+      writeComponent (component, 0);
+      stream_.flush ();
+      if (!stream_) {
+	throw Exception ("Failed to write component " + component->name ()
+			 + ".");
+      }
+    }
+
+    // ======================================================================
+
+    void KxmlWriter::writeToFile (const std::string& filename,
+				  const CkppComponentConstShPtr& component,
+				  Ecompression compression)
+    {
+      const std::string tmp = temporaryFilename (filename);
+      {
+	std::ofstream file (tmp.c_str (), std::ios::binary | std::ios::trunc);
+	if (!file) {
+	  throw Exception ("Cannot write " + tmp + ".");
+	}
+	boost::iostreams::filtering_ostream stream;
+	if (compression == GZIP) {
+	  stream.push (boost::iostreams::gzip_compressor ());
+	}
+	stream.push (file);
+	try {
+	  KxmlWriter writer (stream);
+	  writer.write (component);
+	} catch (...) {
+	  stream.reset ();
+	  file.close ();
+	  unlink (tmp.c_str ());
+	  throw;
+	}
+	// Flush compressor before checking the file.
+	stream.reset ();
+	file.close ();
+	if (!file) {
+	  unlink (tmp.c_str ());
+	  throw Exception ("Failed to write " + tmp + ".");
+	}
+      }
+      commitTemporaryFile (tmp, filename);
+    }
+
+    // ======================================================================
+
+    void KxmlWriter::indent (std::size_t depth)
+    {
+      for (std::size_t i = 0; i < depth; ++i) stream_ << "  ";
+    }
+
+    // ======================================================================
+
+    void KxmlWriter::writeComponent (const CkppComponentConstShPtr& component,
+				     std::size_t depth)
+    {
+      // Tag of the component alone, built by the writer methods
+      // registered for its type. It is released before child components
+      // are written.
+      const unsigned int nbChildComponents =
+	component->countChildComponents ();
+      std::string name;
+      bool hasChildren;
+      {
+	CkprXMLTagShPtr tag;
+	if (writer_->writeComponentTag (component, tag) != KD_OK || !tag) {
+	  throw Exception ("Failed to write component " + component->name ()
+			   + ".");
+	}
+	name = tag->name ();
+	const bool empty = tag->countChildTags () == 0 &&
+	  tag->text ().empty () && nbChildComponents == 0;
+	writeStartTag (tag, depth, empty);
+	if (empty) return;
+	writeText (tag->text ());
+	hasChildren = tag->countChildTags () != 0 || nbChildComponents != 0;
+	if (hasChildren) stream_ << "\n";
+	for (unsigned int i = 0; i < tag->countChildTags (); ++i) {
+	  writeTag (tag->childTag (i), depth + 1);
+	}
+      }
+      for (unsigned int i = 0; i < nbChildComponents; ++i) {
+	writeComponent (component->childComponent (i), depth + 1);
+      }
+      if (hasChildren) indent (depth);
+      stream_ << "</" << name << ">\n";
+      if (!stream_) {
+	throw Exception ("Failed to write component " + component->name ()
+			 + ".");
+      }
+    }
+
+    // ======================================================================
+
+    void KxmlWriter::writeStartTag (const CkprXMLTagConstShPtr& tag,
+				    std::size_t depth, bool empty)
+    {
+      indent (depth);
+      stream_ << "<" << tag->name ();
+      for (unsigned int i = 0; i < tag->countAttributes (); ++i) {
+	const std::string attribute = tag->attributeName (i);
+	std::string value;
+	tag->getAttribute (attribute, value);
+	stream_ << " " << attribute << "=\"";
+	writeEscaped (stream_, value);
+	stream_ << "\"";
+      }
+      stream_ << (empty ? "/>\n" : ">");
+    }
+
+    // ======================================================================
+
+    void KxmlWriter::writeTag (const CkprXMLTagConstShPtr& tag,
+			       std::size_t depth)
+    {
+      const bool empty = tag->countChildTags () == 0 && tag->text ().empty ();
+      writeStartTag (tag, depth, empty);
+      if (empty) return;
+      writeText (tag->text ());
+      if (tag->countChildTags () != 0) {
+	stream_ << "\n";
+	for (unsigned int i = 0; i < tag->countChildTags (); ++i) {
+	  writeTag (tag->childTag (i), depth + 1);
+	}
+	indent (depth);
+      }
+      stream_ << "</" << tag->name () << ">\n";
+    }
+
+    // ======================================================================
+
+    void KxmlWriter::writeText (const std::string& text)
+    {
+      // Vertices and triangles of polyhedra are the text content of
+      // their tags: write them by chunks so that no copy of the whole
+      // content is made.
+      const char* data = text.data ();
+      for (std::size_t offset = 0; offset < text.size ();
+	   offset += CHUNK_SIZE) {
+	const std::size_t size = std::min (CHUNK_SIZE, text.size () - offset);
+	writeEscaped (stream_, data + offset, data + offset + size);
+      }
+    }
+  } // namespace model
+} // namespace hpp
@@ -0,0 +1,104 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_MAPPED_FILE_HH
+# define HPP_MODEL_MAPPED_FILE_HH
+
+# include <fcntl.h>
+# include <stdio.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+
+# include <sstream>
+# include <string>
+
+# include <boost/noncopyable.hpp>
+
+# include "hpp/model/exception.hh"
+
+namespace hpp {
+  namespace model {
+    /// Read-only memory mapping of a whole file, shared with the other
+    /// processes mapping the same file.
+    class MappedFile : private boost::noncopyable
+    {
+    public:
+      MappedFile () : data_ (0), size_ (0)
+      {
+      }
+
+      ~MappedFile ()
+      {
+	if (data_) {
+	  munmap (const_cast<char*> (data_), size_);
+	}
+      }
+
+      /// Map a file, return false if it does not exist or is empty.
+      bool open (const std::string& filename)
+      {
+	const int fd = ::open (filename.c_str (), O_RDONLY);
+	if (fd < 0) {
+	  return false;
+	}
+	struct stat st;
+	if (fstat (fd, &st) != 0 || st.st_size == 0) {
+	  close (fd);
+	  return false;
+	}
+	void* map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED) {
+	  return false;
+	}
+	data_ = static_cast<const char*> (map);
+	size_ = st.st_size;
+	return true;
+      }
+
+      const char* data () const { return data_; }
+      std::size_t size () const { return size_; }
+
+    private:
+      const char* data_;
+      std::size_t size_;
+    }; // class MappedFile
+
+    /// Temporary file renamed over the destination when complete, so that
+    /// processes mapping the destination never see a partial file.
+    inline std::string temporaryFilename (const std::string& filename)
+    {
+      std::ostringstream oss;
+      oss << filename << ".tmp." << getpid ();
+      return oss.str ();
+    }
+
+    inline void commitTemporaryFile (const std::string& tmp,
+				     const std::string& filename)
+    {
+      if (rename (tmp.c_str (), filename.c_str ()) != 0) {
+	unlink (tmp.c_str ());
+	throw Exception ("Failed to rename " + tmp + ".");
+      }
+    }
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_MAPPED_FILE_HH
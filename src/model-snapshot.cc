@@ -0,0 +1,541 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <KineoModel/kppJointComponent.h>
+#include <KineoModel/kppSolidComponent.h>
+#include <KineoModel/kppSolidComponentRef.h>
+
+#include <hpp/util/debug.hh>
+
+#include "hpp/model/body-distance.hh"
+#include "hpp/model/exception.hh"
+#include "hpp/model/humanoid-robot.hh"
+#include "hpp/model/joint.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/model-snapshot.hh"
+
+#include "mapped-file.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Layout of a snapshot file. Sections follow each other in the
+      // order below and all records are made of 8 byte fields, so that
+      // every section is aligned in the mapped file.
+      //
+      //   Header
+      //   JointRecord  x nbJoints
+      //   DofRecord    x numberDof
+      //   StringRef    x nbGeometries
+      //   DistanceRecord x nbBodyDistances
+      //   char         x stringsSize
+      const char magic [8] = {'H', 'P', 'P', 'M', 'S', 'N', 'A', 'P'};
+      const uint32_t byteOrderMark = 0x01020304;
+      const uint64_t noParent = ~uint64_t (0);
+
+      struct Header
+      {
+	char magic [8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t sourceHash;
+	uint64_t numberDof;
+	uint64_t nbJoints;
+	uint64_t nbGeometries;
+	uint64_t nbBodyDistances;
+	uint64_t stringsSize;
+      };
+
+      struct StringRef
+      {
+	uint64_t offset;
+	uint64_t length;
+      };
+
+      struct JointRecord
+      {
+	uint64_t parent;
+	uint64_t type;
+	uint64_t rank;
+	uint64_t roles;
+	StringRef name;
+	uint64_t firstGeometry;
+	uint64_t nbGeometries;
+	double staticTransform [12];
+	double mass;
+	double localCenterOfMass [3];
+	double inertia [6];
+      };
+
+      struct DofRecord
+      {
+	double lowerBound;
+	double upperBound;
+	double lowerTorqueBound;
+	double upperTorqueBound;
+      };
+
+      struct DistanceRecord
+      {
+	StringRef name;
+	uint64_t nbDistPairs;
+      };
+
+      // Append a string to the string table
+      StringRef addString (std::string& strings, const std::string& s)
+      {
+	StringRef ref;
+	ref.offset = strings.size ();
+	ref.length = s.size ();
+	strings += s;
+	return ref;
+      }
+
+      template <typename T> void append (std::ofstream& file,
+					 const std::vector<T>& records)
+      {
+	if (!records.empty ()) {
+	  file.write (reinterpret_cast<const char*> (&records [0]),
+		      records.size () * sizeof (T));
+	}
+      }
+
+      const Header& header (const char* data)
+      {
+	return *reinterpret_cast<const Header*> (data);
+      }
+
+      const JointRecord* jointRecords (const char* data)
+      {
+	return reinterpret_cast<const JointRecord*> (data + sizeof (Header));
+      }
+
+      const DofRecord* dofRecords (const char* data)
+      {
+	return reinterpret_cast<const DofRecord*>
+	  (jointRecords (data) + header (data).nbJoints);
+      }
+
+      const StringRef* geometryRecords (const char* data)
+      {
+	return reinterpret_cast<const StringRef*>
+	  (dofRecords (data) + header (data).numberDof);
+      }
+
+      const DistanceRecord* distanceRecords (const char* data)
+      {
+	return reinterpret_cast<const DistanceRecord*>
+	  (geometryRecords (data) + header (data).nbGeometries);
+      }
+
+      const char* strings (const char* data)
+      {
+	return reinterpret_cast<const char*>
+	  (distanceRecords (data) + header (data).nbBodyDistances);
+      }
+
+      // Size of a file described by a header, 0 if the header is
+      // inconsistent.
+      std::size_t expectedSize (const Header& h)
+      {
+	const uint64_t limit = uint64_t (1) << 40;
+	if (h.nbJoints > limit || h.numberDof > limit ||
+	    h.nbGeometries > limit || h.nbBodyDistances > limit ||
+	    h.stringsSize > limit) {
+	  return 0;
+	}
+	return sizeof (Header) + h.nbJoints * sizeof (JointRecord)
+	  + h.numberDof * sizeof (DofRecord)
+	  + h.nbGeometries * sizeof (StringRef)
+	  + h.nbBodyDistances * sizeof (DistanceRecord) + h.stringsSize;
+      }
+
+      bool isValid (const StringRef& ref, const Header& h)
+      {
+	return ref.offset <= h.stringsSize &&
+	  ref.length <= h.stringsSize - ref.offset;
+      }
+    } // namespace
+
+    const uint32_t ModelSnapshot::VERSION;
+
+    // ======================================================================
+
+    ModelSnapshot::ModelSnapshot ()
+      : file_ (new MappedFile ()), data_ (0), kinematicTree_ ()
+    {
+    }
+
+    // ======================================================================
+
+    ModelSnapshot::~ModelSnapshot ()
+    {
+    }
+
+    // ======================================================================
+
+    uint64_t ModelSnapshot::sourceHash (const std::string& filename)
+    {
+      std::ifstream file (filename.c_str (), std::ios::binary);
+      if (!file) {
+	throw Exception ("Cannot read " + filename + ".");
+      }
+      uint64_t hash = 14695981039346656037ULL;
+      char buffer [65536];
+      while (file) {
+	file.read (buffer, sizeof (buffer));
+	const std::streamsize n = file.gcount ();
+	for (std::streamsize i = 0; i < n; ++i) {
+	  hash ^= static_cast<unsigned char> (buffer [i]);
+	  hash *= 1099511628211ULL;
+	}
+      }
+      return hash;
+    }
+
+    // ======================================================================
+
+    void ModelSnapshot::write (const std::string& filename,
+			       const HumanoidRobot& robot, uint64_t sourceHash)
+    {
+      const KinematicTreeConstShPtr& tree = robot.kinematicTree ();
+      if (!tree) {
+	throw Exception ("Cannot write snapshot of uninitialized robot.");
+      }
+      const std::size_t n = tree->nbJoints ();
+      std::string stringTable;
+      std::vector<JointRecord> joints (n);
+      std::vector<DofRecord> dofs (tree->numberDof ());
+      std::vector<StringRef> geometries;
+      std::vector<DistanceRecord> distances;
+
+      const CjrlJoint* roleJoint [] =
+	{robot.gazeJoint (), robot.leftAnkle (), robot.rightAnkle (),
+	 robot.leftWrist (), robot.rightWrist (), robot.waist (),
+	 robot.chest ()};
+      const unsigned int role [] =
+	{HumanoidRobot::ROLE_GAZE, HumanoidRobot::ROLE_LEFT_ANKLE,
+	 HumanoidRobot::ROLE_RIGHT_ANKLE, HumanoidRobot::ROLE_LEFT_WRIST,
+	 HumanoidRobot::ROLE_RIGHT_WRIST, HumanoidRobot::ROLE_WAIST,
+	 HumanoidRobot::ROLE_CHEST};
+
+      for (std::size_t j = 0; j < n; ++j) {
+	JointRecord& record = joints [j];
+	memset (&record, 0, sizeof (JointRecord));
+	record.parent = tree->parent (j) == SIZE_MAX ?
+	  noParent : tree->parent (j);
+	record.type = tree->jointType (j);
+	record.rank = tree->rankInConfiguration (j);
+	record.name = addString (stringTable, tree->jointName (j));
+	std::copy (tree->staticTransform (j), tree->staticTransform (j) + 12,
+		   record.staticTransform);
+	record.mass = tree->mass (j);
+	std::copy (tree->localCenterOfMass (j),
+		   tree->localCenterOfMass (j) + 3, record.localCenterOfMass);
+	std::copy (tree->inertia (j), tree->inertia (j) + 6, record.inertia);
+
+	JointShPtr joint = tree->joint (j);
+	record.firstGeometry = geometries.size ();
+	if (joint) {
+	  const CjrlJoint* jrlJoint = joint->jrlJoint ();
+	  for (std::size_t r = 0; r < sizeof (role) / sizeof (role [0]);
+	       ++r) {
+	    if (roleJoint [r] && roleJoint [r] == jrlJoint) {
+	      record.roles |= role [r];
+	    }
+	  }
+	  std::vector<CkppSolidComponentRefShPtr> solidComps;
+	  joint->kppJoint ()->getSolidComponentRefVector (solidComps);
+	  for (std::size_t s = 0; s < solidComps.size (); ++s) {
+	    CkppSolidComponentShPtr solid =
+	      solidComps [s]->referencedSolidComponent ();
+	    geometries.push_back (addString (stringTable, solid->name ()));
+	  }
+	}
+	record.nbGeometries = geometries.size () - record.firstGeometry;
+      }
+
+      for (std::size_t dof = 0; dof < dofs.size (); ++dof) {
+	dofs [dof].lowerBound = tree->lowerBound (dof);
+	dofs [dof].upperBound = tree->upperBound (dof);
+	dofs [dof].lowerTorqueBound = tree->lowerTorqueBound (dof);
+	dofs [dof].upperTorqueBound = tree->upperTorqueBound (dof);
+      }
+
+      const std::vector<BodyDistanceShPtr>& bodyDistances =
+	robot.bodyDistances ();
+      for (std::size_t i = 0; i < bodyDistances.size (); ++i) {
+	DistanceRecord record;
+	record.name = addString (stringTable, bodyDistances [i]->name ());
+	record.nbDistPairs = bodyDistances [i]->nbDistPairs ();
+	distances.push_back (record);
+      }
+
+      Header h;
+      memset (&h, 0, sizeof (Header));
+      memcpy (h.magic, magic, sizeof (magic));
+      h.version = VERSION;
+      h.byteOrder = byteOrderMark;
+      h.sourceHash = sourceHash;
+      h.numberDof = dofs.size ();
+      h.nbJoints = n;
+      h.nbGeometries = geometries.size ();
+      h.nbBodyDistances = distances.size ();
+      h.stringsSize = stringTable.size ();
+
+      const std::string tmp = temporaryFilename (filename);
+      {
+	std::ofstream file (tmp.c_str (), std::ios::binary | std::ios::trunc);
+	if (!file) {
+	  throw Exception ("Cannot write " + tmp + ".");
+	}
+	file.write (reinterpret_cast<const char*> (&h), sizeof (Header));
+	append (file, joints);
+	append (file, dofs);
+	append (file, geometries);
+	append (file, distances);
+	file.write (stringTable.data (), stringTable.size ());
+	if (!file) {
+	  unlink (tmp.c_str ());
+	  throw Exception ("Failed to write " + tmp + ".");
+	}
+      }
+      commitTemporaryFile (tmp, filename);
+      hppDout (info, "Wrote snapshot " << filename << " with " << n
+	       << " joints.");
+    }
+
+    // ======================================================================
+
+    ModelSnapshotShPtr ModelSnapshot::load (const std::string& filename,
+					    uint64_t sourceHash)
+    {
+      ModelSnapshot* ptr = new ModelSnapshot ();
+      ModelSnapshotShPtr shPtr (ptr);
+      if (!ptr->file_->open (filename) ||
+	  ptr->file_->size () < sizeof (Header)) {
+	return ModelSnapshotShPtr ();
+      }
+      ptr->data_ = ptr->file_->data ();
+      const std::size_t size = ptr->file_->size ();
+
+      const Header& h = header (ptr->data_);
+      if (memcmp (h.magic, magic, sizeof (magic)) != 0 ||
+	  h.version != VERSION || h.byteOrder != byteOrderMark) {
+	hppDout (info, filename << " is not a snapshot of version "
+		 << VERSION << ".");
+	return ModelSnapshotShPtr ();
+      }
+      if (h.sourceHash != sourceHash) {
+	hppDout (info, filename << " was produced from another source.");
+	return ModelSnapshotShPtr ();
+      }
+      if (expectedSize (h) != size) {
+	hppDout (error, filename << " is truncated.");
+	return ModelSnapshotShPtr ();
+      }
+
+      const StringRef* geometries = geometryRecords (ptr->data_);
+      for (std::size_t i = 0; i < h.nbGeometries; ++i) {
+	if (!isValid (geometries [i], h)) {
+	  hppDout (error, filename << " is corrupted.");
+	  return ModelSnapshotShPtr ();
+	}
+      }
+      const DistanceRecord* distances = distanceRecords (ptr->data_);
+      for (std::size_t i = 0; i < h.nbBodyDistances; ++i) {
+	if (!isValid (distances [i].name, h)) {
+	  hppDout (error, filename << " is corrupted.");
+	  return ModelSnapshotShPtr ();
+	}
+      }
+
+      // Rebuild the kinematic tree
+      KinematicTree* tree = new KinematicTree ();
+      KinematicTreeShPtr treeShPtr (tree);
+      const std::size_t n = h.nbJoints;
+      const std::size_t nbDof = h.numberDof;
+      const JointRecord* joints = jointRecords (ptr->data_);
+      const DofRecord* dofs = dofRecords (ptr->data_);
+      tree->numberDof_ = nbDof;
+      tree->joint_.resize (n);
+      tree->jointOfDof_.assign (nbDof, SIZE_MAX);
+      for (std::size_t dof = 0; dof < nbDof; ++dof) {
+	tree->lowerBound_.push_back (dofs [dof].lowerBound);
+	tree->upperBound_.push_back (dofs [dof].upperBound);
+	tree->lowerTorqueBound_.push_back (dofs [dof].lowerTorqueBound);
+	tree->upperTorqueBound_.push_back (dofs [dof].upperTorqueBound);
+      }
+      for (std::size_t j = 0; j < n; ++j) {
+	const JointRecord& record = joints [j];
+	const std::size_t parent =
+	  record.parent == noParent ? SIZE_MAX : record.parent;
+	if ((parent != SIZE_MAX && parent >= j) ||
+	    record.type > KinematicTree::ANCHOR ||
+	    !isValid (record.name, h) ||
+	    record.firstGeometry > h.nbGeometries ||
+	    record.nbGeometries > h.nbGeometries - record.firstGeometry) {
+	  hppDout (error, filename << " is corrupted.");
+	  return ModelSnapshotShPtr ();
+	}
+	tree->parent_.push_back (parent);
+	tree->jointType_.push_back
+	  (static_cast<KinematicTree::EjointType> (record.type));
+	tree->rankInConfiguration_.push_back (record.rank);
+	tree->jointName_.push_back (ptr->stringAt (record.name.offset,
+						 record.name.length));
+	tree->staticTransform_.insert (tree->staticTransform_.end (),
+				       record.staticTransform,
+				       record.staticTransform + 12);
+	tree->mass_.push_back (record.mass);
+	tree->localCenterOfMass_.insert (tree->localCenterOfMass_.end (),
+					 record.localCenterOfMass,
+					 record.localCenterOfMass + 3);
+	tree->inertia_.insert (tree->inertia_.end (), record.inertia,
+			       record.inertia + 6);
+	tree->totalMass_ += record.mass;
+
+	std::vector<std::size_t> support;
+	if (parent != SIZE_MAX) {
+	  support = tree->supportDofs_ [parent];
+	}
+	for (std::size_t i = 0; i < tree->jointDof (j); ++i) {
+	  const std::size_t dof = record.rank + i;
+	  if (dof >= nbDof) {
+	    hppDout (error, filename << " is corrupted.");
+	    return ModelSnapshotShPtr ();
+	  }
+	  support.push_back (dof);
+	  tree->jointOfDof_ [dof] = j;
+	}
+	std::sort (support.begin (), support.end ());
+	tree->supportDofs_.push_back (support);
+      }
+      ptr->kinematicTree_ = treeShPtr;
+      hppDout (info, "Loaded snapshot " << filename << " with " << n
+	       << " joints.");
+      return shPtr;
+    }
+
+    // ======================================================================
+
+    ModelSnapshotShPtr ModelSnapshot::loadOrBuild
+    (const std::string& kxmlFilename, const std::string& snapshotFilename,
+     const Builder_t& builder, HumanoidRobotShPtr& outRobot)
+    {
+      outRobot.reset ();
+      const uint64_t hash = sourceHash (kxmlFilename);
+      ModelSnapshotShPtr snapshot = load (snapshotFilename, hash);
+      if (snapshot) {
+	return snapshot;
+      }
+      hppDout (info, "Rebuilding snapshot " << snapshotFilename
+	       << " from " << kxmlFilename << ".");
+      HumanoidRobotShPtr robot = builder (kxmlFilename);
+      if (!robot) {
+	throw Exception ("Failed to build robot from " + kxmlFilename + ".");
+      }
+      outRobot = robot;
+      write (snapshotFilename, *robot, hash);
+      snapshot = load (snapshotFilename, hash);
+      if (!snapshot) {
+	throw Exception ("Failed to load " + snapshotFilename + ".");
+      }
+      return snapshot;
+    }
+
+    // ======================================================================
+
+    uint64_t ModelSnapshot::hash () const
+    {
+      return header (data_).sourceHash;
+    }
+
+    // ======================================================================
+
+    unsigned int ModelSnapshot::jointRoles (std::size_t jointId) const
+    {
+      return jointRecords (data_) [jointId].roles;
+    }
+
+    // ======================================================================
+
+    std::size_t ModelSnapshot::jointWithRole (unsigned int role) const
+    {
+      const JointRecord* joints = jointRecords (data_);
+      for (std::size_t j = 0; j < header (data_).nbJoints; ++j) {
+	if (joints [j].roles & role) return j;
+      }
+      return SIZE_MAX;
+    }
+
+    // ======================================================================
+
+    std::size_t ModelSnapshot::nbGeometries (std::size_t jointId) const
+    {
+      return jointRecords (data_) [jointId].nbGeometries;
+    }
+
+    // ======================================================================
+
+    std::string ModelSnapshot::geometryName (std::size_t jointId,
+					     std::size_t rank) const
+    {
+      const StringRef& ref = geometryRecords (data_)
+	[jointRecords (data_) [jointId].firstGeometry + rank];
+      return stringAt (ref.offset, ref.length);
+    }
+
+    // ======================================================================
+
+    std::size_t ModelSnapshot::nbBodyDistances () const
+    {
+      return header (data_).nbBodyDistances;
+    }
+
+    // ======================================================================
+
+    std::string ModelSnapshot::bodyDistanceName (std::size_t rank) const
+    {
+      const StringRef& ref = distanceRecords (data_) [rank].name;
+      return stringAt (ref.offset, ref.length);
+    }
+
+    // ======================================================================
+
+    std::size_t ModelSnapshot::nbDistPairs (std::size_t rank) const
+    {
+      return distanceRecords (data_) [rank].nbDistPairs;
+    }
+
+    // ======================================================================
+
+    std::string ModelSnapshot::stringAt (uint64_t offset, uint64_t length)
+      const
+    {
+      return std::string (strings (data_) + offset, length);
+    }
+  } // namespace model
+} // namespace hpp
@@ -16,12 +16,23 @@
 // hpp-model  If not, see
 // <http://www.gnu.org/licenses/>.
 
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <typeinfo>
+#include <vector>
 #include <stdexcept>
 
+#include <boost/bind.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/tokenizer.hpp>
 
+#include <KineoKCDModel/kppKCDPolyhedron.h>
 #include <kprParserXML/kprParserManager.h>
 #include <KineoModuleManager/kppModuleManager.h>
 #include <KineoModuleManager/kppModule.h>
@@ -29,16 +40,124 @@
 #include <hpp/util/debug.hh>
 #include "hpp/model/humanoid-robot.hh"
 #include "hpp/model/anchor-joint.hh"
+#include "hpp/model/exception.hh"
 #include "hpp/model/freeflyer-joint.hh"
+#include "hpp/model/geometry-store.hh"
 #include "hpp/model/rotation-joint.hh"
+#include "hpp/model/trace.hh"
 #include "hpp/model/translation-joint.hh"
 #include "hpp/model/parser.hh"
 
 #include "module-dir.hh"
+#include "task-pool.hh"
 
 namespace hpp {
   namespace model {
-    Parser::Parser(bool addon)
+    namespace {
+      struct StoredPolyhedronTag
+      {
+	std::string store;
+	std::string mesh;
+	std::string name;
+      };
+
+      // Content of a kxml file, compressed or not.
+      std::string readDocument(const std::string& filename)
+      {
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+	  throw Exception("cannot open " + filename + ".");
+	}
+	const bool gzip = file.peek() == 0x1f;
+	boost::iostreams::filtering_istream stream;
+	if (gzip) {
+	  stream.push(boost::iostreams::gzip_decompressor());
+	}
+	stream.push(file);
+	std::ostringstream content;
+	boost::iostreams::copy(stream, content);
+	return content.str();
+      }
+
+      std::string unescape(const std::string& value)
+      {
+	static const char* entities[5][2] = {
+	  {"&lt;", "<"}, {"&gt;", ">"}, {"&quot;", "\""}, {"&apos;", "'"},
+	  {"&amp;", "&"}};
+	std::string result;
+	for (std::size_t i = 0; i < value.size(); ++i) {
+	  std::size_t e = 0;
+	  if (value[i] == '&') {
+	    while (e < 5 && value.compare(i, strlen(entities[e][0]),
+					  entities[e][0]) != 0) ++e;
+	  } else {
+	    e = 5;
+	  }
+	  if (e < 5) {
+	    result += entities[e][1];
+	    i += strlen(entities[e][0]) - 1;
+	  } else {
+	    result += value[i];
+	  }
+	}
+	return result;
+      }
+
+      // HPP_STORED_POLYHEDRON tags of a document, in document order.
+      void storedPolyhedronTags(const std::string& document,
+				std::vector<StoredPolyhedronTag>& tags)
+      {
+	static const std::string tagName("<HPP_STORED_POLYHEDRON");
+	for (std::size_t begin = document.find(tagName);
+	     begin != std::string::npos;
+	     begin = document.find(tagName, begin)) {
+	  begin += tagName.size();
+	  const std::size_t end = document.find('>', begin);
+	  if (end == std::string::npos) return;
+	  StoredPolyhedronTag tag;
+	  bool hasName = false;
+	  std::size_t i = begin;
+	  while (true) {
+	    const std::size_t equal = document.find('=', i);
+	    if (equal == std::string::npos || equal > end) break;
+	    const std::size_t quote = document.find_first_of("\"'", equal);
+	    if (quote == std::string::npos || quote > end) break;
+	    const std::size_t close = document.find(document[quote], quote + 1);
+	    if (close == std::string::npos || close > end) break;
+	    std::string attribute = document.substr(i, equal - i);
+	    attribute.erase(0, attribute.find_first_not_of(" \t\r\n"));
+	    attribute.erase(attribute.find_last_not_of(" \t\r\n") + 1);
+	    const std::string value =
+	      unescape(document.substr(quote + 1, close - quote - 1));
+	    if (attribute == "store") {
+	      tag.store = value;
+	    } else if (attribute == "mesh") {
+	      tag.mesh = value;
+	    } else if (attribute == "name") {
+	      tag.name = value;
+	      hasName = true;
+	    }
+	    i = close + 1;
+	  }
+	  if (!hasName) tag.name = tag.mesh;
+	  tags.push_back(tag);
+	  begin = end;
+	}
+      }
+    } // namespace
+
+    struct Parser::PreparedPolyhedron
+    {
+      PreparedPolyhedron() : done(false) {}
+      boost::mutex mutex;
+      boost::condition_variable condition;
+      bool done;
+      CkppKCDPolyhedronShPtr polyhedron;
+      std::string error;
+    };
+
+    Parser::Parser(bool addon) :
+      geometryPool_(new TaskPool(0)), lazyGeometry_(false)
     {
       if (addon) {
 	// Initialize module manager.
@@ -119,10 +238,139 @@ namespace hpp {
 	throw std::runtime_error
 	  ("Could not register HPP_ANCHOR_JOINT tag");
       hppDout(info, "register HPP_ANCHOR_JOINT tag");
+      // Read polyhedron stored in a geometry store
+      status =
+	CkprParserManager::defaultManager()->addXMLTagBuilderMethod < Parser >
+	("HPP_STORED_POLYHEDRON", this, &Parser::buildStoredPolyhedron);
+      if (status != KD_OK)
+	throw std::runtime_error
+	  ("Could not register HPP_STORED_POLYHEDRON tag");
+      hppDout(info, "register HPP_STORED_POLYHEDRON tag");
     }
 
     Parser::~Parser()
     {
+      try {
+	geometryPool_->wait();
+      } catch (const std::exception& exception) {
+	hppDout(error, exception.what());
+      }
+    }
+
+    void Parser::geometryThreads(std::size_t nbThreads)
+    {
+      geometryPool_->wait();
+      geometryPool_.reset(new TaskPool(nbThreads));
+    }
+
+    std::size_t Parser::geometryThreads() const
+    {
+      return geometryPool_->nbThreads();
+    }
+
+    void Parser::lazyGeometry(bool lazy)
+    {
+      lazyGeometry_ = lazy;
+    }
+
+    bool Parser::lazyGeometry() const
+    {
+      return lazyGeometry_;
+    }
+
+    void Parser::waitForGeometry()
+    {
+      Trace::Span span("parser", "wait-for-geometry");
+      geometryPool_->wait();
+    }
+
+    ktStatus Parser::loadComponentFromFile
+    (const std::string& filename,
+     CkppComponentShPtr& outComponent,
+     const CkppComponentFactoryRegistryShPtr& registry,
+     const CkitParameterMapShPtr& parameters)
+    {
+      Trace::Span span("parser", "load-component", "file", filename);
+      preparePolyhedra(filename);
+      const ktStatus status =
+	CkprParserManager::defaultManager()->loadComponentFromFile
+	(filename, outComponent, registry, parameters);
+      // Polyhedra of tags that were not reached if parsing failed.
+      geometryPool_->wait();
+      preparedPolyhedra_.clear();
+      return status;
+    }
+
+    void Parser::preparePolyhedra(const std::string& filename)
+    {
+      preparedPolyhedra_.clear();
+      if (lazyGeometry_ || geometryPool_->nbThreads() == 0) return;
+      Trace::Span span("parser", "prepare-polyhedra");
+      std::vector<StoredPolyhedronTag> tags;
+      try {
+	storedPolyhedronTags(readDocument(filename), tags);
+      } catch (const std::exception& exception) {
+	hppDout(warning, exception.what());
+	return;
+      }
+      for (std::size_t i = 0; i < tags.size(); ++i) {
+	// Errors are reported by the tag builder.
+	GeometryStoreShPtr store;
+	try {
+	  store = GeometryStore::open(tags[i].store);
+	} catch (const Exception&) {
+	  continue;
+	}
+	const std::size_t mesh = store->meshIndex(tags[i].mesh);
+	if (mesh == SIZE_MAX) continue;
+	PreparedPolyhedronShPtr result(new PreparedPolyhedron);
+	preparedPolyhedra_[PreparedKey_t
+			   (store->filename(),
+			    std::make_pair(mesh, tags[i].name))]
+	  .push_back(result);
+	geometryPool_->push(boost::bind(&Parser::preparePolyhedron, store,
+					mesh, tags[i].name, result));
+      }
+    }
+
+    void Parser::preparePolyhedron(const GeometryStoreShPtr& store,
+				   std::size_t mesh, const std::string& name,
+				   const PreparedPolyhedronShPtr& result)
+    {
+      CkppKCDPolyhedronShPtr polyhedron;
+      std::string error;
+      try {
+	polyhedron = CkppKCDPolyhedron::create(name);
+	store->fillPolyhedron(mesh, polyhedron);
+      } catch (const std::exception& exception) {
+	polyhedron.reset();
+	error = exception.what();
+	if (error.empty()) error = "unknown error";
+      }
+      boost::mutex::scoped_lock lock(result->mutex);
+      result->polyhedron = polyhedron;
+      result->error = error;
+      result->done = true;
+      result->condition.notify_all();
+    }
+
+    CkppKCDPolyhedronShPtr Parser::preparedPolyhedron(const PreparedKey_t& key)
+    {
+      PreparedPolyhedra_t::iterator it = preparedPolyhedra_.find(key);
+      if (it == preparedPolyhedra_.end() || it->second.empty()) {
+	return CkppKCDPolyhedronShPtr();
+      }
+      const PreparedPolyhedronShPtr result = it->second.front();
+      it->second.pop_front();
+      Trace::Span span("parser", "wait-for-polyhedron");
+      boost::mutex::scoped_lock lock(result->mutex);
+      while (!result->done) {
+	result->condition.wait(lock);
+      }
+      if (!result->error.empty()) {
+	throw Exception(result->error);
+      }
+      return result->polyhedron;
     }
 
     ktStatus Parser::writeHumanoidRobot
@@ -144,6 +392,7 @@ namespace hpp {
      CkprXMLBuildingContextShPtr&,
      CkppComponentShPtr& outComponent)
     {
+      Trace::Span span("parser", "build-humanoid-robot");
       hppDout(info, "building HumanoidRobot.");
       outComponent = HumanoidRobot::create("Humanoid Robot");
       if (!outComponent) {
@@ -171,6 +420,7 @@ namespace hpp {
 			CkprXMLBuildingContextShPtr&,
 			CkppComponentShPtr& outComponent)
     {
+      Trace::Span span("parser", "build-freeflyer-joint");
       hppDout(info, "building FreeFlyerJoint.");
       outComponent = FreeflyerJoint::create("FREEFLYER");
       if (!outComponent) {
@@ -198,6 +448,7 @@ namespace hpp {
 		       CkprXMLBuildingContextShPtr&,
 		       CkppComponentShPtr& outComponent)
     {
+      Trace::Span span("parser", "build-rotation-joint");
       hppDout(info, "building RotationJoint.");
       outComponent = RotationJoint::create("ROTATION");
       if (!outComponent) {
@@ -225,6 +476,7 @@ namespace hpp {
 			  CkprXMLBuildingContextShPtr&,
 			  CkppComponentShPtr& outComponent)
     {
+      Trace::Span span("parser", "build-translation-joint");
       hppDout(info, "building TranslationJoint.");
       outComponent = TranslationJoint::create("TRANSLATION");
       if (!outComponent) {
@@ -252,6 +504,7 @@ namespace hpp {
 		     CkprXMLBuildingContextShPtr&,
 		     CkppComponentShPtr& outComponent)
     {
+      Trace::Span span("parser", "build-anchor-joint");
       hppDout(info, "building AnchorJoint.");
       outComponent = AnchorJoint::create("ANCHOR");
       if (!outComponent) {
@@ -260,5 +513,52 @@ namespace hpp {
       return KD_OK;
     }
 
+    ktStatus Parser::
+    buildStoredPolyhedron(const CkprXMLTagConstShPtr& inTag,
+			  const CkppComponentShPtr&,
+			  std::vector< CkppComponentShPtr >&,
+			  CkprXMLBuildingContextShPtr&,
+			  CkppComponentShPtr& outComponent)
+    {
+      std::string storeFile, meshName, name;
+      if (inTag->getAttribute("store", storeFile) != KD_OK ||
+	  inTag->getAttribute("mesh", meshName) != KD_OK) {
+	hppDout(error, "HPP_STORED_POLYHEDRON requires store and mesh "
+		"attributes");
+	return KD_ERROR;
+      }
+      if (inTag->getAttribute("name", name) != KD_OK) {
+	name = meshName;
+      }
+      hppDout(info, "building polyhedron " << name << " from "
+	      << storeFile << ".");
+      Trace::Span span("parser", "build-stored-polyhedron", "mesh", meshName);
+      try {
+	GeometryStoreShPtr store = GeometryStore::open(storeFile);
+	const std::size_t mesh = store->meshIndex(meshName);
+	if (mesh == SIZE_MAX) {
+	  hppDout(error, "no mesh " << meshName << " in " << storeFile);
+	  return KD_ERROR;
+	}
+	CkppKCDPolyhedronShPtr polyhedron;
+	if (lazyGeometry_) {
+	  polyhedron = CkppKCDPolyhedron::create(name);
+	  GeometryStore::deferPolyhedron(store, mesh, polyhedron);
+	} else {
+	  polyhedron = preparedPolyhedron
+	    (PreparedKey_t(store->filename(), std::make_pair(mesh, name)));
+	  if (!polyhedron) {
+	    polyhedron = CkppKCDPolyhedron::create(name);
+	    store->fillPolyhedron(mesh, polyhedron);
+	  }
+	}
+	outComponent = polyhedron;
+      } catch (const Exception& exception) {
+	hppDout(error, exception.what());
+	return KD_ERROR;
+      }
+      return KD_OK;
+    }
+
   } // namespace model
 } // namespace hpp
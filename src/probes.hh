@@ -0,0 +1,64 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_PROBES_HH
+# define HPP_MODEL_PROBES_HH
+
+// USDT probes of provider hpp_model, compiled when HPP_MODEL_USDT is
+// defined (cmake -DHPP_MODEL_USDT=ON). A probe is a nop instruction
+// until a tracer (bpftrace, perf, systemtap) attaches to it.
+//
+// HPP_MODEL_PROBE_SCOPEn (name, ...) fires name_entry where it is
+// declared and name_return with the same arguments when the scope is
+// left, by return or by exception. The first argument is always the
+// object pointer. See scripts/hpp-model-latency.bt.
+
+# ifdef HPP_MODEL_USDT
+#  include <sys/sdt.h>
+
+#  define HPP_MODEL_PROBE_SCOPE2(name, object, arg)			\
+  DTRACE_PROBE2 (hpp_model, name##_entry, object, long (arg));		\
+  struct name##_probe_t {						\
+    const void* object_;						\
+    long arg_;								\
+    ~name##_probe_t ()							\
+    {									\
+      DTRACE_PROBE2 (hpp_model, name##_return, object_, arg_);		\
+    }									\
+  } name##_probe = {object, long (arg)}
+
+#  define HPP_MODEL_PROBE_SCOPE3(name, object, arg1, arg2)		\
+  DTRACE_PROBE3 (hpp_model, name##_entry, object, long (arg1),		\
+		 long (arg2));						\
+  struct name##_probe_t {						\
+    const void* object_;						\
+    long arg1_;								\
+    long arg2_;								\
+    ~name##_probe_t ()							\
+    {									\
+      DTRACE_PROBE3 (hpp_model, name##_return, object_, arg1_, arg2_);	\
+    }									\
+  } name##_probe = {object, long (arg1), long (arg2)}
+
+# else
+#  define HPP_MODEL_PROBE_SCOPE2(name, object, arg)
+#  define HPP_MODEL_PROBE_SCOPE3(name, object, arg1, arg2)
+# endif
+
+#endif // HPP_MODEL_PROBES_HH
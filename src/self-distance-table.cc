@@ -0,0 +1,148 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <limits>
+
+#include <kcd2/kcdAnalysis.h>
+#include <kcd2/kcdExactDistanceReport.h>
+#include <kcd2/kcdPoint.h>
+
+#include <hpp/util/debug.hh>
+
+#include "hpp/model/allowed-collision-matrix.hh"
+#include "hpp/model/self-distance-table.hh"
+#include "hpp/model/statistics.hh"
+#include "hpp/model/trace.hh"
+
+#include "device-bodies.hh"
+#include "probes.hh"
+
+namespace hpp {
+  namespace model {
+
+    SelfDistanceTable::SelfDistanceTable ()
+      : bodyName_ (), body1_ (), body2_ (), analysis_ (), distance_ (),
+	point1_ (), point2_ (), minPair_ (SIZE_MAX)
+    {
+    }
+
+    // ======================================================================
+
+    SelfDistanceTableShPtr SelfDistanceTable::create
+    (const DeviceShPtr& device, const AllowedCollisionMatrixConstShPtr& matrix)
+    {
+      if (matrix && !matrix->matches (*device)) {
+	throw Exception ("Allowed collision matrix does not match device "
+			 + device->name () + ".");
+      }
+      const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+      Bodies_t bodies;
+      std::vector<std::size_t> jointIds;
+      deviceBodies (*device, bodies, jointIds);
+
+      SelfDistanceTable* ptr = new SelfDistanceTable ();
+      SelfDistanceTableShPtr shPtr (ptr);
+      std::vector<std::vector<CkcdObjectShPtr> > objects (bodies.size ());
+      for (std::size_t i = 0; i < bodies.size (); ++i) {
+	ptr->bodyName_.push_back (tree->jointName (jointIds [i]));
+	objects [i] = bodies [i]->mobileObjects ();
+      }
+      for (std::size_t i = 0; i < bodies.size (); ++i) {
+	for (std::size_t j = i + 1; j < bodies.size (); ++j) {
+	  if (matrix && matrix->isAllowed (i, j)) continue;
+	  for (std::size_t k = 0; k < objects [i].size (); ++k) {
+	    for (std::size_t l = 0; l < objects [j].size (); ++l) {
+	      CkcdAnalysisShPtr analysis = CkcdAnalysis::create ();
+	      analysis->analysisData ()
+		->analysisType (CkcdAnalysisType::EXACT_DISTANCE);
+	      // Ignore tolerance for distance computations
+	      analysis->analysisData ()->isToleranceActivated (false);
+	      analysis->leftObject (objects [i][k]);
+	      analysis->rightObject (objects [j][l]);
+	      ptr->body1_.push_back (i);
+	      ptr->body2_.push_back (j);
+	      ptr->analysis_.push_back (analysis);
+	    }
+	  }
+	}
+      }
+      const std::size_t n = ptr->analysis_.size ();
+      ptr->distance_.assign (n, std::numeric_limits<double>::infinity ());
+      ptr->point1_.assign (3 * n, std::numeric_limits<double>::quiet_NaN ());
+      ptr->point2_.assign (3 * n, std::numeric_limits<double>::quiet_NaN ());
+      hppDout (info, "Self distance table of " << device->name () << ": "
+	       << bodies.size () << " bodies, " << n << " pairs.");
+      return shPtr;
+    }
+
+    // ======================================================================
+
+    double SelfDistanceTable::computeDistances ()
+    {
+      Trace::Span span ("distance", "self-distance", "pairs",
+			long (nbPairs ()));
+      HPP_MODEL_PROBE_SCOPE3 (self_distance, this, nbPairs (), nbBodies ());
+      Statistics::Scope statistics (Statistics::SELF_DISTANCE);
+      double minDistance = std::numeric_limits<double>::infinity ();
+      minPair_ = SIZE_MAX;
+      CkcdPoint point1, point2;
+      for (std::size_t p = 0; p < analysis_.size (); ++p) {
+	const CkcdAnalysisShPtr& analysis = analysis_ [p];
+	if (!KD_SUCCEEDED (analysis->compute ())) {
+	  hppDout (error, "distance computation failed.");
+	  throw Exception ("Self distance computation failed.");
+	}
+	if (analysis->countExactDistanceReports () == 0) {
+	  // Objects in collision: KCD gives no closest points.
+	  distance_ [p] = 0;
+	  for (std::size_t i = 0; i < 3; ++i) {
+	    point1_ [3*p + i] = std::numeric_limits<double>::quiet_NaN ();
+	    point2_ [3*p + i] = std::numeric_limits<double>::quiet_NaN ();
+	  }
+	} else {
+	  CkcdExactDistanceReportShPtr report =
+	    analysis->exactDistanceReport (0);
+	  distance_ [p] = report->distance ();
+	  report->getPointsAbsolute (point1, point2);
+	  for (std::size_t i = 0; i < 3; ++i) {
+	    point1_ [3*p + i] = point1 [i];
+	    point2_ [3*p + i] = point2 [i];
+	  }
+	}
+	if (distance_ [p] < minDistance) {
+	  minDistance = distance_ [p];
+	  minPair_ = p;
+	}
+      }
+      return minDistance;
+    }
+
+    // ======================================================================
+
+    void SelfDistanceTable::closestPoints (std::size_t pairId,
+					   CkcdPoint& outPoint1,
+					   CkcdPoint& outPoint2) const
+    {
+      outPoint1 = CkcdPoint (point1_ [3*pairId], point1_ [3*pairId + 1],
+			     point1_ [3*pairId + 2]);
+      outPoint2 = CkcdPoint (point2_ [3*pairId], point2_ [3*pairId + 1],
+			     point2_ [3*pairId + 2]);
+    }
+  } // namespace model
+} // namespace hpp
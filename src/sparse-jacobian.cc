@@ -0,0 +1,89 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "hpp/model/sparse-jacobian.hh"
+
+namespace hpp {
+  namespace model {
+
+    double SparseJacobian::operator () (std::size_t row, std::size_t dof)
+      const
+    {
+      std::vector<std::size_t>::const_iterator it =
+	std::lower_bound (columns_.begin (), columns_.end (), dof);
+      if (it == columns_.end () || *it != dof) {
+	return 0;
+      }
+      return values_ [(it - columns_.begin ()) * nbRows_ + row];
+    }
+
+    // ======================================================================
+
+    void SparseJacobian::resize (std::size_t nbRows, std::size_t numberDof,
+				 const std::vector<std::size_t>& columns)
+    {
+      nbRows_ = nbRows;
+      numberDof_ = numberDof;
+      columns_ = columns;
+      values_.assign (nbRows * columns.size (), 0);
+    }
+
+    // ======================================================================
+
+    void SparseJacobian::multiply (const double* v, double* out) const
+    {
+      std::fill (out, out + nbRows_, 0.);
+      for (std::size_t i = 0; i < columns_.size (); ++i) {
+	const double vi = v [columns_ [i]];
+	const double* col = &values_ [i * nbRows_];
+	for (std::size_t r = 0; r < nbRows_; ++r) {
+	  out [r] += col [r] * vi;
+	}
+      }
+    }
+
+    // ======================================================================
+
+    void SparseJacobian::transposeMultiplyAdd (const double* f, double* out)
+      const
+    {
+      for (std::size_t i = 0; i < columns_.size (); ++i) {
+	const double* col = &values_ [i * nbRows_];
+	double sum = 0;
+	for (std::size_t r = 0; r < nbRows_; ++r) {
+	  sum += col [r] * f [r];
+	}
+	out [columns_ [i]] += sum;
+      }
+    }
+
+    // ======================================================================
+
+    void SparseJacobian::toDense (double* out) const
+    {
+      std::fill (out, out + nbRows_ * numberDof_, 0.);
+      for (std::size_t i = 0; i < columns_.size (); ++i) {
+	std::copy (&values_ [i * nbRows_], &values_ [i * nbRows_] + nbRows_,
+		   out + columns_ [i] * nbRows_);
+      }
+    }
+  } // namespace model
+} // namespace hpp
@@ -0,0 +1,283 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <jrl/mal/matrixabstractlayer.hh>
+#include <abstract-robot-dynamics/foot.hh>
+#include <abstract-robot-dynamics/joint.hh>
+
+#include "hpp/model/exception.hh"
+#include "hpp/model/humanoid-robot.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/static-stability.hh"
+
+#include "kinematic-kernels.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Twice the signed area of triangle (o, a, b)
+      inline double cross2 (const double* o, const double* a, const double* b)
+      {
+	return (a [0] - o [0]) * (b [1] - o [1])
+	  - (a [1] - o [1]) * (b [0] - o [0]);
+      }
+
+      inline bool lexicographicLess (const double* a, const double* b)
+      {
+	return a [0] < b [0] || (a [0] == b [0] && a [1] < b [1]);
+      }
+    } // namespace
+
+    // ======================================================================
+
+    std::size_t StaticStability::convexHull (const double* points,
+					     std::size_t nbPoints,
+					     double* outVertices)
+    {
+      if (nbPoints > 8) {
+	throw Exception ("Convex hull of more than 8 points.");
+      }
+      // Insertion sort: nbPoints is small.
+      double sorted [16];
+      std::copy (points, points + 2*nbPoints, sorted);
+      for (std::size_t i = 1; i < nbPoints; ++i) {
+	for (std::size_t j = i; j > 0 &&
+	       lexicographicLess (sorted + 2*j, sorted + 2*(j - 1)); --j) {
+	  std::swap (sorted [2*j], sorted [2*(j - 1)]);
+	  std::swap (sorted [2*j + 1], sorted [2*(j - 1) + 1]);
+	}
+      }
+      if (nbPoints < 3) {
+	std::copy (sorted, sorted + 2*nbPoints, outVertices);
+	return nbPoints;
+      }
+      // Andrew's monotone chain
+      double hull [2*16];
+      std::size_t k = 0;
+      for (std::size_t i = 0; i < nbPoints; ++i) {
+	while (k >= 2 && cross2 (hull + 2*(k - 2), hull + 2*(k - 1),
+				 sorted + 2*i) <= 0) --k;
+	hull [2*k] = sorted [2*i]; hull [2*k + 1] = sorted [2*i + 1]; ++k;
+      }
+      const std::size_t lower = k + 1;
+      for (std::size_t i = nbPoints - 1; i-- > 0;) {
+	while (k >= lower && cross2 (hull + 2*(k - 2), hull + 2*(k - 1),
+				     sorted + 2*i) <= 0) --k;
+	hull [2*k] = sorted [2*i]; hull [2*k + 1] = sorted [2*i + 1]; ++k;
+      }
+      // Last point is equal to the first one.
+      const std::size_t nbVertices = k - 1;
+      std::copy (hull, hull + 2*nbVertices, outVertices);
+      return nbVertices;
+    }
+
+    // ======================================================================
+
+    double StaticStability::signedDistance (const double* vertices,
+					    std::size_t nbVertices,
+					    const double* point)
+    {
+      if (nbVertices == 0) {
+	return -std::numeric_limits<double>::infinity ();
+      }
+      // Inside a convex polygon, the distance to the boundary is the
+      // distance to the closest line supporting an edge. Outside, it is
+      // the distance to the closest edge.
+      bool inside = nbVertices >= 3;
+      double lineDistance = std::numeric_limits<double>::infinity ();
+      double edgeDistance2 = std::numeric_limits<double>::infinity ();
+      for (std::size_t i = 0; i < nbVertices; ++i) {
+	const double* a = vertices + 2*i;
+	const double* b = vertices + 2*((i + 1) % nbVertices);
+	const double ab [2] = {b [0] - a [0], b [1] - a [1]};
+	const double ap [2] = {point [0] - a [0], point [1] - a [1]};
+	const double length2 = ab [0] * ab [0] + ab [1] * ab [1];
+	double t = 0;
+	if (length2 > 0) {
+	  const double cross = cross2 (a, b, point);
+	  if (cross < 0) inside = false;
+	  lineDistance = std::min (lineDistance, cross / sqrt (length2));
+	  t = std::max (0., std::min (1., (ap [0] * ab [0] + ap [1] * ab [1])
+				      / length2));
+	}
+	const double d [2] = {ap [0] - t * ab [0], ap [1] - t * ab [1]};
+	edgeDistance2 = std::min (edgeDistance2, d [0] * d [0] + d [1] * d [1]);
+      }
+      return inside ? lineDistance : -sqrt (edgeDistance2);
+    }
+
+    // ======================================================================
+
+    StaticStability::StaticStability (const HumanoidRobot& robot,
+				      double margin)
+      : tree_ (robot.kinematicTree ()), margin_ (margin)
+    {
+      if (!(tree_->totalMass () > 0)) {
+	throw Exception ("Cannot check static stability of a robot without"
+			 " mass.");
+      }
+      const CjrlJoint* ankle [2] = {robot.leftAnkle (), robot.rightAnkle ()};
+      const CjrlFoot* foot [2] = {robot.leftFoot (), robot.rightFoot ()};
+      for (std::size_t f = 0; f < 2; ++f) {
+	if (!ankle [f] || !foot [f]) {
+	  throw Exception ("Humanoid robot feet are not defined.");
+	}
+	ankle_ [f] = tree_->jointIndex (ankle [f]);
+	if (ankle_ [f] == SIZE_MAX) {
+	  throw Exception ("Ankle joint does not belong to kinematic tree.");
+	}
+	double length, width;
+	vector3d anklePosition;
+	foot [f]->getSoleSize (length, width);
+	foot [f]->getAnklePositionInLocalFrame (anklePosition);
+	// Express sole corners in the ankle frame, the foot frame being
+	// parallel to the global frame at initial position.
+	const matrix4d& initialPosition = ankle [f]->initialPosition ();
+	for (std::size_t c = 0; c < 4; ++c) {
+	  const double local [3] =
+	    {-anklePosition [0] + (c == 0 || c == 3 ? .5 : -.5) * length,
+	     -anklePosition [1] + (c < 2 ? .5 : -.5) * width,
+	     -anklePosition [2]};
+	  for (std::size_t i = 0; i < 3; ++i) {
+	    corner_ [f][3*c + i] = 0;
+	    for (std::size_t k = 0; k < 3; ++k) {
+	      corner_ [f][3*c + i] +=
+		MAL_S4x4_MATRIX_ACCESS_I_J (initialPosition, k, i) * local [k];
+	    }
+	  }
+	}
+      }
+    }
+
+    // ======================================================================
+
+    void StaticStability::soleCorners (const double* m, std::size_t foot,
+				       double* outCorners) const
+    {
+      for (std::size_t c = 0; c < 4; ++c) {
+	const double* p = corner_ [foot] + 3*c;
+	for (std::size_t i = 0; i < 2; ++i) {
+	  outCorners [2*c + i] = m [4*i] * p [0] + m [4*i + 1] * p [1]
+	    + m [4*i + 2] * p [2] + m [4*i + 3];
+	}
+      }
+    }
+
+    // ======================================================================
+
+    std::size_t StaticStability::supportHull (const double* leftAnkle,
+					      const double* rightAnkle,
+					      Esupport support,
+					      double* outVertices) const
+    {
+      double points [16];
+      std::size_t nbPoints = 0;
+      if (support != RIGHT_FOOT) {
+	soleCorners (leftAnkle, 0, points);
+	nbPoints += 4;
+      }
+      if (support != LEFT_FOOT) {
+	soleCorners (rightAnkle, 1, points + 2*nbPoints);
+	nbPoints += 4;
+      }
+      return convexHull (points, nbPoints, outVertices);
+    }
+
+    // ======================================================================
+
+    void StaticStability::supportPolygon (const double* transforms,
+					  Esupport support,
+					  std::vector<double>& outVertices)
+      const
+    {
+      double vertices [16];
+      const std::size_t n =
+	supportHull (transforms + 12*ankle_ [0], transforms + 12*ankle_ [1],
+		     support, vertices);
+      outVertices.assign (vertices, vertices + 2*n);
+    }
+
+    // ======================================================================
+
+    double StaticStability::stabilityMargin (const double* config,
+					     Esupport support) const
+    {
+      std::vector<double> transforms (12 * tree_->nbJoints ());
+      kernel::forwardKinematics<1> (*tree_, config, &transforms [0]);
+      double com [3];
+      kernel::firstMomentOfMass<1> (*tree_, &transforms [0], com);
+      com [0] /= tree_->totalMass ();
+      com [1] /= tree_->totalMass ();
+      double vertices [16];
+      const std::size_t n =
+	supportHull (&transforms [12*ankle_ [0]], &transforms [12*ankle_ [1]],
+		     support, vertices);
+      return signedDistance (vertices, n, com);
+    }
+
+    // ======================================================================
+
+    bool StaticStability::isStable (const double* config, Esupport support)
+      const
+    {
+      return stabilityMargin (config, support) >= margin_;
+    }
+
+    // ======================================================================
+
+    void StaticStability::isStable (const double* configs,
+				    std::size_t nbConfigs, Esupport support,
+				    std::vector<bool>& outStable) const
+    {
+      const std::size_t W = KinematicTree::BLOCK_SIZE;
+      const std::size_t nbDof = tree_->numberDof ();
+      std::vector<double> q (W * std::max (nbDof, std::size_t (1)));
+      std::vector<double> transforms (12 * W * tree_->nbJoints ());
+      double moment [3*W];
+      double ankle [2][12];
+      double vertices [16];
+      outStable.resize (nbConfigs);
+
+      for (std::size_t k = 0; k < nbConfigs; k += W) {
+	const std::size_t nbLanes = std::min (W, nbConfigs - k);
+	kernel::gatherConfigurations<W> (configs + k * nbDof, nbLanes, nbDof,
+					 &q [0]);
+	kernel::forwardKinematics<W> (*tree_, &q [0], &transforms [0]);
+	kernel::firstMomentOfMass<W> (*tree_, &transforms [0], moment);
+	for (std::size_t l = 0; l < nbLanes; ++l) {
+	  for (std::size_t f = 0; f < 2; ++f) {
+	    const double* m = &transforms [12*W*ankle_ [f]];
+	    for (std::size_t e = 0; e < 12; ++e) {
+	      ankle [f][e] = m [e*W + l];
+	    }
+	  }
+	  const double com [2] = {moment [l] / tree_->totalMass (),
+				  moment [W + l] / tree_->totalMass ()};
+	  const std::size_t n = supportHull (ankle [0], ankle [1], support,
+					     vertices);
+	  outStable [k + l] = signedDistance (vertices, n, com) >= margin_;
+	}
+      }
+    }
+  } // namespace model
+} // namespace hpp
@@ -0,0 +1,272 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "hpp/model/statistics.hh"
+
+#include "histogram.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Incremented by Statistics::reset (). Histograms of an older
+      // generation are cleared by their thread on its next call, and
+      // ignored until then.
+      uint64_t currentGeneration = 0;
+
+      struct Histograms_t
+      {
+	Histograms_t () : generation (load (currentGeneration)),
+			  histograms (Statistics::NB_COUNTERS)
+	{
+	}
+
+	bool isCurrent () const
+	{
+	  return __atomic_load_n (&generation, __ATOMIC_ACQUIRE) ==
+	    load (currentGeneration);
+	}
+
+	uint64_t generation;
+	std::vector<Histogram> histograms;
+      };
+      typedef boost::shared_ptr<Histograms_t> HistogramsShPtr;
+
+      // Histograms of the running threads that recorded a call, and
+      // histograms of terminated threads merged together.
+      boost::mutex registryMutex;
+      std::vector<HistogramsShPtr> registry;
+      Histograms_t retired;
+
+      // Called with registryMutex locked.
+      Histograms_t& retiredHistograms ()
+      {
+	const uint64_t generation = load (currentGeneration);
+	if (retired.generation != generation) {
+	  for (std::size_t c = 0; c < Statistics::NB_COUNTERS; ++c) {
+	    retired.histograms [c] = Histogram ();
+	  }
+	  retired.generation = generation;
+	}
+	return retired;
+      }
+
+      // Called when a thread terminates: its histograms are merged in the
+      // retired ones, so that the registry does not grow with the number
+      // of threads ever started.
+      void retire (Histograms_t* histograms)
+      {
+	boost::mutex::scoped_lock lock (registryMutex);
+	if (histograms->isCurrent ()) {
+	  Histograms_t& result = retiredHistograms ();
+	  for (std::size_t c = 0; c < Statistics::NB_COUNTERS; ++c) {
+	    result.histograms [c].merge (histograms->histograms [c]);
+	  }
+	}
+	for (std::size_t i = 0; i < registry.size (); ++i) {
+	  if (registry [i].get () == histograms) {
+	    registry [i] = registry.back ();
+	    registry.pop_back ();
+	    break;
+	  }
+	}
+      }
+
+      boost::thread_specific_ptr<Histograms_t> threadHistograms (retire);
+
+      Histograms_t& localHistograms ()
+      {
+	Histograms_t* histograms = threadHistograms.get ();
+	if (!histograms) {
+	  HistogramsShPtr shPtr (new Histograms_t);
+	  {
+	    boost::mutex::scoped_lock lock (registryMutex);
+	    registry.push_back (shPtr);
+	  }
+	  histograms = shPtr.get ();
+	  threadHistograms.reset (histograms);
+	}
+	const uint64_t generation = load (currentGeneration);
+	if (histograms->generation != generation) {
+	  for (std::size_t c = 0; c < Statistics::NB_COUNTERS; ++c) {
+	    histograms->histograms [c].clear ();
+	  }
+	  // Readers see the histograms again once they are cleared.
+	  __atomic_store_n (&histograms->generation, generation,
+			    __ATOMIC_RELEASE);
+	}
+	return *histograms;
+      }
+
+      Histogram merged (Statistics::Ecounter counter)
+      {
+	boost::mutex::scoped_lock lock (registryMutex);
+	Histogram result = retiredHistograms ().histograms [counter];
+	for (std::size_t i = 0; i < registry.size (); ++i) {
+	  if (registry [i]->isCurrent ()) {
+	    result.merge (registry [i]->histograms [counter]);
+	  }
+	}
+	return result;
+      }
+
+      const char* names [Statistics::NB_COUNTERS] = {
+	"set-config-geometric",
+	"set-config-dynamic",
+	"set-config-both",
+	"kws-to-jrl-config",
+	"jrl-to-kws-config",
+	"forward-kinematics",
+	"forward-kinematics-batch",
+	"body-distance",
+	"capsule-body-distance",
+	"capsule-body-kcd-distance",
+	"capsule-body-capsule-distance",
+	"capsule-body-min-distance",
+	"capsule-body-cascade-distance",
+	"self-distance",
+	"bounding-box",
+	"create-copy"
+      };
+    } // namespace
+
+    const unsigned int Histogram::subBucketBits;
+    const unsigned int Histogram::nbSubBuckets;
+    const unsigned int Histogram::nbBuckets;
+
+    bool Statistics::enabled_ = false;
+
+    // ======================================================================
+
+    void Statistics::enable (bool enabled)
+    {
+      store (enabled_, enabled);
+    }
+
+
+    // ======================================================================
+
+    void Statistics::reset ()
+    {
+      // Histograms belong to the threads recording calls: they are
+      // cleared by their owner, never from here.
+      __atomic_add_fetch (&currentGeneration, 1, __ATOMIC_RELAXED);
+    }
+
+    // ======================================================================
+
+    const char* Statistics::name (Ecounter counter)
+    {
+      return names [counter];
+    }
+
+    // ======================================================================
+
+    uint64_t Statistics::count (Ecounter counter)
+    {
+      return merged (counter).count;
+    }
+
+    // ======================================================================
+
+    uint64_t Statistics::nbSamples (Ecounter counter)
+    {
+      return merged (counter).samples;
+    }
+
+    // ======================================================================
+
+    double Statistics::percentile (Ecounter counter, double percent)
+    {
+      return merged (counter).percentile (percent);
+    }
+
+    // ======================================================================
+
+    uint64_t Statistics::now ()
+    {
+      struct timespec ts;
+      clock_gettime (CLOCK_MONOTONIC, &ts);
+      return uint64_t (ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    // ======================================================================
+
+    void Statistics::record (Ecounter counter, uint64_t start)
+    {
+      Histogram& histogram = localHistograms ().histograms [counter];
+      increment (histogram.count);
+      if (start == 0) return;
+      histogram.add (now () - start);
+    }
+
+    // ======================================================================
+
+    void Statistics::write (std::ostream& os)
+    {
+      std::size_t nbThreads;
+      {
+	boost::mutex::scoped_lock lock (registryMutex);
+	nbThreads = registry.size ();
+      }
+      os << "{\n"
+	 << "  \"enabled\": " << (isEnabled () ? "true" : "false") << ",\n"
+	 << "  \"threads\": " << nbThreads << ",\n"
+	 << "  \"unit\": \"ns\",\n"
+	 << "  \"counters\": [";
+      for (std::size_t c = 0; c < NB_COUNTERS; ++c) {
+	const Histogram histogram = merged (Ecounter (c));
+	os << (c == 0 ? "" : ",") << "\n"
+	   << "    {\"name\": \"" << names [c] << "\", "
+	   << "\"count\": " << histogram.count << ", "
+	   << "\"samples\": " << histogram.samples;
+	if (histogram.samples > 0) {
+	  os << ", \"min\": " << histogram.min
+	     << ", \"max\": " << histogram.max
+	     << ", \"mean\": " << histogram.total / histogram.samples
+	     << ", \"p50\": " << histogram.percentile (50)
+	     << ", \"p90\": " << histogram.percentile (90)
+	     << ", \"p99\": " << histogram.percentile (99)
+	     << ", \"p999\": " << histogram.percentile (99.9)
+	     << ",\n     \"histogram\": [";
+	  // Non-empty buckets as [upper bound, count].
+	  bool first = true;
+	  for (unsigned int i = 0; i < Histogram::nbBuckets; ++i) {
+	    if (histogram.buckets [i] == 0) continue;
+	    os << (first ? "" : ", ") << "["
+	       << Histogram::bucketUpperBound (i) << ", "
+	       << histogram.buckets [i] << "]";
+	    first = false;
+	  }
+	  os << "]";
+	}
+	os << "}";
+      }
+      os << "\n  ]\n}\n";
+    }
+  } // namespace model
+} // namespace hpp
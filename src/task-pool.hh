@@ -0,0 +1,153 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_TASK_POOL_HH
+# define HPP_MODEL_TASK_POOL_HH
+
+# include <deque>
+# include <exception>
+# include <string>
+
+# include <boost/bind.hpp>
+# include <boost/function.hpp>
+# include <boost/noncopyable.hpp>
+# include <boost/thread/condition_variable.hpp>
+# include <boost/thread/mutex.hpp>
+# include <boost/thread/thread.hpp>
+
+# include "hpp/model/exception.hh"
+
+namespace hpp {
+  namespace model {
+    /// Fixed number of threads executing independent tasks.
+
+    /// Tasks are started in the order they are pushed. wait () returns
+    /// when every task pushed so far is finished and reports the error of
+    /// the first task, in push order, that failed, so that the outcome
+    /// does not depend on scheduling. With 0 threads, tasks are executed
+    /// by push ().
+    class TaskPool : private boost::noncopyable
+    {
+    public:
+      typedef boost::function<void ()> Task_t;
+
+      explicit TaskPool (std::size_t nbThreads)
+	: tasks_ (), nbPushed_ (0), nbFinished_ (0), stop_ (false),
+	  errorTask_ (0), error_ ()
+      {
+	for (std::size_t i = 0; i < nbThreads; ++i) {
+	  threads_.create_thread (boost::bind (&TaskPool::run, this));
+	}
+      }
+
+      ~TaskPool ()
+      {
+	{
+	  boost::mutex::scoped_lock lock (mutex_);
+	  stop_ = true;
+	}
+	available_.notify_all ();
+	threads_.join_all ();
+      }
+
+      std::size_t nbThreads () const { return threads_.size (); }
+
+      void push (const Task_t& task)
+      {
+	boost::mutex::scoped_lock lock (mutex_);
+	const std::size_t index = nbPushed_++;
+	if (threads_.size () == 0) {
+	  lock.unlock ();
+	  execute (task, index);
+	  return;
+	}
+	tasks_.push_back (std::make_pair (index, task));
+	lock.unlock ();
+	available_.notify_one ();
+      }
+
+      /// Wait for all tasks
+      /// \throw Exception if a task threw.
+      void wait ()
+      {
+	boost::mutex::scoped_lock lock (mutex_);
+	while (nbFinished_ != nbPushed_) {
+	  done_.wait (lock);
+	}
+	if (!error_.empty ()) {
+	  const std::string error = error_;
+	  error_.clear ();
+	  throw Exception (error);
+	}
+      }
+
+    private:
+      void run ()
+      {
+	boost::mutex::scoped_lock lock (mutex_);
+	while (true) {
+	  while (tasks_.empty () && !stop_) {
+	    available_.wait (lock);
+	  }
+	  if (tasks_.empty ()) return;
+	  const std::pair<std::size_t, Task_t> task = tasks_.front ();
+	  tasks_.pop_front ();
+	  lock.unlock ();
+	  execute (task.second, task.first);
+	  lock.lock ();
+	}
+      }
+
+      void execute (const Task_t& task, std::size_t index)
+      {
+	std::string error;
+	try {
+	  task ();
+	} catch (const std::exception& exception) {
+	  error = exception.what ();
+	  if (error.empty ()) error = "unknown error";
+	} catch (...) {
+	  error = "unknown error";
+	}
+	boost::mutex::scoped_lock lock (mutex_);
+	if (!error.empty () && (error_.empty () || index < errorTask_)) {
+	  error_ = error;
+	  errorTask_ = index;
+	}
+	++nbFinished_;
+	if (nbFinished_ == nbPushed_) {
+	  done_.notify_all ();
+	}
+      }
+
+      boost::mutex mutex_;
+      boost::condition_variable available_;
+      boost::condition_variable done_;
+      boost::thread_group threads_;
+      std::deque<std::pair<std::size_t, Task_t> > tasks_;
+      std::size_t nbPushed_;
+      std::size_t nbFinished_;
+      bool stop_;
+      std::size_t errorTask_;
+      std::string error_;
+    }; // class TaskPool
+  } // namespace model
+} // namespace hpp
+
+#endif // HPP_MODEL_TASK_POOL_HH
@@ -0,0 +1,131 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include <boost/thread/mutex.hpp>
+
+#include <hpp/util/debug.hh>
+
+#include "hpp/model/exception.hh"
+#include "hpp/model/trace.hh"
+
+namespace hpp {
+  namespace model {
+    namespace {
+      // Events are formatted in a buffer written to the file when it
+      // exceeds bufferSize, and by stop ().
+      const std::size_t bufferSize = 1 << 20;
+
+      boost::mutex traceMutex;
+      FILE* traceFile = 0;
+      std::string buffer;
+      bool firstEvent = true;
+
+      void escape (std::ostream& os, const std::string& s)
+      {
+	for (std::string::const_iterator it = s.begin (); it != s.end ();
+	     ++it) {
+	  if (*it == '"' || *it == '\\') os << '\\';
+	  if ((unsigned char) (*it) >= 0x20) os << *it;
+	}
+      }
+
+      void flush ()
+      {
+	if (!buffer.empty ()) {
+	  fwrite (buffer.data (), 1, buffer.size (), traceFile);
+	  buffer.clear ();
+	}
+      }
+    } // namespace
+
+    bool Trace::enabled_ = false;
+
+    // ======================================================================
+
+    void Trace::Span::write () const
+    {
+      const uint64_t end = Statistics::now ();
+      std::ostringstream oss;
+      oss.setf (std::ios::fixed);
+      oss.precision (3);
+      oss << "{\"name\": \"" << name_ << "\", \"cat\": \"" << category_
+	  << "\", \"ph\": \"X\", \"ts\": " << start_ * 1e-3
+	  << ", \"dur\": " << (end - start_) * 1e-3
+	  << ", \"pid\": " << getpid ()
+	  << ", \"tid\": " << syscall (SYS_gettid);
+      if (argName_) {
+	oss << ", \"args\": {\"" << argName_ << "\": ";
+	if (isString_) {
+	  oss << "\"";
+	  escape (oss, stringArg_);
+	  oss << "\"";
+	} else {
+	  oss << intArg_;
+	}
+	oss << "}";
+      }
+      oss << "}";
+
+      boost::mutex::scoped_lock lock (traceMutex);
+      // Tracing may have been stopped since the span started.
+      if (!traceFile) return;
+      buffer += firstEvent ? "\n" : ",\n";
+      buffer += oss.str ();
+      firstEvent = false;
+      if (buffer.size () > bufferSize) flush ();
+    }
+
+    // ======================================================================
+
+    void Trace::start (const std::string& filename)
+    {
+      boost::mutex::scoped_lock lock (traceMutex);
+      if (traceFile) {
+	throw Exception ("A trace is already being written.");
+      }
+      traceFile = fopen (filename.c_str (), "w");
+      if (!traceFile) {
+	throw Exception ("Cannot write trace " + filename + ".");
+      }
+      hppDout (info, "Writing trace to " << filename << ".");
+      buffer = "[";
+      firstEvent = true;
+      __atomic_store_n (&enabled_, true, __ATOMIC_RELAXED);
+    }
+
+    // ======================================================================
+
+    void Trace::stop ()
+    {
+      boost::mutex::scoped_lock lock (traceMutex);
+      if (!traceFile) return;
+      __atomic_store_n (&enabled_, false, __ATOMIC_RELAXED);
+      buffer += "\n]\n";
+      flush ();
+      fclose (traceFile);
+      traceFile = 0;
+    }
+  } // namespace model
+} // namespace hpp
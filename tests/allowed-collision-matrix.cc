@@ -0,0 +1,103 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE ALLOWED_COLLISION_MATRIX
+#include <boost/test/unit_test.hpp>
+
+#include "hpp/model/allowed-collision-matrix.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/kinematic-tree.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::AllowedCollisionMatrix;
+using hpp::model::AllowedCollisionMatrixShPtr;
+using hpp::model::DeviceShPtr;
+using hpp::model::KinematicTree;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  std::size_t jointIndex (const KinematicTree& tree, const std::string& name)
+  {
+    for (std::size_t j = 0; j < tree.nbJoints (); ++j) {
+      if (tree.jointName (j) == name) return j;
+    }
+    return SIZE_MAX;
+  }
+
+  DeviceShPtr generateRobot ()
+  {
+    return RobotGenerator ().nbJoints (12).branching (2).rotationRatio (.7)
+      .capsulesPerBody (2).generate ("allowed-collision-matrix");
+  }
+} // namespace
+
+// Bodies attached to a joint and its parent are adjacent.
+BOOST_AUTO_TEST_CASE (adjacent)
+{
+  DeviceShPtr device = generateRobot ();
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  AllowedCollisionMatrixShPtr matrix =
+    AllowedCollisionMatrix::generate (device, 50, 1, 5);
+  BOOST_REQUIRE (matrix);
+  BOOST_CHECK_EQUAL (matrix->nbBodies (), tree->nbJoints ());
+  BOOST_CHECK (matrix->matches (*device));
+  for (std::size_t i = 0; i < matrix->nbBodies (); ++i) {
+    const std::size_t joint1 = jointIndex (*tree, matrix->bodyName (i));
+    BOOST_REQUIRE (joint1 != SIZE_MAX);
+    BOOST_CHECK_EQUAL (matrix->reason (i, i), AllowedCollisionMatrix::ADJACENT);
+    for (std::size_t j = 0; j < matrix->nbBodies (); ++j) {
+      const std::size_t joint2 = jointIndex (*tree, matrix->bodyName (j));
+      BOOST_CHECK_EQUAL (matrix->reason (i, j), matrix->reason (j, i));
+      if (tree->parent (joint1) == joint2) {
+	BOOST_CHECK_EQUAL (matrix->reason (i, j),
+			   AllowedCollisionMatrix::ADJACENT);
+      }
+    }
+  }
+}
+
+// Copies of the device give the same matrix as the device itself, which
+// is left in its configuration.
+BOOST_AUTO_TEST_CASE (threads)
+{
+  DeviceShPtr device = generateRobot ();
+  std::vector<double> before, after;
+  device->getCurrentDofValues (before);
+  AllowedCollisionMatrixShPtr single =
+    AllowedCollisionMatrix::generate (device, 60, 1, 7);
+  device->getCurrentDofValues (after);
+  BOOST_CHECK (before == after);
+
+  AllowedCollisionMatrixShPtr parallel =
+    AllowedCollisionMatrix::generate (device, 60, 3, 7);
+  BOOST_REQUIRE_EQUAL (parallel->nbBodies (), single->nbBodies ());
+  for (std::size_t i = 0; i < single->nbBodies (); ++i) {
+    BOOST_CHECK_EQUAL (parallel->bodyName (i), single->bodyName (i));
+    for (std::size_t j = 0; j < single->nbBodies (); ++j) {
+      BOOST_CHECK_EQUAL (parallel->reason (i, j), single->reason (i, j));
+    }
+  }
+  device->getCurrentDofValues (after);
+  BOOST_CHECK (before == after);
+}
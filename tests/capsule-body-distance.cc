@@ -0,0 +1,231 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE CAPSULE_BODY_DISTANCE
+#include <boost/test/unit_test.hpp>
+
+#include <KineoKCDModel/kppKCDPolyhedron.h>
+#include <KineoUtility/kitMat4.h>
+#include <kcd2/kcdPoint.h>
+
+#include <hpp/geometry/component/segment.hh>
+
+#include "hpp/model/capsule-body-distance.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/kinematic-tree.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::CapsuleBodyDistance;
+using hpp::model::CapsuleBodyDistanceShPtr;
+using hpp::model::Device;
+using hpp::model::DeviceShPtr;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  // Minimum over the capsule pairs, computed one pair at a time.
+  double bruteForceDistance (const CapsuleBodyDistanceShPtr& distance)
+  {
+    double result = std::numeric_limits<double>::max ();
+    for (std::size_t i = distance->nbKCDDistPairs ();
+	 i < distance->nbDistPairs (); ++i) {
+      double d;
+      CkcdPoint pointBody, pointEnv;
+      BOOST_REQUIRE (distance->distAndPairsOfPoints (i, d, pointBody,
+						     pointEnv) == KD_OK);
+      result = std::min (result, d);
+    }
+    return result;
+  }
+
+  CkitMat4 translation (const CkcdPoint& point)
+  {
+    CkitMat4 result;
+    for (std::size_t k = 0; k < 3; ++k) {
+      result (k, 3) = point [k];
+    }
+    return result;
+  }
+
+  CkppKCDPolyhedronShPtr createBox (const std::string& name)
+  {
+    CkppKCDPolyhedronShPtr box = CkppKCDPolyhedron::create (name);
+    unsigned int rank;
+    for (unsigned int i = 0; i < 8; ++i) {
+      box->addPoint (i & 1 ? .05 : -.05, i & 2 ? .02 : -.02,
+		     i & 4 ? .1 : 0, rank);
+    }
+    const unsigned int triangles [36] = {0, 2, 1,  1, 2, 3,  4, 5, 6,
+					 5, 7, 6,  0, 1, 4,  1, 5, 4,
+					 2, 6, 3,  3, 6, 7,  0, 4, 2,
+					 2, 4, 6,  1, 3, 5,  3, 7, 5};
+    for (unsigned int i = 0; i < 12; ++i) {
+      box->addTriangle (triangles [3*i], triangles [3*i + 1],
+			triangles [3*i + 2], rank);
+    }
+    box->makeCollisionEntity (CkcdObject::IMMEDIATE_BUILD);
+    return box;
+  }
+
+  void checkPoint (const CkcdPoint& point, const CkcdPoint& expected)
+  {
+    for (std::size_t k = 0; k < 3; ++k) {
+      BOOST_CHECK_SMALL (point [k] - expected [k], 1e-12);
+    }
+  }
+} // namespace
+
+// An outer capsule moved between two queries is found at its new
+// position once the hierarchy is refitted.
+BOOST_AUTO_TEST_CASE (moving_obstacle)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (10).branching (2)
+    .rotationRatio (.7).capsulesPerBody (2).nbObstacles (6)
+    .generate ("capsule-body-distance");
+  CapsuleBodyDistanceShPtr distance = KIT_DYNAMIC_PTR_CAST
+    (CapsuleBodyDistance, device->bodyDistances ().back ());
+  BOOST_REQUIRE (distance);
+
+  // Start far from the device.
+  CapsuleBodyDistance::capsule_t obstacle =
+    hpp::geometry::component::Segment::create (CkcdPoint (0, 0, 0),
+					       CkcdPoint (.1, 0, 0), .01);
+  obstacle->setAbsolutePosition (translation (CkcdPoint (100, 0, 0)));
+  distance->addOuterCapsule (obstacle);
+
+  double d;
+  CkcdPoint pointBody, pointEnv;
+  BOOST_REQUIRE (distance->capsuleDistAndPairsOfPoints (d, pointBody,
+							pointEnv) == KD_OK);
+  BOOST_CHECK_SMALL (d - bruteForceDistance (distance), 1e-12);
+  BOOST_CHECK (d < 50);
+
+  // Move the obstacle next to the closest point of the body.
+  obstacle->setAbsolutePosition
+    (translation (CkcdPoint (pointBody [0], pointBody [1],
+			     pointBody [2] + .05)));
+  distance->refitOuterCapsules ();
+  const double before = d;
+  BOOST_REQUIRE (distance->capsuleDistAndPairsOfPoints (d, pointBody,
+							pointEnv) == KD_OK);
+  BOOST_CHECK_SMALL (d - bruteForceDistance (distance), 1e-12);
+  BOOST_CHECK (d <= .05);
+  BOOST_CHECK (d <= before);
+
+  // Move it away again.
+  obstacle->setAbsolutePosition (translation (CkcdPoint (-100, 0, 0)));
+  distance->refitOuterCapsules ();
+  BOOST_REQUIRE (distance->capsuleDistAndPairsOfPoints (d, pointBody,
+							pointEnv) == KD_OK);
+  BOOST_CHECK_SMALL (d - bruteForceDistance (distance), 1e-12);
+}
+
+// The cascade finds the distance and closest points of the exhaustive
+// computation over KCD and capsule pairs. With a threshold below that
+// distance, it returns a lower bound not below the threshold.
+BOOST_AUTO_TEST_CASE (cascade)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (10).branching (2)
+    .rotationRatio (.7).capsulesPerBody (2).nbObstacles (2)
+    .generate ("capsule-body-distance-cascade");
+  Random random (23);
+  std::vector<CapsuleBodyDistanceShPtr> distances;
+  for (std::size_t i = 0; i < device->bodyDistances ().size (); ++i) {
+    CapsuleBodyDistanceShPtr distance = KIT_DYNAMIC_PTR_CAST
+      (CapsuleBodyDistance, device->bodyDistances () [i]);
+    BOOST_REQUIRE (distance);
+    distances.push_back (distance);
+  }
+  // Boxes spread in the box of the obstacles of the generator.
+  for (std::size_t o = 0; o < 8; ++o) {
+    std::ostringstream name;
+    name << "box-" << o;
+    CkppKCDPolyhedronShPtr box = createBox (name.str ());
+    box->setAbsolutePosition
+      (translation (CkcdPoint (random.uniform (-1, 1),
+			       random.uniform (-1, 1),
+			       random.uniform (0, 1))));
+    for (std::size_t i = 0; i < distances.size (); ++i) {
+      distances [i]->addOuterObject (KIT_DYNAMIC_PTR_CAST (CkcdObject, box));
+    }
+  }
+
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  vectorN q;
+  std::size_t nbPairs = 0, nbExactPairs = 0;
+  for (std::size_t k = 0; k < 5; ++k) {
+    randomConfiguration (*tree, random, q);
+    device->hppSetCurrentConfig (q, Device::BOTH);
+    for (std::size_t i = 0; i < distances.size (); ++i) {
+      const CapsuleBodyDistanceShPtr& distance = distances [i];
+      // One KCD pair per box and inner capsule, two capsule pairs per
+      // inner capsule.
+      BOOST_REQUIRE_EQUAL (2 * distance->nbKCDDistPairs (),
+			   8 * distance->nbCapsuleDistPairs ());
+      double expected, capsuleDistance;
+      CkcdPoint expectedBody, expectedEnv, capsuleBody, capsuleEnv;
+      BOOST_REQUIRE (distance->kcdDistAndPairsOfPoints
+		     (expected, expectedBody, expectedEnv) == KD_OK);
+      BOOST_REQUIRE (distance->capsuleDistAndPairsOfPoints
+		     (capsuleDistance, capsuleBody, capsuleEnv) == KD_OK);
+      if (capsuleDistance < expected) {
+	expected = capsuleDistance;
+	expectedBody = capsuleBody;
+	expectedEnv = capsuleEnv;
+      }
+
+      double d;
+      CkcdPoint pointBody, pointEnv;
+      BOOST_REQUIRE (distance->cascadeDistAndPairsOfPoints
+		     (std::numeric_limits<double>::max (), d, pointBody,
+		      pointEnv) == KD_OK);
+      BOOST_CHECK_SMALL (d - expected, 1e-12);
+      checkPoint (pointBody, expectedBody);
+      checkPoint (pointEnv, expectedEnv);
+
+      // Threshold above the distance
+      BOOST_REQUIRE (distance->cascadeDistAndPairsOfPoints
+		     (expected + .01, d, pointBody, pointEnv) == KD_OK);
+      BOOST_CHECK_SMALL (d - expected, 1e-12);
+      checkPoint (pointBody, expectedBody);
+      checkPoint (pointEnv, expectedEnv);
+
+      // Threshold hit
+      if (expected <= 0) continue;
+      const double threshold = .5 * expected;
+      BOOST_REQUIRE (distance->cascadeDistAndPairsOfPoints
+		     (threshold, d, pointBody, pointEnv) == KD_OK);
+      BOOST_CHECK (d >= threshold);
+      BOOST_CHECK (d <= expected + 1e-12);
+      nbPairs += distance->nbKCDDistPairs ();
+      nbExactPairs += distance->nbExactPairs ();
+    }
+  }
+  // Lower bounds above the threshold skip exact computations.
+  BOOST_CHECK (nbPairs > 0);
+  BOOST_CHECK (nbExactPairs < nbPairs);
+}
@@ -0,0 +1,135 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#define BOOST_TEST_MODULE CAPSULE_FITTER
+#include <boost/test/unit_test.hpp>
+
+#include <KineoKCDModel/kppKCDPolyhedron.h>
+#include <KineoUtility/kitMat4.h>
+#include <kcd2/kcdPoint.h>
+#include <kwsKcd2/kwsKCDBodyAdvanced.h>
+
+#include <hpp/geometry/component/segment.hh>
+
+#include "hpp/model/capsule-body-distance.hh"
+#include "hpp/model/capsule-fitter.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/joint.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::CapsuleBodyDistance;
+using hpp::model::CapsuleBodyDistanceShPtr;
+using hpp::model::CapsuleFitter;
+using hpp::model::CapsuleFitterShPtr;
+using hpp::model::Device;
+using hpp::model::DeviceShPtr;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  CkppKCDPolyhedronShPtr createBox (const std::string& name)
+  {
+    CkppKCDPolyhedronShPtr box = CkppKCDPolyhedron::create (name);
+    unsigned int rank;
+    for (unsigned int i = 0; i < 8; ++i) {
+      box->addPoint (i & 1 ? .05 : -.05, i & 2 ? .02 : -.02,
+		     i & 4 ? .3 : 0, rank);
+    }
+    const unsigned int triangles [36] = {0, 2, 1,  1, 2, 3,  4, 5, 6,
+					 5, 7, 6,  0, 1, 4,  1, 5, 4,
+					 2, 6, 3,  3, 6, 7,  0, 4, 2,
+					 2, 4, 6,  1, 3, 5,  3, 7, 5};
+    for (unsigned int i = 0; i < 12; ++i) {
+      box->addTriangle (triangles [3*i], triangles [3*i + 1],
+			triangles [3*i + 2], rank);
+    }
+    box->makeCollisionEntity (CkcdObject::IMMEDIATE_BUILD);
+    return box;
+  }
+} // namespace
+
+// Fitted capsules are used for distance computation only: the mobile
+// objects of the body are not modified.
+BOOST_AUTO_TEST_CASE (distance_only)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (3).capsulesPerBody (0)
+    .generate ("capsule-fitter");
+  CkwsKCDBodyAdvancedShPtr body = CkwsKCDBodyAdvanced::create ("box-body");
+  device->getRootJoint ()->kppJoint ()->kwsJoint ()->setAttachedBody (body);
+  std::vector<CkcdObjectShPtr> objects;
+  objects.push_back (KIT_DYNAMIC_PTR_CAST (CkcdObject, createBox ("box")));
+  body->mobileObjects (objects);
+
+  CapsuleBodyDistanceShPtr distance =
+    CapsuleBodyDistance::create (body, "box-body");
+  CapsuleBodyDistance::capsule_t obstacle =
+    hpp::geometry::component::Segment::create (CkcdPoint (1, 0, 0),
+					       CkcdPoint (1, 0, .3), .01);
+  distance->addOuterCapsule (obstacle);
+  CapsuleFitterShPtr fitter = CapsuleFitter::create ("");
+  const std::size_t nbCapsules = fitter->fitBody (distance, 3);
+  BOOST_CHECK (nbCapsules > 0);
+  BOOST_CHECK_EQUAL (distance->nbCapsuleDistPairs (), nbCapsules);
+  BOOST_REQUIRE_EQUAL (body->mobileObjects ().size (), 1u);
+  BOOST_CHECK (body->mobileObjects () [0] == objects [0]);
+
+  // The box is around the z axis, the obstacle at x = 1.
+  double d;
+  CkcdPoint pointBody, pointEnv;
+  BOOST_REQUIRE (distance->capsuleDistAndPairsOfPoints (d, pointBody,
+							pointEnv) == KD_OK);
+  BOOST_CHECK (d > .8 && d < 1);
+
+  // Per pair queries follow the joint as well.
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  Random random (11);
+  vectorN q;
+  for (std::size_t k = 0; k < 5; ++k) {
+    randomConfiguration (*tree, random, q);
+    device->hppSetCurrentConfig (q, Device::BOTH);
+    double minDistance = std::numeric_limits<double>::max ();
+    for (std::size_t i = distance->nbKCDDistPairs ();
+	 i < distance->nbDistPairs (); ++i) {
+      BOOST_REQUIRE (distance->distAndPairsOfPoints (i, d, pointBody,
+						     pointEnv) == KD_OK);
+      minDistance = std::min (minDistance, d);
+    }
+    BOOST_REQUIRE (distance->capsuleDistAndPairsOfPoints (d, pointBody,
+							  pointEnv) == KD_OK);
+    BOOST_CHECK_SMALL (d - minDistance, 1e-12);
+  }
+}
+
+// Bodies that already have capsules are not fitted again.
+BOOST_AUTO_TEST_CASE (fitted_bodies_skipped)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (6).capsulesPerBody (2)
+    .generate ("capsule-fitter-skip");
+  const std::size_t nbDistances = device->bodyDistances ().size ();
+  BOOST_REQUIRE (nbDistances > 0);
+  CapsuleFitterShPtr fitter = CapsuleFitter::create ("");
+  BOOST_CHECK (fitter->fitDevice (device, 3).empty ());
+  BOOST_CHECK_EQUAL (device->bodyDistances ().size (), nbDistances);
+}
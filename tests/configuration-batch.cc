@@ -0,0 +1,253 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE CONFIGURATION_BATCH
+#include <boost/test/unit_test.hpp>
+
+#include "hpp/model/configuration-batch.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/exception.hh"
+#include "hpp/model/kinematic-tree.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::ConfigurationBatch;
+using hpp::model::ConfigurationBatchShPtr;
+using hpp::model::ConfigurationBatchWriter;
+using hpp::model::DeviceShPtr;
+using hpp::model::Exception;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  // Offsets of header fields in the file format.
+  const std::size_t numberDofOffset = 24;
+  const std::size_t nbRowsOffset = 40;
+
+  KinematicTreeConstShPtr generateTree ()
+  {
+    DeviceShPtr device = RobotGenerator ().nbJoints (8).branching (2)
+      .rotationRatio (.7).freeflyerRoot (true).capsulesPerBody (0)
+      .generate ("configuration-batch");
+    return device->kinematicTree ();
+  }
+
+  std::string readFile (const std::string& filename)
+  {
+    std::ifstream file (filename.c_str (), std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf ();
+    return content.str ();
+  }
+
+  void writeFile (const std::string& filename, const std::string& content)
+  {
+    std::ofstream file (filename.c_str (),
+			std::ios::binary | std::ios::trunc);
+    file.write (content.data (), content.size ());
+  }
+
+  void setField (std::string& content, std::size_t offset, uint64_t value)
+  {
+    memcpy (&content [offset], &value, sizeof (value));
+  }
+
+  bool rejected (const std::string& filename)
+  {
+    try {
+      ConfigurationBatch::open (filename);
+    } catch (const Exception&) {
+      return true;
+    }
+    return false;
+  }
+} // namespace
+
+// Rows and parameters written are read back, with the description of
+// the kinematic tree.
+BOOST_AUTO_TEST_CASE (round_trip)
+{
+  KinematicTreeConstShPtr tree = generateTree ();
+  const std::size_t nbDof = tree->numberDof ();
+  const std::string filename ("./configuration-batch-round-trip.bin");
+  std::vector<double> rows, parameters;
+  Random random (17);
+  vectorN q;
+  {
+    ConfigurationBatchWriter writer (filename, *tree,
+				     ConfigurationBatch::PATH,
+				     ConfigurationBatch::JRL_DYNAMICS, nbDof);
+    for (std::size_t i = 0; i < 10; ++i) {
+      randomConfiguration (*tree, random, q);
+      const std::vector<double> row = toArray (q);
+      rows.insert (rows.end (), row.begin (), row.begin () + nbDof);
+      parameters.push_back (.1 * i);
+      writer.append (&row [0], .1 * i);
+    }
+    std::vector<double> block (3 * nbDof);
+    for (std::size_t i = 0; i < 3; ++i) {
+      randomConfiguration (*tree, random, q);
+      for (std::size_t k = 0; k < nbDof; ++k) block [i * nbDof + k] = q [k];
+      parameters.push_back (1 + i);
+    }
+    rows.insert (rows.end (), block.begin (), block.end ());
+    writer.append (&block [0], 3, &parameters [10]);
+    BOOST_CHECK_EQUAL (writer.nbRows (), 13u);
+    writer.close ();
+  }
+
+  ConfigurationBatchShPtr batch = ConfigurationBatch::open (filename);
+  BOOST_CHECK_EQUAL (batch->kind (), ConfigurationBatch::PATH);
+  BOOST_CHECK_EQUAL (batch->convention (), ConfigurationBatch::JRL_DYNAMICS);
+  BOOST_REQUIRE_EQUAL (batch->numberDof (), nbDof);
+  BOOST_REQUIRE_EQUAL (batch->nbRows (), 13u);
+  BOOST_CHECK (std::equal (rows.begin (), rows.end (), batch->rows ()));
+  BOOST_CHECK (std::equal (rows.begin () + 5 * nbDof,
+			   rows.begin () + 6 * nbDof, batch->row (5)));
+  BOOST_REQUIRE (batch->parameters ());
+  BOOST_CHECK (std::equal (parameters.begin (), parameters.end (),
+			   batch->parameters ()));
+  BOOST_REQUIRE_EQUAL (batch->nbJoints (), tree->nbJoints ());
+  for (std::size_t j = 0; j < tree->nbJoints (); ++j) {
+    BOOST_CHECK_EQUAL (batch->jointName (j), tree->jointName (j));
+    BOOST_CHECK_EQUAL (batch->jointType (j), tree->jointType (j));
+    BOOST_CHECK_EQUAL (batch->rankInConfiguration (j),
+		       tree->rankInConfiguration (j));
+  }
+  BOOST_CHECK (batch->matches (*tree));
+  KinematicTreeConstShPtr other = RobotGenerator ().nbJoints (5)
+    .capsulesPerBody (0).generate ("configuration-batch-other")
+    ->kinematicTree ();
+  BOOST_CHECK (!batch->matches (*other));
+
+  // Configurations have no parameters.
+  {
+    ConfigurationBatchWriter writer (filename, *tree,
+				     ConfigurationBatch::CONFIGURATIONS,
+				     ConfigurationBatch::JRL_DYNAMICS, nbDof);
+    writer.append (&rows [0], 2, 0);
+    writer.close ();
+  }
+  batch = ConfigurationBatch::open (filename);
+  BOOST_CHECK_EQUAL (batch->kind (), ConfigurationBatch::CONFIGURATIONS);
+  BOOST_REQUIRE_EQUAL (batch->nbRows (), 2u);
+  BOOST_CHECK (!batch->parameters ());
+  BOOST_CHECK (std::equal (rows.begin (), rows.begin () + 2 * nbDof,
+			   batch->rows ()));
+}
+
+// A writer destroyed before close () leaves no file, or the previous
+// one.
+BOOST_AUTO_TEST_CASE (unclosed_writer)
+{
+  KinematicTreeConstShPtr tree = generateTree ();
+  const std::size_t nbDof = tree->numberDof ();
+  const std::string filename ("./configuration-batch-unclosed.bin");
+  remove (filename.c_str ());
+  std::vector<double> row (nbDof, 0.);
+  {
+    ConfigurationBatchWriter writer (filename, *tree,
+				     ConfigurationBatch::CONFIGURATIONS,
+				     ConfigurationBatch::JRL_DYNAMICS, nbDof);
+    writer.append (&row [0]);
+  }
+  BOOST_CHECK (!std::ifstream (filename.c_str ()));
+  BOOST_CHECK (rejected (filename));
+
+  {
+    ConfigurationBatchWriter writer (filename, *tree,
+				     ConfigurationBatch::CONFIGURATIONS,
+				     ConfigurationBatch::JRL_DYNAMICS, nbDof);
+    writer.append (&row [0]);
+    writer.close ();
+  }
+  {
+    ConfigurationBatchWriter writer (filename, *tree,
+				     ConfigurationBatch::CONFIGURATIONS,
+				     ConfigurationBatch::JRL_DYNAMICS, nbDof);
+    for (std::size_t i = 0; i < 5; ++i) writer.append (&row [0]);
+  }
+  BOOST_CHECK_EQUAL (ConfigurationBatch::open (filename)->nbRows (), 1u);
+}
+
+// Truncated files and headers whose sizes do not match the file are
+// rejected, including sizes whose product overflows.
+BOOST_AUTO_TEST_CASE (corrupted)
+{
+  KinematicTreeConstShPtr tree = generateTree ();
+  const std::size_t nbDof = tree->numberDof ();
+  const std::string filename ("./configuration-batch-corrupted.bin");
+  const std::string corrupted ("./configuration-batch-corrupted-copy.bin");
+  std::vector<double> rows (4 * nbDof, 1.);
+  {
+    ConfigurationBatchWriter writer (filename, *tree,
+				     ConfigurationBatch::CONFIGURATIONS,
+				     ConfigurationBatch::JRL_DYNAMICS, nbDof);
+    writer.append (&rows [0], 4, 0);
+    writer.close ();
+  }
+  const std::string content = readFile (filename);
+  BOOST_REQUIRE (!rejected (filename));
+
+  // Truncated files
+  writeFile (corrupted, content.substr (0, 10));
+  BOOST_CHECK (rejected (corrupted));
+  writeFile (corrupted, content.substr (0, content.size () - 8));
+  BOOST_CHECK (rejected (corrupted));
+  writeFile (corrupted, content + std::string (8, '\0'));
+  BOOST_CHECK (rejected (corrupted));
+
+  // Bad magic number
+  std::string copy = content;
+  copy [0] = 'X';
+  writeFile (corrupted, copy);
+  BOOST_CHECK (rejected (corrupted));
+
+  // Number of rows not matching the size
+  copy = content;
+  setField (copy, nbRowsOffset, 5);
+  writeFile (corrupted, copy);
+  BOOST_CHECK (rejected (corrupted));
+
+  // 2^21 rows of 2^40 doubles take 2^64 bytes, which overflows to 0.
+  // The header of a batch without rows is made to claim them.
+  {
+    ConfigurationBatchWriter writer (filename, *tree,
+				     ConfigurationBatch::CONFIGURATIONS,
+				     ConfigurationBatch::JRL_DYNAMICS, nbDof);
+    writer.close ();
+  }
+  copy = readFile (filename);
+  BOOST_REQUIRE (!rejected (filename));
+  setField (copy, numberDofOffset, uint64_t (1) << 40);
+  setField (copy, nbRowsOffset, uint64_t (1) << 21);
+  writeFile (corrupted, copy);
+  BOOST_CHECK (rejected (corrupted));
+}
@@ -0,0 +1,103 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <vector>
+
+#define BOOST_TEST_MODULE DISTANCE_GRADIENT
+#include <boost/test/unit_test.hpp>
+
+#include <kcd2/kcdPoint.h>
+
+#include "hpp/model/body-distance.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/sparse-jacobian.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::BodyDistanceShPtr;
+using hpp::model::Device;
+using hpp::model::DeviceShPtr;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::SparseJacobian;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  double distance (const BodyDistanceShPtr& bodyDistance, std::size_t pairId)
+  {
+    double result;
+    CkcdPoint pointBody, pointEnv;
+    BOOST_REQUIRE (bodyDistance->distAndPairsOfPoints
+		   (pairId, result, pointBody, pointEnv) == KD_OK);
+    return result;
+  }
+} // namespace
+
+// Gradients of the distances between the capsules of the bodies and
+// capsule obstacles are compared to central finite differences.
+BOOST_AUTO_TEST_CASE (finite_differences)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (15).branching (2)
+    .rotationRatio (.7).freeflyerRoot (true).capsulesPerBody (2)
+    .nbObstacles (4).generate ("distance-gradient");
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  const std::size_t nbDof = tree->numberDof ();
+  const std::vector<BodyDistanceShPtr>& distances = device->bodyDistances ();
+  BOOST_REQUIRE (!distances.empty ());
+  const double h = 1e-6;
+  std::vector<double> transforms (12 * tree->nbJoints ());
+  std::vector<SparseJacobian> jacobians;
+  SparseJacobian comJacobian;
+  std::vector<double> gradient;
+  Random random (23);
+  vectorN q;
+  for (std::size_t k = 0; k < 3; ++k) {
+    randomConfiguration (*tree, random, q);
+    tree->forwardKinematics (&toArray (q) [0], &transforms [0]);
+    tree->computeJacobians (&toArray (q) [0], jacobians, comJacobian);
+    for (std::size_t b = 0; b < distances.size (); ++b) {
+      const BodyDistanceShPtr& bodyDistance = distances [b];
+      const std::size_t j = bodyDistance->jointIndex (*tree);
+      BOOST_REQUIRE (j != SIZE_MAX);
+      for (std::size_t pairId = 0; pairId < bodyDistance->nbDistPairs ();
+	   ++pairId) {
+	device->hppSetCurrentConfig (q, Device::BOTH);
+	double d;
+	CkcdPoint pointBody, pointEnv;
+	BOOST_REQUIRE (bodyDistance->distanceGradient
+		       (pairId, &transforms [12*j], jacobians [j], d,
+			pointBody, pointEnv, gradient) == KD_OK);
+	BOOST_REQUIRE_EQUAL (gradient.size (), nbDof);
+	BOOST_CHECK_SMALL (d - distance (bodyDistance, pairId), 1e-12);
+	for (std::size_t dof = 0; dof < nbDof; ++dof) {
+	  const double value = q [dof];
+	  q [dof] = value + h;
+	  device->hppSetCurrentConfig (q, Device::BOTH);
+	  const double plus = distance (bodyDistance, pairId);
+	  q [dof] = value - h;
+	  device->hppSetCurrentConfig (q, Device::BOTH);
+	  const double minus = distance (bodyDistance, pairId);
+	  q [dof] = value;
+	  BOOST_CHECK_SMALL (gradient [dof] - (plus - minus) / (2*h), 1e-5);
+	}
+      }
+    }
+  }
+}
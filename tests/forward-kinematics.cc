@@ -0,0 +1,105 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE FORWARD_KINEMATICS
+#include <boost/test/unit_test.hpp>
+
+#include <abstract-robot-dynamics/joint.hh>
+
+#include "hpp/model/device.hh"
+#include "hpp/model/joint.hh"
+#include "hpp/model/kinematic-tree.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::DeviceShPtr;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+// Compare the positions computed by the kinematic tree to the ones
+// computed by jrl-dynamics for random configurations.
+static void checkForwardKinematics (const DeviceShPtr& device)
+{
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  Random random (7);
+  vectorN q;
+  std::vector<double> transforms (12 * tree->nbJoints ());
+  for (std::size_t k = 0; k < 20; ++k) {
+    randomConfiguration (*tree, random, q);
+    device->hppSetCurrentConfig (q, hpp::model::Device::DYNAMIC);
+    tree->forwardKinematics (&toArray (q) [0], &transforms [0]);
+    for (std::size_t j = 0; j < tree->nbJoints (); ++j) {
+      const matrix4d& expected =
+	tree->joint (j)->jrlJoint ()->currentTransformation ();
+      for (std::size_t r = 0; r < 3; ++r) {
+	for (std::size_t c = 0; c < 4; ++c) {
+	  BOOST_CHECK_SMALL (transforms [12*j + 4*r + c] -
+			     MAL_S4x4_MATRIX_ACCESS_I_J (expected, r, c),
+			     1e-10);
+	}
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE (serial_chain)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (12).rotationRatio (.7)
+    .generate ("serial-chain");
+  checkForwardKinematics (device);
+}
+
+BOOST_AUTO_TEST_CASE (tree_with_freeflyer)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (30).branching (3)
+    .rotationRatio (.7).freeflyerRoot (true).generate ("tree");
+  checkForwardKinematics (device);
+}
+
+// Batched forward kinematics gives the same positions as one
+// configuration at a time, whatever the number of configurations with
+// respect to the block size.
+BOOST_AUTO_TEST_CASE (batch)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (20).branching (2)
+    .rotationRatio (.7).freeflyerRoot (true).generate ("batch");
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  const std::size_t nbConfigs = 2 * hpp::model::KinematicTree::BLOCK_SIZE + 3;
+  const std::size_t nbDof = tree->numberDof ();
+  const std::size_t size = 12 * tree->nbJoints ();
+  Random random (3);
+  vectorN q;
+  std::vector<double> configs (nbConfigs * nbDof);
+  for (std::size_t k = 0; k < nbConfigs; ++k) {
+    randomConfiguration (*tree, random, q);
+    for (std::size_t i = 0; i < nbDof; ++i) {
+      configs [k * nbDof + i] = q [i];
+    }
+  }
+  std::vector<double> batch (nbConfigs * size);
+  tree->forwardKinematics (&configs [0], nbConfigs, &batch [0]);
+  std::vector<double> single (size);
+  for (std::size_t k = 0; k < nbConfigs; ++k) {
+    tree->forwardKinematics (&configs [k * nbDof], &single [0]);
+    for (std::size_t e = 0; e < size; ++e) {
+      BOOST_CHECK_SMALL (batch [k * size + e] - single [e], 1e-12);
+    }
+  }
+}
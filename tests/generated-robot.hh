@@ -0,0 +1,81 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_MODEL_TESTS_GENERATED_ROBOT_HH
+# define HPP_MODEL_TESTS_GENERATED_ROBOT_HH
+
+# include <cmath>
+# include <vector>
+
+# include <boost/test/unit_test.hpp>
+
+# include <KineoModel/kppLicense.h>
+# include <jrl/mal/matrixabstractlayer.hh>
+
+# include "hpp/model/device.hh"
+# include "hpp/model/exception.hh"
+# include "hpp/model/kinematic-tree.hh"
+
+# include "robot-generator.hh"
+
+// Helpers shared by the tests run on devices built by
+// benchmark::RobotGenerator.
+
+/// Validate the Kineo license before test cases create components.
+struct KineoLicense
+{
+  KineoLicense ()
+  {
+    if (!CkppLicense::initialize ()) {
+      throw hpp::model::Exception ("failed to validate Kineo license.");
+    }
+  }
+};
+
+BOOST_GLOBAL_FIXTURE (KineoLicense);
+
+/// Draw a configuration within the bounds of the degrees of freedom.
+/// Unbounded degrees of freedom are drawn in [-1, 1].
+inline void randomConfiguration (const hpp::model::KinematicTree& tree,
+				 hpp::model::benchmark::Random& random,
+				 vectorN& config)
+{
+  MAL_VECTOR_RESIZE (config, tree.numberDof ());
+  for (std::size_t i = 0; i < tree.numberDof (); ++i) {
+    const double lower = tree.lowerBound (i);
+    const double upper = tree.upperBound (i);
+    if (lower < upper && lower > -1e10 && upper < 1e10) {
+      config [i] = random.uniform (lower, upper);
+    } else {
+      config [i] = random.uniform (-1, 1);
+    }
+  }
+}
+
+/// Copy a configuration into an array of doubles.
+inline std::vector<double> toArray (const vectorN& config)
+{
+  std::vector<double> result (config.size () + 1);
+  for (std::size_t i = 0; i < config.size (); ++i) {
+    result [i] = config [i];
+  }
+  return result;
+}
+
+#endif // HPP_MODEL_TESTS_GENERATED_ROBOT_HH
@@ -0,0 +1,198 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE GEOMETRY_STORE
+#include <boost/test/unit_test.hpp>
+
+#include <KineoKCDModel/kppKCDPolyhedron.h>
+
+#include "hpp/model/capsule-fitter.hh"
+#include "hpp/model/exception.hh"
+#include "hpp/model/geometry-store.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::CapsuleFitter;
+using hpp::model::Exception;
+using hpp::model::GeometryStore;
+using hpp::model::GeometryStoreShPtr;
+
+namespace {
+  // Sizes of the file format: header, then one record per mesh.
+  const std::size_t headerSize = 48;
+  const std::size_t meshRecordSize = 96;
+
+  // Tetrahedron translated along x.
+  GeometryStore::Mesh tetrahedron (const std::string& name, double x)
+  {
+    GeometryStore::Mesh result;
+    result.name = name;
+    const double vertices [12] = {x, 0, 0,  x + 1, 0, 0,  x, 1, 0,  x, 0, 1};
+    result.vertices.assign (vertices, vertices + 12);
+    const uint32_t triangles [12] = {0, 2, 1,  0, 1, 3,  0, 3, 2,  1, 2, 3};
+    result.triangles.assign (triangles, triangles + 12);
+    return result;
+  }
+
+  std::vector<GeometryStore::Mesh> meshes ()
+  {
+    std::vector<GeometryStore::Mesh> result;
+    // Not sorted by name.
+    result.push_back (tetrahedron ("zeta", 0));
+    result.push_back (tetrahedron ("alpha", 2));
+    result.push_back (tetrahedron ("mu", -3));
+    return result;
+  }
+
+  std::string readFile (const std::string& filename)
+  {
+    std::ifstream file (filename.c_str (), std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf ();
+    return content.str ();
+  }
+
+  void writeFile (const std::string& filename, const std::string& content)
+  {
+    std::ofstream file (filename.c_str (),
+			std::ios::binary | std::ios::trunc);
+    file.write (content.data (), content.size ());
+  }
+
+  bool rejected (const std::string& filename)
+  {
+    try {
+      GeometryStore::open (filename);
+    } catch (const Exception&) {
+      return true;
+    }
+    return false;
+  }
+} // namespace
+
+// Meshes written are found by name with their vertices, triangles and
+// bounding box.
+BOOST_AUTO_TEST_CASE (round_trip)
+{
+  const std::string filename ("./geometry-store-round-trip.store");
+  const std::vector<GeometryStore::Mesh> expected = meshes ();
+  GeometryStore::write (filename, expected);
+  GeometryStoreShPtr store = GeometryStore::open (filename);
+  BOOST_CHECK_EQUAL (store->filename (), filename);
+  BOOST_CHECK (GeometryStore::open ("././" + filename) == store);
+  BOOST_REQUIRE_EQUAL (store->nbMeshes (), expected.size ());
+  BOOST_CHECK_EQUAL (store->meshIndex ("beta"), SIZE_MAX);
+  BOOST_CHECK_EQUAL (store->meshIndex (""), SIZE_MAX);
+  for (std::size_t i = 0; i < expected.size (); ++i) {
+    const GeometryStore::Mesh& mesh = expected [i];
+    const std::size_t index = store->meshIndex (mesh.name);
+    BOOST_REQUIRE (index != SIZE_MAX);
+    BOOST_CHECK_EQUAL (store->meshName (index), mesh.name);
+    BOOST_REQUIRE_EQUAL (3 * store->nbVertices (index), mesh.vertices.size ());
+    BOOST_CHECK (std::equal (mesh.vertices.begin (), mesh.vertices.end (),
+			     store->vertices (index)));
+    BOOST_REQUIRE_EQUAL (3 * store->nbTriangles (index),
+			 mesh.triangles.size ());
+    BOOST_CHECK (std::equal (mesh.triangles.begin (), mesh.triangles.end (),
+			     store->triangles (index)));
+    const double* box = store->boundingBox (index);
+    BOOST_CHECK_EQUAL (box [0], mesh.vertices [0]);
+    BOOST_CHECK_EQUAL (box [3], mesh.vertices [0] + 1);
+    for (std::size_t k = 1; k < 3; ++k) {
+      BOOST_CHECK_EQUAL (box [k], 0);
+      BOOST_CHECK_EQUAL (box [3 + k], 1);
+    }
+
+    CkppKCDPolyhedronShPtr polyhedron =
+      store->buildPolyhedron (index, mesh.name + "-polyhedron");
+    BOOST_CHECK_EQUAL (polyhedron->name (), mesh.name + "-polyhedron");
+    std::vector<double> vertices;
+    std::vector<uint32_t> triangles;
+    BOOST_REQUIRE (CapsuleFitter::mesh
+		   (KIT_DYNAMIC_PTR_CAST (CkcdObject, polyhedron), vertices,
+		    triangles));
+    BOOST_CHECK (vertices == mesh.vertices);
+    BOOST_CHECK (triangles == mesh.triangles);
+  }
+}
+
+// Ill-formed meshes and meshes with the same name are not written.
+BOOST_AUTO_TEST_CASE (ill_formed)
+{
+  const std::string filename ("./geometry-store-ill-formed.store");
+  std::vector<GeometryStore::Mesh> input = meshes ();
+  input [1].triangles [4] = 4;
+  BOOST_CHECK_THROW (GeometryStore::write (filename, input), Exception);
+  input = meshes ();
+  input [2].vertices.pop_back ();
+  BOOST_CHECK_THROW (GeometryStore::write (filename, input), Exception);
+  input = meshes ();
+  input [2].name = input [0].name;
+  BOOST_CHECK_THROW (GeometryStore::write (filename, input), Exception);
+}
+
+// Truncated and corrupted files are rejected, in particular triangles
+// referring to vertices outside their mesh.
+BOOST_AUTO_TEST_CASE (corrupted)
+{
+  const std::string filename ("./geometry-store-corrupted.store");
+  const std::string corrupted ("./geometry-store-corrupted-copy.store");
+  const std::vector<GeometryStore::Mesh> input = meshes ();
+  GeometryStore::write (filename, input);
+  const std::string content = readFile (filename);
+  BOOST_REQUIRE (!rejected (filename));
+
+  BOOST_CHECK (rejected ("./geometry-store-missing.store"));
+  writeFile (corrupted, content.substr (0, 20));
+  BOOST_CHECK (rejected (corrupted));
+  writeFile (corrupted, content.substr (0, content.size () - 1));
+  BOOST_CHECK (rejected (corrupted));
+
+  std::string copy = content;
+  copy [0] = 'X';
+  writeFile (corrupted, copy);
+  BOOST_CHECK (rejected (corrupted));
+
+  // Each mesh has 4 vertices: index 4 is outside the first mesh but
+  // inside the store.
+  copy = content;
+  const std::size_t trianglesOffset = headerSize +
+    input.size () * meshRecordSize + 3 * 4 * input.size () * sizeof (double);
+  const uint32_t index = 4;
+  memcpy (&copy [trianglesOffset], &index, sizeof (index));
+  writeFile (corrupted, copy);
+  BOOST_CHECK (rejected (corrupted));
+
+  // First vertex of a mesh whose sum with its number of vertices
+  // overflows.
+  copy = content;
+  const uint64_t firstVertex = ~uint64_t (0);
+  memcpy (&copy [headerSize + 16], &firstVertex, sizeof (firstVertex));
+  writeFile (corrupted, copy);
+  BOOST_CHECK (rejected (corrupted));
+}
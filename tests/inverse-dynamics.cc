@@ -0,0 +1,134 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <string>
+
+#define BOOST_TEST_MODULE INVERSE_DYNAMICS
+#include <boost/test/unit_test.hpp>
+
+#include "hpp/model/device.hh"
+#include "hpp/model/inverse-dynamics.hh"
+#include "hpp/model/kinematic-tree.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::DeviceShPtr;
+using hpp::model::InverseDynamics;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  void setProperty (const DeviceShPtr& device, const std::string& name)
+  {
+    std::string property (name);
+    device->setProperty (property, "true");
+  }
+
+  // Torques computed by jrl-dynamics for (q, dq, ddq).
+  void jrlTorques (const DeviceShPtr& device, const vectorN& q,
+		   const vectorN& dq, const vectorN& ddq,
+		   std::vector<double>& outTorques)
+  {
+    device->currentConfiguration (q);
+    device->currentVelocity (dq);
+    device->currentAcceleration (ddq);
+    device->computeForwardKinematics ();
+    const vectorN& torques = device->currentJointTorques ();
+    outTorques.resize (q.size ());
+    for (std::size_t i = 0; i < q.size (); ++i) {
+      outTorques [i] = torques [i];
+    }
+  }
+
+  // Compare recursive Newton-Euler torques of a fixed-base device to
+  // jrl-dynamics, with or without velocity and acceleration.
+  void checkTorques (bool moving)
+  {
+    DeviceShPtr device = RobotGenerator ().nbJoints (20).branching (2)
+      .rotationRatio (.7).mass (2.).generate ("inverse-dynamics");
+    setProperty (device, "ComputeVelocity");
+    setProperty (device, "ComputeAcceleration");
+    setProperty (device, "ComputeBackwardDynamics");
+    const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+    const std::size_t nbDof = tree->numberDof ();
+    InverseDynamics inverseDynamics (tree);
+    Random random (17);
+    vectorN q, dq (nbDof), ddq (nbDof);
+    std::vector<double> torques (nbDof), expected;
+    for (std::size_t k = 0; k < 10; ++k) {
+      randomConfiguration (*tree, random, q);
+      for (std::size_t i = 0; i < nbDof; ++i) {
+	dq [i] = moving ? random.uniform (-1, 1) : 0;
+	ddq [i] = moving ? random.uniform (-1, 1) : 0;
+      }
+      inverseDynamics.compute (&toArray (q) [0], &toArray (dq) [0],
+			       &toArray (ddq) [0], &torques [0]);
+      jrlTorques (device, q, dq, ddq, expected);
+      for (std::size_t i = 0; i < nbDof; ++i) {
+	BOOST_CHECK_SMALL (torques [i] - expected [i], 1e-8);
+      }
+    }
+  }
+} // namespace
+
+BOOST_AUTO_TEST_CASE (gravity_torques)
+{
+  checkTorques (false);
+}
+
+BOOST_AUTO_TEST_CASE (dynamic_torques)
+{
+  checkTorques (true);
+}
+
+// Trajectory computation by blocks gives the same torques as samples
+// processed one at a time.
+BOOST_AUTO_TEST_CASE (trajectory)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (20).branching (2)
+    .rotationRatio (.7).freeflyerRoot (true).mass (2.)
+    .generate ("trajectory");
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  const std::size_t nbDof = tree->numberDof ();
+  const std::size_t nbSamples = 2 * hpp::model::KinematicTree::BLOCK_SIZE + 1;
+  InverseDynamics inverseDynamics (tree);
+  Random random (19);
+  vectorN config;
+  std::vector<double> q (nbSamples * nbDof), dq (nbSamples * nbDof),
+    ddq (nbSamples * nbDof);
+  for (std::size_t k = 0; k < nbSamples; ++k) {
+    randomConfiguration (*tree, random, config);
+    for (std::size_t i = 0; i < nbDof; ++i) {
+      q [k * nbDof + i] = config [i];
+      dq [k * nbDof + i] = random.uniform (-1, 1);
+      ddq [k * nbDof + i] = random.uniform (-1, 1);
+    }
+  }
+  std::vector<double> trajectory (nbSamples * nbDof), single (nbDof);
+  inverseDynamics.computeTrajectory (&q [0], &dq [0], &ddq [0], nbSamples,
+				     &trajectory [0]);
+  for (std::size_t k = 0; k < nbSamples; ++k) {
+    inverseDynamics.compute (&q [k * nbDof], &dq [k * nbDof],
+			     &ddq [k * nbDof], &single [0]);
+    for (std::size_t i = 0; i < nbDof; ++i) {
+      BOOST_CHECK_SMALL (trajectory [k * nbDof + i] - single [i], 1e-9);
+    }
+  }
+}
@@ -0,0 +1,142 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE JACOBIANS
+#include <boost/test/unit_test.hpp>
+
+#include <abstract-robot-dynamics/joint.hh>
+
+#include "hpp/model/device.hh"
+#include "hpp/model/joint.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/sparse-jacobian.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::DeviceShPtr;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::SparseJacobian;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+// Jacobians of a fixed-base device are compared to jrl-dynamics. With a
+// freeflyer root, columns of jrl-dynamics are angular velocities while
+// the ones of the tree are derivatives with respect to roll, pitch and
+// yaw: Jacobians are then compared to finite differences of forward
+// kinematics.
+
+BOOST_AUTO_TEST_CASE (jrl_dynamics)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (25).branching (2)
+    .rotationRatio (.7).mass (1.).generate ("fixed-base");
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  const std::size_t nbDof = tree->numberDof ();
+  std::vector<SparseJacobian> jacobians;
+  SparseJacobian comJacobian;
+  Random random (11);
+  vectorN q;
+  for (std::size_t k = 0; k < 10; ++k) {
+    randomConfiguration (*tree, random, q);
+    device->hppSetCurrentConfig (q, hpp::model::Device::DYNAMIC);
+    tree->computeJacobians (&toArray (q) [0], jacobians, comJacobian);
+    BOOST_REQUIRE_EQUAL (jacobians.size (), tree->nbJoints ());
+    for (std::size_t j = 0; j < tree->nbJoints (); ++j) {
+      CjrlJoint* joint = tree->joint (j)->jrlJoint ();
+      joint->computeJacobianJointWrtConfig ();
+      const matrixNxP& expected = joint->jacobianJointWrtConfig ();
+      for (std::size_t r = 0; r < 6; ++r) {
+	for (std::size_t dof = 0; dof < nbDof; ++dof) {
+	  BOOST_CHECK_SMALL (jacobians [j] (r, dof) -
+			     expected (r, dof), 1e-10);
+	}
+      }
+    }
+    device->computeJacobianCenterOfMass ();
+    const matrixNxP& expected = device->jacobianCenterOfMass ();
+    for (std::size_t r = 0; r < 3; ++r) {
+      for (std::size_t dof = 0; dof < nbDof; ++dof) {
+	BOOST_CHECK_SMALL (comJacobian (r, dof) -
+			   expected (r, dof), 1e-10);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE (finite_differences)
+{
+  DeviceShPtr device = RobotGenerator ().nbJoints (25).branching (3)
+    .rotationRatio (.7).freeflyerRoot (true).mass (1.)
+    .generate ("freeflyer");
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  const std::size_t nbDof = tree->numberDof ();
+  const std::size_t nbJoints = tree->nbJoints ();
+  const double h = 1e-6;
+  std::vector<SparseJacobian> jacobians;
+  SparseJacobian comJacobian;
+  std::vector<double> m (12 * nbJoints), plus (12 * nbJoints),
+    minus (12 * nbJoints);
+  double comPlus [3], comMinus [3];
+  Random random (13);
+  vectorN config;
+  for (std::size_t k = 0; k < 5; ++k) {
+    randomConfiguration (*tree, random, config);
+    std::vector<double> q = toArray (config);
+    tree->computeJacobians (&q [0], jacobians, comJacobian);
+    tree->forwardKinematics (&q [0], &m [0]);
+    for (std::size_t dof = 0; dof < nbDof; ++dof) {
+      const double value = q [dof];
+      q [dof] = value + h;
+      tree->forwardKinematics (&q [0], &plus [0]);
+      tree->centerOfMass (&q [0], comPlus);
+      q [dof] = value - h;
+      tree->forwardKinematics (&q [0], &minus [0]);
+      tree->centerOfMass (&q [0], comMinus);
+      q [dof] = value;
+      for (std::size_t j = 0; j < nbJoints; ++j) {
+	const double* R = &m [12*j];
+	// Derivative of the position and of the rotation matrix.
+	double dp [3], dR [9];
+	for (std::size_t r = 0; r < 3; ++r) {
+	  dp [r] = (plus [12*j + 4*r + 3] - minus [12*j + 4*r + 3]) / (2*h);
+	  for (std::size_t c = 0; c < 3; ++c) {
+	    dR [3*r + c] =
+	      (plus [12*j + 4*r + c] - minus [12*j + 4*r + c]) / (2*h);
+	  }
+	}
+	// Angular velocity: dR R^T is the skew-symmetric matrix of w.
+	double S [9];
+	for (std::size_t r = 0; r < 3; ++r) {
+	  for (std::size_t c = 0; c < 3; ++c) {
+	    S [3*r + c] = dR [3*r] * R [4*c] + dR [3*r + 1] * R [4*c + 1]
+	      + dR [3*r + 2] * R [4*c + 2];
+	  }
+	}
+	const double w [3] = {S [7], S [2], S [3]};
+	for (std::size_t r = 0; r < 3; ++r) {
+	  BOOST_CHECK_SMALL (jacobians [j] (r, dof) - dp [r], 1e-6);
+	  BOOST_CHECK_SMALL (jacobians [j] (3 + r, dof) - w [r], 1e-6);
+	}
+      }
+      for (std::size_t r = 0; r < 3; ++r) {
+	BOOST_CHECK_SMALL (comJacobian (r, dof) -
+			   (comPlus [r] - comMinus [r]) / (2*h), 1e-6);
+      }
+    }
+  }
+}
@@ -0,0 +1,170 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#define BOOST_TEST_MODULE KXML_WRITER
+#include <boost/test/unit_test.hpp>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <KineoUtility/kitParameterMap.h>
+#include <KineoModel/kppComponentFactoryRegistry.h>
+#include <KineoModel/kppSolidComponentRef.h>
+#include <KineoController/kppDocument.h>
+#include <KineoKCDModel/kppKCDPolyhedron.h>
+#include <kprParserXML/kprParserManager.h>
+
+#include "hpp/model/capsule-fitter.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/joint.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/kxml-writer.hh"
+#include "hpp/model/parser.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::CapsuleFitter;
+using hpp::model::Device;
+using hpp::model::DeviceShPtr;
+using hpp::model::KinematicTree;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::KxmlWriter;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  // Box of 8 vertices and 12 triangles.
+  CkppKCDPolyhedronShPtr createBox (const std::string& name)
+  {
+    CkppKCDPolyhedronShPtr box = CkppKCDPolyhedron::create (name);
+    unsigned int rank;
+    for (unsigned int i = 0; i < 8; ++i) {
+      box->addPoint (i & 1 ? .05 : -.05, i & 2 ? .02 : -.02,
+		     i & 4 ? .1 : 0, rank);
+    }
+    const unsigned int triangles [36] = {0, 2, 1,  1, 2, 3,  4, 5, 6,
+					 5, 7, 6,  0, 1, 4,  1, 5, 4,
+					 2, 6, 3,  3, 6, 7,  0, 4, 2,
+					 2, 4, 6,  1, 3, 5,  3, 7, 5};
+    for (unsigned int i = 0; i < 12; ++i) {
+      box->addTriangle (triangles [3*i], triangles [3*i + 1],
+			triangles [3*i + 2], rank);
+    }
+    box->makeCollisionEntity (CkcdObject::IMMEDIATE_BUILD);
+    return box;
+  }
+
+  CkppComponentShPtr findComponent (const CkppComponentShPtr& component,
+				    const std::string& name)
+  {
+    if (component->name () == name) return component;
+    for (unsigned int i = 0; i < component->countChildComponents (); ++i) {
+      CkppComponentShPtr result =
+	findComponent (component->childComponent (i), name);
+      if (result) return result;
+    }
+    return CkppComponentShPtr ();
+  }
+
+  CkppComponentShPtr load (const std::string& filename)
+  {
+    CkprParserManagerShPtr parser = CkprParserManager::defaultManager ();
+    CkppDocumentShPtr document =
+      CkppDocument::create (parser->moduleManager ());
+    CkppComponentShPtr component;
+    BOOST_REQUIRE (parser->loadComponentFromFile
+		   (filename, component,
+		    document->componentFactoryRegistry (),
+		    CkitParameterMap::create ()) == KD_OK);
+    return component;
+  }
+
+  std::string readFile (const std::string& filename, bool gzip)
+  {
+    std::ifstream file (filename.c_str (), std::ios::binary);
+    boost::iostreams::filtering_istream stream;
+    if (gzip) {
+      stream.push (boost::iostreams::gzip_decompressor ());
+    }
+    stream.push (file);
+    std::ostringstream content;
+    boost::iostreams::copy (stream, content);
+    return content.str ();
+  }
+} // namespace
+
+// Write a generated humanoid robot, whose tag is read by Parser, with a
+// polyhedron, parse the file and compare the kinematic chain and the
+// geometry.
+BOOST_AUTO_TEST_CASE (round_trip)
+{
+  hpp::model::Parser extra (true);
+  DeviceShPtr device = RobotGenerator ().nbJoints (10).branching (2)
+    .rotationRatio (.6).freeflyerRoot (true).humanoid (true)
+    .capsulesPerBody (0).generate ("round-trip");
+  CkppKCDPolyhedronShPtr box = createBox ("box");
+  device->getRootJoint ()->kppJoint ()->addSolidComponentRef
+    (CkppSolidComponentRef::create (box));
+
+  const std::string filename ("./kxml-writer-round-trip.kxml");
+  KxmlWriter::writeToFile (filename, device);
+  CkppComponentShPtr component = load (filename);
+
+  DeviceShPtr loaded = KIT_DYNAMIC_PTR_CAST (Device, component);
+  BOOST_REQUIRE (loaded);
+  BOOST_CHECK_EQUAL (loaded->name (), device->name ());
+  loaded->initialize ();
+  const KinematicTreeConstShPtr& expected = device->kinematicTree ();
+  const KinematicTreeConstShPtr& tree = loaded->kinematicTree ();
+  BOOST_REQUIRE_EQUAL (tree->nbJoints (), expected->nbJoints ());
+  BOOST_REQUIRE_EQUAL (tree->numberDof (), expected->numberDof ());
+  for (std::size_t j = 0; j < tree->nbJoints (); ++j) {
+    BOOST_CHECK_EQUAL (tree->jointName (j), expected->jointName (j));
+    BOOST_CHECK_EQUAL (tree->jointType (j), expected->jointType (j));
+    BOOST_CHECK_EQUAL (tree->parent (j), expected->parent (j));
+    for (std::size_t e = 0; e < 12; ++e) {
+      BOOST_CHECK_SMALL (tree->staticTransform (j) [e] -
+			 expected->staticTransform (j) [e], 1e-12);
+    }
+  }
+  for (std::size_t dof = 0; dof < tree->numberDof (); ++dof) {
+    BOOST_CHECK_EQUAL (tree->lowerBound (dof), expected->lowerBound (dof));
+    BOOST_CHECK_EQUAL (tree->upperBound (dof), expected->upperBound (dof));
+  }
+
+  std::vector<double> vertices, expectedVertices;
+  std::vector<uint32_t> triangles, expectedTriangles;
+  BOOST_REQUIRE (CapsuleFitter::mesh (KIT_DYNAMIC_PTR_CAST (CkcdObject, box),
+				      expectedVertices, expectedTriangles));
+  CkcdObjectShPtr loadedBox =
+    KIT_DYNAMIC_PTR_CAST (CkcdObject, findComponent (component, "box"));
+  BOOST_REQUIRE (CapsuleFitter::mesh (loadedBox, vertices, triangles));
+  BOOST_CHECK (vertices == expectedVertices);
+  BOOST_CHECK (triangles == expectedTriangles);
+
+  // Compressed output holds the same document.
+  const std::string gzFilename ("./kxml-writer-round-trip.kxml.gz");
+  KxmlWriter::writeToFile (gzFilename, device, KxmlWriter::GZIP);
+  BOOST_CHECK (readFile (gzFilename, true) == readFile (filename, false));
+}
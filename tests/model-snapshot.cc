@@ -0,0 +1,215 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE MODEL_SNAPSHOT
+#include <boost/test/unit_test.hpp>
+
+#include "hpp/model/body-distance.hh"
+#include "hpp/model/humanoid-robot.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/model-snapshot.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::HumanoidRobot;
+using hpp::model::HumanoidRobotShPtr;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::ModelSnapshot;
+using hpp::model::ModelSnapshotShPtr;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  // Offset of the number of joints in the header of the file format.
+  const std::size_t nbJointsOffset = 32;
+
+  std::size_t nbBuilds = 0;
+
+  HumanoidRobotShPtr generateRobot (std::size_t nbJoints)
+  {
+    HumanoidRobotShPtr robot = KIT_DYNAMIC_PTR_CAST
+      (HumanoidRobot, RobotGenerator ().nbJoints (nbJoints).branching (2)
+       .rotationRatio (.6).freeflyerRoot (true).humanoid (true)
+       .capsulesPerBody (1).generate ("model-snapshot"));
+    BOOST_REQUIRE (robot);
+    return robot;
+  }
+
+  // Builder standing for a KXML parse: snapshots only depend on the
+  // content hash of the source file.
+  HumanoidRobotShPtr build (const std::string&)
+  {
+    ++nbBuilds;
+    return generateRobot (12);
+  }
+
+  std::string readFile (const std::string& filename)
+  {
+    std::ifstream file (filename.c_str (), std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf ();
+    return content.str ();
+  }
+
+  void writeFile (const std::string& filename, const std::string& content)
+  {
+    std::ofstream file (filename.c_str (),
+			std::ios::binary | std::ios::trunc);
+    file.write (content.data (), content.size ());
+  }
+} // namespace
+
+// A loaded snapshot has the kinematic tree of the robot it was written
+// from: same description and same forward kinematics.
+BOOST_AUTO_TEST_CASE (round_trip)
+{
+  HumanoidRobotShPtr robot = generateRobot (16);
+  const std::string filename ("./model-snapshot-round-trip.snap");
+  ModelSnapshot::write (filename, *robot, 42);
+  BOOST_CHECK (!ModelSnapshot::load (filename, 43));
+  ModelSnapshotShPtr snapshot = ModelSnapshot::load (filename, 42);
+  BOOST_REQUIRE (snapshot);
+  BOOST_CHECK_EQUAL (snapshot->hash (), 42u);
+
+  const KinematicTreeConstShPtr& expected = robot->kinematicTree ();
+  const KinematicTreeConstShPtr& tree = snapshot->kinematicTree ();
+  BOOST_REQUIRE_EQUAL (tree->nbJoints (), expected->nbJoints ());
+  BOOST_REQUIRE_EQUAL (tree->numberDof (), expected->numberDof ());
+  for (std::size_t j = 0; j < tree->nbJoints (); ++j) {
+    BOOST_CHECK_EQUAL (tree->jointName (j), expected->jointName (j));
+    BOOST_CHECK_EQUAL (tree->jointType (j), expected->jointType (j));
+    BOOST_CHECK_EQUAL (tree->parent (j), expected->parent (j));
+    BOOST_CHECK_EQUAL (tree->rankInConfiguration (j),
+		       expected->rankInConfiguration (j));
+    BOOST_CHECK (!tree->joint (j));
+  }
+  for (std::size_t dof = 0; dof < tree->numberDof (); ++dof) {
+    BOOST_CHECK_EQUAL (tree->lowerBound (dof), expected->lowerBound (dof));
+    BOOST_CHECK_EQUAL (tree->upperBound (dof), expected->upperBound (dof));
+  }
+
+  Random random (13);
+  vectorN q;
+  std::vector<double> transforms (12 * tree->nbJoints ()),
+    expectedTransforms (12 * tree->nbJoints ());
+  for (std::size_t k = 0; k < 10; ++k) {
+    randomConfiguration (*expected, random, q);
+    const std::vector<double> config = toArray (q);
+    tree->forwardKinematics (&config [0], &transforms [0]);
+    expected->forwardKinematics (&config [0], &expectedTransforms [0]);
+    BOOST_CHECK (transforms == expectedTransforms);
+  }
+
+  const std::vector<hpp::model::BodyDistanceShPtr>& distances =
+    robot->bodyDistances ();
+  BOOST_REQUIRE_EQUAL (snapshot->nbBodyDistances (), distances.size ());
+  for (std::size_t i = 0; i < distances.size (); ++i) {
+    BOOST_CHECK_EQUAL (snapshot->bodyDistanceName (i), distances [i]->name ());
+    BOOST_CHECK_EQUAL (snapshot->nbDistPairs (i),
+		       distances [i]->nbDistPairs ());
+  }
+}
+
+// The robot is built only when the snapshot is missing or the source
+// changed.
+BOOST_AUTO_TEST_CASE (stale_source)
+{
+  const std::string source ("./model-snapshot-stale.kxml");
+  const std::string filename ("./model-snapshot-stale.snap");
+  writeFile (source, "<?xml version=\"1.0\"?>\n");
+  remove (filename.c_str ());
+  nbBuilds = 0;
+
+  HumanoidRobotShPtr robot;
+  ModelSnapshotShPtr snapshot =
+    ModelSnapshot::loadOrBuild (source, filename, &build, robot);
+  BOOST_REQUIRE (snapshot);
+  BOOST_CHECK_EQUAL (nbBuilds, 1u);
+  BOOST_REQUIRE (robot);
+  BOOST_CHECK_EQUAL (snapshot->kinematicTree ()->nbJoints (),
+		     robot->kinematicTree ()->nbJoints ());
+  BOOST_CHECK_EQUAL (snapshot->hash (), ModelSnapshot::sourceHash (source));
+
+  // Up to date
+  snapshot = ModelSnapshot::loadOrBuild (source, filename, &build, robot);
+  BOOST_REQUIRE (snapshot);
+  BOOST_CHECK_EQUAL (nbBuilds, 1u);
+  BOOST_CHECK (!robot);
+
+  // Stale
+  const uint64_t hash = ModelSnapshot::sourceHash (source);
+  writeFile (source, "<?xml version=\"1.0\"?>\n<!-- modified -->\n");
+  BOOST_CHECK (ModelSnapshot::sourceHash (source) != hash);
+  BOOST_CHECK (!ModelSnapshot::load (filename,
+				     ModelSnapshot::sourceHash (source)));
+  snapshot = ModelSnapshot::loadOrBuild (source, filename, &build, robot);
+  BOOST_REQUIRE (snapshot);
+  BOOST_CHECK_EQUAL (nbBuilds, 2u);
+  BOOST_CHECK (robot);
+  BOOST_CHECK_EQUAL (snapshot->hash (), ModelSnapshot::sourceHash (source));
+}
+
+// Truncated files and headers whose sizes do not match the file are
+// rejected, and rebuilt by loadOrBuild ().
+BOOST_AUTO_TEST_CASE (truncated)
+{
+  HumanoidRobotShPtr robot = generateRobot (8);
+  const std::string filename ("./model-snapshot-truncated.snap");
+  const std::string corrupted ("./model-snapshot-truncated-copy.snap");
+  ModelSnapshot::write (filename, *robot, 7);
+  const std::string content = readFile (filename);
+  BOOST_REQUIRE (ModelSnapshot::load (filename, 7));
+
+  BOOST_CHECK (!ModelSnapshot::load ("./model-snapshot-missing.snap", 7));
+  writeFile (corrupted, content.substr (0, 10));
+  BOOST_CHECK (!ModelSnapshot::load (corrupted, 7));
+  writeFile (corrupted, content.substr (0, content.size () - 1));
+  BOOST_CHECK (!ModelSnapshot::load (corrupted, 7));
+  writeFile (corrupted, content + std::string (8, '\0'));
+  BOOST_CHECK (!ModelSnapshot::load (corrupted, 7));
+
+  std::string copy = content;
+  const uint64_t nbJoints = robot->kinematicTree ()->nbJoints () + 1;
+  memcpy (&copy [nbJointsOffset], &nbJoints, sizeof (nbJoints));
+  writeFile (corrupted, copy);
+  BOOST_CHECK (!ModelSnapshot::load (corrupted, 7));
+
+  // Truncated snapshot of the current source
+  const std::string source ("./model-snapshot-truncated.kxml");
+  writeFile (source, "<?xml version=\"1.0\"?>\n");
+  ModelSnapshot::write (corrupted, *robot,
+			ModelSnapshot::sourceHash (source));
+  copy = readFile (corrupted);
+  writeFile (corrupted, copy.substr (0, copy.size () / 2));
+  nbBuilds = 0;
+  HumanoidRobotShPtr built;
+  BOOST_CHECK (ModelSnapshot::loadOrBuild (source, corrupted, &build,
+					   built));
+  BOOST_CHECK_EQUAL (nbBuilds, 1u);
+  BOOST_CHECK (built);
+}
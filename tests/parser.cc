@@ -0,0 +1,298 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE PARSER
+#include <boost/test/unit_test.hpp>
+
+#include <KineoUtility/kitParameterMap.h>
+#include <KineoModel/kppComponentFactoryRegistry.h>
+#include <KineoModel/kppSolidComponentRef.h>
+#include <KineoController/kppDocument.h>
+#include <KineoKCDModel/kppKCDPolyhedron.h>
+#include <kprParserXML/kprParserManager.h>
+
+#include "hpp/model/capsule-fitter.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/geometry-store.hh"
+#include "hpp/model/joint.hh"
+#include "hpp/model/kxml-writer.hh"
+#include "hpp/model/parser.hh"
+
+#include "generated-robot.hh"
+
+using hpp::model::CapsuleFitter;
+using hpp::model::Device;
+using hpp::model::DeviceShPtr;
+using hpp::model::GeometryStore;
+using hpp::model::GeometryStoreShPtr;
+using hpp::model::JointShPtr;
+using hpp::model::KxmlWriter;
+using hpp::model::Parser;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  const std::size_t nbMeshes = 3;
+
+  // Box of 8 vertices and 12 triangles, scaled by (mesh + 1).
+  GeometryStore::Mesh box (std::size_t mesh)
+  {
+    GeometryStore::Mesh result;
+    std::ostringstream name;
+    name << "mesh-" << mesh;
+    result.name = name.str ();
+    const double scale = mesh + 1;
+    for (unsigned int i = 0; i < 8; ++i) {
+      result.vertices.push_back (scale * (i & 1 ? .05 : -.05));
+      result.vertices.push_back (scale * (i & 2 ? .02 : -.02));
+      result.vertices.push_back (scale * (i & 4 ? .1 : 0));
+    }
+    const uint32_t triangles [36] = {0, 2, 1,  1, 2, 3,  4, 5, 6,
+				     5, 7, 6,  0, 1, 4,  1, 5, 4,
+				     2, 6, 3,  3, 6, 7,  0, 4, 2,
+				     2, 4, 6,  1, 3, 5,  3, 7, 5};
+    result.triangles.assign (triangles, triangles + 36);
+    return result;
+  }
+
+  // Attach a polyhedron called "part-<i>" to every joint, i being the
+  // rank of the joint in depth first order.
+  void attachParts (const JointShPtr& joint, std::size_t& rank)
+  {
+    std::ostringstream name;
+    name << "part-" << rank++;
+    CkppKCDPolyhedronShPtr part = CkppKCDPolyhedron::create (name.str ());
+    GeometryStore::Mesh mesh = box (0);
+    unsigned int index;
+    for (std::size_t i = 0; i < mesh.vertices.size (); i += 3) {
+      part->addPoint (mesh.vertices [i], mesh.vertices [i + 1],
+		      mesh.vertices [i + 2], index);
+    }
+    for (std::size_t i = 0; i < mesh.triangles.size (); i += 3) {
+      part->addTriangle (mesh.triangles [i], mesh.triangles [i + 1],
+			 mesh.triangles [i + 2], index);
+    }
+    part->makeCollisionEntity (CkcdObject::IMMEDIATE_BUILD);
+    joint->kppJoint ()->addSolidComponentRef
+      (CkppSolidComponentRef::create (part));
+    for (unsigned int i = 0; i < joint->countChildJoints (); ++i) {
+      attachParts (joint->childJoint (i), rank);
+    }
+  }
+
+  std::string readFile (const std::string& filename)
+  {
+    std::ifstream file (filename.c_str ());
+    std::ostringstream content;
+    content << file.rdbuf ();
+    return content.str ();
+  }
+
+  // Replace the element of the polyhedron called name by a
+  // HPP_STORED_POLYHEDRON tag with the same attributes.
+  void storePolyhedron (std::string& document, const std::string& name,
+			const std::string& store, const std::string& mesh)
+  {
+    const std::size_t attribute = document.find (" name=\"" + name + "\"");
+    BOOST_REQUIRE (attribute != std::string::npos);
+    const std::size_t begin = document.rfind ('<', attribute);
+    const std::size_t tagEnd = document.find_first_of (" \t\n", begin);
+    const std::string tag = document.substr (begin + 1, tagEnd - begin - 1);
+    const std::size_t openEnd = document.find ('>', attribute);
+    BOOST_REQUIRE (openEnd != std::string::npos);
+    const bool empty = document [openEnd - 1] == '/';
+    std::size_t end = openEnd + 1;
+    if (!empty) {
+      end = document.find ("</" + tag + ">", openEnd);
+      BOOST_REQUIRE (end != std::string::npos);
+      end += tag.size () + 3;
+    }
+    const std::string attributes =
+      document.substr (tagEnd, openEnd - tagEnd - (empty ? 1 : 0));
+    document.replace (begin, end - begin,
+		      "<HPP_STORED_POLYHEDRON" + attributes + " store=\"" +
+		      store + "\" mesh=\"" + mesh + "\"/>");
+  }
+
+  CkppComponentShPtr findComponent (const CkppComponentShPtr& component,
+				    const std::string& name)
+  {
+    if (component->name () == name) return component;
+    for (unsigned int i = 0; i < component->countChildComponents (); ++i) {
+      CkppComponentShPtr result =
+	findComponent (component->childComponent (i), name);
+      if (result) return result;
+    }
+    return CkppComponentShPtr ();
+  }
+
+  CkppComponentShPtr load (Parser& parser, const std::string& filename)
+  {
+    CkppDocumentShPtr document = CkppDocument::create
+      (CkprParserManager::defaultManager ()->moduleManager ());
+    CkppComponentShPtr component;
+    BOOST_REQUIRE (parser.loadComponentFromFile
+		   (filename, component,
+		    document->componentFactoryRegistry (),
+		    CkitParameterMap::create ()) == KD_OK);
+    BOOST_REQUIRE (component);
+    return component;
+  }
+
+  // Write a generated robot whose parts are meshes of a store.
+  std::size_t writeModel (const std::string& filename,
+			  const std::string& storeFile)
+  {
+    std::vector<GeometryStore::Mesh> meshes;
+    for (std::size_t mesh = 0; mesh < nbMeshes; ++mesh) {
+      meshes.push_back (box (mesh));
+    }
+    GeometryStore::write (storeFile, meshes);
+
+    DeviceShPtr device = RobotGenerator ().nbJoints (12).branching (2)
+      .rotationRatio (.6).capsulesPerBody (0).generate ("parser");
+    std::size_t nbParts = 0;
+    attachParts (device->getRootJoint (), nbParts);
+    KxmlWriter::writeToFile (filename, device);
+
+    // Several parts share a mesh.
+    std::string document = readFile (filename);
+    for (std::size_t part = 0; part < nbParts; ++part) {
+      std::ostringstream name, mesh;
+      name << "part-" << part;
+      mesh << "mesh-" << part % nbMeshes;
+      storePolyhedron (document, name.str (), storeFile, mesh.str ());
+    }
+    std::ofstream file (filename.c_str ());
+    file << document;
+    return nbParts;
+  }
+} // namespace
+
+// Polyhedra built by the geometry threads are the ones built by the tag
+// builder, and the ones of the store.
+BOOST_AUTO_TEST_CASE (geometry_threads)
+{
+  Parser parser (true);
+  const std::string filename ("./parser-geometry-threads.kxml");
+  const std::string storeFile ("./parser-geometry-threads.store");
+  const std::size_t nbParts = writeModel (filename, storeFile);
+  GeometryStoreShPtr store = GeometryStore::open (storeFile);
+
+  BOOST_CHECK_EQUAL (parser.geometryThreads (), 0u);
+  CkppComponentShPtr expected = load (parser, filename);
+  parser.geometryThreads (3);
+  BOOST_CHECK_EQUAL (parser.geometryThreads (), 3u);
+  CkppComponentShPtr component = load (parser, filename);
+  parser.waitForGeometry ();
+
+  for (std::size_t part = 0; part < nbParts; ++part) {
+    std::ostringstream name;
+    name << "part-" << part;
+    std::vector<double> vertices, expectedVertices;
+    std::vector<uint32_t> triangles, expectedTriangles;
+    BOOST_REQUIRE (CapsuleFitter::mesh
+		   (KIT_DYNAMIC_PTR_CAST
+		    (CkcdObject, findComponent (expected, name.str ())),
+		    expectedVertices, expectedTriangles));
+    BOOST_REQUIRE (CapsuleFitter::mesh
+		   (KIT_DYNAMIC_PTR_CAST
+		    (CkcdObject, findComponent (component, name.str ())),
+		    vertices, triangles));
+    BOOST_CHECK (vertices == expectedVertices);
+    BOOST_CHECK (triangles == expectedTriangles);
+
+    std::ostringstream meshName;
+    meshName << "mesh-" << part % nbMeshes;
+    const std::size_t mesh = store->meshIndex (meshName.str ());
+    BOOST_REQUIRE (mesh != SIZE_MAX);
+    BOOST_REQUIRE_EQUAL (vertices.size (), 3 * store->nbVertices (mesh));
+    BOOST_CHECK (std::equal (vertices.begin (), vertices.end (),
+			     store->vertices (mesh)));
+    BOOST_REQUIRE_EQUAL (triangles.size (), 3 * store->nbTriangles (mesh));
+    BOOST_CHECK (std::equal (triangles.begin (), triangles.end (),
+			     store->triangles (mesh)));
+  }
+}
+
+// Lazily parsed polyhedra are empty, with the bounding box of their
+// mesh, until the device is initialized. They then hold the geometry
+// of the eager parse.
+BOOST_AUTO_TEST_CASE (lazy_geometry)
+{
+  Parser parser (true);
+  const std::string filename ("./parser-lazy-geometry.kxml");
+  const std::string storeFile ("./parser-lazy-geometry.store");
+  const std::size_t nbParts = writeModel (filename, storeFile);
+  GeometryStoreShPtr store = GeometryStore::open (storeFile);
+
+  BOOST_CHECK (!parser.lazyGeometry ());
+  CkppComponentShPtr expected = load (parser, filename);
+  const std::size_t nbDeferred = GeometryStore::nbDeferred ();
+  parser.lazyGeometry (true);
+  BOOST_CHECK (parser.lazyGeometry ());
+  CkppComponentShPtr component = load (parser, filename);
+  BOOST_CHECK_EQUAL (GeometryStore::nbDeferred (), nbDeferred + nbParts);
+
+  for (std::size_t part = 0; part < nbParts; ++part) {
+    std::ostringstream name, meshName;
+    name << "part-" << part;
+    meshName << "mesh-" << part % nbMeshes;
+    CkcdPolyhedronShPtr polyhedron = KIT_DYNAMIC_PTR_CAST
+      (CkcdPolyhedron, findComponent (component, name.str ()));
+    BOOST_REQUIRE (polyhedron);
+    BOOST_CHECK_EQUAL (polyhedron->countPoints (), 0u);
+    BOOST_CHECK_EQUAL (polyhedron->countTriangles (), 0u);
+    const std::size_t mesh = store->meshIndex (meshName.str ());
+    BOOST_REQUIRE (mesh != SIZE_MAX);
+    double box [6];
+    BOOST_REQUIRE (GeometryStore::deferredBoundingBox (polyhedron, box));
+    BOOST_CHECK (std::equal (box, box + 6, store->boundingBox (mesh)));
+  }
+
+  DeviceShPtr device = KIT_DYNAMIC_PTR_CAST (Device, component);
+  BOOST_REQUIRE (device);
+  device->initialize ();
+  BOOST_CHECK_EQUAL (GeometryStore::nbDeferred (), nbDeferred);
+
+  for (std::size_t part = 0; part < nbParts; ++part) {
+    std::ostringstream name;
+    name << "part-" << part;
+    CkcdObjectShPtr object = KIT_DYNAMIC_PTR_CAST
+      (CkcdObject, findComponent (component, name.str ()));
+    double box [6];
+    BOOST_CHECK (!GeometryStore::deferredBoundingBox (object, box));
+    BOOST_CHECK (!GeometryStore::loadDeferred (object));
+    std::vector<double> vertices, expectedVertices;
+    std::vector<uint32_t> triangles, expectedTriangles;
+    BOOST_REQUIRE (CapsuleFitter::mesh (object, vertices, triangles));
+    BOOST_REQUIRE (CapsuleFitter::mesh
+		   (KIT_DYNAMIC_PTR_CAST
+		    (CkcdObject, findComponent (expected, name.str ())),
+		    expectedVertices, expectedTriangles));
+    BOOST_CHECK (!vertices.empty ());
+    BOOST_CHECK (vertices == expectedVertices);
+    BOOST_CHECK (triangles == expectedTriangles);
+  }
+}
@@ -0,0 +1,177 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <vector>
+
+#define BOOST_TEST_MODULE SELF_DISTANCE_TABLE
+#include <boost/test/unit_test.hpp>
+
+#include <kcd2/kcdAnalysis.h>
+#include <kcd2/kcdExactDistanceReport.h>
+#include <kcd2/kcdPoint.h>
+
+#include "hpp/model/allowed-collision-matrix.hh"
+#include "hpp/model/device.hh"
+#include "hpp/model/kinematic-tree.hh"
+#include "hpp/model/self-distance-table.hh"
+
+#include "device-bodies.hh"
+#include "generated-robot.hh"
+
+using hpp::model::AllowedCollisionMatrix;
+using hpp::model::AllowedCollisionMatrixShPtr;
+using hpp::model::Bodies_t;
+using hpp::model::Device;
+using hpp::model::DeviceShPtr;
+using hpp::model::KinematicTreeConstShPtr;
+using hpp::model::SelfDistanceTable;
+using hpp::model::SelfDistanceTableShPtr;
+using hpp::model::benchmark::Random;
+using hpp::model::benchmark::RobotGenerator;
+
+namespace {
+  DeviceShPtr generateRobot (std::size_t capsulesPerBody)
+  {
+    return RobotGenerator ().nbJoints (10).branching (2).rotationRatio (.7)
+      .capsulesPerBody (capsulesPerBody).generate ("self-distance-table");
+  }
+
+  CkcdAnalysisShPtr exactDistance (const CkcdObjectShPtr& left,
+				   const CkcdObjectShPtr& right)
+  {
+    CkcdAnalysisShPtr analysis = CkcdAnalysis::create ();
+    analysis->analysisData ()->analysisType (CkcdAnalysisType::EXACT_DISTANCE);
+    analysis->analysisData ()->isToleranceActivated (false);
+    analysis->leftObject (left);
+    analysis->rightObject (right);
+    BOOST_REQUIRE (KD_SUCCEEDED (analysis->compute ()));
+    return analysis;
+  }
+} // namespace
+
+// Distances and closest points of the table are the ones of distance
+// analyses built for each pair of objects of different bodies.
+BOOST_AUTO_TEST_CASE (direct_analysis)
+{
+  DeviceShPtr device = generateRobot (2);
+  const KinematicTreeConstShPtr& tree = device->kinematicTree ();
+  SelfDistanceTableShPtr table = SelfDistanceTable::create (device);
+  BOOST_REQUIRE (table);
+  Bodies_t bodies;
+  std::vector<std::size_t> jointIds;
+  hpp::model::deviceBodies (*device, bodies, jointIds);
+  BOOST_REQUIRE_EQUAL (table->nbBodies (), bodies.size ());
+
+  Random random (31);
+  vectorN q;
+  std::size_t nbColliding = 0;
+  for (std::size_t k = 0; k < 4; ++k) {
+    randomConfiguration (*tree, random, q);
+    device->hppSetCurrentConfig (q, Device::BOTH);
+    const double minDistance = table->computeDistances ();
+    BOOST_REQUIRE (table->minPair () != SIZE_MAX);
+    BOOST_CHECK_EQUAL (minDistance, table->distance (table->minPair ()));
+
+    std::size_t p = 0;
+    double expectedMin = std::numeric_limits<double>::infinity ();
+    for (std::size_t i = 0; i < bodies.size (); ++i) {
+      for (std::size_t j = i + 1; j < bodies.size (); ++j) {
+	const std::vector<CkcdObjectShPtr>& objects1 =
+	  bodies [i]->mobileObjects ();
+	const std::vector<CkcdObjectShPtr>& objects2 =
+	  bodies [j]->mobileObjects ();
+	for (std::size_t o1 = 0; o1 < objects1.size (); ++o1) {
+	  for (std::size_t o2 = 0; o2 < objects2.size (); ++o2, ++p) {
+	    BOOST_REQUIRE (p < table->nbPairs ());
+	    BOOST_CHECK_EQUAL (table->body1 (p), i);
+	    BOOST_CHECK_EQUAL (table->body2 (p), j);
+	    CkcdAnalysisShPtr analysis =
+	      exactDistance (objects1 [o1], objects2 [o2]);
+	    CkcdPoint point1, point2;
+	    table->closestPoints (p, point1, point2);
+	    if (analysis->countExactDistanceReports () == 0) {
+	      ++nbColliding;
+	      BOOST_CHECK_EQUAL (table->distance (p), 0);
+	      BOOST_CHECK (!table->hasClosestPoints (p));
+	      BOOST_CHECK (point1 [0] != point1 [0]);
+	      expectedMin = 0;
+	      continue;
+	    }
+	    CkcdExactDistanceReportShPtr report =
+	      analysis->exactDistanceReport (0);
+	    CkcdPoint expected1, expected2;
+	    report->getPointsAbsolute (expected1, expected2);
+	    BOOST_CHECK_SMALL (table->distance (p) - report->distance (),
+			       1e-12);
+	    BOOST_REQUIRE (table->hasClosestPoints (p));
+	    for (std::size_t c = 0; c < 3; ++c) {
+	      BOOST_CHECK_SMALL (point1 [c] - expected1 [c], 1e-12);
+	      BOOST_CHECK_SMALL (point2 [c] - expected2 [c], 1e-12);
+	    }
+	    expectedMin = std::min (expectedMin, double (report->distance ()));
+	  }
+	}
+      }
+    }
+    BOOST_CHECK_EQUAL (p, table->nbPairs ());
+    BOOST_CHECK_SMALL (minDistance - expectedMin, 1e-12);
+  }
+  // Capsules of adjacent bodies overlap at their joint.
+  BOOST_CHECK (nbColliding > 0);
+}
+
+// Pairs of bodies allowed to collide are left out, other pairs of bodies
+// are stored once.
+BOOST_AUTO_TEST_CASE (allowed_collision_matrix)
+{
+  DeviceShPtr device = generateRobot (1);
+  AllowedCollisionMatrixShPtr matrix =
+    AllowedCollisionMatrix::generate (device, 50, 1, 3);
+  BOOST_REQUIRE (matrix);
+  SelfDistanceTableShPtr table = SelfDistanceTable::create (device, matrix);
+  BOOST_REQUIRE_EQUAL (table->nbBodies (), matrix->nbBodies ());
+  for (std::size_t i = 0; i < table->nbBodies (); ++i) {
+    BOOST_CHECK_EQUAL (table->bodyName (i), matrix->bodyName (i));
+  }
+
+  std::set<std::pair<std::size_t, std::size_t> > pairs;
+  for (std::size_t p = 0; p < table->nbPairs (); ++p) {
+    const std::size_t i = table->body1 (p), j = table->body2 (p);
+    BOOST_CHECK (i < j);
+    BOOST_CHECK (!matrix->isAllowed (i, j));
+    BOOST_CHECK (pairs.insert (std::make_pair (i, j)).second);
+  }
+  std::size_t nbExpected = 0;
+  for (std::size_t i = 0; i < matrix->nbBodies (); ++i) {
+    for (std::size_t j = i + 1; j < matrix->nbBodies (); ++j) {
+      if (!matrix->isAllowed (i, j)) ++nbExpected;
+    }
+  }
+  BOOST_CHECK_EQUAL (pairs.size (), nbExpected);
+  BOOST_CHECK (nbExpected < matrix->nbBodies () *
+	       (matrix->nbBodies () - 1) / 2);
+
+  // Without matrix, every pair of bodies is stored.
+  SelfDistanceTableShPtr all = SelfDistanceTable::create (device);
+  BOOST_CHECK_EQUAL (all->nbPairs (), matrix->nbBodies () *
+		     (matrix->nbBodies () - 1) / 2);
+}
@@ -0,0 +1,74 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+
+#define BOOST_TEST_MODULE STATIC_STABILITY
+#include <boost/test/unit_test.hpp>
+
+#include "hpp/model/static-stability.hh"
+
+using hpp::model::StaticStability;
+
+// Double support: left sole x in [-.1, .15], y in [.05, .15], right sole
+// x in [-.05, .2], y in [-.15, -.05]. Corners (.15, .05) and (-.05, -.05)
+// are inside the hull.
+static const double soleCorners [16] = {-.1, .05,  .15, .05,
+					 .15, .15, -.1, .15,
+					 -.05, -.15, .2, -.15,
+					 .2, -.05, -.05, -.05};
+
+static const double expectedHull [12] = {-.1, .05,  -.05, -.15,
+					  .2, -.15,  .2, -.05,
+					  .15, .15,  -.1, .15};
+
+BOOST_AUTO_TEST_CASE (support_polygon)
+{
+  double vertices [16];
+  const std::size_t n = StaticStability::convexHull (soleCorners, 8,
+						     vertices);
+  BOOST_REQUIRE_EQUAL (n, 6u);
+  for (std::size_t i = 0; i < 12; ++i) {
+    BOOST_CHECK_SMALL (vertices [i] - expectedHull [i], 1e-15);
+  }
+}
+
+BOOST_AUTO_TEST_CASE (margin)
+{
+  // Inside: closest edge is from (-.1, .05) to (-.05, -.15).
+  const double inside [2] = {0, 0};
+  BOOST_CHECK_CLOSE (StaticStability::signedDistance (expectedHull, 6,
+						      inside),
+		     .0175 / sqrt (.0425), 1e-9);
+  // Outside, in front of the edge y = .15.
+  const double front [2] = {.05, .25};
+  BOOST_CHECK_CLOSE (StaticStability::signedDistance (expectedHull, 6,
+						      front),
+		     -.1, 1e-9);
+  // Outside, closest to vertex (.2, -.15): the distance to the lines
+  // supporting the edges would be -.1.
+  const double corner [2] = {.3, -.25};
+  BOOST_CHECK_CLOSE (StaticStability::signedDistance (expectedHull, 6,
+						      corner),
+		     -sqrt (.02), 1e-9);
+  // On the boundary.
+  const double boundary [2] = {.2, -.1};
+  BOOST_CHECK_SMALL (StaticStability::signedDistance (expectedHull, 6,
+						      boundary), 1e-15);
+}
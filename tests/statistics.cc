@@ -0,0 +1,163 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdint.h>
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#define BOOST_TEST_MODULE STATISTICS
+#include <boost/test/unit_test.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "hpp/model/statistics.hh"
+
+#include "histogram.hh"
+
+using hpp::model::Histogram;
+using hpp::model::Statistics;
+
+namespace {
+  void countCalls (std::size_t nbCalls)
+  {
+    for (std::size_t i = 0; i < nbCalls; ++i) {
+      Statistics::Scope scope (Statistics::CREATE_COPY);
+    }
+  }
+
+  std::string written ()
+  {
+    std::ostringstream os;
+    Statistics::write (os);
+    return os.str ();
+  }
+} // namespace
+
+// Each value falls in the bucket whose upper bound is the first one not
+// below the value, with a relative width of at most 1/16.
+BOOST_AUTO_TEST_CASE (buckets)
+{
+  for (uint64_t value = 0; value < Histogram::nbSubBuckets; ++value) {
+    BOOST_CHECK_EQUAL (Histogram::bucket (value), value);
+    BOOST_CHECK_EQUAL (Histogram::bucketUpperBound (value), value);
+  }
+  for (unsigned int index = 0; index + 1 < Histogram::nbBuckets; ++index) {
+    const uint64_t upper = Histogram::bucketUpperBound (index);
+    BOOST_CHECK_EQUAL (Histogram::bucket (upper), index);
+    BOOST_CHECK_EQUAL (Histogram::bucket (upper + 1), index + 1);
+    if (index > 0) {
+      const uint64_t lower = Histogram::bucketUpperBound (index - 1) + 1;
+      BOOST_CHECK_EQUAL (Histogram::bucket (lower), index);
+      BOOST_CHECK (upper - lower <= lower / Histogram::nbSubBuckets);
+    }
+  }
+  const uint64_t max = std::numeric_limits<uint64_t>::max ();
+  BOOST_CHECK_EQUAL (Histogram::bucket (max), Histogram::nbBuckets - 1);
+  BOOST_CHECK_EQUAL (Histogram::bucketUpperBound (Histogram::nbBuckets - 1),
+		     max);
+}
+
+// Merging histograms adds their counts and buckets, percentiles are
+// upper bounds of buckets, within the range of the values.
+BOOST_AUTO_TEST_CASE (merge_and_percentiles)
+{
+  Histogram empty;
+  BOOST_CHECK_EQUAL (empty.percentile (50), 0u);
+
+  Histogram low, high;
+  for (uint64_t value = 1; value <= 50; ++value) {
+    ++low.count;
+    low.add (value);
+  }
+  for (uint64_t value = 51; value <= 100; ++value) {
+    ++high.count;
+    high.add (value);
+  }
+  Histogram result;
+  result.merge (low);
+  result.merge (high);
+  BOOST_CHECK_EQUAL (result.count, 100u);
+  BOOST_CHECK_EQUAL (result.samples, 100u);
+  BOOST_CHECK_EQUAL (result.total, 5050u);
+  BOOST_CHECK_EQUAL (result.min, 1u);
+  BOOST_CHECK_EQUAL (result.max, 100u);
+  for (unsigned int i = 0; i < Histogram::nbBuckets; ++i) {
+    BOOST_CHECK_EQUAL (result.buckets [i],
+		       low.buckets [i] + high.buckets [i]);
+  }
+
+  BOOST_CHECK_EQUAL (result.percentile (0), 1u);
+  BOOST_CHECK_EQUAL (result.percentile (10), 10u);
+  BOOST_CHECK_EQUAL (result.percentile (50),
+		     Histogram::bucketUpperBound (Histogram::bucket (50)));
+  BOOST_CHECK_EQUAL (result.percentile (99),
+		     Histogram::bucketUpperBound (Histogram::bucket (99)));
+  BOOST_CHECK_EQUAL (result.percentile (100), 100u);
+  for (double percent = 1; percent <= 100; percent += 1) {
+    const double percentile = result.percentile (percent);
+    BOOST_CHECK (percentile >= percent);
+    BOOST_CHECK (percentile <= percent * (1 + 1. / Histogram::nbSubBuckets));
+  }
+
+  // Clearing keeps the buckets.
+  result.clear ();
+  BOOST_CHECK_EQUAL (result.count, 0u);
+  BOOST_CHECK_EQUAL (result.samples, 0u);
+  BOOST_CHECK_EQUAL (result.buckets.size (), Histogram::nbBuckets);
+  BOOST_CHECK_EQUAL (result.percentile (50), 0u);
+}
+
+// Calls of terminated threads are still counted, until reset ().
+BOOST_AUTO_TEST_CASE (threads)
+{
+  Statistics::enable (true);
+  Statistics::reset ();
+  BOOST_CHECK_EQUAL (Statistics::count (Statistics::CREATE_COPY), 0u);
+  countCalls (5);
+  BOOST_CHECK_EQUAL (Statistics::count (Statistics::CREATE_COPY), 5u);
+  BOOST_CHECK_EQUAL (Statistics::nbSamples (Statistics::CREATE_COPY), 5u);
+
+  for (std::size_t round = 0; round < 3; ++round) {
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < 4; ++i) {
+      threads.create_thread (boost::bind (&countCalls, 10));
+    }
+    threads.join_all ();
+  }
+  BOOST_CHECK_EQUAL (Statistics::count (Statistics::CREATE_COPY), 125u);
+  BOOST_CHECK (Statistics::percentile (Statistics::CREATE_COPY, 50) > 0);
+  // Only the main thread is still running.
+  BOOST_CHECK (written ().find ("\"threads\": 1,") != std::string::npos);
+
+  Statistics::reset ();
+  BOOST_CHECK_EQUAL (Statistics::count (Statistics::CREATE_COPY), 0u);
+  BOOST_CHECK_EQUAL (Statistics::percentile (Statistics::CREATE_COPY, 50), 0);
+  countCalls (2);
+  BOOST_CHECK_EQUAL (Statistics::count (Statistics::CREATE_COPY), 2u);
+
+  // Without histograms, calls are only counted.
+  Statistics::enable (false);
+  boost::thread thread (boost::bind (&countCalls, 3));
+  thread.join ();
+  BOOST_CHECK_EQUAL (Statistics::count (Statistics::CREATE_COPY), 5u);
+  BOOST_CHECK_EQUAL (Statistics::nbSamples (Statistics::CREATE_COPY), 2u);
+}
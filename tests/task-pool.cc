@@ -0,0 +1,96 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#define BOOST_TEST_MODULE TASK_POOL
+#include <boost/test/unit_test.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "hpp/model/exception.hh"
+
+#include "task-pool.hh"
+
+using hpp::model::Exception;
+using hpp::model::TaskPool;
+
+namespace {
+  void square (std::size_t i, std::vector<std::size_t>* results)
+  {
+    boost::this_thread::yield ();
+    (*results) [i] = i * i;
+  }
+
+  void fail (std::size_t i)
+  {
+    std::ostringstream error;
+    error << "task " << i;
+    throw std::runtime_error (error.str ());
+  }
+} // namespace
+
+// Every task pushed is finished when wait () returns, with any number of
+// threads.
+BOOST_AUTO_TEST_CASE (wait)
+{
+  const std::size_t nbTasks = 1000;
+  for (std::size_t nbThreads = 0; nbThreads < 5; ++nbThreads) {
+    TaskPool pool (nbThreads);
+    BOOST_CHECK_EQUAL (pool.nbThreads (), nbThreads);
+    for (std::size_t round = 0; round < 3; ++round) {
+      std::vector<std::size_t> results (nbTasks, 0);
+      for (std::size_t i = 0; i < nbTasks; ++i) {
+	pool.push (boost::bind (&square, i, &results));
+      }
+      pool.wait ();
+      for (std::size_t i = 0; i < nbTasks; ++i) {
+	BOOST_CHECK_EQUAL (results [i], i * i);
+      }
+    }
+  }
+}
+
+// wait () reports the error of the first failing task in push order,
+// then the pool is usable again.
+BOOST_AUTO_TEST_CASE (errors)
+{
+  TaskPool pool (4);
+  std::vector<std::size_t> results (100, 0);
+  for (std::size_t i = 0; i < 100; ++i) {
+    if (i == 40 || i == 70) {
+      pool.push (boost::bind (&fail, i));
+    } else {
+      pool.push (boost::bind (&square, i, &results));
+    }
+  }
+  try {
+    pool.wait ();
+    BOOST_ERROR ("wait () should have thrown");
+  } catch (const Exception& exception) {
+    BOOST_CHECK_EQUAL (std::string (exception.what ()), "task 40");
+  }
+  BOOST_CHECK_EQUAL (results [99], 99u * 99u);
+
+  pool.push (boost::bind (&square, 3, &results));
+  BOOST_CHECK_NO_THROW (pool.wait ());
+}
@@ -0,0 +1,128 @@
+///
+/// Copyright (c) 2013 CNRS
+/// Authors: Florent Lamiraux
+///
+///
+// This file is part of hpp-model
+// hpp-model is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// hpp-model is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Lesser Public License for more details.  You should have
+// received a copy of the GNU Lesser General Public License along with
+// hpp-model  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#define BOOST_TEST_MODULE TRACE
+#include <boost/test/unit_test.hpp>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "hpp/model/exception.hh"
+#include "hpp/model/trace.hh"
+
+using boost::property_tree::ptree;
+using hpp::model::Exception;
+using hpp::model::Trace;
+
+namespace {
+  ptree readTrace (const std::string& filename)
+  {
+    std::ifstream file (filename.c_str ());
+    BOOST_REQUIRE (file);
+    ptree result;
+    BOOST_REQUIRE_NO_THROW (boost::property_tree::read_json (file, result));
+    return result;
+  }
+
+  // Find the event called name in a trace.
+  const ptree* event (const ptree& trace, const std::string& name)
+  {
+    for (ptree::const_iterator it = trace.begin (); it != trace.end ();
+	 ++it) {
+      if (it->second.get<std::string> ("name", "") == name) {
+	return &it->second;
+      }
+    }
+    return 0;
+  }
+} // namespace
+
+// Spans finished between start () and stop () are written as complete
+// events of a valid trace-event file, other spans are dropped.
+BOOST_AUTO_TEST_CASE (spans)
+{
+  const std::string filename ("./trace-spans.json");
+  BOOST_CHECK (!Trace::isEnabled ());
+  {
+    Trace::Span span ("device", "before-start");
+  }
+  Trace::start (filename);
+  BOOST_CHECK (Trace::isEnabled ());
+  BOOST_CHECK_THROW (Trace::start (filename), Exception);
+  {
+    Trace::Span span ("device", "no-argument");
+  }
+  {
+    Trace::Span span ("distance", "integer", "pairs", 42);
+  }
+  {
+    Trace::Span span ("parser", "string", "file", "a \"b\" \\c\n");
+  }
+  {
+    // Started before stop (), finished after.
+    Trace::Span span ("device", "interrupted");
+    Trace::stop ();
+  }
+  BOOST_CHECK (!Trace::isEnabled ());
+  {
+    Trace::Span span ("device", "after-stop");
+  }
+  Trace::stop ();
+
+  const ptree trace = readTrace (filename);
+  BOOST_CHECK_EQUAL (trace.size (), 3u);
+  BOOST_CHECK (!event (trace, "before-start"));
+  BOOST_CHECK (!event (trace, "interrupted"));
+  BOOST_CHECK (!event (trace, "after-stop"));
+
+  const ptree* noArgument = event (trace, "no-argument");
+  BOOST_REQUIRE (noArgument);
+  BOOST_CHECK_EQUAL (noArgument->get<std::string> ("cat"), "device");
+  BOOST_CHECK_EQUAL (noArgument->get<std::string> ("ph"), "X");
+  BOOST_CHECK (noArgument->get<double> ("ts") > 0);
+  BOOST_CHECK (noArgument->get<double> ("dur") >= 0);
+  BOOST_CHECK_EQUAL (noArgument->get<long> ("pid"), long (getpid ()));
+  BOOST_CHECK (noArgument->get<long> ("tid") > 0);
+  BOOST_CHECK (!noArgument->get_child_optional ("args"));
+
+  const ptree* integer = event (trace, "integer");
+  BOOST_REQUIRE (integer);
+  BOOST_CHECK_EQUAL (integer->get<std::string> ("cat"), "distance");
+  BOOST_CHECK_EQUAL (integer->get<long> ("args.pairs"), 42);
+
+  // Quotes and backslashes are escaped, control characters dropped.
+  const ptree* string = event (trace, "string");
+  BOOST_REQUIRE (string);
+  BOOST_CHECK_EQUAL (string->get<std::string> ("args.file"), "a \"b\" \\c");
+
+  // Tracing can be started again.
+  Trace::start (filename);
+  {
+    Trace::Span span ("device", "restarted");
+  }
+  Trace::stop ();
+  const ptree restarted = readTrace (filename);
+  BOOST_CHECK_EQUAL (restarted.size (), 1u);
+  BOOST_CHECK (event (restarted, "restarted"));
+}